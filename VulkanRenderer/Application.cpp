@@ -1,29 +1,64 @@
 #include "Application.h"
 
-#include <thread>
 #include <chrono>
+#include <iostream>
 
 using namespace std;
 
 namespace application {
 
-   void Application::Initialise()
+   void Application::Initialise(const RendererSettings& rendererSettings)
    {
-      pWindow = new RenderWindow();
+      settings = rendererSettings;
+
+      pRenderer = new HelloTriangle(settings);
+      pRenderer->Initialise();
    }
 
    void Application::MainLoop()
    {
-      while (!glfwWindowShouldClose(pWindow->Get()))
+      auto startTime = chrono::high_resolution_clock::now();
+
+      while (!pRenderer->ShouldClose())
       {
-         glfwPollEvents();
+         // There is no window to pump messages for when running headless
+         if (!settings.headless)
+         {
+            // Nothing can be drawn while minimised, so sleep until the
+            // window comes back rather than spin
+            if (pRenderer->IsMinimised())
+            {
+               glfwWaitEvents();
+               continue;
+            }
+
+            glfwPollEvents();
+         }
 
-         this_thread::sleep_for(chrono::milliseconds(250));
+         pRenderer->DrawFrame();
       }
+
+      chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - startTime;
+
+      // Attempts abandoned for a stale swap chain are not counted
+      uint32_t frameCount = pRenderer->GetFrameTimings().frameCount;
+
+      if (elapsed.count() > 0.0)
+      {
+         cout << "Rendered " << frameCount << " frames in " << elapsed.count() << " s ("
+            << frameCount / elapsed.count() << " fps)" << endl;
+      }
+
+      pRenderer->PrintFrameReport(cout);
    }
 
    void Application::Destroy()
    {
-      pWindow->Destroy();
+      if (pRenderer)
+      {
+         pRenderer->CleanUp();
+         delete pRenderer;
+         pRenderer = nullptr;
+      }
    }
 }
\ No newline at end of file
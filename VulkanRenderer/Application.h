@@ -1,5 +1,5 @@
 #pragma once
-#include "Window/RenderWindow.h"
+#include "Window/HelloTriangle.h"
 
 using namespace renderer;
 
@@ -7,12 +7,13 @@ namespace application {
 
    class Application {
    public:
-      void Initialise();
+      void Initialise(const RendererSettings& settings);
       void MainLoop();
       void Destroy();
 
    private:
 
-      RenderWindow* pWindow;
+      RendererSettings settings;
+      HelloTriangle* pRenderer = nullptr;
    };
 }
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "CullingBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+using namespace scene;
+
+namespace benchmark {
+
+   namespace {
+      const float ObjectSpacing = 3.0f;
+   }
+
+   void CullingBenchmark::FillScene(SceneStore& store, uint32_t objectCount)
+   {
+      mt19937 random(1234);
+      float halfExtent = 0.5f * ObjectSpacing * cbrt((float)objectCount);
+      uniform_real_distribution<float> position(-halfExtent, halfExtent);
+      uniform_real_distribution<float> radius(0.5f, 1.5f);
+
+      store.Clear();
+      store.Reserve(objectCount);
+
+      for (uint32_t i = 0; i < objectCount; i++)
+      {
+         glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), position(random)));
+         store.Add(transform, glm::vec3(0.0f), radius(random));
+      }
+   }
+
+   Frustum CullingBenchmark::CameraFrustum(uint32_t objectCount)
+   {
+      float halfExtent = 0.5f * ObjectSpacing * cbrt((float)objectCount);
+      glm::vec3 eye(halfExtent, 0.25f * halfExtent, 0.0f);
+
+      glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 4.0f * halfExtent);
+      glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+      projection[1][1] *= -1.0f;
+
+      return Frustum::FromViewProjection(projection * view);
+   }
+
+   int CullingBenchmark::Run(int iterations)
+   {
+      const uint32_t objectCounts[] = { 10000, 100000, 1000000 };
+      const CullKernel kernels[] = { CullKernel::Scalar, CullKernel::Sse, CullKernel::Avx2 };
+
+      printf("%-10s %-8s %12s %12s %12s\n", "objects", "kernel", "mean ms", "best ms", "visible");
+
+      SceneStore store;
+      vector<uint32_t> expected;
+      vector<uint32_t> visible;
+      uint32_t visibleCount = 0;
+      bool allMatch = true;
+
+      for (uint32_t objectCount : objectCounts)
+      {
+         FillScene(store, objectCount);
+         Frustum frustum = CameraFrustum(objectCount);
+         expected.resize(store.Cull(frustum, expected, CullKernel::Scalar));
+
+         for (CullKernel kernel : kernels)
+         {
+            if (!SceneStore::IsSupported(kernel))
+            {
+               printf("%-10u %-8s %12s\n", objectCount, SceneStore::KernelName(kernel), "unsupported");
+               continue;
+            }
+
+            double totalMs = 0.0;
+            double bestMs = 0.0;
+
+            for (int i = 0; i < iterations; i++)
+            {
+               auto start = chrono::high_resolution_clock::now();
+               visibleCount = store.Cull(frustum, visible, kernel);
+               chrono::duration<double, milli> elapsed = chrono::high_resolution_clock::now() - start;
+
+               totalMs += elapsed.count();
+               bestMs = i == 0 ? elapsed.count() : min(bestMs, elapsed.count());
+            }
+
+            bool matches = visibleCount == expected.size() && equal(expected.begin(), expected.end(), visible.begin());
+            allMatch = allMatch && matches;
+
+            printf("%-10u %-8s %12.4f %12.4f %12u%s\n", objectCount, SceneStore::KernelName(kernel),
+               iterations > 0 ? totalMs / iterations : 0.0, bestMs, visibleCount, matches ? "" : "  MISMATCH");
+         }
+      }
+
+      return allMatch ? EXIT_SUCCESS : EXIT_FAILURE;
+   }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+
+#include "../Scene/SceneStore.h"
+
+namespace benchmark {
+
+   // Times frustum culling a SceneStore of 10k, 100k and 1M objects with
+   // each kernel the CPU supports, and checks the SIMD kernels produce
+   // the same visible list as the scalar one. The objects fill a cube the
+   // way the GPU driven instances do, seen from just inside its edge.
+   class CullingBenchmark {
+   public:
+      int Run(int iterations);
+
+      // Seeded, so every run culls the same scene
+      static void FillScene(scene::SceneStore& store, uint32_t objectCount);
+      static scene::Frustum CameraFrustum(uint32_t objectCount);
+   };
+}
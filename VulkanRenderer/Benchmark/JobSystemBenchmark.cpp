@@ -0,0 +1,144 @@
+#include "JobSystemBenchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "../Scene/SceneStore.h"
+#include "../Threading/JobSystem.h"
+#include "CullingBenchmark.h"
+
+using namespace std;
+using namespace scene;
+using namespace threading;
+
+namespace benchmark {
+
+   namespace {
+      const uint32_t SmallJobCount = 16 * 1024;
+      const uint32_t CullObjectCount = 1000000;
+
+      // Roughly a microsecond of arithmetic the compiler cannot drop
+      uint32_t SmallWork(uint32_t seed)
+      {
+         uint32_t value = seed;
+
+         for (int i = 0; i < 256; i++)
+         {
+            value = value * 1664525u + 1013904223u;
+         }
+
+         return value;
+      }
+
+      struct Timing
+      {
+         double meanMs = 0.0;
+         double bestMs = 0.0;
+      };
+
+      Timing Time(int iterations, const function<void()>& body)
+      {
+         Timing timing;
+
+         for (int i = 0; i < iterations; i++)
+         {
+            auto start = chrono::high_resolution_clock::now();
+            body();
+            chrono::duration<double, milli> elapsed = chrono::high_resolution_clock::now() - start;
+
+            timing.meanMs += elapsed.count() / iterations;
+            timing.bestMs = i == 0 ? elapsed.count() : min(timing.bestMs, elapsed.count());
+         }
+
+         return timing;
+      }
+   }
+
+   int JobSystemBenchmark::Run(int iterations)
+   {
+      iterations = max(iterations, 1);
+
+      vector<uint32_t> threadCounts;
+      uint32_t hardwareThreads = max(thread::hardware_concurrency(), 1u);
+
+      for (uint32_t threadCount = 1; threadCount < hardwareThreads; threadCount *= 2)
+      {
+         threadCounts.push_back(threadCount);
+      }
+
+      threadCounts.push_back(hardwareThreads);
+
+      SceneStore store;
+      CullingBenchmark::FillScene(store, CullObjectCount);
+      Frustum frustum = CullingBenchmark::CameraFrustum(CullObjectCount);
+
+      vector<uint32_t> expected;
+      expected.resize(store.Cull(frustum, expected));
+
+      printf("%-8s %-12s %12s %12s %10s %10s\n", "threads", "test", "mean ms", "best ms", "speed up", "stolen");
+
+      double smallJobsBaseMs = 0.0;
+      double cullBaseMs = 0.0;
+      bool allMatch = true;
+
+      for (uint32_t threadCount : threadCounts)
+      {
+         JobSystem jobs;
+         jobs.Initialise(threadCount);
+
+         atomic<uint32_t> sink{ 0 };
+         uint64_t stolenBefore = jobs.GetStatistics().jobsStolen;
+
+         // Spawned from the main thread, which is job thread 0, so they
+         // land on its own deque and every other thread has to steal them
+         Timing smallJobs = Time(iterations, [&]
+         {
+            JobCounter counter;
+
+            for (uint32_t i = 0; i < SmallJobCount; i++)
+            {
+               jobs.Run([&sink, i] { sink.fetch_add(SmallWork(i), memory_order_relaxed); }, &counter);
+            }
+
+            jobs.Wait(counter);
+         });
+
+         uint64_t smallJobsStolen = (jobs.GetStatistics().jobsStolen - stolenBefore) / iterations;
+         stolenBefore = jobs.GetStatistics().jobsStolen;
+
+         vector<uint32_t> visible;
+         uint32_t visibleCount = 0;
+
+         Timing cull = Time(iterations, [&]
+         {
+            visibleCount = store.Cull(frustum, visible, jobs);
+         });
+
+         uint64_t cullStolen = (jobs.GetStatistics().jobsStolen - stolenBefore) / iterations;
+
+         if (threadCount == 1)
+         {
+            smallJobsBaseMs = smallJobs.meanMs;
+            cullBaseMs = cull.meanMs;
+         }
+
+         bool matches = visibleCount == expected.size() && equal(expected.begin(), expected.end(), visible.begin());
+         allMatch = allMatch && matches;
+
+         printf("%-8u %-12s %12.4f %12.4f %9.2fx %10llu\n", threadCount, "small jobs",
+            smallJobs.meanMs, smallJobs.bestMs, smallJobsBaseMs / smallJobs.meanMs, (unsigned long long)smallJobsStolen);
+         printf("%-8u %-12s %12.4f %12.4f %9.2fx %10llu%s\n", threadCount, "cull 1M",
+            cull.meanMs, cull.bestMs, cullBaseMs / cull.meanMs, (unsigned long long)cullStolen, matches ? "" : "  MISMATCH");
+
+         jobs.Destroy();
+      }
+
+      return allMatch ? EXIT_SUCCESS : EXIT_FAILURE;
+   }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace benchmark {
+
+   // Times the job system with 1, 2, 4... threads up to one per hardware
+   // thread, reporting the speed up over one thread. Small jobs show the
+   // cost of scheduling and stealing, and culling 1M objects shows a real
+   // frame task split into jobs, checked against a serial cull.
+   class JobSystemBenchmark {
+   public:
+      int Run(int iterations);
+   };
+}
@@ -0,0 +1,169 @@
+#include "MeshLoadBenchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include "../Mesh/MeshFile.h"
+#include "../Mesh/ObjParser.h"
+
+using namespace std;
+using namespace mesh;
+
+namespace benchmark {
+
+   namespace {
+      const char* GeneratedObjPath = "Data/mesh_benchmark.obj";
+      const char* ConvertedMeshPath = "Data/mesh_benchmark.vmesh";
+
+      // A UV sphere of about a million triangles, coloured by normal
+      void WriteSphereObj(const string& path, uint32_t rings, uint32_t segments)
+      {
+         ofstream file(path);
+
+         if (!file.is_open())
+         {
+            throw runtime_error("Failed to create " + path);
+         }
+
+         const float pi = 3.14159265f;
+
+         for (uint32_t ring = 0; ring <= rings; ring++)
+         {
+            float phi = pi * ring / rings;
+
+            for (uint32_t segment = 0; segment <= segments; segment++)
+            {
+               float theta = 2.0f * pi * segment / segments;
+               float x = sin(phi) * cos(theta);
+               float y = cos(phi);
+               float z = sin(phi) * sin(theta);
+               file << "v " << x << " " << y << " " << z << " "
+                  << 0.5f * x + 0.5f << " " << 0.5f * y + 0.5f << " " << 0.5f * z + 0.5f << "\n";
+            }
+         }
+
+         for (uint32_t ring = 0; ring < rings; ring++)
+         {
+            for (uint32_t segment = 0; segment < segments; segment++)
+            {
+               uint32_t a = ring * (segments + 1) + segment + 1;
+               uint32_t b = a + segments + 1;
+               file << "f " << a << " " << a + 1 << " " << b + 1 << " " << b << "\n";
+            }
+         }
+      }
+
+      double ElapsedMs(chrono::high_resolution_clock::time_point start)
+      {
+         chrono::duration<double, milli> elapsed = chrono::high_resolution_clock::now() - start;
+         return elapsed.count();
+      }
+
+      // Stands in for the upload engine's copy into the staging ring
+      void CopyToStaging(vector<char>& staging, const MeshView& view)
+      {
+         size_t vertexBytes = view.vertexCount * sizeof(PackedVertex);
+         size_t indexBytes = view.indexCount * sizeof(uint32_t);
+         staging.resize(vertexBytes + indexBytes);
+         memcpy(staging.data(), view.pVertices, vertexBytes);
+         memcpy(staging.data() + vertexBytes, view.pIndices, indexBytes);
+      }
+
+      // Parses, quantises and copies, everything a text loader would do at load time
+      double LoadObj(const string& path, vector<char>& staging)
+      {
+         auto start = chrono::high_resolution_clock::now();
+
+         PackedMesh packed = Quantise(ParseObj(path));
+         CopyToStaging(staging, packed.View());
+
+         return ElapsedMs(start);
+      }
+
+      double LoadRead(const string& path, vector<char>& staging)
+      {
+         auto start = chrono::high_resolution_clock::now();
+
+         ifstream file(path, ios::ate | ios::binary);
+
+         if (!file.is_open())
+         {
+            throw runtime_error("Failed to open " + path);
+         }
+
+         vector<char> buffer((size_t)file.tellg());
+         file.seekg(0);
+         file.read(buffer.data(), buffer.size());
+
+         const MeshFileHeader* pHeader = reinterpret_cast<const MeshFileHeader*>(buffer.data());
+         MeshView view;
+         view.pVertices = reinterpret_cast<const PackedVertex*>(buffer.data() + pHeader->vertexOffset);
+         view.vertexCount = pHeader->vertexCount;
+         view.pIndices = reinterpret_cast<const uint32_t*>(buffer.data() + pHeader->indexOffset);
+         view.indexCount = pHeader->indexCount;
+         CopyToStaging(staging, view);
+
+         return ElapsedMs(start);
+      }
+
+      double LoadMapped(const string& path, vector<char>& staging)
+      {
+         auto start = chrono::high_resolution_clock::now();
+
+         MeshFile file;
+         file.Open(path);
+         CopyToStaging(staging, file.View());
+
+         return ElapsedMs(start);
+      }
+   }
+
+   int MeshLoadBenchmark::Run(const string& objPath, int iterations)
+   {
+      string sourcePath = objPath;
+
+      if (sourcePath.empty())
+      {
+         sourcePath = GeneratedObjPath;
+         WriteSphereObj(sourcePath, 512, 1024);
+      }
+
+      PackedMesh packed = Quantise(ParseObj(sourcePath));
+      WriteMeshFile(ConvertedMeshPath, packed);
+
+      printf("%s: %zu vertices, %zu triangles\n", sourcePath.c_str(), packed.vertices.size(), packed.indices.size() / 3);
+      printf("%-10s %14s %14s %14s\n", "iteration", "obj ms", "read ms", "mapped ms");
+
+      // Staging is kept across loads so its allocation is not timed
+      vector<char> staging;
+      double objTotal = 0.0;
+      double readTotal = 0.0;
+      double mappedTotal = 0.0;
+
+      for (int i = 0; i < iterations; i++)
+      {
+         double objMs = LoadObj(sourcePath, staging);
+         double readMs = LoadRead(ConvertedMeshPath, staging);
+         double mappedMs = LoadMapped(ConvertedMeshPath, staging);
+
+         printf("%-10d %14.3f %14.3f %14.3f\n", i, objMs, readMs, mappedMs);
+
+         objTotal += objMs;
+         readTotal += readMs;
+         mappedTotal += mappedMs;
+      }
+
+      if (iterations > 0)
+      {
+         printf("%-10s %14.3f %14.3f %14.3f\n", "mean", objTotal / iterations, readTotal / iterations, mappedTotal / iterations);
+      }
+
+      return EXIT_SUCCESS;
+   }
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+
+namespace benchmark {
+
+   // Times getting a mesh from disk into staging memory three ways: parsing
+   // the OBJ, reading the .vmesh into a heap buffer the way
+   // Shader::ReadFile does, and mapping the .vmesh and copying from the
+   // mapped pages. With no OBJ given it writes a large sphere to convert.
+   //
+   // After the first iteration the file is in the OS cache, so these are
+   // warm cache numbers. The mapped load pulls ahead further from a cold
+   // cache, since its reads start as soon as the file is opened.
+   class MeshLoadBenchmark {
+   public:
+      int Run(const std::string& objPath, int iterations);
+   };
+}
@@ -0,0 +1,48 @@
+#include "RecordingBenchmark.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace std;
+using namespace renderer;
+
+namespace benchmark {
+
+   int RecordingBenchmark::Run(const RendererSettings& settings, uint32_t drawCount, uint32_t frameCount)
+   {
+      const uint32_t threadCounts[] = { 1, 2, 4, 8, 16 };
+      double baselineMs = 0.0;
+
+      printf("%u draws, %u frames, %u hardware threads\n", drawCount, frameCount, thread::hardware_concurrency());
+      printf("%-10s %14s %14s\n", "threads", "record ms", "speedup");
+
+      for (uint32_t threadCount : threadCounts)
+      {
+         RendererSettings runSettings = settings;
+         runSettings.headless = true;
+         runSettings.workerCount = threadCount;
+         runSettings.drawCount = drawCount;
+
+         HelloTriangle renderer(runSettings);
+         renderer.Initialise();
+
+         for (uint32_t i = 0; i < frameCount; i++)
+         {
+            renderer.DrawFrame();
+         }
+
+         double recordMs = renderer.GetFrameTimings().MeanRecordMs();
+         renderer.CleanUp();
+
+         if (threadCount == 1)
+         {
+            baselineMs = recordMs;
+         }
+
+         printf("%-10u %14.3f %13.2fx\n", threadCount, recordMs, recordMs > 0.0 ? baselineMs / recordMs : 0.0);
+      }
+
+      return EXIT_SUCCESS;
+   }
+}
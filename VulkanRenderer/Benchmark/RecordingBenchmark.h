@@ -0,0 +1,14 @@
+#pragma once
+#include "../Window/HelloTriangle.h"
+
+namespace benchmark {
+
+   // Renders the same draw list headless with 1 to 16 recording threads
+   // and reports CPU recording time per frame against the single threaded
+   // run. Only recording is timed, so GPU throughput does not skew the
+   // numbers.
+   class RecordingBenchmark {
+   public:
+      int Run(const renderer::RendererSettings& settings, uint32_t drawCount, uint32_t frameCount);
+   };
+}
@@ -0,0 +1,66 @@
+#include "StartupBenchmark.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+using namespace renderer;
+
+namespace benchmark {
+
+   namespace {
+      StartupTimings MeasureStartup(const RendererSettings& settings)
+      {
+         HelloTriangle renderer(settings);
+         renderer.Initialise();
+         StartupTimings timings = renderer.GetStartupTimings();
+         renderer.CleanUp();
+
+         return timings;
+      }
+   }
+
+   int StartupBenchmark::Run(const RendererSettings& settings, int iterations)
+   {
+      StartupTimings coldTotal;
+      StartupTimings warmTotal;
+
+      printf("%-10s %14s %14s %14s %14s\n", "iteration", "cold init ms", "cold pso ms", "warm init ms", "warm pso ms");
+
+      for (int i = 0; i < iterations; i++)
+      {
+         error_code error;
+         filesystem::remove(settings.pipelineCachePath, error);
+
+         // First run compiles from scratch and writes the cache on shutdown,
+         // the second run should pick it up
+         StartupTimings cold = MeasureStartup(settings);
+         StartupTimings warm = MeasureStartup(settings);
+
+         if (cold.pipelineCacheWarm || !warm.pipelineCacheWarm)
+         {
+            cerr << "Pipeline cache was not used as expected on iteration " << i << endl;
+         }
+
+         printf("%-10d %14.3f %14.3f %14.3f %14.3f\n", i,
+            cold.initialiseVulkanMs, cold.graphicsPipelineMs,
+            warm.initialiseVulkanMs, warm.graphicsPipelineMs);
+
+         coldTotal.initialiseVulkanMs += cold.initialiseVulkanMs;
+         coldTotal.graphicsPipelineMs += cold.graphicsPipelineMs;
+         warmTotal.initialiseVulkanMs += warm.initialiseVulkanMs;
+         warmTotal.graphicsPipelineMs += warm.graphicsPipelineMs;
+      }
+
+      if (iterations > 0)
+      {
+         printf("%-10s %14.3f %14.3f %14.3f %14.3f\n", "mean",
+            coldTotal.initialiseVulkanMs / iterations, coldTotal.graphicsPipelineMs / iterations,
+            warmTotal.initialiseVulkanMs / iterations, warmTotal.graphicsPipelineMs / iterations);
+      }
+
+      return EXIT_SUCCESS;
+   }
+}
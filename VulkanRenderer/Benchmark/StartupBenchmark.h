@@ -0,0 +1,16 @@
+#pragma once
+#include "../Window/HelloTriangle.h"
+
+namespace benchmark {
+
+   // Measures renderer startup with an empty pipeline cache against startup
+   // with the cache written by the previous run.
+   //
+   // Drivers can keep their own shader cache as well (Mesa, including
+   // lavapipe, does unless MESA_SHADER_CACHE_DISABLE=true is set), which
+   // will make the cold numbers look warmer than a first launch really is.
+   class StartupBenchmark {
+   public:
+      int Run(const renderer::RendererSettings& settings, int iterations);
+   };
+}
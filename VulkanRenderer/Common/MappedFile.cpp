@@ -0,0 +1,196 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace common {
+
+   MappedFile::~MappedFile()
+   {
+      Close();
+   }
+
+   MappedFile::MappedFile(MappedFile&& other) noexcept
+   {
+      *this = move(other);
+   }
+
+   MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+   {
+      if (this != &other)
+      {
+         Close();
+
+         _pData = exchange(other._pData, nullptr);
+         _size = exchange(other._size, 0);
+         _isOpen = exchange(other._isOpen, false);
+#ifdef _WIN32
+         _file = exchange(other._file, nullptr);
+         _mapping = exchange(other._mapping, nullptr);
+#endif
+      }
+
+      return *this;
+   }
+
+#ifdef _WIN32
+   bool MappedFile::Open(const string& path)
+   {
+      Close();
+
+      HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+      if (file == INVALID_HANDLE_VALUE)
+      {
+         return false;
+      }
+
+      LARGE_INTEGER size;
+
+      if (!GetFileSizeEx(file, &size))
+      {
+         CloseHandle(file);
+         return false;
+      }
+
+      _file = file;
+      _size = (size_t)size.QuadPart;
+      _isOpen = true;
+
+      // An empty file cannot be mapped, but is still a valid file
+      if (_size == 0)
+      {
+         return true;
+      }
+
+      _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+      if (_mapping == nullptr)
+      {
+         Close();
+         return false;
+      }
+
+      _pData = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+
+      if (_pData == nullptr)
+      {
+         Close();
+         return false;
+      }
+
+      return true;
+   }
+
+   void MappedFile::Close()
+   {
+      if (_pData)
+      {
+         UnmapViewOfFile(_pData);
+      }
+
+      if (_mapping)
+      {
+         CloseHandle(_mapping);
+      }
+
+      if (_file)
+      {
+         CloseHandle(_file);
+      }
+
+      _pData = nullptr;
+      _mapping = nullptr;
+      _file = nullptr;
+      _size = 0;
+      _isOpen = false;
+   }
+
+   void MappedFile::WillNeed()
+   {
+      if (_pData == nullptr)
+      {
+         return;
+      }
+
+      WIN32_MEMORY_RANGE_ENTRY range = { const_cast<uint8_t*>(_pData), _size };
+      PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+   }
+#else
+   bool MappedFile::Open(const string& path)
+   {
+      Close();
+
+      int file = open(path.c_str(), O_RDONLY);
+
+      if (file < 0)
+      {
+         return false;
+      }
+
+      struct stat status;
+
+      if (fstat(file, &status) != 0)
+      {
+         close(file);
+         return false;
+      }
+
+      _size = (size_t)status.st_size;
+      _isOpen = true;
+
+      // An empty file cannot be mapped, but is still a valid file
+      if (_size > 0)
+      {
+         void* pMapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, file, 0);
+
+         if (pMapped == MAP_FAILED)
+         {
+            close(file);
+            Close();
+            return false;
+         }
+
+         _pData = static_cast<const uint8_t*>(pMapped);
+      }
+
+      // The mapping keeps its own reference to the file
+      close(file);
+
+      return true;
+   }
+
+   void MappedFile::Close()
+   {
+      if (_pData)
+      {
+         munmap(const_cast<uint8_t*>(_pData), _size);
+      }
+
+      _pData = nullptr;
+      _size = 0;
+      _isOpen = false;
+   }
+
+   void MappedFile::WillNeed()
+   {
+      if (_pData)
+      {
+         madvise(const_cast<uint8_t*>(_pData), _size, MADV_WILLNEED);
+      }
+   }
+#endif
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace common {
+
+   // A read only view of a whole file mapped into the address space. Pages
+   // are faulted in from the OS file cache as they are touched, so nothing
+   // is read up front and nothing is copied into a heap buffer.
+   class MappedFile {
+   public:
+      MappedFile() = default;
+      ~MappedFile();
+
+      MappedFile(const MappedFile&) = delete;
+      MappedFile& operator=(const MappedFile&) = delete;
+      MappedFile(MappedFile&& other) noexcept;
+      MappedFile& operator=(MappedFile&& other) noexcept;
+
+      // Returns false if the file cannot be opened or mapped
+      bool Open(const std::string& path);
+      void Close();
+
+      // Hints that the whole file is about to be read front to back
+      void WillNeed();
+
+      bool IsOpen() const { return _isOpen; }
+      const uint8_t* Data() const { return _pData; }
+      size_t Size() const { return _size; }
+
+   private:
+      const uint8_t* _pData = nullptr;
+      size_t _size = 0;
+      bool _isOpen = false;
+
+#ifdef _WIN32
+      void* _file = nullptr;
+      void* _mapping = nullptr;
+#endif
+   };
+}
@@ -0,0 +1,295 @@
+#include "BindlessDescriptors.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace descriptor {
+
+   bool BindlessDescriptors::QuerySupport(const VkPhysicalDevice& physicalDevice, VkPhysicalDeviceDescriptorIndexingFeaturesEXT& features)
+   {
+      uint32_t extensionCount = 0;
+      vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+      vector<VkExtensionProperties> extensions(extensionCount);
+      vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+      bool hasExtension = any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties& extension)
+      {
+         return strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0;
+      });
+
+      if (!hasExtension)
+      {
+         return false;
+      }
+
+      VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {};
+      supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+      VkPhysicalDeviceFeatures2 features2 = {};
+      features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features2.pNext = &supported;
+      vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+      bool isSupported = supported.runtimeDescriptorArray &&
+         supported.descriptorBindingPartiallyBound &&
+         supported.descriptorBindingUpdateUnusedWhilePending &&
+         supported.descriptorBindingSampledImageUpdateAfterBind &&
+         supported.descriptorBindingStorageBufferUpdateAfterBind &&
+         supported.shaderSampledImageArrayNonUniformIndexing &&
+         supported.shaderStorageBufferArrayNonUniformIndexing;
+
+      if (!isSupported)
+      {
+         return false;
+      }
+
+      // Only what the bindless set uses, nothing else the device offers
+      features = {};
+      features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+      features.runtimeDescriptorArray = VK_TRUE;
+      features.descriptorBindingPartiallyBound = VK_TRUE;
+      features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+      features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+      features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+      features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+      features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+      return true;
+   }
+
+   void BindlessDescriptors::Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, const VkPhysicalDevice& physicalDevice, uint32_t framesInFlight)
+   {
+      _device = device;
+      _pAllocationCallbacks = pAllocationCallbacks;
+
+      VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+      indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+      VkPhysicalDeviceProperties2 properties = {};
+      properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+      properties.pNext = &indexingProperties;
+      vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+      // Every stage can see the arrays, so the per stage limits apply to
+      // each of them in full
+      _images.capacity = min({ MaxImages, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+         indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages });
+      _buffers.capacity = min({ MaxBuffers, indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+         indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+      _samplers.capacity = min({ MaxSamplers, indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+         indexingProperties.maxDescriptorSetUpdateAfterBindSamplers });
+
+      // The arrays also share one per stage budget. Samplers are few, so
+      // images and buffers split whatever they leave.
+      uint32_t resources = indexingProperties.maxPerStageUpdateAfterBindResources;
+
+      if (_images.capacity + _buffers.capacity + _samplers.capacity > resources)
+      {
+         _samplers.capacity = min(_samplers.capacity, resources);
+         uint32_t remaining = resources - _samplers.capacity;
+         _buffers.capacity = min(_buffers.capacity, remaining / 2);
+         _images.capacity = min(_images.capacity, remaining - _buffers.capacity);
+      }
+
+      for (IndexPool* pool : { &_images, &_buffers, &_samplers })
+      {
+         pool->pending.resize(framesInFlight);
+      }
+
+      VkDescriptorSetLayoutBinding bindings[3] = {};
+      bindings[0] = { ImageBinding, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, _images.capacity, Stages, nullptr };
+      bindings[1] = { BufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _buffers.capacity, Stages, nullptr };
+      bindings[2] = { SamplerBinding, VK_DESCRIPTOR_TYPE_SAMPLER, _samplers.capacity, Stages, nullptr };
+
+      // Slots nothing is registered in are never read, and writing one is
+      // allowed while a frame using the set is still in flight
+      VkDescriptorBindingFlagsEXT bindingFlags[3];
+      fill(begin(bindingFlags), end(bindingFlags), VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+         VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT);
+
+      VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+      bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+      bindingFlagsInfo.bindingCount = 3;
+      bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+      VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+      layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+      layoutInfo.pNext = &bindingFlagsInfo;
+      layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+      layoutInfo.bindingCount = 3;
+      layoutInfo.pBindings = bindings;
+
+      if (vkCreateDescriptorSetLayout(_device, &layoutInfo, _pAllocationCallbacks, &_setLayout) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to create bindless descriptor set layout");
+      }
+
+      VkDescriptorPoolSize poolSizes[3] = {
+         { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, _images.capacity },
+         { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _buffers.capacity },
+         { VK_DESCRIPTOR_TYPE_SAMPLER, _samplers.capacity }
+      };
+
+      VkDescriptorPoolCreateInfo poolInfo = {};
+      poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+      poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+      poolInfo.maxSets = 1;
+      poolInfo.poolSizeCount = 3;
+      poolInfo.pPoolSizes = poolSizes;
+
+      if (vkCreateDescriptorPool(_device, &poolInfo, _pAllocationCallbacks, &_pool) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to create bindless descriptor pool");
+      }
+
+      VkDescriptorSetAllocateInfo allocateInfo = {};
+      allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+      allocateInfo.descriptorPool = _pool;
+      allocateInfo.descriptorSetCount = 1;
+      allocateInfo.pSetLayouts = &_setLayout;
+
+      if (vkAllocateDescriptorSets(_device, &allocateInfo, &_set) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to allocate bindless descriptor set");
+      }
+   }
+
+   void BindlessDescriptors::Destroy()
+   {
+      if (_device == VK_NULL_HANDLE)
+      {
+         return;
+      }
+
+      vkDestroyDescriptorPool(_device, _pool, _pAllocationCallbacks);
+      vkDestroyDescriptorSetLayout(_device, _setLayout, _pAllocationCallbacks);
+
+      _pool = VK_NULL_HANDLE;
+      _set = VK_NULL_HANDLE;
+      _setLayout = VK_NULL_HANDLE;
+      _device = VK_NULL_HANDLE;
+   }
+
+   void BindlessDescriptors::BeginFrame(uint32_t frameSlot)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      for (IndexPool* pool : { &_images, &_buffers, &_samplers })
+      {
+         auto& pending = pool->pending[frameSlot];
+         pool->free.insert(pool->free.end(), pending.begin(), pending.end());
+         pending.clear();
+      }
+   }
+
+   BindlessIndex BindlessDescriptors::IndexPool::Acquire()
+   {
+      if (!free.empty())
+      {
+         BindlessIndex index = free.back();
+         free.pop_back();
+         return index;
+      }
+
+      if (next == capacity)
+      {
+         throw runtime_error("Failed to register bindless resource, the array is full");
+      }
+
+      return next++;
+   }
+
+   BindlessIndex BindlessDescriptors::RegisterImage(VkImageView imageView, VkImageLayout layout)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      BindlessIndex index = _images.Acquire();
+
+      VkDescriptorImageInfo imageInfo = { VK_NULL_HANDLE, imageView, layout };
+
+      VkWriteDescriptorSet write = {};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = _set;
+      write.dstBinding = ImageBinding;
+      write.dstArrayElement = index;
+      write.descriptorCount = 1;
+      write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+      write.pImageInfo = &imageInfo;
+
+      vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+      return index;
+   }
+
+   BindlessIndex BindlessDescriptors::RegisterBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      BindlessIndex index = _buffers.Acquire();
+
+      VkDescriptorBufferInfo bufferInfo = { buffer, offset, range };
+
+      VkWriteDescriptorSet write = {};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = _set;
+      write.dstBinding = BufferBinding;
+      write.dstArrayElement = index;
+      write.descriptorCount = 1;
+      write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      write.pBufferInfo = &bufferInfo;
+
+      vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+      return index;
+   }
+
+   BindlessIndex BindlessDescriptors::RegisterSampler(VkSampler sampler)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      BindlessIndex index = _samplers.Acquire();
+
+      VkDescriptorImageInfo samplerInfo = { sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+
+      VkWriteDescriptorSet write = {};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = _set;
+      write.dstBinding = SamplerBinding;
+      write.dstArrayElement = index;
+      write.descriptorCount = 1;
+      write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+      write.pImageInfo = &samplerInfo;
+
+      vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+      return index;
+   }
+
+   void BindlessDescriptors::ReleaseImage(BindlessIndex index, uint32_t frameSlot)
+   {
+      Release(_images, index, frameSlot);
+   }
+
+   void BindlessDescriptors::ReleaseBuffer(BindlessIndex index, uint32_t frameSlot)
+   {
+      Release(_buffers, index, frameSlot);
+   }
+
+   void BindlessDescriptors::ReleaseSampler(BindlessIndex index, uint32_t frameSlot)
+   {
+      Release(_samplers, index, frameSlot);
+   }
+
+   void BindlessDescriptors::Release(IndexPool& pool, BindlessIndex index, uint32_t frameSlot)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      // Frames already recorded may still index it, so it only comes back
+      // once this slot's fence has signalled
+      pool.pending[frameSlot].push_back(index);
+   }
+
+   void BindlessDescriptors::Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout)
+   {
+      vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, 0, 1, &_set, 0, nullptr);
+   }
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <mutex>
+#include <vector>
+
+#include "../Common/Common.h"
+
+namespace descriptor {
+
+   typedef uint32_t BindlessIndex;
+   static constexpr BindlessIndex InvalidBindlessIndex = UINT32_MAX;
+
+   // What every draw or dispatch pushes in place of binding descriptor
+   // sets. Shaders index the bindless arrays with these.
+   struct BindlessPushConstants
+   {
+      uint32_t drawIndex;
+      BindlessIndex imageIndex;
+      BindlessIndex bufferIndex;
+      BindlessIndex samplerIndex;
+   };
+
+   // One descriptor set holding large arrays of sampled images, storage
+   // buffers and samplers, bound once per command buffer. Resources are
+   // registered for an index into their array, and draws pass indices
+   // through push constants rather than each binding sets of their own.
+   //
+   // Needs descriptor indexing: the arrays are partially bound and updated
+   // after bind, so registering a resource never waits on the GPU. Released
+   // indices are held back until every frame that could still be reading
+   // them has retired.
+   class BindlessDescriptors {
+   public:
+      static constexpr uint32_t ImageBinding = 0;
+      static constexpr uint32_t BufferBinding = 1;
+      static constexpr uint32_t SamplerBinding = 2;
+
+      static constexpr uint32_t MaxImages = 16384;
+      static constexpr uint32_t MaxBuffers = 16384;
+      static constexpr uint32_t MaxSamplers = 64;
+
+      static constexpr VkShaderStageFlags Stages = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+
+      // Fills in the features to enable when creating the device. Returns
+      // false if the device or its driver cannot run bindless.
+      static bool QuerySupport(const VkPhysicalDevice& physicalDevice, VkPhysicalDeviceDescriptorIndexingFeaturesEXT& features);
+
+      void Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, const VkPhysicalDevice& physicalDevice, uint32_t framesInFlight);
+      void Destroy();
+
+      // Once the frame's fence has signalled, frees the indices released
+      // the last time this slot was recorded
+      void BeginFrame(uint32_t frameSlot);
+
+      BindlessIndex RegisterImage(VkImageView imageView, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+      BindlessIndex RegisterBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+      BindlessIndex RegisterSampler(VkSampler sampler);
+
+      // The resource must stay alive until frameSlot comes round again
+      void ReleaseImage(BindlessIndex index, uint32_t frameSlot);
+      void ReleaseBuffer(BindlessIndex index, uint32_t frameSlot);
+      void ReleaseSampler(BindlessIndex index, uint32_t frameSlot);
+
+      // Pipeline layouts put this at set 0 and add PushConstantRange, so
+      // every pipeline can share the one binding
+      VkDescriptorSetLayout SetLayout() { return _setLayout; };
+      static VkPushConstantRange PushConstantRange() { return { Stages, 0, sizeof(BindlessPushConstants) }; };
+
+      void Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout);
+
+   private:
+      // Indices of one array, handed out lowest first
+      struct IndexPool
+      {
+         uint32_t capacity = 0;
+         uint32_t next = 0;
+         std::vector<BindlessIndex> free;
+         std::vector<std::vector<BindlessIndex>> pending;   // Per frame slot
+
+         BindlessIndex Acquire();
+      };
+
+      void Release(IndexPool& pool, BindlessIndex index, uint32_t frameSlot);
+
+      VkDevice _device = VK_NULL_HANDLE;
+      const VkAllocationCallbacks* _pAllocationCallbacks = nullptr;
+      VkDescriptorSetLayout _setLayout = VK_NULL_HANDLE;
+      VkDescriptorPool _pool = VK_NULL_HANDLE;
+      VkDescriptorSet _set = VK_NULL_HANDLE;
+
+      IndexPool _images;
+      IndexPool _buffers;
+      IndexPool _samplers;
+
+      std::mutex _mutex;
+   };
+}
@@ -0,0 +1,147 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace descriptor {
+
+   vector<PoolSizeRatio> DescriptorAllocator::DefaultRatios()
+   {
+      return {
+         { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+         { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+         { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+         { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+         { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2.0f },
+         { VK_DESCRIPTOR_TYPE_SAMPLER, 1.0f },
+         { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f }
+      };
+   }
+
+   void DescriptorAllocator::Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, uint32_t framesInFlight, uint32_t setsPerPool,
+      const vector<PoolSizeRatio>& ratios)
+   {
+      _device = device;
+      _pAllocationCallbacks = pAllocationCallbacks;
+      _ratios = ratios;
+      _nextSetsPerPool = setsPerPool;
+      _frames.resize(framesInFlight);
+   }
+
+   void DescriptorAllocator::Destroy()
+   {
+      for (auto pool : _pools)
+      {
+         vkDestroyDescriptorPool(_device, pool, _pAllocationCallbacks);
+      }
+
+      _pools.clear();
+      _freePools.clear();
+      _frames.clear();
+   }
+
+   void DescriptorAllocator::BeginFrame(uint32_t frameSlot)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      FramePools& frame = _frames[frameSlot];
+
+      if (frame.current != VK_NULL_HANDLE)
+      {
+         frame.full.push_back(frame.current);
+         frame.current = VK_NULL_HANDLE;
+      }
+
+      for (auto pool : frame.full)
+      {
+         vkResetDescriptorPool(_device, pool, 0);
+         _freePools.push_back(pool);
+      }
+
+      frame.full.clear();
+   }
+
+   VkDescriptorSet DescriptorAllocator::Allocate(uint32_t frameSlot, VkDescriptorSetLayout layout)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      FramePools& frame = _frames[frameSlot];
+
+      VkDescriptorSetAllocateInfo allocateInfo = {};
+      allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+      allocateInfo.descriptorSetCount = 1;
+      allocateInfo.pSetLayouts = &layout;
+
+      // A fresh pool can still fail if the layout needs more of one type
+      // than a whole pool holds, so only try twice
+      for (int attempt = 0; attempt < 2; attempt++)
+      {
+         if (frame.current == VK_NULL_HANDLE)
+         {
+            frame.current = AcquirePool();
+         }
+
+         allocateInfo.descriptorPool = frame.current;
+
+         VkDescriptorSet set = VK_NULL_HANDLE;
+         VkResult result = vkAllocateDescriptorSets(_device, &allocateInfo, &set);
+
+         if (result == VK_SUCCESS)
+         {
+            return set;
+         }
+
+         if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+         {
+            break;
+         }
+
+         frame.full.push_back(frame.current);
+         frame.current = VK_NULL_HANDLE;
+      }
+
+      throw runtime_error("Failed to allocate descriptor set");
+   }
+
+   VkDescriptorPool DescriptorAllocator::AcquirePool()
+   {
+      if (!_freePools.empty())
+      {
+         VkDescriptorPool pool = _freePools.back();
+         _freePools.pop_back();
+         return pool;
+      }
+
+      VkDescriptorPool pool = CreatePool(_nextSetsPerPool);
+      _nextSetsPerPool = min(_nextSetsPerPool * 2, MaxSetsPerPool);
+      return pool;
+   }
+
+   VkDescriptorPool DescriptorAllocator::CreatePool(uint32_t setCount)
+   {
+      vector<VkDescriptorPoolSize> poolSizes;
+
+      for (const auto& ratio : _ratios)
+      {
+         poolSizes.push_back({ ratio.type, max(1u, (uint32_t)(ratio.ratio * setCount)) });
+      }
+
+      VkDescriptorPoolCreateInfo poolInfo = {};
+      poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+      poolInfo.maxSets = setCount;
+      poolInfo.poolSizeCount = (uint32_t)poolSizes.size();
+      poolInfo.pPoolSizes = poolSizes.data();
+
+      VkDescriptorPool pool;
+
+      if (vkCreateDescriptorPool(_device, &poolInfo, _pAllocationCallbacks, &pool) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to create descriptor pool");
+      }
+
+      _pools.push_back(pool);
+      return pool;
+   }
+}
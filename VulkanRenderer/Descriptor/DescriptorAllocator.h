@@ -0,0 +1,62 @@
+#pragma once
+#include <mutex>
+#include <vector>
+
+#include "../Common/Common.h"
+
+namespace descriptor {
+
+   // How many descriptors of each type a pool holds, per set it can allocate
+   struct PoolSizeRatio
+   {
+      VkDescriptorType type;
+      float ratio;
+   };
+
+   // Hands out short lived descriptor sets from pools that belong to a frame
+   // in flight. Nothing is freed individually; once the frame's fence has
+   // signalled its pools are reset wholesale and go back on a free list for
+   // any frame to reuse. When a pool runs out another is taken from the free
+   // list, or created at twice the size of the last, so a frame that needs
+   // more sets than usual only pays for it once.
+   class DescriptorAllocator {
+   public:
+      static constexpr uint32_t DefaultSetsPerPool = 64;
+      static constexpr uint32_t MaxSetsPerPool = 4096;
+
+      void Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, uint32_t framesInFlight, uint32_t setsPerPool = DefaultSetsPerPool,
+         const std::vector<PoolSizeRatio>& ratios = DefaultRatios());
+      void Destroy();
+
+      // Once the frame's fence has signalled, recycles everything it allocated
+      void BeginFrame(uint32_t frameSlot);
+
+      // Valid until frameSlot comes round again. Safe to call from any thread.
+      VkDescriptorSet Allocate(uint32_t frameSlot, VkDescriptorSetLayout layout);
+
+      uint32_t PoolCount() { return (uint32_t)_pools.size(); };
+
+      static std::vector<PoolSizeRatio> DefaultRatios();
+
+   private:
+      struct FramePools
+      {
+         std::vector<VkDescriptorPool> full;
+         VkDescriptorPool current = VK_NULL_HANDLE;
+      };
+
+      VkDescriptorPool AcquirePool();
+      VkDescriptorPool CreatePool(uint32_t setCount);
+
+      VkDevice _device = VK_NULL_HANDLE;
+      const VkAllocationCallbacks* _pAllocationCallbacks = nullptr;
+      std::vector<PoolSizeRatio> _ratios;
+      uint32_t _nextSetsPerPool = DefaultSetsPerPool;
+
+      std::vector<VkDescriptorPool> _pools;       // Every pool, for destruction
+      std::vector<VkDescriptorPool> _freePools;   // Reset and ready for any frame
+      std::vector<FramePools> _frames;
+
+      std::mutex _mutex;
+   };
+}
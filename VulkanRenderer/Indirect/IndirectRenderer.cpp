@@ -0,0 +1,458 @@
+#include "IndirectRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "../Profiling/Trace.h"
+#include "../Shader/Shader.h"
+
+using namespace std;
+using namespace descriptor;
+using namespace memory;
+using namespace mesh;
+using namespace pipeline;
+using namespace rendergraph;
+using namespace scene;
+using namespace shader;
+using namespace transfer;
+
+namespace indirect {
+
+   namespace {
+      const VkShaderStageFlags SharedStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+      const uint32_t StorageBindingCount = 4;
+      const uint32_t FrameConstantsBinding = 4;
+
+      bool HasExtension(const VkPhysicalDevice& physicalDevice, const char* name)
+      {
+         uint32_t extensionCount = 0;
+         vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+         vector<VkExtensionProperties> extensions(extensionCount);
+         vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+         return any_of(extensions.begin(), extensions.end(), [&](const VkExtensionProperties& extension)
+         {
+            return strcmp(extension.extensionName, name) == 0;
+         });
+      }
+   }
+
+   IndirectSupport IndirectRenderer::QuerySupport(const VkPhysicalDevice& physicalDevice, VkPhysicalDeviceFeatures& enabledFeatures,
+      vector<const char*>& enabledExtensions)
+   {
+      VkPhysicalDeviceFeatures features;
+      vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+      IndirectSupport support;
+
+      // One indirect call covers every instance, and each command's
+      // firstInstance is how the vertex shader finds its instance
+      support.supported = features.multiDrawIndirect && features.drawIndirectFirstInstance;
+
+      if (!support.supported)
+      {
+         return support;
+      }
+
+      enabledFeatures.multiDrawIndirect = VK_TRUE;
+      enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+
+      support.drawIndirectCount = HasExtension(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+      if (support.drawIndirectCount)
+      {
+         enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+      }
+
+      return support;
+   }
+
+   void IndirectRenderer::Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, const VkPhysicalDevice& physicalDevice, DeviceAllocator& allocator,
+      UniformRing& uniformRing, DescriptorAllocator& descriptorAllocator, UploadEngine& uploadEngine, Shader& shaders, PipelineManager& pipelineManager,
+      ShaderVariants& fragmentVariants, VariantKey fragmentVariant, bool prewarmVariants,
+      VkRenderPass renderPass, const IndirectSupport& support)
+   {
+      TRACE_FUNCTION();
+
+      _device = device;
+      _pAllocationCallbacks = pAllocationCallbacks;
+      _pAllocator = &allocator;
+      _pUniformRing = &uniformRing;
+      _pDescriptorAllocator = &descriptorAllocator;
+      _pUploadEngine = &uploadEngine;
+      _pPipelineManager = &pipelineManager;
+      _pFragmentVariants = &fragmentVariants;
+      _fragmentVariant = fragmentVariant;
+      _prewarmVariants = prewarmVariants;
+      _support = support;
+
+      VkPhysicalDeviceProperties properties;
+      vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+      _maxDrawIndirectCount = properties.limits.maxDrawIndirectCount;
+
+      if (_support.drawIndirectCount)
+      {
+         _vkCmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(_device, "vkCmdDrawIndexedIndirectCountKHR");
+         _support.drawIndirectCount = _vkCmdDrawIndexedIndirectCount != nullptr;
+      }
+
+      CreateSetLayout();
+      CreatePipelines(shaders, renderPass);
+   }
+
+   void IndirectRenderer::Destroy()
+   {
+      if (_device == VK_NULL_HANDLE)
+      {
+         return;
+      }
+
+      DestroyBuffers();
+
+      vkDestroyPipelineLayout(_device, _pipelineLayout, _pAllocationCallbacks);
+      vkDestroyDescriptorSetLayout(_device, _setLayout, _pAllocationCallbacks);
+
+      _device = VK_NULL_HANDLE;
+      _descriptorSet = VK_NULL_HANDLE;
+      _cullPipelineHandle = InvalidPipeline;
+      _drawPipelineHandle = InvalidPipeline;
+      _uploaded = false;
+      _ready = false;
+   }
+
+   void IndirectRenderer::CreateSetLayout()
+   {
+      // Instances, meshes, draw commands and the draw count, in that order,
+      // then the frame constants. Drawing reads the first two, culling all
+      // four, and both read the constants.
+      VkDescriptorSetLayoutBinding bindings[StorageBindingCount + 1] = {};
+
+      for (uint32_t i = 0; i < StorageBindingCount; i++)
+      {
+         bindings[i].binding = i;
+         bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+         bindings[i].descriptorCount = 1;
+         bindings[i].stageFlags = i < 2 ? SharedStages : (VkShaderStageFlags)VK_SHADER_STAGE_COMPUTE_BIT;
+      }
+
+      bindings[FrameConstantsBinding].binding = FrameConstantsBinding;
+      bindings[FrameConstantsBinding].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+      bindings[FrameConstantsBinding].descriptorCount = 1;
+      bindings[FrameConstantsBinding].stageFlags = SharedStages;
+
+      VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+      layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+      layoutInfo.bindingCount = StorageBindingCount + 1;
+      layoutInfo.pBindings = bindings;
+
+      if (vkCreateDescriptorSetLayout(_device, &layoutInfo, _pAllocationCallbacks, &_setLayout) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to create indirect descriptor set layout");
+      }
+
+      // Both pipelines share the layout
+      VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+      pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+      pipelineLayoutInfo.setLayoutCount = 1;
+      pipelineLayoutInfo.pSetLayouts = &_setLayout;
+
+      if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, _pAllocationCallbacks, &_pipelineLayout) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to create indirect pipeline layout");
+      }
+   }
+
+   void IndirectRenderer::CreatePipelines(Shader& shaders, VkRenderPass renderPass)
+   {
+      // The fragment shader is the triangle pipeline's, so its module comes back from the cache
+      VkShaderModule cullModule = shaders.LoadModule("ShaderData/cull.comp.spv");
+      VkShaderModule vertexModule = shaders.LoadModule("ShaderData/mesh.vert.spv");
+      VkShaderModule fragmentModule = shaders.LoadModule("ShaderData/hellotriangle.frag.spv");
+
+      ComputePipelineDesc cullDesc;
+      cullDesc.shader = cullModule;
+      cullDesc.layout = _pipelineLayout;
+
+      // Quantised, the vertex shader dequantises positions with its mesh's bounds.
+      // Meshes wind counter-clockwise, which the flipped projection keeps.
+      GraphicsPipelineDesc drawDesc;
+      drawDesc.vertexShader = vertexModule;
+      drawDesc.fragmentShader = fragmentModule;
+      drawDesc.variantFeatureCount = _pFragmentVariants->FeatureCount();
+      drawDesc.vertexBindings = { { 0, sizeof(PackedVertex), VK_VERTEX_INPUT_RATE_VERTEX } };
+      drawDesc.vertexAttributes = {
+         { 0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(PackedVertex, position) },
+         { 1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedVertex, colour) }
+      };
+      drawDesc.cullMode = VK_CULL_MODE_BACK_BIT;
+      drawDesc.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+      drawDesc.depthTest = true;
+      drawDesc.depthWrite = true;
+      drawDesc.depthCompare = VK_COMPARE_OP_LESS;
+      drawDesc.layout = _pipelineLayout;
+      drawDesc.renderPass = renderPass;
+
+      // On a reload the current pipelines carry on until their replacements are ready
+      _cullPipelineHandle = _pPipelineManager->Request(cullDesc, _cullPipelineHandle);
+
+      if (_prewarmVariants)
+      {
+         for (VariantKey key : _pFragmentVariants->AllKeys())
+         {
+            drawDesc.variantKey = key;
+            _pPipelineManager->Request(drawDesc);
+            _pFragmentVariants->MarkGenerated(key);
+         }
+      }
+
+      // A repeat of one of the prewarmed requests, so it shares that compile
+      drawDesc.variantKey = _fragmentVariant;
+      _drawPipelineHandle = _pPipelineManager->Request(drawDesc, _drawPipelineHandle);
+      _pFragmentVariants->MarkGenerated(_fragmentVariant);
+   }
+
+   void IndirectRenderer::ReloadPipelines(Shader& shaders, VkRenderPass renderPass)
+   {
+      if (_device == VK_NULL_HANDLE)
+      {
+         return;
+      }
+
+      CreatePipelines(shaders, renderPass);
+   }
+
+   void IndirectRenderer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, Allocation& allocation)
+   {
+      VkBufferCreateInfo bufferInfo = {};
+      bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      bufferInfo.size = size;
+      bufferInfo.usage = usage;
+      bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+      _pAllocator->CreateBuffer(bufferInfo, MemoryUsage::GpuOnly, buffer, allocation);
+   }
+
+   void IndirectRenderer::DestroyBuffers()
+   {
+      if (_vertexBuffer == VK_NULL_HANDLE)
+      {
+         return;
+      }
+
+      _pAllocator->DestroyBuffer(_vertexBuffer, _vertexAllocation);
+      _pAllocator->DestroyBuffer(_indexBuffer, _indexAllocation);
+      _pAllocator->DestroyBuffer(_meshBuffer, _meshAllocation);
+      _pAllocator->DestroyBuffer(_instanceBuffer, _instanceAllocation);
+      _pAllocator->DestroyBuffer(_drawCommandBuffer, _drawCommandAllocation);
+      _pAllocator->DestroyBuffer(_drawCountBuffer, _drawCountAllocation);
+   }
+
+   void IndirectRenderer::SetScene(const vector<MeshView>& meshes, const vector<InstanceData>& instances)
+   {
+      TRACE_FUNCTION();
+
+      if (_vertexBuffer != VK_NULL_HANDLE)
+      {
+         throw runtime_error("Failed to set scene, the indirect renderer already has one");
+      }
+
+      if (meshes.empty() || instances.empty())
+      {
+         throw runtime_error("Failed to set scene, it has no meshes or no instances");
+      }
+
+      if (instances.size() > _maxDrawIndirectCount)
+      {
+         throw runtime_error("Failed to set scene, more instances than maxDrawIndirectCount");
+      }
+
+      // Every mesh goes into one vertex and one index buffer, so the whole
+      // scene draws without rebinding. Indices stay local to their mesh and
+      // vertexOffset rebases them, so each mesh's blobs are uploaded as
+      // they are.
+      vector<MeshRecord> records;
+      uint32_t vertexCount = 0;
+      uint32_t indexCount = 0;
+
+      for (const auto& mesh : meshes)
+      {
+         Dequantisation dequantisation = GetDequantisation(mesh.bounds);
+
+         MeshRecord record = { mesh.indexCount, indexCount, (int32_t)vertexCount, mesh.bounds.radius,
+            { dequantisation.offset[0], dequantisation.offset[1], dequantisation.offset[2], 0.0f },
+            { dequantisation.scale[0], dequantisation.scale[1], dequantisation.scale[2], 0.0f } };
+         records.push_back(record);
+
+         vertexCount += mesh.vertexCount;
+         indexCount += mesh.indexCount;
+      }
+
+      _instanceCount = instances.size();
+
+      VkDeviceSize vertexSize = vertexCount * sizeof(PackedVertex);
+      VkDeviceSize indexSize = indexCount * sizeof(uint32_t);
+      VkDeviceSize meshSize = records.size() * sizeof(MeshRecord);
+      VkDeviceSize instanceSize = instances.size() * sizeof(InstanceData);
+      VkDeviceSize drawCommandSize = instances.size() * sizeof(VkDrawIndexedIndirectCommand);
+
+      CreateBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, _vertexBuffer, _vertexAllocation);
+      CreateBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, _indexBuffer, _indexAllocation);
+      CreateBuffer(meshSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, _meshBuffer, _meshAllocation);
+      CreateBuffer(instanceSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, _instanceBuffer, _instanceAllocation);
+      CreateBuffer(drawCommandSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+         _drawCommandBuffer, _drawCommandAllocation);
+      CreateBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+         _drawCountBuffer, _drawCountAllocation);
+
+      // Straight from wherever the views point, a mapped file included,
+      // into the staging ring
+      for (size_t i = 0; i < meshes.size(); i++)
+      {
+         _pUploadEngine->UploadBuffer(_vertexBuffer, (VkDeviceSize)records[i].vertexOffset * sizeof(PackedVertex), meshes[i].pVertices,
+            meshes[i].vertexCount * sizeof(PackedVertex), VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+         _pUploadEngine->UploadBuffer(_indexBuffer, (VkDeviceSize)records[i].firstIndex * sizeof(uint32_t), meshes[i].pIndices,
+            meshes[i].indexCount * sizeof(uint32_t), VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+      }
+
+      _pUploadEngine->UploadBuffer(_meshBuffer, 0, records.data(), meshSize,
+         VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+      _uploadTicket = _pUploadEngine->UploadBuffer(_instanceBuffer, 0, instances.data(), instanceSize,
+         VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+      _pUploadEngine->Flush();
+   }
+
+   void IndirectRenderer::AddPasses(RenderGraph& graph, ResourceHandle& drawCommands, ResourceHandle& drawCount)
+   {
+      // Each frame overwrites what the previous frame drew from, which the
+      // graph orders by treating the draw as the buffers' use outside it
+      _drawCommandResource = graph.ImportBuffer("DrawCommands", _instanceCount * sizeof(VkDrawIndexedIndirectCommand),
+         ResourceUsage::IndirectBuffer, ResourceUsage::IndirectBuffer);
+      _drawCountResource = graph.ImportBuffer("DrawCount", sizeof(uint32_t),
+         ResourceUsage::IndirectBuffer, ResourceUsage::IndirectBuffer);
+
+      PassHandle clearPass = graph.AddPass("ClearDrawCount", [this](VkCommandBuffer commandBuffer) { RecordClear(commandBuffer); });
+      graph.Write(clearPass, _drawCountResource, ResourceUsage::TransferDst);
+
+      // The count is incremented, so it is read as well as written
+      PassHandle cullPass = graph.AddPass("CullInstances", [this](VkCommandBuffer commandBuffer) { RecordCull(commandBuffer); });
+      graph.Read(cullPass, _drawCountResource, ResourceUsage::ComputeStorageRead);
+      graph.Write(cullPass, _drawCountResource, ResourceUsage::ComputeStorageWrite);
+      graph.Write(cullPass, _drawCommandResource, ResourceUsage::ComputeStorageWrite);
+
+      drawCommands = _drawCommandResource;
+      drawCount = _drawCountResource;
+   }
+
+   void IndirectRenderer::BindResources(RenderGraphExecutor& executor)
+   {
+      executor.BindBuffer(_drawCommandResource, _drawCommandBuffer);
+      executor.BindBuffer(_drawCountResource, _drawCountBuffer);
+   }
+
+   void IndirectRenderer::Update(const glm::mat4& viewProjection, uint32_t frameSlot)
+   {
+      // Checked before the frame acquires uploads, so anything complete
+      // now is acquired by the same frame that first draws it
+      _uploaded = _uploaded || (_uploadTicket != 0 && _pUploadEngine->IsComplete(_uploadTicket));
+
+      _cullPipeline = _pPipelineManager->Get(_cullPipelineHandle);
+      _drawPipeline = _pPipelineManager->Get(_drawPipelineHandle);
+      _ready = _uploaded && _cullPipeline != VK_NULL_HANDLE && _drawPipeline != VK_NULL_HANDLE;
+
+      FrameConstants constants;
+      constants.viewProjection = viewProjection;
+
+      Frustum frustum = Frustum::FromViewProjection(viewProjection);
+      memcpy(constants.frustumPlanes, frustum.planes, sizeof(frustum.planes));
+
+      constants.instanceCount = (uint32_t)_instanceCount;
+      constants.compact = _support.drawIndirectCount ? 1 : 0;
+
+      _frameConstantsOffset = _pUniformRing->Push(constants);
+
+      if (!_ready)
+      {
+         return;
+      }
+
+      // A fresh set from this frame's pools each time, so nothing a frame
+      // still in flight is reading gets rewritten
+      _descriptorSet = _pDescriptorAllocator->Allocate(frameSlot, _setLayout);
+
+      VkBuffer buffers[StorageBindingCount] = { _instanceBuffer, _meshBuffer, _drawCommandBuffer, _drawCountBuffer };
+      VkDescriptorBufferInfo bufferInfos[StorageBindingCount + 1];
+      VkWriteDescriptorSet writes[StorageBindingCount + 1] = {};
+
+      for (uint32_t i = 0; i < StorageBindingCount; i++)
+      {
+         bufferInfos[i] = { buffers[i], 0, VK_WHOLE_SIZE };
+
+         writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+         writes[i].dstSet = _descriptorSet;
+         writes[i].dstBinding = i;
+         writes[i].descriptorCount = 1;
+         writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+         writes[i].pBufferInfo = &bufferInfos[i];
+      }
+
+      // Still picked out of the ring by the dynamic offset the set is bound with
+      bufferInfos[FrameConstantsBinding] = { _pUniformRing->Buffer(), 0, sizeof(FrameConstants) };
+
+      writes[FrameConstantsBinding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[FrameConstantsBinding].dstSet = _descriptorSet;
+      writes[FrameConstantsBinding].dstBinding = FrameConstantsBinding;
+      writes[FrameConstantsBinding].descriptorCount = 1;
+      writes[FrameConstantsBinding].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+      writes[FrameConstantsBinding].pBufferInfo = &bufferInfos[FrameConstantsBinding];
+
+      vkUpdateDescriptorSets(_device, StorageBindingCount + 1, writes, 0, nullptr);
+   }
+
+   void IndirectRenderer::RecordClear(VkCommandBuffer commandBuffer)
+   {
+      vkCmdFillBuffer(commandBuffer, _drawCountBuffer, 0, sizeof(uint32_t), 0);
+   }
+
+   void IndirectRenderer::RecordCull(VkCommandBuffer commandBuffer)
+   {
+      if (!_ready)
+      {
+         return;
+      }
+
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipeline);
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &_descriptorSet, 1, &_frameConstantsOffset);
+      vkCmdDispatch(commandBuffer, (uint32_t)((_instanceCount + CullGroupSize - 1) / CullGroupSize), 1, 1);
+   }
+
+   void IndirectRenderer::RecordDraw(VkCommandBuffer commandBuffer, const VkViewport& viewport, const VkRect2D& scissor)
+   {
+      if (!_ready)
+      {
+         return;
+      }
+
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _drawPipeline);
+      _pFragmentVariants->MarkUsed(_fragmentVariant);
+      vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+      vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1, &_descriptorSet, 1, &_frameConstantsOffset);
+
+      VkDeviceSize vertexOffset = 0;
+      vkCmdBindVertexBuffers(commandBuffer, 0, 1, &_vertexBuffer, &vertexOffset);
+      vkCmdBindIndexBuffer(commandBuffer, _indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+      uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+      if (_support.drawIndirectCount)
+      {
+         _vkCmdDrawIndexedIndirectCount(commandBuffer, _drawCommandBuffer, 0, _drawCountBuffer, 0, (uint32_t)_instanceCount, stride);
+      }
+      else
+      {
+         vkCmdDrawIndexedIndirect(commandBuffer, _drawCommandBuffer, 0, (uint32_t)_instanceCount, stride);
+      }
+   }
+}
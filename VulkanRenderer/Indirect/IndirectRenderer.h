@@ -0,0 +1,150 @@
+#pragma once
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+
+#include "../Common/Common.h"
+#include "../Descriptor/DescriptorAllocator.h"
+#include "../Memory/DeviceAllocator.h"
+#include "../Memory/UniformRing.h"
+#include "../Pipeline/PipelineManager.h"
+#include "../RenderGraph/RenderGraph.h"
+#include "../RenderGraph/RenderGraphExecutor.h"
+#include "../Scene/Frustum.h"
+#include "../Shader/Shader.h"
+#include "../Shader/ShaderVariants.h"
+#include "../Transfer/UploadEngine.h"
+#include "SceneGeometry.h"
+
+namespace indirect {
+
+   struct IndirectSupport
+   {
+      bool supported = false;            // multiDrawIndirect and drawIndirectFirstInstance
+      bool drawIndirectCount = false;    // VK_KHR_draw_indirect_count
+   };
+
+   // Draws every instance in the scene with one indirect call. A compute
+   // pass frustum culls the instances and writes a
+   // VkDrawIndexedIndirectCommand for each visible one, so the CPU cost of
+   // a frame does not grow with the number of objects.
+   //
+   // With VK_KHR_draw_indirect_count the visible commands are packed and
+   // the GPU supplies the draw count. Without it every instance keeps a
+   // command and culled ones are drawn with an instance count of zero.
+   //
+   // The pipelines compile in the background, and nothing is culled or
+   // drawn until both have finished and the scene has uploaded.
+   class IndirectRenderer {
+   public:
+      // Fills in the features and extensions to enable when creating the device
+      static IndirectSupport QuerySupport(const VkPhysicalDevice& physicalDevice, VkPhysicalDeviceFeatures& enabledFeatures,
+         std::vector<const char*>& enabledExtensions);
+
+      // The draw pipeline uses the fragmentVariant permutation of
+      // hellotriangle.frag, and with prewarmVariants every other one is
+      // compiled alongside it
+      void Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, const VkPhysicalDevice& physicalDevice, memory::DeviceAllocator& allocator,
+         memory::UniformRing& uniformRing, descriptor::DescriptorAllocator& descriptorAllocator, transfer::UploadEngine& uploadEngine,
+         shader::Shader& shaders, pipeline::PipelineManager& pipelineManager,
+         shader::ShaderVariants& fragmentVariants, shader::VariantKey fragmentVariant, bool prewarmVariants,
+         VkRenderPass renderPass, const IndirectSupport& support);
+      void Destroy();
+
+      // Requests the pipelines again from the shader cache's current
+      // modules. The old ones keep drawing until the new ones are compiled.
+      void ReloadPipelines(shader::Shader& shaders, VkRenderPass renderPass);
+
+      // Uploads the geometry and instances. The meshes are copied into
+      // staging memory before this returns, so whatever they point into
+      // can be freed or unmapped straight after. Nothing is culled or drawn
+      // until the uploads have finished.
+      void SetScene(const std::vector<mesh::MeshView>& meshes, const std::vector<InstanceData>& instances);
+
+      // Adds the passes that reset the draw count and cull into the draw
+      // buffers, and imports those buffers for the pass that draws them
+      void AddPasses(rendergraph::RenderGraph& graph, rendergraph::ResourceHandle& drawCommands, rendergraph::ResourceHandle& drawCount);
+      void BindResources(rendergraph::RenderGraphExecutor& executor);
+
+      // Once per frame, after the uniform ring and descriptor allocator have
+      // begun the frame and before any uploads are acquired
+      void Update(const glm::mat4& viewProjection, uint32_t frameSlot);
+
+      // Inside a render pass begun with inline contents
+      void RecordDraw(VkCommandBuffer commandBuffer, const VkViewport& viewport, const VkRect2D& scissor);
+
+      uint32_t InstanceCount() { return (uint32_t)_instanceCount; };
+      // After Initialise, which drops draw count if its entry point is missing
+      const IndirectSupport& Support() { return _support; };
+
+   private:
+      // One std140 block read by both passes, written to the uniform ring
+      // each frame and bound with a dynamic offset
+      struct FrameConstants
+      {
+         glm::mat4 viewProjection;
+         float frustumPlanes[scene::Frustum::PlaneCount][4];
+         uint32_t instanceCount;
+         uint32_t compact;
+      };
+
+      static const uint32_t CullGroupSize = 64;
+
+      void CreatePipelines(shader::Shader& shaders, VkRenderPass renderPass);
+      void CreateSetLayout();
+      void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, memory::Allocation& allocation);
+      void DestroyBuffers();
+
+      void RecordClear(VkCommandBuffer commandBuffer);
+      void RecordCull(VkCommandBuffer commandBuffer);
+
+      VkDevice _device = VK_NULL_HANDLE;
+      const VkAllocationCallbacks* _pAllocationCallbacks = nullptr;
+      memory::DeviceAllocator* _pAllocator = nullptr;
+      memory::UniformRing* _pUniformRing = nullptr;
+      descriptor::DescriptorAllocator* _pDescriptorAllocator = nullptr;
+      transfer::UploadEngine* _pUploadEngine = nullptr;
+      pipeline::PipelineManager* _pPipelineManager = nullptr;
+      shader::ShaderVariants* _pFragmentVariants = nullptr;
+      shader::VariantKey _fragmentVariant = 0;
+      bool _prewarmVariants = false;
+      IndirectSupport _support;
+      uint32_t _maxDrawIndirectCount = 0;
+      PFN_vkCmdDrawIndexedIndirectCountKHR _vkCmdDrawIndexedIndirectCount = nullptr;
+
+      VkDescriptorSetLayout _setLayout = VK_NULL_HANDLE;
+      // Allocated and written each frame, so it is only valid for the frame
+      // that Update last ran for
+      VkDescriptorSet _descriptorSet = VK_NULL_HANDLE;
+      VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+      pipeline::PipelineHandle _cullPipelineHandle = pipeline::InvalidPipeline;
+      pipeline::PipelineHandle _drawPipelineHandle = pipeline::InvalidPipeline;
+
+      // Owned by the pipeline manager, and looked up again every frame
+      VkPipeline _cullPipeline = VK_NULL_HANDLE;
+      VkPipeline _drawPipeline = VK_NULL_HANDLE;
+
+      VkBuffer _vertexBuffer = VK_NULL_HANDLE;
+      VkBuffer _indexBuffer = VK_NULL_HANDLE;
+      VkBuffer _meshBuffer = VK_NULL_HANDLE;
+      VkBuffer _instanceBuffer = VK_NULL_HANDLE;
+      VkBuffer _drawCommandBuffer = VK_NULL_HANDLE;
+      VkBuffer _drawCountBuffer = VK_NULL_HANDLE;
+      memory::Allocation _vertexAllocation;
+      memory::Allocation _indexAllocation;
+      memory::Allocation _meshAllocation;
+      memory::Allocation _instanceAllocation;
+      memory::Allocation _drawCommandAllocation;
+      memory::Allocation _drawCountAllocation;
+
+      rendergraph::ResourceHandle _drawCommandResource = 0;
+      rendergraph::ResourceHandle _drawCountResource = 0;
+
+      size_t _instanceCount = 0;
+      transfer::UploadTicket _uploadTicket = 0;
+      bool _uploaded = false;
+      bool _ready = false;
+
+      uint32_t _frameConstantsOffset = 0;
+   };
+}
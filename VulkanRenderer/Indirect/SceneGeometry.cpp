@@ -0,0 +1,97 @@
+#include "SceneGeometry.h"
+
+#include <cmath>
+#include <random>
+
+using namespace std;
+using namespace mesh;
+
+namespace indirect {
+
+   MeshData CreateCube()
+   {
+      MeshData mesh;
+
+      for (int i = 0; i < 8; i++)
+      {
+         float x = (i & 1) ? 0.5f : -0.5f;
+         float y = (i & 2) ? 0.5f : -0.5f;
+         float z = (i & 4) ? 0.5f : -0.5f;
+         mesh.vertices.push_back({ { x, y, z }, { x + 0.5f, y + 0.5f, z + 0.5f } });
+      }
+
+      // Every mesh winds counter-clockwise seen from outside
+      mesh.indices = {
+         0, 2, 1, 1, 2, 3,   // -z
+         4, 5, 6, 5, 7, 6,   // +z
+         0, 1, 4, 1, 5, 4,   // -y
+         2, 6, 3, 3, 6, 7,   // +y
+         0, 4, 2, 2, 4, 6,   // -x
+         1, 3, 5, 3, 7, 5    // +x
+      };
+
+      return mesh;
+   }
+
+   MeshData CreateOctahedron()
+   {
+      MeshData mesh;
+      mesh.vertices = {
+         { { 0.6f, 0.0f, 0.0f }, { 1.0f, 0.3f, 0.3f } },
+         { { -0.6f, 0.0f, 0.0f }, { 0.3f, 1.0f, 0.3f } },
+         { { 0.0f, 0.6f, 0.0f }, { 0.3f, 0.3f, 1.0f } },
+         { { 0.0f, -0.6f, 0.0f }, { 1.0f, 1.0f, 0.3f } },
+         { { 0.0f, 0.0f, 0.6f }, { 1.0f, 0.3f, 1.0f } },
+         { { 0.0f, 0.0f, -0.6f }, { 0.3f, 1.0f, 1.0f } }
+      };
+
+      mesh.indices = {
+         0, 2, 4, 0, 5, 2, 0, 3, 5, 0, 4, 3,
+         1, 4, 2, 1, 2, 5, 1, 5, 3, 1, 3, 4
+      };
+
+      return mesh;
+   }
+
+   MeshData CreateTetrahedron()
+   {
+      MeshData mesh;
+      mesh.vertices = {
+         { { 0.4f, 0.4f, 0.4f }, { 1.0f, 0.6f, 0.2f } },
+         { { 0.4f, -0.4f, -0.4f }, { 0.2f, 0.6f, 1.0f } },
+         { { -0.4f, 0.4f, -0.4f }, { 0.6f, 1.0f, 0.2f } },
+         { { -0.4f, -0.4f, 0.4f }, { 1.0f, 0.2f, 0.6f } }
+      };
+
+      mesh.indices = { 0, 1, 2, 0, 3, 1, 0, 2, 3, 1, 3, 2 };
+
+      return mesh;
+   }
+
+   vector<InstanceData> GenerateInstances(uint32_t instanceCount, uint32_t meshCount, float spacing, uint32_t seed)
+   {
+      mt19937 random(seed);
+
+      float halfExtent = 0.5f * spacing * cbrt((float)instanceCount);
+      uniform_real_distribution<float> position(-halfExtent, halfExtent);
+      uniform_real_distribution<float> scale(0.5f, 1.5f);
+      uniform_int_distribution<uint32_t> colour(0x40, 0xff);
+
+      vector<InstanceData> instances(instanceCount);
+
+      for (uint32_t i = 0; i < instanceCount; i++)
+      {
+         InstanceData& instance = instances[i];
+         instance.position[0] = position(random);
+         instance.position[1] = position(random);
+         instance.position[2] = position(random);
+         instance.scale = scale(random);
+         instance.meshIndex = i % meshCount;
+         instance.colour = colour(random) | (colour(random) << 8) | (colour(random) << 16) | 0xff000000u;
+         instance.padding[0] = 0;
+         instance.padding[1] = 0;
+      }
+
+      return instances;
+   }
+}
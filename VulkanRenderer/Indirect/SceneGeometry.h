@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "../Mesh/Mesh.h"
+
+namespace indirect {
+
+   // Laid out as the std430 structs the cull and mesh shaders read, so
+   // both are uploaded as they are
+   struct InstanceData
+   {
+      float position[3];
+      float scale;
+      uint32_t meshIndex;
+      uint32_t colour;        // RGBA8, tints the mesh's vertex colours
+      uint32_t padding[2];
+   };
+
+   struct MeshRecord
+   {
+      uint32_t indexCount;
+      uint32_t firstIndex;
+      int32_t vertexOffset;
+      float radius;           // Bounding sphere about the origin, for culling
+      float dequantiseOffset[4];
+      float dequantiseScale[4];
+   };
+
+   mesh::MeshData CreateCube();
+   mesh::MeshData CreateOctahedron();
+   mesh::MeshData CreateTetrahedron();
+
+   // Scatters instances through a cube sized so their density stays the
+   // same however many there are. Seeded, so every run draws the same field.
+   std::vector<InstanceData> GenerateInstances(uint32_t instanceCount, uint32_t meshCount, float spacing, uint32_t seed = 1);
+}
@@ -0,0 +1,472 @@
+#include "DeviceAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace memory {
+
+   namespace {
+      uint32_t CountBits(uint32_t value)
+      {
+         uint32_t count = 0;
+
+         for (; value; value &= value - 1)
+         {
+            count++;
+         }
+
+         return count;
+      }
+   }
+
+   void DeviceAllocator::Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, const VkPhysicalDevice& physicalDevice, VkDeviceSize blockSize)
+   {
+      _device = device;
+      _pAllocationCallbacks = pAllocationCallbacks;
+
+      vkGetPhysicalDeviceMemoryProperties(physicalDevice, &_memoryProperties);
+
+      VkPhysicalDeviceProperties properties;
+      vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+      _limits = properties.limits;
+
+      // Small heaps (e.g. a 256MB host visible BAR) would be exhausted by a
+      // few full size blocks, so scale blocks down to an eighth of the heap
+      for (uint32_t i = 0; i < _memoryProperties.memoryTypeCount; i++)
+      {
+         VkDeviceSize heapSize = _memoryProperties.memoryHeaps[_memoryProperties.memoryTypes[i].heapIndex].size;
+         _blockSizes[i] = min(blockSize, max<VkDeviceSize>(heapSize / 8, 1024 * 1024));
+      }
+
+      _blockPools.clear();
+      _blockPools.resize(_memoryProperties.memoryTypeCount * 2);
+   }
+
+   void DeviceAllocator::Destroy()
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      for (auto& pool : _blockPools)
+      {
+         for (auto& block : pool.blocks)
+         {
+            if (block)
+            {
+               FreeDeviceMemory(block->memory);
+            }
+         }
+      }
+
+      for (auto& pool : _linearPools)
+      {
+         FreeDeviceMemory(pool.memory);
+      }
+
+      _blockPools.clear();
+      _linearPools.clear();
+   }
+
+   uint32_t DeviceAllocator::FindMemoryType(uint32_t memoryTypeBits, MemoryUsage usage)
+   {
+      VkMemoryPropertyFlags required = 0;
+      VkMemoryPropertyFlags preferred = 0;
+      VkMemoryPropertyFlags avoided = 0;
+
+      switch (usage)
+      {
+      case MemoryUsage::GpuOnly:
+         preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+         avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+         break;
+      case MemoryUsage::CpuToGpu:
+         required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+         avoided = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+         break;
+      case MemoryUsage::GpuToCpu:
+         required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+         preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+         break;
+      }
+
+      // Pick the type missing the fewest preferred flags and carrying the
+      // fewest unwanted ones. Unified memory devices (and lavapipe) expose
+      // types with every flag set, which still come out as valid matches.
+      uint32_t bestType = UINT32_MAX;
+      uint32_t bestCost = UINT32_MAX;
+
+      for (uint32_t i = 0; i < _memoryProperties.memoryTypeCount; i++)
+      {
+         VkMemoryPropertyFlags flags = _memoryProperties.memoryTypes[i].propertyFlags;
+
+         if (!(memoryTypeBits & (1u << i)) || (flags & required) != required)
+         {
+            continue;
+         }
+
+         uint32_t cost = CountBits(preferred & ~flags) + CountBits(flags & avoided);
+
+         if (cost < bestCost)
+         {
+            bestType = i;
+            bestCost = cost;
+         }
+      }
+
+      if (bestType == UINT32_MAX)
+      {
+         throw runtime_error("Failed to find a suitable memory type");
+      }
+
+      return bestType;
+   }
+
+   Allocation DeviceAllocator::Allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, ResourceTiling tiling)
+   {
+      uint32_t memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, usage);
+
+      lock_guard<mutex> lock(_mutex);
+
+      Allocation allocation;
+      allocation.memoryTypeIndex = memoryTypeIndex;
+      allocation.size = requirements.size;
+
+      // Anything over half a block would waste most of the block it lands
+      // in, give it its own allocation instead
+      if (requirements.size > _blockSizes[memoryTypeIndex] / 2)
+      {
+         void* pMapped = nullptr;
+         allocation.memory = AllocateDeviceMemory(requirements.size, memoryTypeIndex, &pMapped);
+         allocation.pMapped = pMapped;
+         allocation.type = AllocationType::Dedicated;
+
+         _dedicatedCount++;
+         _dedicatedBytes += requirements.size;
+
+         return allocation;
+      }
+
+      uint32_t poolIndex = memoryTypeIndex * 2 + (tiling == ResourceTiling::Optimal ? 1 : 0);
+
+      if (!AllocateFromPool(poolIndex, requirements, allocation))
+      {
+         throw runtime_error("Failed to sub-allocate device memory");
+      }
+
+      return allocation;
+   }
+
+   void DeviceAllocator::Free(Allocation& allocation)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      switch (allocation.type)
+      {
+      case AllocationType::Dedicated:
+         FreeDeviceMemory(allocation.memory);
+         _dedicatedCount--;
+         _dedicatedBytes -= allocation.size;
+         break;
+
+      case AllocationType::Block:
+      {
+         BlockPool& pool = _blockPools[allocation.poolIndex];
+         MemoryBlock& block = *pool.blocks[allocation.blockIndex];
+         block.allocator.Free(allocation.blockAllocation);
+
+         // Hang on to one empty block per pool so a free followed by an
+         // allocate does not round trip through the driver, release the rest
+         if (block.allocator.IsEmpty())
+         {
+            bool otherEmptyBlock = false;
+
+            for (size_t i = 0; i < pool.blocks.size(); i++)
+            {
+               if (i != allocation.blockIndex && pool.blocks[i] && pool.blocks[i]->allocator.IsEmpty())
+               {
+                  otherEmptyBlock = true;
+                  break;
+               }
+            }
+
+            if (otherEmptyBlock)
+            {
+               FreeDeviceMemory(block.memory);
+               pool.blocks[allocation.blockIndex].reset();
+            }
+         }
+         break;
+      }
+
+      case AllocationType::Linear:
+      case AllocationType::None:
+         // Linear allocations are released by resetting their pool
+         break;
+      }
+
+      allocation = Allocation();
+   }
+
+   void DeviceAllocator::CreateBuffer(const VkBufferCreateInfo& createInfo, MemoryUsage usage, VkBuffer& buffer, Allocation& allocation)
+   {
+      if (vkCreateBuffer(_device, &createInfo, _pAllocationCallbacks, &buffer) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to create buffer");
+      }
+
+      VkMemoryRequirements requirements;
+      vkGetBufferMemoryRequirements(_device, buffer, &requirements);
+
+      allocation = Allocate(requirements, usage, ResourceTiling::Linear);
+
+      if (vkBindBufferMemory(_device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to bind buffer memory");
+      }
+   }
+
+   void DeviceAllocator::DestroyBuffer(VkBuffer& buffer, Allocation& allocation)
+   {
+      vkDestroyBuffer(_device, buffer, _pAllocationCallbacks);
+      Free(allocation);
+      buffer = VK_NULL_HANDLE;
+   }
+
+   void DeviceAllocator::CreateImage(const VkImageCreateInfo& createInfo, MemoryUsage usage, VkImage& image, Allocation& allocation)
+   {
+      if (vkCreateImage(_device, &createInfo, _pAllocationCallbacks, &image) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to create image");
+      }
+
+      VkMemoryRequirements requirements;
+      vkGetImageMemoryRequirements(_device, image, &requirements);
+
+      ResourceTiling tiling = createInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? ResourceTiling::Optimal : ResourceTiling::Linear;
+      allocation = Allocate(requirements, usage, tiling);
+
+      if (vkBindImageMemory(_device, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to bind image memory");
+      }
+   }
+
+   void DeviceAllocator::DestroyImage(VkImage& image, Allocation& allocation)
+   {
+      vkDestroyImage(_device, image, _pAllocationCallbacks);
+      Free(allocation);
+      image = VK_NULL_HANDLE;
+   }
+
+   LinearPoolHandle DeviceAllocator::CreateLinearPool(VkDeviceSize size, uint32_t memoryTypeBits, MemoryUsage usage)
+   {
+      uint32_t memoryTypeIndex = FindMemoryType(memoryTypeBits, usage);
+
+      lock_guard<mutex> lock(_mutex);
+
+      LinearPool pool;
+      pool.memoryTypeIndex = memoryTypeIndex;
+      pool.allocator = LinearAllocator(size);
+      pool.memory = AllocateDeviceMemory(size, memoryTypeIndex, &pool.pMapped);
+
+      _linearPools.push_back(pool);
+      return (LinearPoolHandle)(_linearPools.size() - 1);
+   }
+
+   Allocation DeviceAllocator::AllocateLinear(LinearPoolHandle handle, const VkMemoryRequirements& requirements)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      LinearPool& pool = _linearPools[handle];
+
+      if (!(requirements.memoryTypeBits & (1u << pool.memoryTypeIndex)))
+      {
+         throw runtime_error("Linear pool memory type is not compatible with the resource");
+      }
+
+      // Transient pools can hold buffers and images side by side, so pad
+      // every allocation out to bufferImageGranularity
+      VkDeviceSize alignment = max(requirements.alignment, _limits.bufferImageGranularity);
+      VkDeviceSize size = (requirements.size + alignment - 1) & ~(alignment - 1);
+
+      uint64_t offset;
+      if (!pool.allocator.Allocate(size, alignment, offset))
+      {
+         throw runtime_error("Linear pool is out of memory");
+      }
+
+      Allocation allocation;
+      allocation.memory = pool.memory;
+      allocation.offset = offset;
+      allocation.size = requirements.size;
+      allocation.pMapped = pool.pMapped ? static_cast<char*>(pool.pMapped) + offset : nullptr;
+      allocation.memoryTypeIndex = pool.memoryTypeIndex;
+      allocation.type = AllocationType::Linear;
+      allocation.poolIndex = handle;
+
+      return allocation;
+   }
+
+   void DeviceAllocator::ResetLinearPool(LinearPoolHandle handle)
+   {
+      lock_guard<mutex> lock(_mutex);
+      _linearPools[handle].allocator.Reset();
+   }
+
+   AllocatorStatistics DeviceAllocator::GetStatistics()
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      AllocatorStatistics statistics;
+      statistics.deviceMemoryCount = _deviceMemoryCount;
+      statistics.dedicatedCount = _dedicatedCount;
+      statistics.allocationCount = _dedicatedCount;
+      statistics.reservedBytes = _dedicatedBytes;
+      statistics.usedBytes = _dedicatedBytes;
+
+      for (auto& pool : _blockPools)
+      {
+         for (auto& block : pool.blocks)
+         {
+            if (!block)
+            {
+               continue;
+            }
+
+            statistics.blockCount++;
+            statistics.allocationCount += block->allocator.AllocationCount();
+            statistics.reservedBytes += block->allocator.Size();
+            statistics.usedBytes += block->allocator.UsedBytes();
+            statistics.blockFreeBytes += block->allocator.FreeBytes();
+            statistics.freeRangeCount += block->allocator.FreeBlockCount();
+            statistics.largestFreeRange = max<VkDeviceSize>(statistics.largestFreeRange, block->allocator.LargestFreeBlock());
+         }
+      }
+
+      for (auto& pool : _linearPools)
+      {
+         statistics.reservedBytes += pool.allocator.Size();
+         statistics.linearPoolBytes += pool.allocator.Size();
+         statistics.linearPoolUsedBytes += pool.allocator.UsedBytes();
+         statistics.linearPoolHighWaterMark += pool.allocator.HighWaterMark();
+      }
+
+      return statistics;
+   }
+
+   void DeviceAllocator::PrintStatistics(ostream& stream)
+   {
+      AllocatorStatistics statistics = GetStatistics();
+      const double megabyte = 1024.0 * 1024.0;
+
+      stream << "Device memory: " << statistics.deviceMemoryCount << " allocations (limit " << _limits.maxMemoryAllocationCount << "), "
+         << statistics.blockCount << " blocks, " << statistics.dedicatedCount << " dedicated" << endl;
+      stream << "\tReserved " << statistics.reservedBytes / megabyte << " MB, used " << statistics.usedBytes / megabyte
+         << " MB across " << statistics.allocationCount << " allocations" << endl;
+      stream << "\tBlock free " << statistics.blockFreeBytes / megabyte << " MB in " << statistics.freeRangeCount
+         << " ranges, largest " << statistics.largestFreeRange / megabyte << " MB, fragmentation " << statistics.Fragmentation() * 100.0f << "%" << endl;
+      stream << "\tLinear pools " << statistics.linearPoolBytes / megabyte << " MB, used " << statistics.linearPoolUsedBytes / megabyte
+         << " MB, high water " << statistics.linearPoolHighWaterMark / megabyte << " MB" << endl;
+   }
+
+   VkDeviceMemory DeviceAllocator::AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** ppMapped)
+   {
+      if (_deviceMemoryCount >= _limits.maxMemoryAllocationCount)
+      {
+         throw runtime_error("Reached maxMemoryAllocationCount");
+      }
+
+      VkMemoryAllocateInfo allocateInfo = {};
+      allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      allocateInfo.allocationSize = size;
+      allocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+      VkDeviceMemory memory;
+      if (vkAllocateMemory(_device, &allocateInfo, _pAllocationCallbacks, &memory) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to allocate device memory");
+      }
+
+      // Host visible memory stays mapped for its whole lifetime
+      *ppMapped = nullptr;
+      if (IsHostVisible(memoryTypeIndex) &&
+         vkMapMemory(_device, memory, 0, VK_WHOLE_SIZE, 0, ppMapped) != VK_SUCCESS)
+      {
+         vkFreeMemory(_device, memory, _pAllocationCallbacks);
+         throw runtime_error("Failed to map device memory");
+      }
+
+      _deviceMemoryCount++;
+      return memory;
+   }
+
+   void DeviceAllocator::FreeDeviceMemory(VkDeviceMemory memory)
+   {
+      // Freeing implicitly unmaps
+      vkFreeMemory(_device, memory, _pAllocationCallbacks);
+      _deviceMemoryCount--;
+   }
+
+   bool DeviceAllocator::IsHostVisible(uint32_t memoryTypeIndex)
+   {
+      return (_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+   }
+
+   bool DeviceAllocator::AllocateFromPool(uint32_t poolIndex, const VkMemoryRequirements& requirements, Allocation& allocation)
+   {
+      BlockPool& pool = _blockPools[poolIndex];
+      uint32_t memoryTypeIndex = poolIndex / 2;
+
+      TlsfAllocation blockAllocation;
+      uint32_t blockIndex = UINT32_MAX;
+
+      for (uint32_t i = 0; i < pool.blocks.size(); i++)
+      {
+         if (pool.blocks[i] && pool.blocks[i]->allocator.Allocate(requirements.size, requirements.alignment, blockAllocation))
+         {
+            blockIndex = i;
+            break;
+         }
+      }
+
+      if (blockIndex == UINT32_MAX)
+      {
+         auto block = make_unique<MemoryBlock>();
+         block->memory = AllocateDeviceMemory(_blockSizes[memoryTypeIndex], memoryTypeIndex, &block->pMapped);
+         block->allocator.Reset(_blockSizes[memoryTypeIndex]);
+
+         if (!block->allocator.Allocate(requirements.size, requirements.alignment, blockAllocation))
+         {
+            FreeDeviceMemory(block->memory);
+            return false;
+         }
+
+         // Reuse a slot a released block left behind, so indices held by
+         // live allocations stay valid
+         auto emptySlot = find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+         blockIndex = (uint32_t)(emptySlot - pool.blocks.begin());
+
+         if (emptySlot == pool.blocks.end())
+         {
+            pool.blocks.push_back(move(block));
+         }
+         else
+         {
+            *emptySlot = move(block);
+         }
+      }
+
+      MemoryBlock& block = *pool.blocks[blockIndex];
+
+      allocation.memory = block.memory;
+      allocation.offset = blockAllocation.offset;
+      allocation.pMapped = block.pMapped ? static_cast<char*>(block.pMapped) + blockAllocation.offset : nullptr;
+      allocation.type = AllocationType::Block;
+      allocation.poolIndex = poolIndex;
+      allocation.blockIndex = blockIndex;
+      allocation.blockAllocation = blockAllocation;
+
+      return true;
+   }
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "../Common/Common.h"
+#include "LinearAllocator.h"
+#include "TlsfAllocator.h"
+
+namespace memory {
+
+   enum class MemoryUsage
+   {
+      GpuOnly,    // Device local, never touched by the CPU
+      CpuToGpu,   // Written by the CPU, read by the GPU (staging, per frame data)
+      GpuToCpu    // Written by the GPU, read back by the CPU
+   };
+
+   // Optimally tiled images and everything else are sub-allocated from
+   // separate blocks, so bufferImageGranularity never has to be honoured
+   // between neighbouring allocations
+   enum class ResourceTiling
+   {
+      Linear,
+      Optimal
+   };
+
+   enum class AllocationType
+   {
+      None,
+      Block,
+      Dedicated,
+      Linear
+   };
+
+   struct Allocation
+   {
+      VkDeviceMemory memory = VK_NULL_HANDLE;
+      VkDeviceSize offset = 0;
+      VkDeviceSize size = 0;
+      void* pMapped = nullptr;    // Set for host visible memory, already offset
+      uint32_t memoryTypeIndex = UINT32_MAX;
+
+      AllocationType type = AllocationType::None;
+      uint32_t poolIndex = UINT32_MAX;
+      uint32_t blockIndex = UINT32_MAX;
+      TlsfAllocation blockAllocation;
+   };
+
+   struct AllocatorStatistics
+   {
+      uint32_t deviceMemoryCount = 0;     // Live vkAllocateMemory allocations
+      uint32_t blockCount = 0;
+      uint32_t dedicatedCount = 0;
+      uint32_t allocationCount = 0;
+
+      VkDeviceSize reservedBytes = 0;     // All device memory held, blocks, dedicated and linear pools
+      VkDeviceSize usedBytes = 0;
+      VkDeviceSize blockFreeBytes = 0;
+      VkDeviceSize largestFreeRange = 0;
+      uint32_t freeRangeCount = 0;
+
+      VkDeviceSize linearPoolBytes = 0;
+      VkDeviceSize linearPoolUsedBytes = 0;
+      VkDeviceSize linearPoolHighWaterMark = 0;
+
+      // 0 when all free block memory is one contiguous range, approaching 1
+      // as it is split into many small ranges
+      float Fragmentation() const
+      {
+         return blockFreeBytes > 0 ? 1.0f - (float)largestFreeRange / (float)blockFreeBytes : 0.0f;
+      }
+   };
+
+   typedef uint32_t LinearPoolHandle;
+
+   // Sub-allocates device memory out of large blocks so resources do not each
+   // need their own vkAllocateMemory. Blocks are split with a TLSF allocator,
+   // requests too large to share a block get a dedicated allocation, and
+   // transient resources can be bump allocated out of linear pools that are
+   // reset wholesale.
+   class DeviceAllocator {
+   public:
+      static constexpr VkDeviceSize DefaultBlockSize = 64ull * 1024 * 1024;
+
+      void Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, const VkPhysicalDevice& physicalDevice, VkDeviceSize blockSize = DefaultBlockSize);
+      void Destroy();
+
+      uint32_t FindMemoryType(uint32_t memoryTypeBits, MemoryUsage usage);
+
+      Allocation Allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, ResourceTiling tiling);
+      void Free(Allocation& allocation);
+
+      void CreateBuffer(const VkBufferCreateInfo& createInfo, MemoryUsage usage, VkBuffer& buffer, Allocation& allocation);
+      void DestroyBuffer(VkBuffer& buffer, Allocation& allocation);
+      void CreateImage(const VkImageCreateInfo& createInfo, MemoryUsage usage, VkImage& image, Allocation& allocation);
+      void DestroyImage(VkImage& image, Allocation& allocation);
+
+      LinearPoolHandle CreateLinearPool(VkDeviceSize size, uint32_t memoryTypeBits, MemoryUsage usage);
+      Allocation AllocateLinear(LinearPoolHandle pool, const VkMemoryRequirements& requirements);
+      void ResetLinearPool(LinearPoolHandle pool);
+
+      const VkPhysicalDeviceMemoryProperties& MemoryProperties() { return _memoryProperties; };
+
+      AllocatorStatistics GetStatistics();
+      void PrintStatistics(std::ostream& stream);
+
+   private:
+      struct MemoryBlock
+      {
+         VkDeviceMemory memory = VK_NULL_HANDLE;
+         void* pMapped = nullptr;
+         TlsfAllocator allocator;
+      };
+
+      struct BlockPool
+      {
+         std::vector<std::unique_ptr<MemoryBlock>> blocks;
+      };
+
+      struct LinearPool
+      {
+         VkDeviceMemory memory = VK_NULL_HANDLE;
+         void* pMapped = nullptr;
+         uint32_t memoryTypeIndex = UINT32_MAX;
+         LinearAllocator allocator;
+      };
+
+      VkDeviceMemory AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** ppMapped);
+      void FreeDeviceMemory(VkDeviceMemory memory);
+      bool IsHostVisible(uint32_t memoryTypeIndex);
+      bool AllocateFromPool(uint32_t poolIndex, const VkMemoryRequirements& requirements, Allocation& allocation);
+
+      VkDevice _device = VK_NULL_HANDLE;
+      const VkAllocationCallbacks* _pAllocationCallbacks = nullptr;
+      VkPhysicalDeviceMemoryProperties _memoryProperties = {};
+      VkPhysicalDeviceLimits _limits = {};
+      VkDeviceSize _blockSizes[VK_MAX_MEMORY_TYPES] = {};
+
+      // Two pools per memory type, indexed memoryTypeIndex * 2 + tiling
+      std::vector<BlockPool> _blockPools;
+      std::vector<LinearPool> _linearPools;
+
+      uint32_t _deviceMemoryCount = 0;
+      uint32_t _dedicatedCount = 0;
+      VkDeviceSize _dedicatedBytes = 0;
+
+      std::mutex _mutex;
+   };
+}
@@ -0,0 +1,392 @@
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+namespace memory {
+
+   struct HostAllocator::Arena
+   {
+      unique_ptr<char[]> buffer{ new char[ArenaSize] };
+
+      // Only the owning thread moves the offset. Any thread may free, so
+      // the live count is atomic, and the owner rewinds once it is 0.
+      size_t offset = 0;
+      atomic<uint32_t> liveCount{ 0 };
+   };
+
+   struct HostAllocator::Pool
+   {
+      ~Pool()
+      {
+         for (char* pChunk : chunks)
+         {
+            free(pChunk);
+         }
+      }
+
+      size_t blockSize = 0;
+      mutex poolMutex;
+
+      // Freed blocks hold the pointer to the next one in their first bytes
+      void* pFreeList = nullptr;
+      vector<char*> chunks;
+   };
+
+   namespace {
+      // Vulkan never asks for more, and the header's offset is 16 bits
+      const size_t MaxAlignment = 4096;
+      const size_t RawAlignment = 16;
+
+      atomic<uint64_t> s_nextAllocatorId{ 1 };
+
+      struct ThreadArenaCache
+      {
+         uint64_t allocatorId = 0;
+         void* pArena = nullptr;
+      };
+
+      thread_local ThreadArenaCache t_arenaCache;
+
+      size_t AlignUp(size_t value, size_t alignment)
+      {
+         return (value + alignment - 1) & ~(alignment - 1);
+      }
+
+      void UpdatePeak(atomic<uint64_t>& peak, uint64_t value)
+      {
+         uint64_t current = peak.load(memory_order_relaxed);
+
+         while (value > current && !peak.compare_exchange_weak(current, value, memory_order_relaxed))
+         {
+         }
+      }
+   }
+
+   HostAllocator::HostAllocator()
+   {
+      _id = s_nextAllocatorId.fetch_add(1);
+
+      _pools.reset(new Pool[PoolCount]);
+
+      for (uint32_t i = 0; i < PoolCount; i++)
+      {
+         _pools[i].blockSize = MinPoolBlockSize << i;
+      }
+
+      _callbacks.pUserData = this;
+      _callbacks.pfnAllocation = &HostAllocator::AllocationFunction;
+      _callbacks.pfnReallocation = &HostAllocator::ReallocationFunction;
+      _callbacks.pfnFree = &HostAllocator::FreeFunction;
+      _callbacks.pfnInternalAllocation = &HostAllocator::InternalAllocationNotification;
+      _callbacks.pfnInternalFree = &HostAllocator::InternalFreeNotification;
+   }
+
+   // Here rather than in the header, where Arena and Pool are incomplete
+   HostAllocator::~HostAllocator() = default;
+
+   HostAllocator::Statistics HostAllocator::GetStatistics() const
+   {
+      Statistics statistics;
+
+      for (uint32_t i = 0; i < ScopeCount; i++)
+      {
+         const AtomicScopeStatistics& source = _statistics[i];
+         ScopeStatistics& scope = statistics.scopes[i];
+
+         scope.allocations = source.allocations.load(memory_order_relaxed);
+         scope.reallocations = source.reallocations.load(memory_order_relaxed);
+         scope.frees = source.frees.load(memory_order_relaxed);
+         scope.bytesAllocated = source.bytesAllocated.load(memory_order_relaxed);
+         scope.liveBytes = source.liveBytes.load(memory_order_relaxed);
+         scope.peakBytes = source.peakBytes.load(memory_order_relaxed);
+         scope.heapFallbacks = source.heapFallbacks.load(memory_order_relaxed);
+         scope.internalAllocations = source.internalAllocations.load(memory_order_relaxed);
+         scope.internalLiveBytes = source.internalLiveBytes.load(memory_order_relaxed);
+      }
+
+      return statistics;
+   }
+
+   const char* HostAllocator::ScopeName(VkSystemAllocationScope scope)
+   {
+      switch (scope)
+      {
+      case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND: return "command";
+      case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT: return "object";
+      case VK_SYSTEM_ALLOCATION_SCOPE_CACHE: return "cache";
+      case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE: return "device";
+      case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE: return "instance";
+      default: return "unknown";
+      }
+   }
+
+   void HostAllocator::PrintReport(ostream& stream, const Statistics& since, uint32_t frameCount) const
+   {
+      Statistics now = GetStatistics();
+      double divisor = frameCount > 0 ? (double)frameCount : 1.0;
+
+      char line[256];
+      snprintf(line, sizeof(line), "Host allocations %s:", frameCount > 0 ? "per frame" : "in total");
+      stream << line << endl;
+
+      snprintf(line, sizeof(line), "  %-9s %10s %10s %10s %12s %10s %10s %12s %12s",
+         "scope", "allocs", "reallocs", "frees", "bytes", "heap", "internal", "live bytes", "peak bytes");
+      stream << line << endl;
+
+      for (uint32_t i = 0; i < ScopeCount; i++)
+      {
+         const ScopeStatistics& start = since.scopes[i];
+         const ScopeStatistics& end = now.scopes[i];
+
+         snprintf(line, sizeof(line), "  %-9s %10.1f %10.1f %10.1f %12.1f %10.1f %10.1f %12llu %12llu",
+            ScopeName((VkSystemAllocationScope)i),
+            (end.allocations - start.allocations) / divisor,
+            (end.reallocations - start.reallocations) / divisor,
+            (end.frees - start.frees) / divisor,
+            (end.bytesAllocated - start.bytesAllocated) / divisor,
+            (end.heapFallbacks - start.heapFallbacks) / divisor,
+            (end.internalAllocations - start.internalAllocations) / divisor,
+            (unsigned long long)end.liveBytes, (unsigned long long)end.peakBytes);
+         stream << line << endl;
+      }
+   }
+
+   VKAPI_ATTR void* VKAPI_CALL HostAllocator::AllocationFunction(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+   {
+      HostAllocator& allocator = *static_cast<HostAllocator*>(pUserData);
+      void* pMemory = allocator.Allocate(size, alignment, scope);
+
+      if (pMemory)
+      {
+         allocator._statistics[scope].allocations.fetch_add(1, memory_order_relaxed);
+      }
+
+      return pMemory;
+   }
+
+   VKAPI_ATTR void* VKAPI_CALL HostAllocator::ReallocationFunction(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope)
+   {
+      HostAllocator& allocator = *static_cast<HostAllocator*>(pUserData);
+      allocator._statistics[scope].reallocations.fetch_add(1, memory_order_relaxed);
+
+      return allocator.Reallocate(pOriginal, size, alignment, scope);
+   }
+
+   VKAPI_ATTR void VKAPI_CALL HostAllocator::FreeFunction(void* pUserData, void* pMemory)
+   {
+      if (pMemory == nullptr)
+      {
+         return;
+      }
+
+      HostAllocator& allocator = *static_cast<HostAllocator*>(pUserData);
+      allocator._statistics[Header(pMemory).scope].frees.fetch_add(1, memory_order_relaxed);
+      allocator.Free(pMemory);
+   }
+
+   VKAPI_ATTR void VKAPI_CALL HostAllocator::InternalAllocationNotification(void* pUserData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+   {
+      AtomicScopeStatistics& statistics = static_cast<HostAllocator*>(pUserData)->_statistics[scope];
+      statistics.internalAllocations.fetch_add(1, memory_order_relaxed);
+      statistics.internalLiveBytes.fetch_add(size, memory_order_relaxed);
+   }
+
+   VKAPI_ATTR void VKAPI_CALL HostAllocator::InternalFreeNotification(void* pUserData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+   {
+      static_cast<HostAllocator*>(pUserData)->_statistics[scope].internalLiveBytes.fetch_sub(size, memory_order_relaxed);
+   }
+
+   void* HostAllocator::Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+   {
+      alignment = max(alignment, RawAlignment);
+
+      // Returning null makes the Vulkan call fail with
+      // VK_ERROR_OUT_OF_HOST_MEMORY, the same as malloc failing would
+      if (size == 0 || size > UINT32_MAX || alignment > MaxAlignment)
+      {
+         return nullptr;
+      }
+
+      // Raw blocks are 16 byte aligned, so the header always fits in front
+      // and larger alignments need at most alignment - 16 bytes of padding
+      size_t rawSize = HeaderSize + size + (alignment - RawAlignment);
+
+      Source source;
+      void* pOwner;
+      char* pRaw = static_cast<char*>(AllocateRaw(rawSize, scope, source, pOwner));
+
+      if (pRaw == nullptr)
+      {
+         return nullptr;
+      }
+
+      char* pMemory = reinterpret_cast<char*>(AlignUp(reinterpret_cast<uintptr_t>(pRaw) + HeaderSize, alignment));
+
+      BlockHeader& header = Header(pMemory);
+      header.pOwner = pOwner;
+      header.size = (uint32_t)size;
+      header.offset = (uint16_t)(pMemory - pRaw);
+      header.scope = (uint8_t)scope;
+      header.source = source;
+
+      AtomicScopeStatistics& statistics = _statistics[scope];
+      statistics.bytesAllocated.fetch_add(size, memory_order_relaxed);
+      UpdatePeak(statistics.peakBytes, statistics.liveBytes.fetch_add(size, memory_order_relaxed) + size);
+
+      return pMemory;
+   }
+
+   void* HostAllocator::Reallocate(void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope)
+   {
+      if (pOriginal == nullptr)
+      {
+         return Allocate(size, alignment, scope);
+      }
+
+      if (size == 0)
+      {
+         Free(pOriginal);
+         return nullptr;
+      }
+
+      // The driver reallocates rarely enough that growing in place is not
+      // worth the bookkeeping. On failure the original is left alone, as
+      // the spec requires.
+      void* pMemory = Allocate(size, alignment, scope);
+
+      if (pMemory)
+      {
+         memcpy(pMemory, pOriginal, min(size, (size_t)Header(pOriginal).size));
+         Free(pOriginal);
+      }
+
+      return pMemory;
+   }
+
+   void HostAllocator::Free(void* pMemory)
+   {
+      BlockHeader& header = Header(pMemory);
+      char* pRaw = static_cast<char*>(pMemory) - header.offset;
+
+      _statistics[header.scope].liveBytes.fetch_sub(header.size, memory_order_relaxed);
+
+      switch (header.source)
+      {
+      case Source::Arena:
+      {
+         // Releases the block's memory to the owner's next rewind
+         static_cast<Arena*>(header.pOwner)->liveCount.fetch_sub(1, memory_order_release);
+         break;
+      }
+      case Source::Pool:
+      {
+         Pool& pool = *static_cast<Pool*>(header.pOwner);
+         lock_guard<mutex> lock(pool.poolMutex);
+
+         *reinterpret_cast<void**>(pRaw) = pool.pFreeList;
+         pool.pFreeList = pRaw;
+         break;
+      }
+      case Source::Heap:
+         free(pRaw);
+         break;
+      }
+   }
+
+   void* HostAllocator::AllocateRaw(size_t rawSize, VkSystemAllocationScope scope, Source& source, void*& pOwner)
+   {
+      if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND)
+      {
+         Arena& arena = ThreadArena();
+
+         // Everything handed out has come back, so the whole arena is free
+         if (arena.liveCount.load(memory_order_acquire) == 0)
+         {
+            arena.offset = 0;
+         }
+
+         if (arena.offset + rawSize <= ArenaSize)
+         {
+            char* pRaw = arena.buffer.get() + arena.offset;
+            arena.offset += AlignUp(rawSize, RawAlignment);
+            arena.liveCount.fetch_add(1, memory_order_relaxed);
+
+            source = Source::Arena;
+            pOwner = &arena;
+            return pRaw;
+         }
+
+         _statistics[scope].heapFallbacks.fetch_add(1, memory_order_relaxed);
+      }
+      else if (scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+      {
+         uint32_t poolIndex = 0;
+
+         while (poolIndex < PoolCount && _pools[poolIndex].blockSize < rawSize)
+         {
+            poolIndex++;
+         }
+
+         if (poolIndex < PoolCount)
+         {
+            Pool& pool = _pools[poolIndex];
+            lock_guard<mutex> lock(pool.poolMutex);
+
+            if (pool.pFreeList == nullptr)
+            {
+               char* pChunk = static_cast<char*>(malloc(PoolChunkSize));
+
+               if (pChunk == nullptr)
+               {
+                  return nullptr;
+               }
+
+               pool.chunks.push_back(pChunk);
+
+               // Threaded onto the free list back to front, so blocks are
+               // handed out in address order
+               for (size_t i = PoolChunkSize / pool.blockSize; i-- > 0;)
+               {
+                  char* pBlock = pChunk + i * pool.blockSize;
+                  *reinterpret_cast<void**>(pBlock) = pool.pFreeList;
+                  pool.pFreeList = pBlock;
+               }
+            }
+
+            void* pRaw = pool.pFreeList;
+            pool.pFreeList = *static_cast<void**>(pRaw);
+
+            source = Source::Pool;
+            pOwner = &pool;
+            return pRaw;
+         }
+
+         _statistics[scope].heapFallbacks.fetch_add(1, memory_order_relaxed);
+      }
+
+      source = Source::Heap;
+      pOwner = nullptr;
+      return malloc(rawSize);
+   }
+
+   HostAllocator::Arena& HostAllocator::ThreadArena()
+   {
+      if (t_arenaCache.allocatorId != _id)
+      {
+         // A thread's first command scope allocation, the only time the
+         // arena list is locked
+         lock_guard<mutex> lock(_arenaMutex);
+         _arenas.push_back(make_unique<Arena>());
+
+         t_arenaCache.allocatorId = _id;
+         t_arenaCache.pArena = _arenas.back().get();
+      }
+
+      return *static_cast<Arena*>(t_arenaCache.pArena);
+   }
+}
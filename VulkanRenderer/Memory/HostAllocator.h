@@ -0,0 +1,132 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "../Common/Common.h"
+
+namespace memory {
+
+   // VkAllocationCallbacks that count the driver's host allocations per
+   // allocation scope and keep the short lived ones away from malloc.
+   //
+   // Command scope memory only lives for the call that asked for it, so it
+   // comes from a per thread arena that rewinds once everything in it has
+   // been freed. Object scope memory comes from size classed pools that
+   // keep freed blocks for the next object. Every other scope, and
+   // anything too large for an arena or pool, goes to the heap.
+   //
+   // The callbacks point back at the allocator, so it must outlive every
+   // object created with them. All methods are thread safe.
+   class HostAllocator {
+   public:
+      static const uint32_t ScopeCount = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+      struct ScopeStatistics
+      {
+         uint64_t allocations = 0;
+         uint64_t reallocations = 0;
+         uint64_t frees = 0;
+         uint64_t bytesAllocated = 0;
+         uint64_t liveBytes = 0;
+         uint64_t peakBytes = 0;
+
+         // Allocations in a pooled scope that had to go to the heap
+         uint64_t heapFallbacks = 0;
+
+         // Memory the driver allocated itself and only told us about
+         uint64_t internalAllocations = 0;
+         uint64_t internalLiveBytes = 0;
+      };
+
+      struct Statistics
+      {
+         ScopeStatistics scopes[ScopeCount];
+      };
+
+      HostAllocator();
+      ~HostAllocator();
+
+      HostAllocator(const HostAllocator&) = delete;
+      HostAllocator& operator=(const HostAllocator&) = delete;
+
+      const VkAllocationCallbacks* Callbacks() const { return &_callbacks; };
+
+      Statistics GetStatistics() const;
+      static const char* ScopeName(VkSystemAllocationScope scope);
+
+      // Calls and bytes per scope since the snapshot, and per frame when
+      // frameCount is not 0, followed by what is live now
+      void PrintReport(std::ostream& stream, const Statistics& since, uint32_t frameCount) const;
+
+   private:
+      enum class Source : uint8_t { Heap, Arena, Pool };
+
+      struct Arena;
+      struct Pool;
+
+      static const uint32_t PoolCount = 8;
+      static const size_t MinPoolBlockSize = 32;
+      static const size_t ArenaSize = 64 * 1024;
+      static const size_t PoolChunkSize = 64 * 1024;
+
+      // Written before every block handed out, so a free can find where it
+      // came from and which scope to count it against
+      struct BlockHeader
+      {
+         void* pOwner;
+         uint32_t size;
+         uint16_t offset;
+         uint8_t scope;
+         Source source;
+      };
+
+      static const size_t HeaderSize = 16;
+      static_assert(sizeof(BlockHeader) <= HeaderSize, "BlockHeader must fit in front of a 16 byte aligned block");
+
+      struct AtomicScopeStatistics
+      {
+         std::atomic<uint64_t> allocations{ 0 };
+         std::atomic<uint64_t> reallocations{ 0 };
+         std::atomic<uint64_t> frees{ 0 };
+         std::atomic<uint64_t> bytesAllocated{ 0 };
+         std::atomic<uint64_t> liveBytes{ 0 };
+         std::atomic<uint64_t> peakBytes{ 0 };
+         std::atomic<uint64_t> heapFallbacks{ 0 };
+         std::atomic<uint64_t> internalAllocations{ 0 };
+         std::atomic<uint64_t> internalLiveBytes{ 0 };
+      };
+
+      static VKAPI_ATTR void* VKAPI_CALL AllocationFunction(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+      static VKAPI_ATTR void* VKAPI_CALL ReallocationFunction(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope);
+      static VKAPI_ATTR void VKAPI_CALL FreeFunction(void* pUserData, void* pMemory);
+      static VKAPI_ATTR void VKAPI_CALL InternalAllocationNotification(void* pUserData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+      static VKAPI_ATTR void VKAPI_CALL InternalFreeNotification(void* pUserData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+      void* Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+      void* Reallocate(void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope);
+      void Free(void* pMemory);
+
+      // Raw blocks are 16 byte aligned, with room for the header and
+      // alignment padding already included in rawSize
+      void* AllocateRaw(size_t rawSize, VkSystemAllocationScope scope, Source& source, void*& pOwner);
+      Arena& ThreadArena();
+
+      static BlockHeader& Header(void* pMemory) { return *reinterpret_cast<BlockHeader*>(static_cast<char*>(pMemory) - HeaderSize); };
+
+      VkAllocationCallbacks _callbacks = {};
+
+      // Tells this allocator's arenas apart from those of one destroyed
+      // earlier at the same address
+      uint64_t _id = 0;
+
+      std::mutex _arenaMutex;
+      std::vector<std::unique_ptr<Arena>> _arenas;
+      std::unique_ptr<Pool[]> _pools;
+
+      AtomicScopeStatistics _statistics[ScopeCount];
+   };
+}
@@ -0,0 +1,34 @@
+#include "LinearAllocator.h"
+
+namespace memory {
+
+   bool LinearAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t& offset)
+   {
+      if (alignment == 0)
+      {
+         alignment = 1;
+      }
+
+      uint64_t alignedHead = (_head + alignment - 1) & ~(alignment - 1);
+
+      if (size > _size || alignedHead > _size - size)
+      {
+         return false;
+      }
+
+      offset = alignedHead;
+      _head = alignedHead + size;
+
+      if (_head > _highWaterMark)
+      {
+         _highWaterMark = _head;
+      }
+
+      return true;
+   }
+
+   void LinearAllocator::Reset()
+   {
+      _head = 0;
+   }
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+
+namespace memory {
+
+   // Bump allocator over an abstract range of bytes, for transient data
+   // that is all released at once. Like TlsfAllocator it only deals in
+   // offsets and has no Vulkan dependency.
+   class LinearAllocator {
+   public:
+      explicit LinearAllocator(uint64_t size = 0) : _size(size) {};
+
+      bool Allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+      void Reset();
+
+      uint64_t Size() { return _size; };
+      uint64_t UsedBytes() { return _head; };
+      uint64_t HighWaterMark() { return _highWaterMark; };
+
+   private:
+      uint64_t _size = 0;
+      uint64_t _head = 0;
+      uint64_t _highWaterMark = 0;
+   };
+}
@@ -0,0 +1,380 @@
+#include "TlsfAllocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+namespace memory {
+
+   namespace {
+      const uint32_t NoNode = UINT32_MAX;
+
+      uint32_t LowestBit(uint64_t value)
+      {
+#ifdef _MSC_VER
+         unsigned long index;
+         _BitScanForward64(&index, value);
+         return index;
+#else
+         return (uint32_t)__builtin_ctzll(value);
+#endif
+      }
+
+      uint32_t HighestBit(uint64_t value)
+      {
+#ifdef _MSC_VER
+         unsigned long index;
+         _BitScanReverse64(&index, value);
+         return index;
+#else
+         return 63 - (uint32_t)__builtin_clzll(value);
+#endif
+      }
+
+      uint64_t AlignUp(uint64_t value, uint64_t alignment)
+      {
+         return (value + alignment - 1) & ~(alignment - 1);
+      }
+   }
+
+   TlsfAllocator::TlsfAllocator(uint64_t size)
+   {
+      Reset(size);
+   }
+
+   void TlsfAllocator::Reset(uint64_t size)
+   {
+      _nodes.clear();
+      _unusedNodes.clear();
+      _firstLevelBitmap = 0;
+
+      for (uint32_t i = 0; i < FirstLevelCount; i++)
+      {
+         _secondLevelBitmaps[i] = 0;
+
+         for (uint32_t j = 0; j < SecondLevelCount; j++)
+         {
+            _freeLists[i][j] = NoNode;
+         }
+      }
+
+      _size = size;
+      _usedBytes = 0;
+      _allocationCount = 0;
+      _freeBlockCount = 0;
+
+      if (size > 0)
+      {
+         uint32_t node = CreateNode();
+         _nodes[node].offset = 0;
+         _nodes[node].size = size;
+         InsertFreeNode(node);
+      }
+   }
+
+   bool TlsfAllocator::Allocate(uint64_t size, uint64_t alignment, TlsfAllocation& allocation)
+   {
+      if (size == 0)
+      {
+         return false;
+      }
+
+      if (alignment == 0)
+      {
+         alignment = 1;
+      }
+
+      uint32_t node = FindFreeNode(size, alignment);
+
+      if (node == NoNode)
+      {
+         return false;
+      }
+
+      RemoveFreeNode(node);
+
+      uint64_t padding = AlignUp(_nodes[node].offset, alignment) - _nodes[node].offset;
+
+      if (padding > 0)
+      {
+         uint32_t alignedNode = SplitNode(node, padding);
+         InsertFreeNode(node);
+         node = alignedNode;
+      }
+
+      if (_nodes[node].size > size)
+      {
+         uint32_t remainder = SplitNode(node, size);
+         InsertFreeNode(remainder);
+      }
+
+      _nodes[node].isFree = false;
+      _usedBytes += size;
+      _allocationCount++;
+
+      allocation.offset = _nodes[node].offset;
+      allocation.size = size;
+      allocation.node = node;
+
+      return true;
+   }
+
+   void TlsfAllocator::Free(const TlsfAllocation& allocation)
+   {
+      uint32_t node = allocation.node;
+
+      if (node >= _nodes.size() || _nodes[node].isFree)
+      {
+         return;
+      }
+
+      _usedBytes -= _nodes[node].size;
+      _allocationCount--;
+
+      // Coalesce with free physical neighbours so free space never stays
+      // split up into blocks that no longer need to be separate
+      uint32_t previous = _nodes[node].prevPhysical;
+      if (previous != NoNode && _nodes[previous].isFree)
+      {
+         RemoveFreeNode(previous);
+         _nodes[previous].size += _nodes[node].size;
+         _nodes[previous].nextPhysical = _nodes[node].nextPhysical;
+
+         if (_nodes[node].nextPhysical != NoNode)
+         {
+            _nodes[_nodes[node].nextPhysical].prevPhysical = previous;
+         }
+
+         ReleaseNode(node);
+         node = previous;
+      }
+
+      uint32_t next = _nodes[node].nextPhysical;
+      if (next != NoNode && _nodes[next].isFree)
+      {
+         RemoveFreeNode(next);
+         _nodes[node].size += _nodes[next].size;
+         _nodes[node].nextPhysical = _nodes[next].nextPhysical;
+
+         if (_nodes[next].nextPhysical != NoNode)
+         {
+            _nodes[_nodes[next].nextPhysical].prevPhysical = node;
+         }
+
+         ReleaseNode(next);
+      }
+
+      InsertFreeNode(node);
+   }
+
+   uint64_t TlsfAllocator::LargestFreeBlock()
+   {
+      if (_firstLevelBitmap == 0)
+      {
+         return 0;
+      }
+
+      // The largest block is somewhere in the highest non-empty size class
+      uint32_t firstLevel = HighestBit(_firstLevelBitmap);
+      uint32_t secondLevel = HighestBit(_secondLevelBitmaps[firstLevel]);
+
+      uint64_t largest = 0;
+      for (uint32_t node = _freeLists[firstLevel][secondLevel]; node != NoNode; node = _nodes[node].nextFree)
+      {
+         if (_nodes[node].size > largest)
+         {
+            largest = _nodes[node].size;
+         }
+      }
+
+      return largest;
+   }
+
+   void TlsfAllocator::MapInsert(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+   {
+      // Sizes below SecondLevelCount get an exact class each, above that
+      // every power of two range is split into SecondLevelCount classes
+      if (size < SecondLevelCount)
+      {
+         firstLevel = 0;
+         secondLevel = (uint32_t)size;
+      }
+      else
+      {
+         uint32_t highestBit = HighestBit(size);
+         secondLevel = (uint32_t)(size >> (highestBit - SecondLevelLog2)) ^ SecondLevelCount;
+         firstLevel = highestBit - SecondLevelLog2 + 1;
+      }
+   }
+
+   void TlsfAllocator::MapSearch(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+   {
+      // Round up to the next class boundary, so every block in the class
+      // that is found is at least as big as the request
+      if (size >= SecondLevelCount)
+      {
+         size += (1ull << (HighestBit(size) - SecondLevelLog2)) - 1;
+      }
+
+      MapInsert(size, firstLevel, secondLevel);
+   }
+
+   uint32_t TlsfAllocator::FindFreeNode(uint64_t size, uint64_t alignment)
+   {
+      // Search for room for the worst case padding, so whichever block
+      // comes back is guaranteed to fit once aligned
+      uint64_t searchSize = size + alignment - 1;
+
+      uint32_t firstLevel;
+      uint32_t secondLevel;
+      MapSearch(searchSize, firstLevel, secondLevel);
+
+      if (firstLevel < FirstLevelCount)
+      {
+         uint32_t secondLevelMap = _secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+
+         if (secondLevelMap == 0)
+         {
+            uint64_t firstLevelMap = firstLevel + 1 < FirstLevelCount ? _firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+
+            if (firstLevelMap != 0)
+            {
+               firstLevel = LowestBit(firstLevelMap);
+               secondLevelMap = _secondLevelBitmaps[firstLevel];
+            }
+         }
+
+         if (secondLevelMap != 0)
+         {
+            secondLevel = LowestBit(secondLevelMap);
+            return _freeLists[firstLevel][secondLevel];
+         }
+      }
+
+      // Rounding up to a class boundary can skip a block that would fit,
+      // which matters when the allocator is nearly full. Fall back to
+      // walking the one class the request itself falls into.
+      MapInsert(size, firstLevel, secondLevel);
+
+      for (uint32_t node = _freeLists[firstLevel][secondLevel]; node != NoNode; node = _nodes[node].nextFree)
+      {
+         uint64_t padding = AlignUp(_nodes[node].offset, alignment) - _nodes[node].offset;
+
+         if (_nodes[node].size >= size + padding)
+         {
+            return node;
+         }
+      }
+
+      return NoNode;
+   }
+
+   void TlsfAllocator::InsertFreeNode(uint32_t node)
+   {
+      uint32_t firstLevel;
+      uint32_t secondLevel;
+      MapInsert(_nodes[node].size, firstLevel, secondLevel);
+
+      uint32_t head = _freeLists[firstLevel][secondLevel];
+
+      _nodes[node].isFree = true;
+      _nodes[node].prevFree = NoNode;
+      _nodes[node].nextFree = head;
+
+      if (head != NoNode)
+      {
+         _nodes[head].prevFree = node;
+      }
+
+      _freeLists[firstLevel][secondLevel] = node;
+      _firstLevelBitmap |= 1ull << firstLevel;
+      _secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+      _freeBlockCount++;
+   }
+
+   void TlsfAllocator::RemoveFreeNode(uint32_t node)
+   {
+      uint32_t firstLevel;
+      uint32_t secondLevel;
+      MapInsert(_nodes[node].size, firstLevel, secondLevel);
+
+      uint32_t previous = _nodes[node].prevFree;
+      uint32_t next = _nodes[node].nextFree;
+
+      if (previous != NoNode)
+      {
+         _nodes[previous].nextFree = next;
+      }
+      else
+      {
+         _freeLists[firstLevel][secondLevel] = next;
+      }
+
+      if (next != NoNode)
+      {
+         _nodes[next].prevFree = previous;
+      }
+
+      if (_freeLists[firstLevel][secondLevel] == NoNode)
+      {
+         _secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+
+         if (_secondLevelBitmaps[firstLevel] == 0)
+         {
+            _firstLevelBitmap &= ~(1ull << firstLevel);
+         }
+      }
+
+      _nodes[node].isFree = false;
+      _freeBlockCount--;
+   }
+
+   uint32_t TlsfAllocator::SplitNode(uint32_t node, uint64_t size)
+   {
+      // CreateNode can grow _nodes, so no references are held across it
+      uint32_t remainder = CreateNode();
+
+      _nodes[remainder].offset = _nodes[node].offset + size;
+      _nodes[remainder].size = _nodes[node].size - size;
+      _nodes[remainder].prevPhysical = node;
+      _nodes[remainder].nextPhysical = _nodes[node].nextPhysical;
+
+      if (_nodes[node].nextPhysical != NoNode)
+      {
+         _nodes[_nodes[node].nextPhysical].prevPhysical = remainder;
+      }
+
+      _nodes[node].size = size;
+      _nodes[node].nextPhysical = remainder;
+
+      return remainder;
+   }
+
+   uint32_t TlsfAllocator::CreateNode()
+   {
+      uint32_t node;
+
+      if (!_unusedNodes.empty())
+      {
+         node = _unusedNodes.back();
+         _unusedNodes.pop_back();
+      }
+      else
+      {
+         node = (uint32_t)_nodes.size();
+         _nodes.emplace_back();
+      }
+
+      _nodes[node] = { 0, 0, NoNode, NoNode, NoNode, NoNode, false };
+      return node;
+   }
+
+   void TlsfAllocator::ReleaseNode(uint32_t node)
+   {
+      // Flagged free so a stale allocation handle is ignored by Free
+      _nodes[node].isFree = true;
+      _unusedNodes.push_back(node);
+   }
+}
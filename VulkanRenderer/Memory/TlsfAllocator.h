@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace memory {
+
+   struct TlsfAllocation
+   {
+      uint64_t offset = 0;
+      uint64_t size = 0;
+      uint32_t node = UINT32_MAX;
+   };
+
+   // Two level segregated fit allocator over an abstract range of bytes. It
+   // never touches the memory it manages, it only hands out offsets, so it
+   // carries no Vulkan dependency and can be exercised entirely on the CPU.
+   //
+   // Allocate and Free are O(1): free blocks are binned by size class in a
+   // two level bitmap, and neighbouring free blocks are merged on Free.
+   class TlsfAllocator {
+   public:
+      explicit TlsfAllocator(uint64_t size = 0);
+
+      void Reset(uint64_t size);
+
+      bool Allocate(uint64_t size, uint64_t alignment, TlsfAllocation& allocation);
+      void Free(const TlsfAllocation& allocation);
+
+      uint64_t Size() { return _size; };
+      uint64_t UsedBytes() { return _usedBytes; };
+      uint64_t FreeBytes() { return _size - _usedBytes; };
+      uint32_t AllocationCount() { return _allocationCount; };
+      uint32_t FreeBlockCount() { return _freeBlockCount; };
+      uint64_t LargestFreeBlock();
+      bool IsEmpty() { return _allocationCount == 0; };
+
+   private:
+      static const uint32_t SecondLevelLog2 = 5;
+      static const uint32_t SecondLevelCount = 1 << SecondLevelLog2;
+      static const uint32_t FirstLevelCount = 64 - SecondLevelLog2 + 1;
+
+      struct Node
+      {
+         uint64_t offset;
+         uint64_t size;
+         uint32_t prevPhysical;
+         uint32_t nextPhysical;
+         uint32_t prevFree;
+         uint32_t nextFree;
+         bool isFree;
+      };
+
+      static void MapInsert(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+      static void MapSearch(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+
+      uint32_t FindFreeNode(uint64_t size, uint64_t alignment);
+      void InsertFreeNode(uint32_t node);
+      void RemoveFreeNode(uint32_t node);
+      uint32_t SplitNode(uint32_t node, uint64_t size);
+      uint32_t CreateNode();
+      void ReleaseNode(uint32_t node);
+
+      std::vector<Node> _nodes;
+      std::vector<uint32_t> _unusedNodes;
+
+      uint64_t _firstLevelBitmap = 0;
+      uint32_t _secondLevelBitmaps[FirstLevelCount] = {};
+      uint32_t _freeLists[FirstLevelCount][SecondLevelCount];
+
+      uint64_t _size = 0;
+      uint64_t _usedBytes = 0;
+      uint32_t _allocationCount = 0;
+      uint32_t _freeBlockCount = 0;
+   };
+}
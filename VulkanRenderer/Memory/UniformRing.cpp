@@ -0,0 +1,94 @@
+#include "UniformRing.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace memory {
+
+   namespace {
+      VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+      {
+         return (value + alignment - 1) / alignment * alignment;
+      }
+   }
+
+   void UniformRing::Initialise(const VkPhysicalDevice& physicalDevice, DeviceAllocator& allocator, uint32_t framesInFlight,
+      VkDeviceSize frameSize)
+   {
+      _pAllocator = &allocator;
+
+      VkPhysicalDeviceProperties properties;
+      vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+      _alignment = max(properties.limits.minUniformBufferOffsetAlignment, (VkDeviceSize)1);
+      _maxRange = properties.limits.maxUniformBufferRange;
+
+      // Every region starts aligned, so offsets within it only need
+      // aligning relative to its start
+      _frameSize = AlignUp(frameSize, _alignment);
+
+      // Dynamic offsets are 32 bit
+      if (_frameSize * framesInFlight > UINT32_MAX)
+      {
+         throw runtime_error("Failed to create uniform ring, it must fit in 4GB");
+      }
+
+      VkBufferCreateInfo bufferInfo = {};
+      bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      bufferInfo.size = _frameSize * framesInFlight;
+      bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+      bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+      // CpuToGpu memory is always host coherent
+      _pAllocator->CreateBuffer(bufferInfo, MemoryUsage::CpuToGpu, _buffer, _allocation);
+
+      if (_allocation.pMapped == nullptr)
+      {
+         throw runtime_error("Failed to map uniform ring");
+      }
+
+      _frameStart = 0;
+      _head = 0;
+   }
+
+   void UniformRing::Destroy()
+   {
+      if (_pAllocator && _buffer != VK_NULL_HANDLE)
+      {
+         _pAllocator->DestroyBuffer(_buffer, _allocation);
+      }
+   }
+
+   void UniformRing::BeginFrame(uint32_t frameSlot)
+   {
+      _highWaterMark = max(_highWaterMark, _head.load(memory_order_relaxed));
+
+      _frameStart = frameSlot * _frameSize;
+      _head.store(0, memory_order_relaxed);
+   }
+
+   UniformAllocation UniformRing::Allocate(VkDeviceSize size)
+   {
+      // A descriptor can only see maxUniformBufferRange bytes past its offset
+      if (size > _maxRange)
+      {
+         throw runtime_error("Failed to allocate frame uniform data, it is larger than maxUniformBufferRange");
+      }
+
+      VkDeviceSize alignedSize = AlignUp(size, _alignment);
+      VkDeviceSize offset = _head.fetch_add(alignedSize, memory_order_relaxed);
+
+      if (offset + size > _frameSize)
+      {
+         throw runtime_error("Failed to allocate frame uniform data, the frame's region of the ring is full");
+      }
+
+      UniformAllocation allocation;
+      allocation.pData = static_cast<char*>(_allocation.pMapped) + _frameStart + offset;
+      allocation.offset = (uint32_t)(_frameStart + offset);
+
+      return allocation;
+   }
+}
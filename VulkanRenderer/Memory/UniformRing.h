@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <cstring>
+
+#include "../Common/Common.h"
+#include "DeviceAllocator.h"
+
+namespace memory {
+
+   struct UniformAllocation
+   {
+      void* pData = nullptr;
+
+      // The dynamic offset to bind the data with
+      uint32_t offset = 0;
+   };
+
+   // Per frame constants, written straight into one persistently mapped
+   // uniform buffer split into a region per frame in flight. Allocating is
+   // an atomic bump of the frame's head, rounded up to
+   // minUniformBufferOffsetAlignment, so any recording thread can allocate
+   // and the data is bound with a dynamic offset into the one descriptor.
+   //
+   // The memory is host coherent, so nothing is ever flushed, and a region
+   // is only rewound once the frame that last used it has finished.
+   class UniformRing {
+   public:
+      static constexpr VkDeviceSize DefaultFrameSize = 1ull * 1024 * 1024;
+
+      void Initialise(const VkPhysicalDevice& physicalDevice, DeviceAllocator& allocator, uint32_t framesInFlight,
+         VkDeviceSize frameSize = DefaultFrameSize);
+      void Destroy();
+
+      // Only once the frame's fence has signalled
+      void BeginFrame(uint32_t frameSlot);
+
+      // Throws if the frame's region is full
+      UniformAllocation Allocate(VkDeviceSize size);
+
+      // Copies data in and returns the dynamic offset to bind it with
+      template <typename T>
+      uint32_t Push(const T& data)
+      {
+         UniformAllocation allocation = Allocate(sizeof(T));
+         memcpy(allocation.pData, &data, sizeof(T));
+         return allocation.offset;
+      };
+
+      VkBuffer Buffer() const { return _buffer; };
+
+      // The most any one frame has allocated
+      VkDeviceSize HighWaterMark() const { return _highWaterMark; };
+
+   private:
+      DeviceAllocator* _pAllocator = nullptr;
+      VkBuffer _buffer = VK_NULL_HANDLE;
+      Allocation _allocation;
+
+      VkDeviceSize _alignment = 0;
+      VkDeviceSize _frameSize = 0;
+      VkDeviceSize _maxRange = 0;
+
+      // Offset of the current frame's region, and how much of it is used
+      VkDeviceSize _frameStart = 0;
+      std::atomic<VkDeviceSize> _head{ 0 };
+      VkDeviceSize _highWaterMark = 0;
+   };
+}
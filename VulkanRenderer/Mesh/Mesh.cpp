@@ -0,0 +1,104 @@
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace std;
+
+namespace mesh {
+
+   namespace {
+      int16_t QuantiseSnorm16(float value)
+      {
+         return (int16_t)lround(min(max(value, -1.0f), 1.0f) * 32767.0f);
+      }
+
+      uint32_t QuantiseUnorm8(float value)
+      {
+         return (uint32_t)lround(min(max(value, 0.0f), 1.0f) * 255.0f);
+      }
+   }
+
+   MeshView PackedMesh::View() const
+   {
+      MeshView view;
+      view.pVertices = vertices.data();
+      view.vertexCount = (uint32_t)vertices.size();
+      view.pIndices = indices.data();
+      view.indexCount = (uint32_t)indices.size();
+      view.bounds = bounds;
+
+      return view;
+   }
+
+   MeshBounds ComputeBounds(const MeshData& mesh)
+   {
+      MeshBounds bounds = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX }, 0.0f };
+      float radiusSquared = 0.0f;
+
+      for (const auto& vertex : mesh.vertices)
+      {
+         const float* p = vertex.position;
+
+         for (int axis = 0; axis < 3; axis++)
+         {
+            bounds.min[axis] = min(bounds.min[axis], p[axis]);
+            bounds.max[axis] = max(bounds.max[axis], p[axis]);
+         }
+
+         radiusSquared = max(radiusSquared, p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+      }
+
+      if (mesh.vertices.empty())
+      {
+         bounds = {};
+      }
+
+      bounds.radius = sqrt(radiusSquared);
+
+      return bounds;
+   }
+
+   Dequantisation GetDequantisation(const MeshBounds& bounds)
+   {
+      Dequantisation dequantisation;
+
+      for (int axis = 0; axis < 3; axis++)
+      {
+         dequantisation.offset[axis] = 0.5f * (bounds.min[axis] + bounds.max[axis]);
+         dequantisation.scale[axis] = 0.5f * (bounds.max[axis] - bounds.min[axis]);
+      }
+
+      return dequantisation;
+   }
+
+   PackedMesh Quantise(const MeshData& mesh)
+   {
+      PackedMesh packed;
+      packed.bounds = ComputeBounds(mesh);
+      packed.indices = mesh.indices;
+      packed.vertices.resize(mesh.vertices.size());
+
+      Dequantisation dequantisation = GetDequantisation(packed.bounds);
+
+      for (size_t i = 0; i < mesh.vertices.size(); i++)
+      {
+         const Vertex& vertex = mesh.vertices[i];
+         PackedVertex& out = packed.vertices[i];
+
+         for (int axis = 0; axis < 3; axis++)
+         {
+            // A flat axis has no extent to divide by, and every vertex sits on the offset
+            float scale = dequantisation.scale[axis];
+            out.position[axis] = scale > 0.0f ? QuantiseSnorm16((vertex.position[axis] - dequantisation.offset[axis]) / scale) : 0;
+         }
+
+         out.position[3] = 0;
+         out.colour = QuantiseUnorm8(vertex.colour[0]) | (QuantiseUnorm8(vertex.colour[1]) << 8) |
+            (QuantiseUnorm8(vertex.colour[2]) << 16) | 0xff000000u;
+      }
+
+      return packed;
+   }
+}
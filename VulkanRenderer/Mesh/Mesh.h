@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace mesh {
+
+   // Geometry as it is authored or parsed, before quantisation
+   struct Vertex
+   {
+      float position[3];
+      float colour[3];
+   };
+
+   struct MeshData
+   {
+      std::vector<Vertex> vertices;
+      std::vector<uint32_t> indices;
+   };
+
+   // What the GPU reads. Positions are 16 bit snorm within the mesh's
+   // bounding box and colours RGBA8, half the size of the float vertex.
+   struct PackedVertex
+   {
+      int16_t position[4];    // w is unused, padding the colour to 4 bytes
+      uint32_t colour;
+   };
+
+   static_assert(sizeof(PackedVertex) == 12, "PackedVertex must match the vertex input layout");
+
+   struct MeshBounds
+   {
+      float min[3];
+      float max[3];
+      float radius;           // Sphere about the origin, which instances are placed by
+   };
+
+   // Quantised positions map -1..1 onto the bounding box, so
+   // position = offset + snorm * scale
+   struct Dequantisation
+   {
+      float offset[3];
+      float scale[3];
+   };
+
+   // Points into memory owned elsewhere, a packed mesh or a mapped file
+   struct MeshView
+   {
+      const PackedVertex* pVertices = nullptr;
+      uint32_t vertexCount = 0;
+      const uint32_t* pIndices = nullptr;
+      uint32_t indexCount = 0;
+      MeshBounds bounds = {};
+   };
+
+   struct PackedMesh
+   {
+      std::vector<PackedVertex> vertices;
+      std::vector<uint32_t> indices;
+      MeshBounds bounds = {};
+
+      MeshView View() const;
+   };
+
+   MeshBounds ComputeBounds(const MeshData& mesh);
+   Dequantisation GetDequantisation(const MeshBounds& bounds);
+
+   PackedMesh Quantise(const MeshData& mesh);
+}
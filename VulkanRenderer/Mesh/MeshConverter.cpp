@@ -0,0 +1,34 @@
+#include "MeshConverter.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "MeshFile.h"
+#include "ObjParser.h"
+
+using namespace std;
+
+namespace mesh {
+
+   int MeshConverter::Run(const string& inputPath, const string& outputPath)
+   {
+      MeshData source = ParseObj(inputPath);
+      PackedMesh packed = Quantise(source);
+      WriteMeshFile(outputPath, packed);
+
+      // Reading it back checks the file is one the renderer will accept
+      MeshFile file;
+      file.Open(outputPath);
+
+      const MeshBounds& bounds = file.Header().bounds;
+      size_t sourceBytes = source.vertices.size() * sizeof(Vertex) + source.indices.size() * sizeof(uint32_t);
+
+      printf("%s -> %s\n", inputPath.c_str(), outputPath.c_str());
+      printf("  %u vertices, %u triangles\n", file.Header().vertexCount, file.Header().indexCount / 3);
+      printf("  bounds (%g, %g, %g) to (%g, %g, %g), radius %g\n",
+         bounds.min[0], bounds.min[1], bounds.min[2], bounds.max[0], bounds.max[1], bounds.max[2], bounds.radius);
+      printf("  %zu bytes as floats, %zu bytes written\n", sourceBytes, file.FileSize());
+
+      return EXIT_SUCCESS;
+   }
+}
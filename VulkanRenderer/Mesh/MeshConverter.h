@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+
+namespace mesh {
+
+   // The offline half of mesh loading: parses a Wavefront OBJ, quantises
+   // it and writes the .vmesh file the renderer maps at load time
+   class MeshConverter {
+   public:
+      int Run(const std::string& inputPath, const std::string& outputPath);
+   };
+}
@@ -0,0 +1,143 @@
+#include "MeshFile.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#include "../Profiling/Trace.h"
+
+using namespace std;
+
+namespace mesh {
+
+   namespace {
+      uint64_t AlignUp(uint64_t value, uint64_t alignment)
+      {
+         return (value + alignment - 1) & ~(alignment - 1);
+      }
+
+      // The blob has to sit wholly inside the file. Sizes are checked by
+      // subtraction so a corrupt count cannot overflow past the check.
+      bool BlobFits(uint64_t offset, uint64_t count, uint64_t stride, uint64_t fileSize)
+      {
+         return offset % MeshBlobAlignment == 0 && offset <= fileSize && count <= (fileSize - offset) / stride;
+      }
+   }
+
+   void MeshFile::Open(const string& path)
+   {
+      TRACE_FUNCTION();
+
+      Close();
+
+      if (!_file.Open(path))
+      {
+         throw runtime_error("Failed to open mesh file " + path);
+      }
+
+      if (_file.Size() < sizeof(MeshFileHeader))
+      {
+         Close();
+         throw runtime_error("Failed to load mesh file " + path + ", it is too small to be a mesh");
+      }
+
+      const MeshFileHeader* pHeader = reinterpret_cast<const MeshFileHeader*>(_file.Data());
+
+      if (pHeader->magic != MeshFileMagic)
+      {
+         Close();
+         throw runtime_error("Failed to load mesh file " + path + ", it is not a mesh file");
+      }
+
+      if (pHeader->version != MeshFileVersion || pHeader->headerSize != sizeof(MeshFileHeader) ||
+         pHeader->vertexStride != sizeof(PackedVertex))
+      {
+         Close();
+         throw runtime_error("Failed to load mesh file " + path + ", it was written by a different version of the converter");
+      }
+
+      if (!BlobFits(pHeader->vertexOffset, pHeader->vertexCount, sizeof(PackedVertex), _file.Size()) ||
+         !BlobFits(pHeader->indexOffset, pHeader->indexCount, sizeof(uint32_t), _file.Size()))
+      {
+         Close();
+         throw runtime_error("Failed to load mesh file " + path + ", it is truncated");
+      }
+
+      // Either would become a zero sized buffer once uploaded
+      if (pHeader->vertexCount == 0 || pHeader->indexCount == 0)
+      {
+         Close();
+         throw runtime_error("Failed to load mesh file " + path + ", it has no vertices or no indices");
+      }
+
+      // The blobs are about to be streamed into staging memory front to
+      // back, so start the reads now rather than page fault through them
+      _file.WillNeed();
+
+      // Nothing checks indices once they are on the GPU, so one past the
+      // end would read whatever follows in the vertex buffer
+      const uint32_t* pIndices = reinterpret_cast<const uint32_t*>(_file.Data() + pHeader->indexOffset);
+
+      for (uint32_t i = 0; i < pHeader->indexCount; i++)
+      {
+         if (pIndices[i] >= pHeader->vertexCount)
+         {
+            Close();
+            throw runtime_error("Failed to load mesh file " + path + ", an index is out of range");
+         }
+      }
+
+      _pHeader = pHeader;
+   }
+
+   void MeshFile::Close()
+   {
+      _file.Close();
+      _pHeader = nullptr;
+   }
+
+   MeshView MeshFile::View() const
+   {
+      MeshView view;
+      view.pVertices = reinterpret_cast<const PackedVertex*>(_file.Data() + _pHeader->vertexOffset);
+      view.vertexCount = _pHeader->vertexCount;
+      view.pIndices = reinterpret_cast<const uint32_t*>(_file.Data() + _pHeader->indexOffset);
+      view.indexCount = _pHeader->indexCount;
+      view.bounds = _pHeader->bounds;
+
+      return view;
+   }
+
+   void WriteMeshFile(const string& path, const PackedMesh& mesh)
+   {
+      MeshFileHeader header = {};
+      header.magic = MeshFileMagic;
+      header.version = MeshFileVersion;
+      header.headerSize = sizeof(MeshFileHeader);
+      header.vertexStride = sizeof(PackedVertex);
+      header.vertexCount = (uint32_t)mesh.vertices.size();
+      header.indexCount = (uint32_t)mesh.indices.size();
+      header.vertexOffset = AlignUp(sizeof(MeshFileHeader), MeshBlobAlignment);
+      header.indexOffset = AlignUp(header.vertexOffset + mesh.vertices.size() * sizeof(PackedVertex), MeshBlobAlignment);
+      header.bounds = mesh.bounds;
+
+      ofstream file(path, ios::binary | ios::trunc);
+
+      if (!file.is_open())
+      {
+         throw runtime_error("Failed to create mesh file " + path);
+      }
+
+      const char padding[MeshBlobAlignment] = {};
+
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(padding, (streamsize)(header.vertexOffset - sizeof(header)));
+      file.write(reinterpret_cast<const char*>(mesh.vertices.data()), (streamsize)(mesh.vertices.size() * sizeof(PackedVertex)));
+      file.write(padding, (streamsize)(header.indexOffset - header.vertexOffset - mesh.vertices.size() * sizeof(PackedVertex)));
+      file.write(reinterpret_cast<const char*>(mesh.indices.data()), (streamsize)(mesh.indices.size() * sizeof(uint32_t)));
+
+      if (!file)
+      {
+         throw runtime_error("Failed to write mesh file " + path);
+      }
+   }
+}
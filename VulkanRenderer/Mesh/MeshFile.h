@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+
+#include "../Common/MappedFile.h"
+#include "Mesh.h"
+
+namespace mesh {
+
+   static const uint32_t MeshFileMagic = 0x48534D56;   // "VMSH" read as little endian
+   static const uint32_t MeshFileVersion = 1;
+
+   // Every blob starts on a cache line, and a mapping starts on a page, so
+   // the blobs can be read in place with no alignment fix ups
+   static const uint64_t MeshBlobAlignment = 64;
+
+   // A .vmesh file is this header, then the packed vertices, then 32 bit
+   // indices local to the mesh, each blob at the offset the header gives.
+   // Everything is little endian, as written by the converter.
+   struct MeshFileHeader
+   {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t headerSize;
+      uint32_t vertexStride;
+      uint32_t vertexCount;
+      uint32_t indexCount;
+      uint64_t vertexOffset;
+      uint64_t indexOffset;
+      MeshBounds bounds;
+      uint32_t padding;
+   };
+
+   static_assert(sizeof(MeshFileHeader) == 72, "MeshFileHeader is part of the file format");
+
+   // Maps a .vmesh file and hands out views straight into the mapping.
+   // Nothing is parsed or copied, so the view stays valid only while the
+   // file is open.
+   class MeshFile {
+   public:
+      // Throws if the file is missing, truncated, not a mesh file of this
+      // version, empty, or has an index past its last vertex
+      void Open(const std::string& path);
+      void Close();
+
+      const MeshFileHeader& Header() const { return *_pHeader; }
+      MeshView View() const;
+      size_t FileSize() const { return _file.Size(); }
+
+   private:
+      common::MappedFile _file;
+      const MeshFileHeader* _pHeader = nullptr;
+   };
+
+   void WriteMeshFile(const std::string& path, const PackedMesh& mesh);
+}
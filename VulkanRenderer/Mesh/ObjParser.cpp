@@ -0,0 +1,117 @@
+#include "ObjParser.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+#include "../Profiling/Trace.h"
+
+using namespace std;
+
+namespace mesh {
+
+   namespace {
+      // OBJ indices count from 1, and negative ones count back from the
+      // most recent vertex
+      uint32_t ResolveIndex(long index, size_t vertexCount, const string& path, size_t lineNumber)
+      {
+         long resolved = index > 0 ? index - 1 : (long)vertexCount + index;
+
+         if (index == 0 || resolved < 0 || (size_t)resolved >= vertexCount)
+         {
+            throw runtime_error("Failed to parse " + path + ", face on line " + to_string(lineNumber) + " refers to a missing vertex");
+         }
+
+         return (uint32_t)resolved;
+      }
+   }
+
+   MeshData ParseObj(const string& path)
+   {
+      TRACE_FUNCTION();
+
+      ifstream file(path);
+
+      if (!file.is_open())
+      {
+         throw runtime_error("Failed to open " + path);
+      }
+
+      MeshData mesh;
+      vector<uint32_t> face;
+      string line;
+      size_t lineNumber = 0;
+
+      while (getline(file, line))
+      {
+         lineNumber++;
+
+         const char* p = line.c_str();
+
+         if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+         {
+            Vertex vertex = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } };
+            char* pEnd = const_cast<char*>(p + 1);
+
+            for (int i = 0; i < 3; i++)
+            {
+               vertex.position[i] = strtof(pEnd, &pEnd);
+            }
+
+            // Colours, if this file has them
+            for (int i = 0; i < 3; i++)
+            {
+               const char* pStart = pEnd;
+               float value = strtof(pStart, &pEnd);
+
+               if (pEnd == pStart)
+               {
+                  break;
+               }
+
+               vertex.colour[i] = value;
+            }
+
+            mesh.vertices.push_back(vertex);
+         }
+         else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+         {
+            face.clear();
+            char* pEnd = const_cast<char*>(p + 1);
+
+            while (true)
+            {
+               const char* pStart = pEnd;
+               long index = strtol(pStart, &pEnd, 10);
+
+               if (pEnd == pStart)
+               {
+                  break;
+               }
+
+               face.push_back(ResolveIndex(index, mesh.vertices.size(), path, lineNumber));
+
+               // Skip the texture coordinate and normal indices
+               while (*pEnd != '\0' && *pEnd != ' ' && *pEnd != '\t')
+               {
+                  pEnd++;
+               }
+            }
+
+            for (size_t i = 2; i < face.size(); i++)
+            {
+               mesh.indices.push_back(face[0]);
+               mesh.indices.push_back(face[i - 1]);
+               mesh.indices.push_back(face[i]);
+            }
+         }
+      }
+
+      if (mesh.vertices.empty() || mesh.indices.empty())
+      {
+         throw runtime_error("Failed to parse " + path + ", it has no triangles");
+      }
+
+      return mesh;
+   }
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+
+#include "Mesh.h"
+
+namespace mesh {
+
+   // Reads positions, the common "v x y z r g b" vertex colour extension,
+   // and faces, fanning polygons into triangles. Texture coordinates,
+   // normals, groups and materials are skipped. Vertices with no colour
+   // are white.
+   //
+   // Text parsing is far too slow for load time, so this belongs in the
+   // converter, not the renderer.
+   MeshData ParseObj(const std::string& path);
+}
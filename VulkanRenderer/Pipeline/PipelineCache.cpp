@@ -0,0 +1,210 @@
+#include "PipelineCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "../Profiling/Trace.h"
+
+using namespace std;
+
+namespace pipeline {
+
+   namespace {
+      // Our own file header, written in front of the driver's blob
+      struct CacheFileHeader
+      {
+         uint32_t magic;
+         uint32_t version;
+         uint64_t dataSize;
+         uint64_t dataHash;
+      };
+
+      const uint32_t cacheFileMagic = 0x43505256; // "VRPC"
+      const uint32_t cacheFileVersion = 1;
+
+      // Layout of VkPipelineCacheHeaderVersionOne, which every driver blob starts with
+      struct DriverCacheHeader
+      {
+         uint32_t headerSize;
+         uint32_t headerVersion;
+         uint32_t vendorID;
+         uint32_t deviceID;
+         uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+      };
+
+      uint64_t HashBytes(const char* data, size_t size)
+      {
+         // FNV-1a
+         uint64_t hash = 14695981039346656037ull;
+
+         for (size_t i = 0; i < size; i++)
+         {
+            hash ^= static_cast<uint8_t>(data[i]);
+            hash *= 1099511628211ull;
+         }
+
+         return hash;
+      }
+   }
+
+   void PipelineCache::Load(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, const VkPhysicalDevice& physicalDevice, const string& path)
+   {
+      TRACE_FUNCTION();
+
+      _device = device;
+      _pAllocationCallbacks = pAllocationCallbacks;
+      _path = path;
+      vkGetPhysicalDeviceProperties(physicalDevice, &_deviceProperties);
+
+      vector<char> data = ReadCacheFile();
+      _isWarm = !data.empty() && IsCompatible(data);
+
+      VkPipelineCacheCreateInfo createInfo = {};
+      createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+      createInfo.initialDataSize = _isWarm ? data.size() : 0;
+      createInfo.pInitialData = _isWarm ? data.data() : nullptr;
+
+      if (vkCreatePipelineCache(_device, &createInfo, _pAllocationCallbacks, &_pipelineCache) != VK_SUCCESS)
+      {
+         // The header checks passed but the driver still refused the data,
+         // fall back to an empty cache rather than failing startup
+         _isWarm = false;
+         createInfo.initialDataSize = 0;
+         createInfo.pInitialData = nullptr;
+
+         if (vkCreatePipelineCache(_device, &createInfo, _pAllocationCallbacks, &_pipelineCache) != VK_SUCCESS)
+         {
+            throw runtime_error("Failed to create pipeline cache");
+         }
+      }
+   }
+
+   void PipelineCache::Save()
+   {
+      TRACE_FUNCTION();
+
+      if (_pipelineCache == VK_NULL_HANDLE)
+      {
+         return;
+      }
+
+      size_t dataSize = 0;
+      if (vkGetPipelineCacheData(_device, _pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+      {
+         return;
+      }
+
+      vector<char> data(dataSize);
+      if (vkGetPipelineCacheData(_device, _pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+      {
+         return;
+      }
+
+      CacheFileHeader header = {};
+      header.magic = cacheFileMagic;
+      header.version = cacheFileVersion;
+      header.dataSize = dataSize;
+      header.dataHash = HashBytes(data.data(), dataSize);
+
+      // Write to a temporary file and swap it in, so a crash mid-write
+      // never leaves a half written cache behind
+      filesystem::path path(_path);
+      filesystem::path tempPath = path;
+      tempPath += ".tmp";
+
+      error_code error;
+      if (path.has_parent_path())
+      {
+         filesystem::create_directories(path.parent_path(), error);
+      }
+
+      {
+         ofstream file(tempPath, ios::binary | ios::trunc);
+
+         if (!file.is_open())
+         {
+            cerr << "Failed to write pipeline cache to " << _path << endl;
+            return;
+         }
+
+         file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+         file.write(data.data(), dataSize);
+      }
+
+      filesystem::rename(tempPath, path, error);
+      if (error)
+      {
+         cerr << "Failed to write pipeline cache to " << _path << ": " << error.message() << endl;
+      }
+   }
+
+   void PipelineCache::Destroy()
+   {
+      if (_pipelineCache != VK_NULL_HANDLE)
+      {
+         vkDestroyPipelineCache(_device, _pipelineCache, _pAllocationCallbacks);
+         _pipelineCache = VK_NULL_HANDLE;
+      }
+   }
+
+   vector<char> PipelineCache::ReadCacheFile()
+   {
+      ifstream file(_path, ios::ate | ios::binary);
+
+      if (!file.is_open())
+      {
+         return {};
+      }
+
+      size_t fileSize = (size_t)file.tellg();
+
+      if (fileSize < sizeof(CacheFileHeader))
+      {
+         return {};
+      }
+
+      CacheFileHeader header = {};
+      file.seekg(0);
+      file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+      if (header.magic != cacheFileMagic ||
+         header.version != cacheFileVersion ||
+         header.dataSize != fileSize - sizeof(CacheFileHeader))
+      {
+         return {};
+      }
+
+      vector<char> data((size_t)header.dataSize);
+      file.read(data.data(), data.size());
+
+      if (!file || HashBytes(data.data(), data.size()) != header.dataHash)
+      {
+         return {};
+      }
+
+      return data;
+   }
+
+   bool PipelineCache::IsCompatible(const vector<char>& data)
+   {
+      if (data.size() < sizeof(DriverCacheHeader))
+      {
+         return false;
+      }
+
+      DriverCacheHeader header;
+      memcpy(&header, data.data(), sizeof(header));
+
+      // A blob from another driver version or GPU is stale, the driver
+      // would ignore it at best so drop it here
+      return header.headerSize >= sizeof(DriverCacheHeader) &&
+         header.headerSize <= data.size() &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == _deviceProperties.vendorID &&
+         header.deviceID == _deviceProperties.deviceID &&
+         memcmp(header.pipelineCacheUUID, _deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+   }
+}
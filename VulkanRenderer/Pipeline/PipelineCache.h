@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "../Common/Common.h"
+
+namespace pipeline {
+
+   // Wraps a VkPipelineCache that is persisted to disk between runs. The blob
+   // is stored behind a small header so truncated or corrupt files can be
+   // rejected before the driver ever sees them, and the driver's own cache
+   // header is checked against the current device before it is reused.
+   class PipelineCache {
+   public:
+      void Load(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, const VkPhysicalDevice& physicalDevice, const std::string& path);
+      void Save();
+      void Destroy();
+
+      VkPipelineCache Get() { return _pipelineCache; };
+      bool IsWarm() { return _isWarm; };
+
+   private:
+      std::vector<char> ReadCacheFile();
+      bool IsCompatible(const std::vector<char>& data);
+
+      VkDevice _device = VK_NULL_HANDLE;
+      const VkAllocationCallbacks* _pAllocationCallbacks = nullptr;
+      VkPhysicalDeviceProperties _deviceProperties = {};
+      VkPipelineCache _pipelineCache = VK_NULL_HANDLE;
+      std::string _path;
+      bool _isWarm = false;
+   };
+}
@@ -0,0 +1,463 @@
+#include "PipelineManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "../Profiling/Trace.h"
+
+using namespace std;
+
+namespace pipeline {
+
+   namespace {
+      // 64 bit FNV-1a, fed a field at a time
+      class Hasher {
+      public:
+         template <typename T>
+         void Add(const T& value)
+         {
+            const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(&value);
+
+            for (size_t i = 0; i < sizeof(T); i++)
+            {
+               _hash ^= pBytes[i];
+               _hash *= 0x100000001b3ull;
+            }
+         }
+
+         template <typename T>
+         void AddArray(const vector<T>& values)
+         {
+            Add(values.size());
+
+            for (const auto& value : values)
+            {
+               Add(value);
+            }
+         }
+
+         uint64_t Get() const { return _hash; }
+
+      private:
+         uint64_t _hash = 0xcbf29ce484222325ull;
+      };
+
+      // The Vulkan description structs are plain 32 bit fields with no padding
+      template <typename T>
+      bool ArraysEqual(const vector<T>& a, const vector<T>& b)
+      {
+         return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+      }
+
+      // Feature bit i becomes the bool specialisation constant with constant_id i
+      struct Specialisation
+      {
+         VkSpecializationMapEntry entries[shader::MaxVariantFeatures];
+         VkBool32 values[shader::MaxVariantFeatures];
+         VkSpecializationInfo info;
+
+         Specialisation(shader::VariantKey key, uint32_t featureCount)
+         {
+            for (uint32_t i = 0; i < featureCount; i++)
+            {
+               entries[i] = { i, i * (uint32_t)sizeof(VkBool32), sizeof(VkBool32) };
+               values[i] = (key & (1u << i)) != 0 ? VK_TRUE : VK_FALSE;
+            }
+
+            info.mapEntryCount = featureCount;
+            info.pMapEntries = entries;
+            info.dataSize = featureCount * sizeof(VkBool32);
+            info.pData = values;
+         }
+
+         const VkSpecializationInfo* Get() const { return info.mapEntryCount > 0 ? &info : nullptr; }
+      };
+   }
+
+   uint64_t GraphicsPipelineDesc::Hash() const
+   {
+      Hasher hasher;
+      hasher.Add(vertexShader);
+      hasher.Add(fragmentShader);
+      hasher.Add(variantKey);
+      hasher.Add(variantFeatureCount);
+      hasher.AddArray(vertexBindings);
+      hasher.AddArray(vertexAttributes);
+      hasher.Add(topology);
+      hasher.Add(polygonMode);
+      hasher.Add(cullMode);
+      hasher.Add(frontFace);
+      hasher.Add(depthTest);
+      hasher.Add(depthWrite);
+      hasher.Add(depthCompare);
+      hasher.Add(blend);
+      hasher.Add(layout);
+      hasher.Add(renderPass);
+      hasher.Add(subpass);
+
+      return hasher.Get();
+   }
+
+   bool GraphicsPipelineDesc::operator==(const GraphicsPipelineDesc& other) const
+   {
+      return vertexShader == other.vertexShader && fragmentShader == other.fragmentShader &&
+         variantKey == other.variantKey && variantFeatureCount == other.variantFeatureCount &&
+         ArraysEqual(vertexBindings, other.vertexBindings) && ArraysEqual(vertexAttributes, other.vertexAttributes) &&
+         topology == other.topology && polygonMode == other.polygonMode && cullMode == other.cullMode &&
+         frontFace == other.frontFace && depthTest == other.depthTest && depthWrite == other.depthWrite &&
+         depthCompare == other.depthCompare && blend == other.blend && layout == other.layout &&
+         renderPass == other.renderPass && subpass == other.subpass;
+   }
+
+   uint64_t ComputePipelineDesc::Hash() const
+   {
+      Hasher hasher;
+      hasher.Add(shader);
+      hasher.Add(variantKey);
+      hasher.Add(variantFeatureCount);
+      hasher.Add(layout);
+
+      return hasher.Get();
+   }
+
+   bool ComputePipelineDesc::operator==(const ComputePipelineDesc& other) const
+   {
+      return shader == other.shader && variantKey == other.variantKey &&
+         variantFeatureCount == other.variantFeatureCount && layout == other.layout;
+   }
+
+   void PipelineManager::Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, VkPipelineCache pipelineCache, uint32_t threadCount)
+   {
+      _device = device;
+      _pAllocationCallbacks = pAllocationCallbacks;
+      _pipelineCache = pipelineCache;
+      _stopping = false;
+
+      if (threadCount == 0)
+      {
+         threadCount = max(thread::hardware_concurrency() / 2, 1u);
+      }
+
+      for (uint32_t i = 0; i < threadCount; i++)
+      {
+         _threads.emplace_back(&PipelineManager::WorkerMain, this);
+      }
+   }
+
+   void PipelineManager::Destroy()
+   {
+      {
+         lock_guard<mutex> lock(_mutex);
+         _stopping = true;
+      }
+
+      _wake.notify_all();
+
+      for (auto& thread : _threads)
+      {
+         thread.join();
+      }
+
+      _threads.clear();
+
+      for (auto& entry : _entries)
+      {
+         if (entry->pipeline != VK_NULL_HANDLE)
+         {
+            vkDestroyPipeline(_device, entry->pipeline, _pAllocationCallbacks);
+         }
+      }
+
+      _entries.clear();
+      _entriesByHash.clear();
+      _queue.clear();
+   }
+
+   PipelineHandle PipelineManager::Request(const GraphicsPipelineDesc& desc, PipelineHandle fallback)
+   {
+      return FindOrAdd(desc, fallback);
+   }
+
+   PipelineHandle PipelineManager::Request(const ComputePipelineDesc& desc, PipelineHandle fallback)
+   {
+      return FindOrAdd(desc, fallback);
+   }
+
+   template <typename Desc>
+   PipelineHandle PipelineManager::FindOrAdd(const Desc& desc, PipelineHandle fallback)
+   {
+      uint64_t hash = desc.Hash();
+
+      lock_guard<mutex> lock(_mutex);
+      _requestCount++;
+
+      // Equal hashes are compared in full, so a collision costs a compile rather than the wrong pipeline
+      auto range = _entriesByHash.equal_range(hash);
+
+      for (auto it = range.first; it != range.second; ++it)
+      {
+         if (Matches(*_entries[it->second], desc))
+         {
+            _deduplicatedCount++;
+            return it->second;
+         }
+      }
+
+      PipelineHandle handle = (PipelineHandle)_entries.size();
+
+      auto entry = make_unique<Entry>();
+      entry->hash = hash;
+      entry->fallback = fallback;
+      entry->future = entry->promise.get_future().share();
+      SetDesc(*entry, desc);
+
+      _entries.push_back(move(entry));
+      _entriesByHash.emplace(hash, handle);
+      _queue.push_back(handle);
+
+      _wake.notify_one();
+
+      return handle;
+   }
+
+   VkPipeline PipelineManager::Get(PipelineHandle handle)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      // A fallback can itself still be compiling, so follow the chain to
+      // the newest pipeline that is ready
+      while (handle != InvalidPipeline)
+      {
+         const Entry& entry = *_entries[handle];
+
+         if (entry.pipeline != VK_NULL_HANDLE)
+         {
+            return entry.pipeline;
+         }
+
+         handle = entry.fallback;
+      }
+
+      return VK_NULL_HANDLE;
+   }
+
+   bool PipelineManager::IsReady(PipelineHandle handle)
+   {
+      lock_guard<mutex> lock(_mutex);
+      return _entries[handle]->pipeline != VK_NULL_HANDLE;
+   }
+
+   shared_future<VkPipeline> PipelineManager::GetFuture(PipelineHandle handle)
+   {
+      lock_guard<mutex> lock(_mutex);
+      return _entries[handle]->future;
+   }
+
+   double PipelineManager::CompileMs(PipelineHandle handle)
+   {
+      lock_guard<mutex> lock(_mutex);
+      return _entries[handle]->compileMs;
+   }
+
+   uint32_t PipelineManager::RequestCount()
+   {
+      lock_guard<mutex> lock(_mutex);
+      return _requestCount;
+   }
+
+   uint32_t PipelineManager::DeduplicatedCount()
+   {
+      lock_guard<mutex> lock(_mutex);
+      return _deduplicatedCount;
+   }
+
+   uint32_t PipelineManager::PipelineCount()
+   {
+      lock_guard<mutex> lock(_mutex);
+      return (uint32_t)_entries.size();
+   }
+
+   void PipelineManager::WorkerMain()
+   {
+      TRACE_THREAD_NAME("PipelineCompiler");
+
+      while (true)
+      {
+         Entry* pEntry;
+
+         {
+            unique_lock<mutex> lock(_mutex);
+            _wake.wait(lock, [this] { return _stopping || !_queue.empty(); });
+
+            // Whatever is queued still gets compiled, so no future is left unresolved
+            if (_queue.empty())
+            {
+               return;
+            }
+
+            pEntry = _entries[_queue.front()].get();
+            _queue.pop_front();
+         }
+
+         auto startTime = chrono::high_resolution_clock::now();
+         VkPipeline pipeline = Compile(*pEntry);
+         chrono::duration<double, milli> elapsed = chrono::high_resolution_clock::now() - startTime;
+
+         {
+            lock_guard<mutex> lock(_mutex);
+            pEntry->pipeline = pipeline;
+            pEntry->compileMs = elapsed.count();
+         }
+
+         pEntry->promise.set_value(pipeline);
+      }
+   }
+
+   VkPipeline PipelineManager::Compile(const Entry& entry)
+   {
+      TRACE_FUNCTION();
+
+      // The description is never written once queued, so it is read here without the lock
+      VkPipeline pipeline = entry.compute ? CompileCompute(entry.computeDesc) : CompileGraphics(entry.graphics);
+
+      if (pipeline == VK_NULL_HANDLE)
+      {
+         cerr << "Failed to compile pipeline " << hex << entry.hash << dec << endl;
+      }
+
+      return pipeline;
+   }
+
+   VkPipeline PipelineManager::CompileGraphics(const GraphicsPipelineDesc& desc)
+   {
+      Specialisation specialisation(desc.variantKey, desc.variantFeatureCount);
+
+      VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+      shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+      shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+      shaderStages[0].module = desc.vertexShader;
+      shaderStages[0].pName = "main";
+      shaderStages[0].pSpecializationInfo = specialisation.Get();
+      shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+      shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+      shaderStages[1].module = desc.fragmentShader;
+      shaderStages[1].pName = "main";
+      shaderStages[1].pSpecializationInfo = specialisation.Get();
+
+      VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+      vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+      vertexInputInfo.vertexBindingDescriptionCount = (uint32_t)desc.vertexBindings.size();
+      vertexInputInfo.pVertexBindingDescriptions = desc.vertexBindings.data();
+      vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)desc.vertexAttributes.size();
+      vertexInputInfo.pVertexAttributeDescriptions = desc.vertexAttributes.data();
+
+      VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+      inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+      inputAssembly.topology = desc.topology;
+      inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+      // Viewport and scissor are dynamic so the pipeline does not depend
+      // on the swap chain extent
+      VkPipelineViewportStateCreateInfo viewportState = {};
+      viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+      viewportState.viewportCount = 1;
+      viewportState.scissorCount = 1;
+
+      VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+      VkPipelineDynamicStateCreateInfo dynamicState = {};
+      dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+      dynamicState.dynamicStateCount = 2;
+      dynamicState.pDynamicStates = dynamicStates;
+
+      VkPipelineRasterizationStateCreateInfo rasterizer = {};
+      rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+      rasterizer.depthClampEnable = VK_FALSE;
+      rasterizer.rasterizerDiscardEnable = VK_FALSE;
+      rasterizer.polygonMode = desc.polygonMode;
+      rasterizer.lineWidth = 1.0f;
+      rasterizer.cullMode = desc.cullMode;
+      rasterizer.frontFace = desc.frontFace;
+      rasterizer.depthBiasEnable = VK_FALSE;
+
+      VkPipelineMultisampleStateCreateInfo multisampling = {};
+      multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+      multisampling.sampleShadingEnable = VK_FALSE;
+      multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+      VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+      depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+      depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+      depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+      depthStencil.depthCompareOp = desc.depthCompare;
+
+      // Premultiplied alpha when blending
+      VkPipelineColorBlendAttachmentState colourBlendAttachment = {};
+      colourBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+      colourBlendAttachment.blendEnable = desc.blend ? VK_TRUE : VK_FALSE;
+      colourBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+      colourBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+      colourBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+      colourBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+      colourBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+      colourBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+      VkPipelineColorBlendStateCreateInfo colourBlending = {};
+      colourBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+      colourBlending.logicOpEnable = VK_FALSE;
+      colourBlending.attachmentCount = 1;
+      colourBlending.pAttachments = &colourBlendAttachment;
+
+      VkGraphicsPipelineCreateInfo pipelineInfo = {};
+      pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+      pipelineInfo.stageCount = 2;
+      pipelineInfo.pStages = shaderStages;
+      pipelineInfo.pVertexInputState = &vertexInputInfo;
+      pipelineInfo.pInputAssemblyState = &inputAssembly;
+      pipelineInfo.pViewportState = &viewportState;
+      pipelineInfo.pRasterizationState = &rasterizer;
+      pipelineInfo.pMultisampleState = &multisampling;
+      pipelineInfo.pDepthStencilState = &depthStencil;
+      pipelineInfo.pColorBlendState = &colourBlending;
+      pipelineInfo.pDynamicState = &dynamicState;
+      pipelineInfo.layout = desc.layout;
+      pipelineInfo.renderPass = desc.renderPass;
+      pipelineInfo.subpass = desc.subpass;
+      pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+      // The pipeline cache synchronises internally, so every worker shares it
+      VkPipeline pipeline = VK_NULL_HANDLE;
+
+      if (vkCreateGraphicsPipelines(_device, _pipelineCache, 1, &pipelineInfo, _pAllocationCallbacks, &pipeline) != VK_SUCCESS)
+      {
+         return VK_NULL_HANDLE;
+      }
+
+      return pipeline;
+   }
+
+   VkPipeline PipelineManager::CompileCompute(const ComputePipelineDesc& desc)
+   {
+      Specialisation specialisation(desc.variantKey, desc.variantFeatureCount);
+
+      VkComputePipelineCreateInfo pipelineInfo = {};
+      pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+      pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+      pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+      pipelineInfo.stage.module = desc.shader;
+      pipelineInfo.stage.pName = "main";
+      pipelineInfo.stage.pSpecializationInfo = specialisation.Get();
+      pipelineInfo.layout = desc.layout;
+
+      VkPipeline pipeline = VK_NULL_HANDLE;
+
+      if (vkCreateComputePipelines(_device, _pipelineCache, 1, &pipelineInfo, _pAllocationCallbacks, &pipeline) != VK_SUCCESS)
+      {
+         return VK_NULL_HANDLE;
+      }
+
+      return pipeline;
+   }
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../Common/Common.h"
+#include "../Shader/ShaderVariants.h"
+
+namespace pipeline {
+
+   typedef uint32_t PipelineHandle;
+   static const PipelineHandle InvalidPipeline = UINT32_MAX;
+
+   // Everything a graphics pipeline is built from. Viewport and scissor
+   // are always dynamic, and there is one colour attachment with no
+   // multisampling. Shader modules stand in for their code, which works
+   // because the shader cache gives identical code one module.
+   struct GraphicsPipelineDesc
+   {
+      VkShaderModule vertexShader = VK_NULL_HANDLE;
+      VkShaderModule fragmentShader = VK_NULL_HANDLE;
+
+      // Specialises both stages, so the key's features must be the same
+      // constant ids in each
+      shader::VariantKey variantKey = 0;
+      uint32_t variantFeatureCount = 0;
+
+      std::vector<VkVertexInputBindingDescription> vertexBindings;
+      std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+      VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+      VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+      VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+      VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+      bool depthTest = false;
+      bool depthWrite = false;
+      VkCompareOp depthCompare = VK_COMPARE_OP_LESS;
+      bool blend = false;
+
+      VkPipelineLayout layout = VK_NULL_HANDLE;
+      VkRenderPass renderPass = VK_NULL_HANDLE;
+      uint32_t subpass = 0;
+
+      uint64_t Hash() const;
+      bool operator==(const GraphicsPipelineDesc& other) const;
+   };
+
+   struct ComputePipelineDesc
+   {
+      VkShaderModule shader = VK_NULL_HANDLE;
+      shader::VariantKey variantKey = 0;
+      uint32_t variantFeatureCount = 0;
+      VkPipelineLayout layout = VK_NULL_HANDLE;
+
+      uint64_t Hash() const;
+      bool operator==(const ComputePipelineDesc& other) const;
+   };
+
+   // Builds pipelines on background threads so a pipeline nobody has
+   // asked for before never holds up a frame. Requests are keyed by a hash
+   // of the whole description, and one that matches an earlier request
+   // gets the same handle back instead of a second compile.
+   //
+   // A frame asks for its pipeline with Get, which never blocks. Until the
+   // compile finishes Get returns the request's fallback pipeline, or
+   // VK_NULL_HANDLE if it has none, in which case the draw is skipped.
+   //
+   // Every pipeline lives until Destroy. All methods are thread safe.
+   class PipelineManager {
+   public:
+      // 0 threads uses half the hardware threads, leaving the rest to rendering
+      void Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, VkPipelineCache pipelineCache, uint32_t threadCount = 0);
+
+      // Waits for compiles in flight, then destroys every pipeline
+      void Destroy();
+
+      PipelineHandle Request(const GraphicsPipelineDesc& desc, PipelineHandle fallback = InvalidPipeline);
+      PipelineHandle Request(const ComputePipelineDesc& desc, PipelineHandle fallback = InvalidPipeline);
+
+      VkPipeline Get(PipelineHandle handle);
+      bool IsReady(PipelineHandle handle);
+
+      // Resolves to the pipeline once compiled, or VK_NULL_HANDLE if it failed
+      std::shared_future<VkPipeline> GetFuture(PipelineHandle handle);
+      VkPipeline Wait(PipelineHandle handle) { return GetFuture(handle).get(); };
+
+      // Time the pipeline took to compile on its worker
+      double CompileMs(PipelineHandle handle);
+
+      uint32_t RequestCount();
+      uint32_t DeduplicatedCount();
+      uint32_t PipelineCount();
+
+   private:
+      struct Entry
+      {
+         uint64_t hash = 0;
+         bool compute = false;
+         GraphicsPipelineDesc graphics;
+         ComputePipelineDesc computeDesc;
+         PipelineHandle fallback = InvalidPipeline;
+
+         VkPipeline pipeline = VK_NULL_HANDLE;
+         double compileMs = 0.0;
+         std::promise<VkPipeline> promise;
+         std::shared_future<VkPipeline> future;
+      };
+
+      template <typename Desc>
+      PipelineHandle FindOrAdd(const Desc& desc, PipelineHandle fallback);
+      bool Matches(const Entry& entry, const GraphicsPipelineDesc& desc) const { return !entry.compute && entry.graphics == desc; };
+      bool Matches(const Entry& entry, const ComputePipelineDesc& desc) const { return entry.compute && entry.computeDesc == desc; };
+      void SetDesc(Entry& entry, const GraphicsPipelineDesc& desc) { entry.graphics = desc; };
+      void SetDesc(Entry& entry, const ComputePipelineDesc& desc) { entry.compute = true; entry.computeDesc = desc; };
+
+      void WorkerMain();
+      VkPipeline Compile(const Entry& entry);
+      VkPipeline CompileGraphics(const GraphicsPipelineDesc& desc);
+      VkPipeline CompileCompute(const ComputePipelineDesc& desc);
+
+      VkDevice _device = VK_NULL_HANDLE;
+      const VkAllocationCallbacks* _pAllocationCallbacks = nullptr;
+      VkPipelineCache _pipelineCache = VK_NULL_HANDLE;
+
+      // Entries never move once added, so workers can hold on to them
+      std::vector<std::unique_ptr<Entry>> _entries;
+      std::unordered_multimap<uint64_t, PipelineHandle> _entriesByHash;
+      std::deque<PipelineHandle> _queue;
+      uint32_t _requestCount = 0;
+      uint32_t _deduplicatedCount = 0;
+
+      std::vector<std::thread> _threads;
+      std::mutex _mutex;
+      std::condition_variable _wake;
+      bool _stopping = false;
+   };
+}
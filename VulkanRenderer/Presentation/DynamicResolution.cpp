@@ -0,0 +1,130 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+namespace presentation {
+
+   namespace {
+      // Weight of each new reading, enough to ride out a single slow frame
+      const double Smoothing = 0.25;
+
+      // Scales to this fraction of the budget, so small swings in GPU time
+      // do not tip it straight back over
+      const double TargetFraction = 0.9;
+
+      // Only climbs back up once well under the budget, so it does not
+      // hunt around the edge of it
+      const double RaiseFraction = 0.75;
+
+      // Drops as far as it needs to at once, but climbs back a little at a
+      // time, as an overshoot upwards costs a dropped frame
+      const float MaxRaise = 0.05f;
+
+      // Changes smaller than this are not worth a visible jump in sharpness
+      const float MinChange = 0.02f;
+   }
+
+   bool DynamicResolution::QuerySupport(const VkPhysicalDevice& physicalDevice, VkFormat format)
+   {
+      VkFormatProperties properties;
+      vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+
+      VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+         VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+      return (properties.optimalTilingFeatures & required) == required;
+   }
+
+   void DynamicResolution::Initialise(double gpuBudgetMs, float minScale, uint32_t framesInFlight)
+   {
+      _budgetMs = gpuBudgetMs;
+      _minScale = min(max(minScale, 0.1f), 1.0f);
+      _framesInFlight = max(framesInFlight, 1u);
+
+      _scale = 1.0f;
+      _smoothedMs = 0.0;
+      _lastResolvedFrame = 0;
+      _settleFrames = 0;
+
+      _scaleTotal = 0.0;
+      _frameCount = 0;
+      _lowestScale = 1.0f;
+      _changeCount = 0;
+   }
+
+   void DynamicResolution::Update(const profiling::GpuProfiler& profiler)
+   {
+      _scaleTotal += _scale;
+      _frameCount++;
+
+      // Nothing new read back this frame
+      if (profiler.ResolvedFrames() == _lastResolvedFrame)
+      {
+         return;
+      }
+
+      _lastResolvedFrame = profiler.ResolvedFrames();
+
+      // Rendered before the last change took effect
+      if (_settleFrames > 0)
+      {
+         _settleFrames--;
+         return;
+      }
+
+      double frameMs = profiler.LastFrameMs();
+      _smoothedMs = _smoothedMs > 0.0 ? _smoothedMs + Smoothing * (frameMs - _smoothedMs) : frameMs;
+
+      if (_smoothedMs <= 0.0 || (_smoothedMs <= _budgetMs && _smoothedMs >= _budgetMs * RaiseFraction))
+      {
+         return;
+      }
+
+      // GPU time follows the pixel count, which goes with the square of
+      // the scale
+      float target = _scale * (float)sqrt(_budgetMs * TargetFraction / _smoothedMs);
+      target = min(target, _scale + MaxRaise);
+      target = min(max(target, _minScale), 1.0f);
+
+      // Small steps are let through only when they reach a limit
+      bool atLimit = target == _minScale || target == 1.0f;
+
+      if (target == _scale || (fabs(target - _scale) < MinChange && !atLimit))
+      {
+         return;
+      }
+
+      _scale = target;
+      _lowestScale = min(_lowestScale, _scale);
+      _changeCount++;
+
+      // Readings from here on are of frames at the old scale until every
+      // frame in flight has been recorded again, and the smoothing starts
+      // over from the first reading at the new scale
+      _settleFrames = _framesInFlight;
+      _smoothedMs = 0.0;
+   }
+
+   VkExtent2D DynamicResolution::RenderExtent(VkExtent2D maxExtent) const
+   {
+      VkExtent2D extent;
+      extent.width = max((uint32_t)(maxExtent.width * _scale + 0.5f), 1u);
+      extent.height = max((uint32_t)(maxExtent.height * _scale + 0.5f), 1u);
+
+      extent.width = min(extent.width, maxExtent.width);
+      extent.height = min(extent.height, maxExtent.height);
+      return extent;
+   }
+
+   void DynamicResolution::PrintReport(ostream& stream)
+   {
+      char line[256];
+      snprintf(line, sizeof(line), "Dynamic resolution: %.2f ms GPU budget, mean scale %.2f, lowest %.2f, %u changes",
+         _budgetMs, _frameCount > 0 ? _scaleTotal / _frameCount : _scale, _lowestScale, _changeCount);
+      stream << line << endl;
+   }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+
+#include "../Common/Common.h"
+#include "../Profiling/GpuProfiler.h"
+
+namespace presentation {
+
+   // Scales the resolution the scene is rendered at to keep GPU frame time
+   // under a budget. The scene renders into the top left of attachments
+   // sized for the full swap chain extent, and is then blitted up to fill
+   // the swap chain image. Changing the scale only moves the viewport, so
+   // it never allocates.
+   //
+   // GPU time is read back framesInFlight frames late. After every change,
+   // the readings of frames still rendered at the old scale are skipped, so
+   // the controller never reacts twice to the same overrun.
+   class DynamicResolution {
+   public:
+      // Whether the scene can be blitted with a linear filter between
+      // images of this format
+      static bool QuerySupport(const VkPhysicalDevice& physicalDevice, VkFormat format);
+
+      void Initialise(double gpuBudgetMs, float minScale, uint32_t framesInFlight);
+
+      // Once per frame, after the profiler has read back whatever it can
+      void Update(const profiling::GpuProfiler& profiler);
+
+      float Scale() const { return _scale; };
+
+      // The part of maxExtent the scene renders to at the current scale
+      VkExtent2D RenderExtent(VkExtent2D maxExtent) const;
+
+      void PrintReport(std::ostream& stream);
+
+   private:
+      double _budgetMs = 0.0;
+      float _minScale = 1.0f;
+      uint32_t _framesInFlight = 1;
+
+      float _scale = 1.0f;
+      double _smoothedMs = 0.0;
+      uint32_t _lastResolvedFrame = 0;
+      uint32_t _settleFrames = 0;
+
+      // For the report
+      double _scaleTotal = 0.0;
+      uint32_t _frameCount = 0;
+      float _lowestScale = 1.0f;
+      uint32_t _changeCount = 0;
+   };
+}
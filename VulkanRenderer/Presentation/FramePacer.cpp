@@ -0,0 +1,422 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "../Profiling/Trace.h"
+
+using namespace std;
+
+namespace presentation {
+
+   namespace {
+      // Sleeping wakes up late by as much as the scheduler's tick, so the
+      // last stretch before a frame is due is spent yielding instead
+      const uint64_t SpinNs = 2000000;
+   }
+
+   bool ParseLatencyMode(const string& name, LatencyMode& mode)
+   {
+      if (name == "throughput")
+      {
+         mode = LatencyMode::Throughput;
+      }
+      else if (name == "vsync")
+      {
+         mode = LatencyMode::Vsync;
+      }
+      else if (name == "low-latency")
+      {
+         mode = LatencyMode::LowLatency;
+      }
+      else
+      {
+         return false;
+      }
+
+      return true;
+   }
+
+   const char* LatencyModeName(LatencyMode mode)
+   {
+      switch (mode)
+      {
+      case LatencyMode::Throughput: return "throughput";
+      case LatencyMode::Vsync: return "vsync";
+      case LatencyMode::LowLatency: return "low-latency";
+      default: return "unknown";
+      }
+   }
+
+   bool ParsePresentMode(const string& name, VkPresentModeKHR& presentMode)
+   {
+      if (name == "immediate")
+      {
+         presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+      }
+      else if (name == "mailbox")
+      {
+         presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+      }
+      else if (name == "fifo")
+      {
+         presentMode = VK_PRESENT_MODE_FIFO_KHR;
+      }
+      else if (name == "fifo-relaxed")
+      {
+         presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+      }
+      else
+      {
+         return false;
+      }
+
+      return true;
+   }
+
+   const char* PresentModeName(VkPresentModeKHR presentMode)
+   {
+      switch (presentMode)
+      {
+      case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+      case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+      case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+      case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo-relaxed";
+      default: return "unknown";
+      }
+   }
+
+   bool FramePacer::QueryDisplayTimingSupport(const VkPhysicalDevice& physicalDevice, vector<const char*>& enabledExtensions)
+   {
+      uint32_t extensionCount = 0;
+      vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+      vector<VkExtensionProperties> extensions(extensionCount);
+      vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+      bool supported = any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties& extension)
+      {
+         return strcmp(extension.extensionName, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME) == 0;
+      });
+
+      if (supported)
+      {
+         enabledExtensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+      }
+
+      return supported;
+   }
+
+   void FramePacer::Initialise(const VkDevice& device, LatencyMode mode, uint32_t framesInFlight, double targetFrameMs, bool displayTiming)
+   {
+      _device = device;
+      _mode = mode;
+      _framesInFlight = max(framesInFlight, 1u);
+      _targetNs = targetFrameMs > 0.0 ? (uint64_t)(targetFrameMs * 1000000.0) : 0;
+
+      if (displayTiming)
+      {
+         _vkGetPastPresentationTiming = (PFN_vkGetPastPresentationTimingGOOGLE)vkGetDeviceProcAddr(device, "vkGetPastPresentationTimingGOOGLE");
+      }
+
+      _displayTiming = _vkGetPastPresentationTiming != nullptr;
+      _displayToSteadyNs = 0;
+      _calibrated = false;
+
+      _records.assign(RecordCount, FrameRecord());
+      _lastStartNs = 0;
+      _lastFrameNumber = UINT32_MAX;
+      _unmeasured = 0;
+   }
+
+   VkPresentModeKHR FramePacer::ChoosePresentMode(const vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR preferredPresentMode)
+   {
+      if (find(availablePresentModes.begin(), availablePresentModes.end(), preferredPresentMode) != availablePresentModes.end())
+      {
+         _presentMode = preferredPresentMode;
+         return _presentMode;
+      }
+
+      // FIFO is the one mode every surface has to support
+      _presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+      if (_mode == LatencyMode::Vsync)
+      {
+         return _presentMode;
+      }
+
+      // Mailbox shows the newest finished frame at the next refresh without
+      // tearing, immediate shows it straight away but tears
+      for (const auto& availablePresentMode : availablePresentModes)
+      {
+         if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+         {
+            _presentMode = availablePresentMode;
+            return _presentMode;
+         }
+         else if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR)
+         {
+            _presentMode = availablePresentMode;
+         }
+      }
+
+      return _presentMode;
+   }
+
+   uint32_t FramePacer::ChooseImageCount(const VkSurfaceCapabilitiesKHR& capabilities)
+   {
+      // One more than the minimum, so there is always an image to render
+      // to while the others are queued or on screen
+      _imageCount = capabilities.minImageCount + 1;
+
+      // Each extra image is one more frame a finished image can wait behind.
+      // Mailbox still needs three, one shown, one queued and one to render
+      // to, or acquiring blocks until the next refresh.
+      if (_mode == LatencyMode::LowLatency)
+      {
+         _imageCount = _presentMode == VK_PRESENT_MODE_MAILBOX_KHR ? max(capabilities.minImageCount, 3u) : capabilities.minImageCount;
+      }
+
+      // A maxImageCount of 0 means there is no limit besides memory
+      if (capabilities.maxImageCount > 0)
+      {
+         _imageCount = min(_imageCount, capabilities.maxImageCount);
+      }
+
+      return _imageCount;
+   }
+
+   void FramePacer::BeginFrame(uint32_t frameNumber)
+   {
+      if (_targetNs > 0 && _lastStartNs > 0)
+      {
+         TRACE_SCOPE("PaceFrame");
+
+         uint64_t dueNs = _lastStartNs + _targetNs;
+         uint64_t nowNs = NowNs();
+
+         while (nowNs < dueNs)
+         {
+            uint64_t remainingNs = dueNs - nowNs;
+
+            if (remainingNs > SpinNs)
+            {
+               this_thread::sleep_for(chrono::nanoseconds(remainingNs - SpinNs));
+            }
+            else
+            {
+               this_thread::yield();
+            }
+
+            nowNs = NowNs();
+         }
+      }
+
+      uint64_t startNs = NowNs();
+
+      // A frame is started again when the swap chain was out of date, and
+      // only the attempt that is submitted counts
+      if (_lastStartNs > 0 && frameNumber != _lastFrameNumber)
+      {
+         _intervals.Add((startNs - _lastStartNs) / 1000000.0);
+      }
+
+      _lastStartNs = startNs;
+      _lastFrameNumber = frameNumber;
+
+      FrameRecord& record = _records[frameNumber % RecordCount];
+
+      // Never presented, mailbox replaced it or the swap chain went away
+      if (record.pending && record.frameNumber != frameNumber)
+      {
+         _unmeasured++;
+      }
+
+      record.frameNumber = frameNumber;
+      record.startNs = startNs;
+      record.fence = VK_NULL_HANDLE;
+      record.pending = true;
+   }
+
+   void FramePacer::EndFrame(uint32_t frameNumber, VkFence fence)
+   {
+      _records[frameNumber % RecordCount].fence = fence;
+   }
+
+   void FramePacer::ChainPresentTime(uint32_t frameNumber, VkPresentInfoKHR& presentInfo)
+   {
+      if (!_displayTiming)
+      {
+         return;
+      }
+
+      // No desired time, the image is shown as soon as the present mode allows
+      _presentTime.presentID = frameNumber;
+      _presentTime.desiredPresentTime = 0;
+
+      _presentTimes.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+      _presentTimes.pNext = presentInfo.pNext;
+      _presentTimes.swapchainCount = 1;
+      _presentTimes.pTimes = &_presentTime;
+
+      presentInfo.pNext = &_presentTimes;
+   }
+
+   void FramePacer::Collect(VkSwapchainKHR swapChain)
+   {
+      if (_displayTiming && swapChain != VK_NULL_HANDLE)
+      {
+         uint32_t timingCount = 0;
+         _vkGetPastPresentationTiming(_device, swapChain, &timingCount, nullptr);
+
+         if (timingCount == 0)
+         {
+            return;
+         }
+
+         _pastTimings.resize(timingCount);
+         VkResult result = _vkGetPastPresentationTiming(_device, swapChain, &timingCount, _pastTimings.data());
+
+         if (result != VK_SUCCESS && result != VK_INCOMPLETE)
+         {
+            return;
+         }
+
+         // Every one of these was presented before now, which bounds the
+         // offset between the two clocks
+         uint64_t collectedNs = NowNs();
+
+         for (uint32_t i = 0; i < timingCount; i++)
+         {
+            Calibrate(_pastTimings[i], collectedNs);
+         }
+
+         for (uint32_t i = 0; i < timingCount; i++)
+         {
+            const VkPastPresentationTimingGOOGLE& timing = _pastTimings[i];
+            FrameRecord& record = _records[timing.presentID % RecordCount];
+
+            if (record.pending && record.frameNumber == timing.presentID)
+            {
+               AddLatency(record, (uint64_t)((int64_t)timing.actualPresentTime + _displayToSteadyNs));
+            }
+         }
+
+         return;
+      }
+
+      // Only tells us the GPU has finished by now, so the result is an upper
+      // bound on when it finished rendering
+      uint64_t nowNs = NowNs();
+
+      for (auto& record : _records)
+      {
+         if (record.pending && record.fence != VK_NULL_HANDLE && vkGetFenceStatus(_device, record.fence) == VK_SUCCESS)
+         {
+            AddLatency(record, nowNs);
+         }
+      }
+   }
+
+   void FramePacer::SwapChainReplaced()
+   {
+      if (!_displayTiming)
+      {
+         return;
+      }
+
+      for (auto& record : _records)
+      {
+         if (record.pending && record.fence != VK_NULL_HANDLE)
+         {
+            record.pending = false;
+            _unmeasured++;
+         }
+      }
+   }
+
+   void FramePacer::PrintReport(ostream& stream, bool histograms)
+   {
+      char line[256];
+
+      // Headless runs have no swap chain to choose for
+      if (_imageCount > 0)
+      {
+         snprintf(line, sizeof(line), "Latency mode %s: %s present mode, %u swap chain images, %u frames ahead, %s",
+            LatencyModeName(_mode), PresentModeName(_presentMode), _imageCount, FramesAhead(),
+            _targetNs > 0 ? "paced" : "unpaced");
+      }
+      else
+      {
+         snprintf(line, sizeof(line), "Latency mode %s: %u frames ahead, %s",
+            LatencyModeName(_mode), FramesAhead(), _targetNs > 0 ? "paced" : "unpaced");
+      }
+
+      stream << line << endl;
+
+      if (_targetNs > 0)
+      {
+         snprintf(line, sizeof(line), "\tTarget frame interval %.2f ms", _targetNs / 1000000.0);
+         stream << line << endl;
+      }
+
+      if (_intervals.Count() > 0)
+      {
+         _intervals.PrintSummary(stream, "Frame interval");
+
+         if (histograms)
+         {
+            _intervals.PrintHistogram(stream);
+         }
+      }
+
+      if (_latencies.Count() > 0)
+      {
+         _latencies.PrintSummary(stream, _displayTiming ? "Latency to present" : "Latency to GPU complete");
+
+         if (histograms)
+         {
+            _latencies.PrintHistogram(stream);
+         }
+      }
+
+      if (_unmeasured > 0)
+      {
+         stream << "\t" << _unmeasured << " frames could not be measured" << endl;
+      }
+   }
+
+   uint64_t FramePacer::NowNs()
+   {
+      return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+   }
+
+   void FramePacer::Calibrate(const VkPastPresentationTimingGOOGLE& timing, uint64_t collectedNs)
+   {
+      // The smallest difference is the one collected soonest after its
+      // present, so it is the closest to the true offset
+      int64_t offsetNs = (int64_t)collectedNs - (int64_t)timing.actualPresentTime;
+
+      if (!_calibrated || offsetNs < _displayToSteadyNs)
+      {
+         _displayToSteadyNs = offsetNs;
+         _calibrated = true;
+      }
+   }
+
+   void FramePacer::AddLatency(FrameRecord& record, uint64_t endNs)
+   {
+      record.pending = false;
+
+      // Should the clocks disagree, a nonsense sample is worse than none
+      if (endNs < record.startNs)
+      {
+         _unmeasured++;
+         return;
+      }
+
+      _latencies.Add((endNs - record.startNs) / 1000000.0);
+   }
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../Common/Common.h"
+#include "../Profiling/FrameHistogram.h"
+
+namespace presentation {
+
+   // How the swap chain and frame loop trade throughput against latency
+   enum class LatencyMode
+   {
+      Throughput,    // Mailbox or immediate, the CPU runs framesInFlight frames ahead
+      Vsync,         // FIFO, never tears, the CPU runs framesInFlight frames ahead
+      LowLatency     // Mailbox or immediate on the shortest swap chain, one frame queued at a time
+   };
+
+   // Accepts "throughput", "vsync" and "low-latency"
+   bool ParseLatencyMode(const std::string& name, LatencyMode& mode);
+   const char* LatencyModeName(LatencyMode mode);
+
+   // Accepts "immediate", "mailbox", "fifo" and "fifo-relaxed"
+   bool ParsePresentMode(const std::string& name, VkPresentModeKHR& presentMode);
+   const char* PresentModeName(VkPresentModeKHR presentMode);
+
+   // Picks the present mode and swap chain length for a latency mode,
+   // throttles how far the CPU may run ahead of the GPU, and paces frame
+   // starts to a target interval.
+   //
+   // Every frame's latency is measured from the start of its CPU work to
+   // the moment its image was presented. With VK_GOOGLE_display_timing
+   // that is the presentation engine's own record of when the image hit
+   // the display. Its clock is not necessarily steady_clock's (on MSVC
+   // that is QueryPerformanceCounter), so present times are moved onto
+   // steady_clock by a calibrated offset. Without the extension the
+   // frame's fence stands in, so latency runs to GPU completion instead
+   // and is only observed at the start of the following frames.
+   class FramePacer {
+   public:
+      // Fills in the extension to enable when creating the device. Returns
+      // false if present times cannot be measured on this device.
+      static bool QueryDisplayTimingSupport(const VkPhysicalDevice& physicalDevice, std::vector<const char*>& enabledExtensions);
+
+      void Initialise(const VkDevice& device, LatencyMode mode, uint32_t framesInFlight, double targetFrameMs, bool displayTiming);
+
+      // Takes preferredPresentMode when the surface supports it, otherwise
+      // the latency mode decides
+      VkPresentModeKHR ChoosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes,
+         VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_MAX_ENUM_KHR);
+      uint32_t ChooseImageCount(const VkSurfaceCapabilitiesKHR& capabilities);
+
+      // How many frames may still be on the GPU when a new one starts. The
+      // frame loop waits on the fence of the frame this many before.
+      uint32_t FramesAhead() const { return _mode == LatencyMode::LowLatency ? 1 : _framesInFlight; };
+
+      // Sleeps until the target interval has passed since the last frame
+      // started, then stamps the start of this one
+      void BeginFrame(uint32_t frameNumber);
+
+      // Once the frame has been submitted with fence
+      void EndFrame(uint32_t frameNumber, VkFence fence);
+
+      // Tags the present with the frame number, so its presentation time can
+      // be matched back to it. presentInfo must be presented before the
+      // next call.
+      void ChainPresentTime(uint32_t frameNumber, VkPresentInfoKHR& presentInfo);
+
+      // Picks up the latency of every frame that has finished since the
+      // last call. Once the current frame's fence has signalled.
+      void Collect(VkSwapchainKHR swapChain);
+
+      // Present times are per swap chain, so frames still waiting on the
+      // old one are never measured
+      void SwapChainReplaced();
+
+      void PrintReport(std::ostream& stream, bool histograms);
+
+   private:
+      struct FrameRecord
+      {
+         uint32_t frameNumber = 0;
+         uint64_t startNs = 0;
+         VkFence fence = VK_NULL_HANDLE;
+         bool pending = false;
+      };
+
+      // Enough for every frame the presentation engine could still be
+      // holding on to
+      static const uint32_t RecordCount = 64;
+
+      static uint64_t NowNs();
+
+      void AddLatency(FrameRecord& record, uint64_t endNs);
+      void Calibrate(const VkPastPresentationTimingGOOGLE& timing, uint64_t collectedNs);
+
+      VkDevice _device = VK_NULL_HANDLE;
+      LatencyMode _mode = LatencyMode::Throughput;
+      uint32_t _framesInFlight = 1;
+      uint64_t _targetNs = 0;
+
+      bool _displayTiming = false;
+      PFN_vkGetPastPresentationTimingGOOGLE _vkGetPastPresentationTiming = nullptr;
+      std::vector<VkPastPresentationTimingGOOGLE> _pastTimings;
+      VkPresentTimeGOOGLE _presentTime = {};
+      VkPresentTimesInfoGOOGLE _presentTimes = {};
+
+      // Added to a present time to put it on steady_clock. Never more than
+      // the true offset plus the shortest delay seen between a present and
+      // its timing being collected, so it only ever moves presents later.
+      int64_t _displayToSteadyNs = 0;
+      bool _calibrated = false;
+
+      VkPresentModeKHR _presentMode = VK_PRESENT_MODE_FIFO_KHR;
+      uint32_t _imageCount = 0;
+
+      std::vector<FrameRecord> _records;
+      uint64_t _lastStartNs = 0;
+      uint32_t _lastFrameNumber = UINT32_MAX;
+      uint32_t _unmeasured = 0;
+
+      profiling::FrameHistogram _intervals;
+      profiling::FrameHistogram _latencies;
+   };
+}
@@ -0,0 +1,97 @@
+#include "FrameHistogram.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+namespace profiling {
+
+   namespace {
+      const int BarWidth = 40;
+   }
+
+   void FrameHistogram::Add(double ms)
+   {
+      ms = max(ms, 0.0);
+      uint32_t bucket = min((uint32_t)(ms / BucketMs), BucketCount - 1);
+
+      _buckets[bucket]++;
+      _count++;
+      _totalMs += ms;
+      _maxMs = max(_maxMs, ms);
+   }
+
+   double FrameHistogram::Percentile(double fraction) const
+   {
+      if (_count == 0)
+      {
+         return 0.0;
+      }
+
+      uint32_t target = max((uint32_t)(fraction * _count + 0.5), 1u);
+      uint32_t seen = 0;
+
+      for (uint32_t i = 0; i < BucketCount; i++)
+      {
+         seen += _buckets[i];
+
+         if (seen >= target)
+         {
+            // The overflow bucket has no upper edge, and no bucket's edge
+            // is worth reporting past the slowest frame
+            return min((i + 1) * BucketMs, _maxMs);
+         }
+      }
+
+      return _maxMs;
+   }
+
+   void FrameHistogram::PrintSummary(ostream& stream, const char* name) const
+   {
+      char line[256];
+      snprintf(line, sizeof(line), "%s: mean %.2f ms, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms over %u frames",
+         name, MeanMs(), Percentile(0.5), Percentile(0.9), Percentile(0.99), MaxMs(), _count);
+      stream << line << endl;
+   }
+
+   void FrameHistogram::PrintHistogram(ostream& stream) const
+   {
+      uint32_t largest = *max_element(_buckets.begin(), _buckets.end());
+
+      if (largest == 0)
+      {
+         return;
+      }
+
+      char line[256];
+
+      for (uint32_t i = 0; i < BucketCount; i++)
+      {
+         if (_buckets[i] == 0)
+         {
+            continue;
+         }
+
+         // Every non-empty bucket gets at least one mark, however rare
+         int width = max((int)((uint64_t)_buckets[i] * BarWidth / largest), 1);
+         string bar(width, '#');
+
+         char range[64];
+
+         if (i == BucketCount - 1)
+         {
+            snprintf(range, sizeof(range), "%.1f+", i * BucketMs);
+         }
+         else
+         {
+            snprintf(range, sizeof(range), "%.1f-%.1f", i * BucketMs, (i + 1) * BucketMs);
+         }
+
+         snprintf(line, sizeof(line), "\t%12s ms %8u %s", range, _buckets[i], bar.c_str());
+
+         stream << line << endl;
+      }
+   }
+}
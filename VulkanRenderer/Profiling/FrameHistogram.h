@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace profiling {
+
+   // Frame times counted into fixed 0.5 ms buckets, with everything past
+   // the last bucket counted in it. Adding is constant time with no
+   // allocation, so it can run every frame; percentiles are read off the
+   // buckets and are accurate to a bucket's width.
+   class FrameHistogram {
+   public:
+      static constexpr double BucketMs = 0.5;
+      static constexpr uint32_t BucketCount = 200;
+
+      FrameHistogram() : _buckets(BucketCount, 0) {};
+
+      void Add(double ms);
+
+      uint32_t Count() const { return _count; };
+      double MeanMs() const { return _count > 0 ? _totalMs / _count : 0.0; };
+      double MaxMs() const { return _maxMs; };
+
+      // Upper edge of the bucket holding the fraction'th sample, so 0.99
+      // gives the time 99% of frames came in under
+      double Percentile(double fraction) const;
+
+      // One line of mean and percentiles
+      void PrintSummary(std::ostream& stream, const char* name) const;
+      // Every bucket with samples in, as a bar scaled to the largest
+      void PrintHistogram(std::ostream& stream) const;
+
+   private:
+      std::vector<uint32_t> _buckets;
+      uint32_t _count = 0;
+      double _totalMs = 0.0;
+      double _maxMs = 0.0;
+   };
+}
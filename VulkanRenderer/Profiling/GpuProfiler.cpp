@@ -0,0 +1,233 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include "Trace.h"
+
+using namespace std;
+
+namespace profiling {
+
+   void GpuProfiler::Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, const VkPhysicalDevice& physicalDevice, uint32_t queueFamily, uint32_t framesInFlight)
+   {
+      _device = device;
+      _pAllocationCallbacks = pAllocationCallbacks;
+
+      VkPhysicalDeviceProperties properties;
+      vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+      uint32_t queueFamilyCount = 0;
+      vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+      vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+      vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+      uint32_t validBits = queueFamily < queueFamilyCount ? queueFamilies[queueFamily].timestampValidBits : 0;
+
+      _supported = validBits > 0 && properties.limits.timestampPeriod > 0.0f;
+      _timestampPeriodNs = properties.limits.timestampPeriod;
+      _timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+      if (!_supported)
+      {
+         return;
+      }
+
+      _frames.resize(framesInFlight);
+      _results.resize(MaxScopes * 2);
+
+      for (auto& frame : _frames)
+      {
+         VkQueryPoolCreateInfo queryPoolInfo = {};
+         queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+         queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+         queryPoolInfo.queryCount = MaxScopes * 2;
+
+         if (vkCreateQueryPool(_device, &queryPoolInfo, _pAllocationCallbacks, &frame.queryPool) != VK_SUCCESS)
+         {
+            throw runtime_error("Failed to create timestamp query pool");
+         }
+
+         frame.scopes.reserve(MaxScopes);
+      }
+   }
+
+   void GpuProfiler::Destroy()
+   {
+      for (auto& frame : _frames)
+      {
+         vkDestroyQueryPool(_device, frame.queryPool, _pAllocationCallbacks);
+      }
+
+      _frames.clear();
+   }
+
+   void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot)
+   {
+      if (!_supported)
+      {
+         return;
+      }
+
+      FrameQueries& frame = _frames[frameSlot];
+
+      if (frame.submitted)
+      {
+         Resolve(frame);
+      }
+
+      frame.scopes.clear();
+      frame.openScopes = 0;
+      frame.submitted = false;
+
+      // Recorded rather than done on the host, so it is ordered with the
+      // frame's own timestamp writes
+      vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, MaxScopes * 2);
+   }
+
+   void GpuProfiler::EndFrame(uint32_t frameSlot)
+   {
+      if (!_supported)
+      {
+         return;
+      }
+
+      FrameQueries& frame = _frames[frameSlot];
+      frame.submitted = !frame.scopes.empty();
+      frame.submitNs = Trace::Now();
+   }
+
+   uint32_t GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, uint32_t frameSlot, const char* name)
+   {
+      if (!_supported)
+      {
+         return UINT32_MAX;
+      }
+
+      FrameQueries& frame = _frames[frameSlot];
+
+      if (frame.scopes.size() == MaxScopes)
+      {
+         return UINT32_MAX;
+      }
+
+      uint32_t scope = (uint32_t)frame.scopes.size();
+      frame.scopes.push_back({ name, frame.openScopes++ });
+
+      vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, scope * 2);
+
+      return scope;
+   }
+
+   void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t scope)
+   {
+      if (!_supported || scope == UINT32_MAX)
+      {
+         return;
+      }
+
+      FrameQueries& frame = _frames[frameSlot];
+      frame.openScopes--;
+
+      // Bottom of pipe, so the timestamp lands once all prior work is done
+      vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, scope * 2 + 1);
+   }
+
+   void GpuProfiler::PrintReport(ostream& stream)
+   {
+      if (!_supported)
+      {
+         stream << "GPU timings: timestamps not supported on this queue" << endl;
+         return;
+      }
+
+      if (_resolvedFrames == 0)
+      {
+         return;
+      }
+
+      vector<pair<const string*, const ScopeTotals*>> scopes;
+      for (const auto& entry : _totals)
+      {
+         scopes.push_back({ &entry.first, &entry.second });
+      }
+
+      sort(scopes.begin(), scopes.end(), [](const auto& a, const auto& b) { return a.second->order < b.second->order; });
+
+      char line[256];
+      snprintf(line, sizeof(line), "GPU frame %.3f ms over %u frames", MeanFrameMs(), _resolvedFrames);
+      stream << line << endl;
+
+      for (const auto& scope : scopes)
+      {
+         snprintf(line, sizeof(line), "\t%*s%-24s %10.3f ms", (int)scope.second->depth * 2, "",
+            scope.first->c_str(), scope.second->ms / max(scope.second->count, 1u));
+         stream << line << endl;
+      }
+   }
+
+   void GpuProfiler::Resolve(FrameQueries& frame)
+   {
+      uint32_t queryCount = (uint32_t)frame.scopes.size() * 2;
+
+      // The frame's fence has signalled, so the results are ready and this
+      // returns without waiting. NOT_READY would mean a scope was left open.
+      if (vkGetQueryPoolResults(_device, frame.queryPool, 0, queryCount, queryCount * sizeof(uint64_t),
+         _results.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+      {
+         return;
+      }
+
+      uint64_t frameStart = UINT64_MAX;
+      uint64_t frameEnd = 0;
+
+      _lastFrame.clear();
+
+      for (size_t i = 0; i < frame.scopes.size(); i++)
+      {
+         uint64_t begin = _results[i * 2] & _timestampMask;
+         uint64_t end = _results[i * 2 + 1] & _timestampMask;
+         double ms = end > begin ? (end - begin) * _timestampPeriodNs / 1000000.0 : 0.0;
+
+         frameStart = min(frameStart, begin);
+         frameEnd = max(frameEnd, end);
+
+         _lastFrame.push_back({ frame.scopes[i].name, ms });
+
+         ScopeTotals& totals = _totals[frame.scopes[i].name];
+         if (totals.count == 0)
+         {
+            totals.order = (uint32_t)_totals.size();
+            totals.depth = frame.scopes[i].depth;
+         }
+         totals.ms += ms;
+         totals.count++;
+      }
+
+      _lastFrameMs = frameEnd > frameStart ? (frameEnd - frameStart) * _timestampPeriodNs / 1000000.0 : 0.0;
+      _frameMs += _lastFrameMs;
+      _resolvedFrames++;
+
+      // GPU ticks have no fixed relation to the CPU clock without calibrated
+      // timestamps, so the trace lines the frame up with its submit. Good
+      // enough to see which side of the frame is the long one.
+      if (Trace::IsEnabled())
+      {
+         for (size_t i = 0; i < frame.scopes.size(); i++)
+         {
+            uint64_t begin = _results[i * 2] & _timestampMask;
+            uint64_t end = _results[i * 2 + 1] & _timestampMask;
+
+            if (end <= begin)
+            {
+               continue;
+            }
+
+            uint64_t startNs = frame.submitNs + (uint64_t)((begin - frameStart) * _timestampPeriodNs);
+            uint64_t endNs = frame.submitNs + (uint64_t)((end - frameStart) * _timestampPeriodNs);
+            Trace::RecordOnTrack("GPU", frame.scopes[i].name, startNs, endNs);
+         }
+      }
+   }
+}
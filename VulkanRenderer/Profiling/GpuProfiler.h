@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../Common/Common.h"
+
+namespace profiling {
+
+   struct GpuScopeTiming
+   {
+      const char* name = nullptr;
+      double ms = 0.0;
+   };
+
+   // Times GPU work with timestamp queries. Every frame in flight has its
+   // own query pool, and a frame's results are only read back once its
+   // fence has signalled, framesInFlight frames later, so reading them
+   // never stalls. Ticks are converted to milliseconds with timestampPeriod.
+   //
+   // Scopes are recorded into the primary command buffer; anything inside
+   // a render pass that runs secondary buffers is timed as a whole.
+   class GpuProfiler {
+   public:
+      static const uint32_t MaxScopes = 64;
+
+      void Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, const VkPhysicalDevice& physicalDevice, uint32_t queueFamily, uint32_t framesInFlight);
+      void Destroy();
+
+      // Queue families may report no timestamp support, in which case
+      // every call below does nothing
+      bool IsSupported() { return _supported; };
+
+      // Once the frame's fence has signalled and its command buffer has begun
+      void BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+      // Once the frame has been submitted
+      void EndFrame(uint32_t frameSlot);
+
+      // name must outlive the profiler, string literals are expected
+      uint32_t BeginScope(VkCommandBuffer commandBuffer, uint32_t frameSlot, const char* name);
+      void EndScope(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint32_t scope);
+
+      // Scopes of the most recently read back frame
+      const std::vector<GpuScopeTiming>& LastFrame() { return _lastFrame; };
+
+      double MeanFrameMs() { return _resolvedFrames > 0 ? _frameMs / _resolvedFrames : 0.0; };
+
+      // First to last timestamp of the most recently read back frame, and
+      // how many frames have been read back, so callers can tell a new
+      // reading from the last one
+      double LastFrameMs() const { return _lastFrameMs; };
+      uint32_t ResolvedFrames() const { return _resolvedFrames; };
+
+      void PrintReport(std::ostream& stream);
+
+   private:
+      struct Scope
+      {
+         const char* name;
+         uint32_t depth;
+      };
+
+      struct FrameQueries
+      {
+         VkQueryPool queryPool = VK_NULL_HANDLE;
+         std::vector<Scope> scopes;
+         uint32_t openScopes = 0;
+         bool submitted = false;
+         uint64_t submitNs = 0;
+      };
+
+      struct ScopeTotals
+      {
+         uint32_t order = 0;
+         uint32_t depth = 0;
+         double ms = 0.0;
+         uint32_t count = 0;
+      };
+
+      void Resolve(FrameQueries& frame);
+
+      VkDevice _device = VK_NULL_HANDLE;
+      const VkAllocationCallbacks* _pAllocationCallbacks = nullptr;
+      bool _supported = false;
+      double _timestampPeriodNs = 1.0;
+      uint64_t _timestampMask = ~0ull;
+
+      std::vector<FrameQueries> _frames;
+      std::vector<uint64_t> _results;
+      std::vector<GpuScopeTiming> _lastFrame;
+
+      // Running totals per scope name, for the report
+      std::map<std::string, ScopeTotals> _totals;
+      double _frameMs = 0.0;
+      double _lastFrameMs = 0.0;
+      uint32_t _resolvedFrames = 0;
+   };
+
+   // Times the commands recorded while it is in scope
+   class GpuScope {
+   public:
+      GpuScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, uint32_t frameSlot, const char* name)
+         : _profiler(profiler), _commandBuffer(commandBuffer), _frameSlot(frameSlot),
+         _scope(profiler.BeginScope(commandBuffer, frameSlot, name)) {};
+      ~GpuScope() { _profiler.EndScope(_commandBuffer, _frameSlot, _scope); };
+
+      GpuScope(const GpuScope&) = delete;
+      GpuScope& operator=(const GpuScope&) = delete;
+
+   private:
+      GpuProfiler& _profiler;
+      VkCommandBuffer _commandBuffer;
+      uint32_t _frameSlot;
+      uint32_t _scope;
+   };
+}
@@ -0,0 +1,171 @@
+#include "Trace.h"
+
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace profiling {
+
+   namespace {
+      struct TraceEvent
+      {
+         const char* name;
+         uint64_t startNs;
+         uint64_t durationNs;
+      };
+
+      struct ThreadBuffer
+      {
+         uint32_t threadId = 0;
+         string threadName;
+         vector<TraceEvent> events;
+      };
+
+      // Buffers belong to the registry rather than their thread, so events
+      // from threads that have since exited still make it into the trace
+      struct Registry
+      {
+         mutex bufferMutex;
+         vector<unique_ptr<ThreadBuffer>> buffers;
+         map<string, ThreadBuffer*> tracks;
+         chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+      };
+
+      Registry& GetRegistry()
+      {
+         static Registry registry;
+         return registry;
+      }
+
+      // Caller holds the registry lock
+      ThreadBuffer& AddBuffer(Registry& registry)
+      {
+         registry.buffers.push_back(make_unique<ThreadBuffer>());
+         ThreadBuffer& buffer = *registry.buffers.back();
+         buffer.threadId = (uint32_t)registry.buffers.size();
+         buffer.events.reserve(4096);
+
+         return buffer;
+      }
+
+      ThreadBuffer& GetThreadBuffer()
+      {
+         // Only the first event on each thread takes the lock
+         thread_local ThreadBuffer* pBuffer = nullptr;
+
+         if (!pBuffer)
+         {
+            Registry& registry = GetRegistry();
+            lock_guard<mutex> lock(registry.bufferMutex);
+
+            pBuffer = &AddBuffer(registry);
+         }
+
+         return *pBuffer;
+      }
+
+      void WriteEscaped(ofstream& file, const char* text)
+      {
+         for (; *text; text++)
+         {
+            if (*text == '"' || *text == '\\')
+            {
+               file << '\\';
+            }
+
+            file << *text;
+         }
+      }
+   }
+
+   uint64_t Trace::Now()
+   {
+      auto elapsed = chrono::steady_clock::now() - GetRegistry().epoch;
+      return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+   }
+
+   void Trace::Record(const char* name, uint64_t startNs, uint64_t endNs)
+   {
+      GetThreadBuffer().events.push_back({ name, startNs, endNs - startNs });
+   }
+
+   void Trace::RecordOnTrack(const char* track, const char* name, uint64_t startNs, uint64_t endNs)
+   {
+      Registry& registry = GetRegistry();
+      lock_guard<mutex> lock(registry.bufferMutex);
+
+      ThreadBuffer*& pBuffer = registry.tracks[track];
+
+      if (!pBuffer)
+      {
+         pBuffer = &AddBuffer(registry);
+         pBuffer->threadName = track;
+      }
+
+      pBuffer->events.push_back({ name, startNs, endNs - startNs });
+   }
+
+   void Trace::SetThreadName(const string& name)
+   {
+      GetThreadBuffer().threadName = name;
+   }
+
+   bool Trace::WriteChromeJson(const string& path)
+   {
+      ofstream file(path, ios::trunc);
+
+      if (!file)
+      {
+         return false;
+      }
+
+      Registry& registry = GetRegistry();
+      lock_guard<mutex> lock(registry.bufferMutex);
+
+      // Complete ("X") events with microsecond timestamps, plus a metadata
+      // event naming each thread
+      file << fixed << setprecision(3);
+      file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+      bool first = true;
+
+      for (auto& buffer : registry.buffers)
+      {
+         if (!buffer->threadName.empty())
+         {
+            file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+               << ",\"args\":{\"name\":\"";
+            WriteEscaped(file, buffer->threadName.c_str());
+            file << "\"}}";
+            first = false;
+         }
+
+         for (const auto& event : buffer->events)
+         {
+            file << (first ? "" : ",") << "\n{\"name\":\"";
+            WriteEscaped(file, event.name);
+            file << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+               << ",\"ts\":" << event.startNs / 1000.0 << ",\"dur\":" << event.durationNs / 1000.0 << "}";
+            first = false;
+         }
+      }
+
+      file << "\n]}\n";
+      return file.good();
+   }
+
+   void Trace::Clear()
+   {
+      Registry& registry = GetRegistry();
+      lock_guard<mutex> lock(registry.bufferMutex);
+
+      for (auto& buffer : registry.buffers)
+      {
+         buffer->events.clear();
+      }
+   }
+}
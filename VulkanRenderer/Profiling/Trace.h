@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Scoped CPU timers, written out as Chrome trace JSON (chrome://tracing or
+// ui.perfetto.dev). Build with ENABLE_TRACING=1 to record; otherwise every
+// macro below compiles to nothing.
+#ifndef ENABLE_TRACING
+#define ENABLE_TRACING 0
+#endif
+
+namespace profiling {
+
+   class Trace {
+   public:
+      static constexpr bool IsEnabled() { return ENABLE_TRACING != 0; };
+
+      // Nanoseconds since the first trace call in the process
+      static uint64_t Now();
+
+      // Appends a finished event to the calling thread's buffer. name must
+      // outlive the trace, string literals are expected.
+      static void Record(const char* name, uint64_t startNs, uint64_t endNs);
+
+      // Appends to a named track of its own rather than the calling
+      // thread's, for timings from elsewhere such as the GPU. Takes a lock.
+      static void RecordOnTrack(const char* track, const char* name, uint64_t startNs, uint64_t endNs);
+
+      static void SetThreadName(const std::string& name);
+
+      // Threads write to their buffers without locking, so only call these
+      // while no traced work is running
+      static bool WriteChromeJson(const std::string& path);
+      static void Clear();
+   };
+
+   class ScopedTimer {
+   public:
+      explicit ScopedTimer(const char* name) : _name(name), _startNs(Trace::Now()) {};
+      ~ScopedTimer() { Trace::Record(_name, _startNs, Trace::Now()); };
+
+      ScopedTimer(const ScopedTimer&) = delete;
+      ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+   private:
+      const char* _name;
+      uint64_t _startNs;
+   };
+}
+
+#if ENABLE_TRACING
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) ::profiling::ScopedTimer TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_FUNCTION() TRACE_SCOPE(__FUNCTION__)
+#define TRACE_THREAD_NAME(name) ::profiling::Trace::SetThreadName(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_FUNCTION() ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
@@ -0,0 +1,135 @@
+#include "ParallelRecorder.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "../Profiling/Trace.h"
+
+using namespace std;
+using namespace threading;
+
+namespace recording {
+
+   void ParallelRecorder::Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, uint32_t queueFamily, uint32_t framesInFlight, JobSystem& jobs)
+   {
+      _device = device;
+      _pAllocationCallbacks = pAllocationCallbacks;
+      _pJobs = &jobs;
+
+      _pools.resize(framesInFlight);
+
+      for (auto& framePools : _pools)
+      {
+         framePools.resize(jobs.ThreadCount());
+
+         for (auto& pool : framePools)
+         {
+            VkCommandPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            poolInfo.queueFamilyIndex = queueFamily;
+
+            if (vkCreateCommandPool(_device, &poolInfo, _pAllocationCallbacks, &pool.commandPool) != VK_SUCCESS)
+            {
+               throw runtime_error("Failed to create recording command pool");
+            }
+         }
+      }
+   }
+
+   void ParallelRecorder::Destroy()
+   {
+      // Destroying a pool frees its command buffers
+      for (auto& framePools : _pools)
+      {
+         for (auto& pool : framePools)
+         {
+            vkDestroyCommandPool(_device, pool.commandPool, _pAllocationCallbacks);
+         }
+      }
+
+      _pools.clear();
+   }
+
+   void ParallelRecorder::BeginFrame(uint32_t frameSlot)
+   {
+      // Buffers are kept allocated and re-recorded, resetting the pool is
+      // far cheaper than freeing them one by one
+      for (auto& pool : _pools[frameSlot])
+      {
+         vkResetCommandPool(_device, pool.commandPool, 0);
+         pool.usedCount = 0;
+      }
+   }
+
+   const vector<VkCommandBuffer>& ParallelRecorder::Record(uint32_t frameSlot, VkRenderPass renderPass, uint32_t subpass,
+      VkFramebuffer framebuffer, uint32_t drawCount, const RecordFunction& record)
+   {
+      uint32_t sliceCount = max(1u, min(_pJobs->ThreadCount(), drawCount / MinDrawsPerSlice));
+      uint32_t sliceSize = (drawCount + sliceCount - 1) / sliceCount;
+
+      _recorded.assign(sliceCount, VK_NULL_HANDLE);
+
+      JobCounter counter;
+
+      _pJobs->ParallelFor(sliceCount, 1, [&](uint32_t slice, uint32_t)
+      {
+         TRACE_SCOPE("RecordSlice");
+
+         VkCommandBuffer commandBuffer = NextCommandBuffer(_pools[frameSlot][_pJobs->ThreadIndex()]);
+
+         VkCommandBufferInheritanceInfo inheritanceInfo = {};
+         inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+         inheritanceInfo.renderPass = renderPass;
+         inheritanceInfo.subpass = subpass;
+         inheritanceInfo.framebuffer = framebuffer;
+
+         VkCommandBufferBeginInfo beginInfo = {};
+         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+         beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+         beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+         if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+         {
+            throw runtime_error("Failed to begin recording secondary command buffer");
+         }
+
+         uint32_t firstDraw = slice * sliceSize;
+         record(commandBuffer, firstDraw, min(sliceSize, drawCount - min(firstDraw, drawCount)));
+
+         if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+         {
+            throw runtime_error("Failed to record secondary command buffer");
+         }
+
+         _recorded[slice] = commandBuffer;
+      }, counter);
+
+      // The calling thread records slices too while it waits
+      _pJobs->Wait(counter);
+
+      return _recorded;
+   }
+
+   VkCommandBuffer ParallelRecorder::NextCommandBuffer(ThreadCommandPool& pool)
+   {
+      if (pool.usedCount == pool.commandBuffers.size())
+      {
+         VkCommandBufferAllocateInfo allocateInfo = {};
+         allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+         allocateInfo.commandPool = pool.commandPool;
+         allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+         allocateInfo.commandBufferCount = 1;
+
+         VkCommandBuffer commandBuffer;
+         if (vkAllocateCommandBuffers(_device, &allocateInfo, &commandBuffer) != VK_SUCCESS)
+         {
+            throw runtime_error("Failed to allocate secondary command buffer");
+         }
+
+         pool.commandBuffers.push_back(commandBuffer);
+      }
+
+      return pool.commandBuffers[pool.usedCount++];
+   }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <functional>
+#include <vector>
+
+#include "../Common/Common.h"
+#include "../Threading/JobSystem.h"
+
+namespace recording {
+
+   // Records a draw list into secondary command buffers as jobs. Each job
+   // thread has its own command pool per frame in flight, since
+   // command pools cannot be used from two threads at once, and every pool
+   // is reset wholesale once its frame has finished on the GPU.
+   class ParallelRecorder {
+   public:
+      // Draws a contiguous slice of the draw list into a secondary buffer
+      typedef std::function<void(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount)> RecordFunction;
+
+      void Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, uint32_t queueFamily, uint32_t framesInFlight, threading::JobSystem& jobs);
+      void Destroy();
+
+      // Only once the frame's fence has signalled
+      void BeginFrame(uint32_t frameSlot);
+
+      // Secondary buffers come back in draw list order, ready for
+      // vkCmdExecuteCommands inside the given render pass and subpass
+      const std::vector<VkCommandBuffer>& Record(uint32_t frameSlot, VkRenderPass renderPass, uint32_t subpass,
+         VkFramebuffer framebuffer, uint32_t drawCount, const RecordFunction& record);
+
+   private:
+      // Fewer draws than this per secondary buffer and the cost of the
+      // buffer itself outweighs recording in parallel
+      static const uint32_t MinDrawsPerSlice = 64;
+
+      struct ThreadCommandPool
+      {
+         VkCommandPool commandPool = VK_NULL_HANDLE;
+         std::vector<VkCommandBuffer> commandBuffers;
+         uint32_t usedCount = 0;
+      };
+
+      VkCommandBuffer NextCommandBuffer(ThreadCommandPool& pool);
+
+      VkDevice _device = VK_NULL_HANDLE;
+      const VkAllocationCallbacks* _pAllocationCallbacks = nullptr;
+      threading::JobSystem* _pJobs = nullptr;
+
+      // Indexed [frameSlot][threadIndex]
+      std::vector<std::vector<ThreadCommandPool>> _pools;
+      std::vector<VkCommandBuffer> _recorded;
+   };
+}
@@ -0,0 +1,585 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace rendergraph {
+
+   namespace {
+      VkImageUsageFlags GetImageUsageFlags(ResourceUsage usage)
+      {
+         switch (usage)
+         {
+         case ResourceUsage::ColourAttachment: return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+         case ResourceUsage::DepthStencilAttachment:
+         case ResourceUsage::DepthStencilRead: return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+         case ResourceUsage::FragmentSampled:
+         case ResourceUsage::ComputeSampled: return VK_IMAGE_USAGE_SAMPLED_BIT;
+         case ResourceUsage::ComputeStorageRead:
+         case ResourceUsage::ComputeStorageWrite: return VK_IMAGE_USAGE_STORAGE_BIT;
+         case ResourceUsage::TransferSrc: return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+         case ResourceUsage::TransferDst: return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+         default: return 0;
+         }
+      }
+
+      VkBufferUsageFlags GetBufferUsageFlags(ResourceUsage usage)
+      {
+         switch (usage)
+         {
+         case ResourceUsage::ComputeStorageRead:
+         case ResourceUsage::ComputeStorageWrite: return VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+         case ResourceUsage::VertexBuffer: return VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+         case ResourceUsage::IndexBuffer: return VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+         case ResourceUsage::IndirectBuffer: return VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+         case ResourceUsage::TransferSrc: return VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+         case ResourceUsage::TransferDst: return VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+         default: return 0;
+         }
+      }
+
+      // Where a resource stands between passes
+      struct TrackedState
+      {
+         VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+         // The last write, not yet made visible to anything that follows
+         VkPipelineStageFlags writeStages = 0;
+         VkAccessFlags writeAccess = 0;
+
+         // Reads since the last write, which a later write has to wait for,
+         // and what they have already been made visible to
+         VkPipelineStageFlags readStages = 0;
+         VkPipelineStageFlags visibleStages = 0;
+         VkAccessFlags visibleAccess = 0;
+
+         // The reader whose barrier last changed the layout. Readers in other
+         // stages wait on these too, which chains them after the transition.
+         VkPipelineStageFlags transitionStages = 0;
+      };
+
+      // Returns true and fills in barrier when moving to the new state
+      // needs one; read after read in the same layout never does
+      bool Transition(TrackedState& state, const UsageState& next, VkPipelineStageFlags& srcStages, Barrier& barrier)
+      {
+         bool layoutChange = next.layout != state.layout;
+
+         if (next.write || layoutChange)
+         {
+            // Write after write and write after read both have to wait,
+            // but only earlier writes need flushing
+            srcStages = state.writeStages | state.readStages;
+            barrier.srcAccess = state.writeAccess;
+            barrier.dstAccess = next.access;
+            barrier.oldLayout = state.layout;
+            barrier.newLayout = next.layout;
+
+            if (next.write)
+            {
+               state.writeStages = next.stages;
+               state.writeAccess = next.access;
+               state.readStages = 0;
+               state.visibleStages = 0;
+               state.visibleAccess = 0;
+               state.transitionStages = 0;
+            }
+            else
+            {
+               // The write stays pending, as only this read has been made to
+               // wait for it. Anything visible in the old layout is not in
+               // the new one.
+               state.readStages = next.stages;
+               state.visibleStages = next.stages;
+               state.visibleAccess = next.access;
+               state.transitionStages = next.stages;
+            }
+
+            state.layout = next.layout;
+            return true;
+         }
+
+         state.readStages |= next.stages;
+
+         bool alreadyVisible = (next.stages & ~state.visibleStages) == 0 && (next.access & ~state.visibleAccess) == 0;
+
+         if ((state.writeStages == 0 && state.transitionStages == 0) || alreadyVisible)
+         {
+            return false;
+         }
+
+         srcStages = state.writeStages | state.transitionStages;
+         barrier.srcAccess = state.writeAccess;
+         barrier.dstAccess = next.access;
+         barrier.oldLayout = state.layout;
+         barrier.newLayout = next.layout;
+
+         state.visibleStages |= next.stages;
+         state.visibleAccess |= next.access;
+         return true;
+      }
+
+      void AddBarrier(BarrierBatch& batch, ResourceHandle resource, TrackedState& state, const UsageState& next)
+      {
+         Barrier barrier = { resource, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED };
+         VkPipelineStageFlags srcStages = 0;
+
+         if (Transition(state, next, srcStages, barrier))
+         {
+            batch.srcStages |= srcStages ? srcStages : (VkPipelineStageFlags)VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            batch.dstStages |= next.stages;
+            batch.barriers.push_back(barrier);
+         }
+      }
+   }
+
+   UsageState GetUsageState(ResourceUsage usage)
+   {
+      switch (usage)
+      {
+      case ResourceUsage::ColourAttachment:
+         return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true };
+      case ResourceUsage::DepthStencilAttachment:
+         return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true };
+      case ResourceUsage::DepthStencilRead:
+         return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false };
+      case ResourceUsage::FragmentSampled:
+         return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false };
+      case ResourceUsage::ComputeSampled:
+         return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false };
+      case ResourceUsage::ComputeStorageRead:
+         return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false };
+      case ResourceUsage::ComputeStorageWrite:
+         return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_GENERAL, true };
+      case ResourceUsage::VertexBuffer:
+         return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false };
+      case ResourceUsage::IndexBuffer:
+         return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false };
+      case ResourceUsage::IndirectBuffer:
+         return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false };
+      case ResourceUsage::TransferSrc:
+         return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false };
+      case ResourceUsage::TransferDst:
+         return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true };
+      case ResourceUsage::Present:
+         // Presentation is ordered by semaphore, so nothing has to wait here
+         return { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false };
+      case ResourceUsage::None:
+      default:
+         return { VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, false };
+      }
+   }
+
+   ResourceHandle RenderGraph::CreateImage(const string& name, VkFormat format, VkExtent2D extent, VkImageAspectFlags aspectMask)
+   {
+      ResourceDesc desc;
+      desc.name = name;
+      desc.type = ResourceType::Image;
+      desc.format = format;
+      desc.extent = extent;
+      desc.aspectMask = aspectMask;
+
+      _resources.push_back(desc);
+      _outputs.push_back(false);
+      return (ResourceHandle)(_resources.size() - 1);
+   }
+
+   ResourceHandle RenderGraph::CreateBuffer(const string& name, VkDeviceSize size)
+   {
+      ResourceDesc desc;
+      desc.name = name;
+      desc.type = ResourceType::Buffer;
+      desc.size = size;
+
+      _resources.push_back(desc);
+      _outputs.push_back(false);
+      return (ResourceHandle)(_resources.size() - 1);
+   }
+
+   ResourceHandle RenderGraph::ImportImage(const string& name, VkFormat format, VkExtent2D extent,
+      ResourceUsage initialUsage, ResourceUsage finalUsage, bool preserveContents)
+   {
+      ResourceHandle resource = CreateImage(name, format, extent);
+
+      ResourceDesc& desc = _resources[resource];
+      desc.imported = true;
+      desc.initialUsage = initialUsage;
+      desc.finalUsage = finalUsage;
+      desc.preserveContents = preserveContents;
+
+      // Whatever happens to it after the graph is out of sight, so it has to be produced
+      _outputs[resource] = finalUsage != ResourceUsage::None;
+      return resource;
+   }
+
+   void RenderGraph::ResizeImage(ResourceHandle resource, VkExtent2D extent)
+   {
+      if (_resources[resource].type != ResourceType::Image)
+      {
+         throw runtime_error("Failed to resize " + _resources[resource].name + ", it is not an image");
+      }
+
+      _resources[resource].extent = extent;
+   }
+
+   ResourceHandle RenderGraph::ImportBuffer(const string& name, VkDeviceSize size, ResourceUsage initialUsage, ResourceUsage finalUsage)
+   {
+      ResourceHandle resource = CreateBuffer(name, size);
+
+      ResourceDesc& desc = _resources[resource];
+      desc.imported = true;
+      desc.initialUsage = initialUsage;
+      desc.finalUsage = finalUsage;
+      desc.preserveContents = true;
+
+      _outputs[resource] = finalUsage != ResourceUsage::None;
+      return resource;
+   }
+
+   PassHandle RenderGraph::AddPass(const string& name, ExecuteFunction execute)
+   {
+      Pass pass;
+      pass.name = name;
+      pass.execute = execute;
+
+      _passes.push_back(pass);
+      return (PassHandle)(_passes.size() - 1);
+   }
+
+   void RenderGraph::Read(PassHandle pass, ResourceHandle resource, ResourceUsage usage)
+   {
+      _passes[pass].accesses.push_back({ resource, usage, false });
+   }
+
+   void RenderGraph::Write(PassHandle pass, ResourceHandle resource, ResourceUsage usage)
+   {
+      _passes[pass].accesses.push_back({ resource, usage, true });
+   }
+
+   void RenderGraph::SetSideEffects(PassHandle pass)
+   {
+      _passes[pass].sideEffects = true;
+   }
+
+   void RenderGraph::MarkOutput(ResourceHandle resource)
+   {
+      _outputs[resource] = true;
+   }
+
+   void RenderGraph::ExecutePass(PassHandle pass, VkCommandBuffer commandBuffer) const
+   {
+      if (_passes[pass].execute)
+      {
+         _passes[pass].execute(commandBuffer);
+      }
+   }
+
+   void RenderGraph::AddWrapDependency(CompiledGraph& compiled, ResourceHandle previous, ResourceHandle next) const
+   {
+      const UsageState& lastUse = compiled.lastUse[previous];
+      const UsageState& firstUse = compiled.firstUse[next];
+      VkAccessFlags srcAccess = lastUse.write ? lastUse.access : 0;
+
+      BarrierBatch& batch = compiled.passes[compiled.lifetimes[next].firstPass].barriers;
+      batch.srcStages |= lastUse.stages;
+      batch.dstStages |= firstUse.stages;
+
+      auto barrier = find_if(batch.barriers.begin(), batch.barriers.end(), [&](const Barrier& b) { return b.resource == next; });
+
+      if (previous == next && barrier != batch.barriers.end())
+      {
+         barrier->srcAccess |= srcAccess;
+      }
+      else if (srcAccess != 0)
+      {
+         batch.memorySrcAccess |= srcAccess;
+         batch.memoryDstAccess |= firstUse.access;
+      }
+   }
+
+   vector<bool> RenderGraph::CullPasses() const
+   {
+      // Walk back from the outputs. A pass survives if it has side effects
+      // or writes something a later surviving pass (or the outside world)
+      // still needs, and what it reads is then needed in turn.
+      vector<bool> needed = _outputs;
+      vector<bool> alive(_passes.size(), false);
+
+      for (size_t i = _passes.size(); i-- > 0;)
+      {
+         const Pass& pass = _passes[i];
+         bool isAlive = pass.sideEffects;
+
+         for (const auto& access : pass.accesses)
+         {
+            isAlive = isAlive || (access.write && needed[access.resource]);
+         }
+
+         if (!isAlive)
+         {
+            continue;
+         }
+
+         alive[i] = true;
+
+         // A write replaces the contents, so earlier writers are only needed
+         // again if this pass also reads the resource
+         for (const auto& access : pass.accesses)
+         {
+            if (access.write)
+            {
+               needed[access.resource] = false;
+            }
+         }
+
+         for (const auto& access : pass.accesses)
+         {
+            if (!access.write)
+            {
+               needed[access.resource] = true;
+            }
+         }
+      }
+
+      return alive;
+   }
+
+   CompiledGraph RenderGraph::Compile() const
+   {
+      CompiledGraph compiled;
+      compiled.lifetimes.resize(_resources.size());
+      compiled.imageUsage.resize(_resources.size(), 0);
+      compiled.bufferUsage.resize(_resources.size(), 0);
+      compiled.firstUse.resize(_resources.size());
+      compiled.lastUse.resize(_resources.size());
+
+      vector<bool> alive = CullPasses();
+      vector<TrackedState> states(_resources.size());
+
+      for (size_t i = 0; i < _resources.size(); i++)
+      {
+         const ResourceDesc& desc = _resources[i];
+
+         if (desc.imported)
+         {
+            // Treat the outside use as a write, so the first use in the
+            // graph waits for it
+            UsageState initial = GetUsageState(desc.initialUsage);
+            states[i].layout = desc.preserveContents ? initial.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+            states[i].writeStages = initial.stages;
+            states[i].writeAccess = initial.write ? initial.access : 0;
+         }
+
+         if (desc.type == ResourceType::Buffer)
+         {
+            states[i].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+         }
+      }
+
+      for (uint32_t i = 0; i < _passes.size(); i++)
+      {
+         if (!alive[i])
+         {
+            compiled.culledPassCount++;
+            continue;
+         }
+
+         const Pass& pass = _passes[i];
+         uint32_t compiledIndex = (uint32_t)compiled.passes.size();
+
+         CompiledPass compiledPass;
+         compiledPass.pass = i;
+
+         // A pass that uses a resource more than once uses it in one state,
+         // the union of everything it does with it
+         vector<pair<ResourceHandle, UsageState>> merged;
+
+         for (const auto& access : pass.accesses)
+         {
+            UsageState usage = GetUsageState(access.usage);
+            usage.write = usage.write || access.write;
+
+            if (_resources[access.resource].type == ResourceType::Buffer)
+            {
+               usage.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+               compiled.bufferUsage[access.resource] |= GetBufferUsageFlags(access.usage);
+            }
+            else
+            {
+               compiled.imageUsage[access.resource] |= GetImageUsageFlags(access.usage);
+            }
+
+            auto existing = find_if(merged.begin(), merged.end(), [&](const auto& entry) { return entry.first == access.resource; });
+
+            if (existing == merged.end())
+            {
+               merged.push_back({ access.resource, usage });
+            }
+            else if (existing->second.layout != usage.layout)
+            {
+               throw runtime_error("Pass " + pass.name + " uses " + _resources[access.resource].name + " in two layouts");
+            }
+            else
+            {
+               existing->second.stages |= usage.stages;
+               existing->second.access |= usage.access;
+               existing->second.write = existing->second.write || usage.write;
+            }
+         }
+
+         for (const auto& entry : merged)
+         {
+            ResourceLifetime& lifetime = compiled.lifetimes[entry.first];
+
+            if (!lifetime.IsUsed())
+            {
+               lifetime.firstPass = compiledIndex;
+               compiled.firstUse[entry.first] = entry.second;
+            }
+
+            lifetime.lastPass = compiledIndex;
+            compiled.lastUse[entry.first] = entry.second;
+
+            AddBarrier(compiledPass.barriers, entry.first, states[entry.first], entry.second);
+         }
+
+         compiled.barrierCount += (uint32_t)compiledPass.barriers.barriers.size();
+         compiled.passes.push_back(compiledPass);
+      }
+
+      // Hand imported resources back in the state the outside world expects
+      for (size_t i = 0; i < _resources.size(); i++)
+      {
+         const ResourceDesc& desc = _resources[i];
+
+         if (desc.imported && desc.finalUsage != ResourceUsage::None)
+         {
+            UsageState final = GetUsageState(desc.finalUsage);
+
+            if (desc.type == ResourceType::Buffer)
+            {
+               final.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+
+            AddBarrier(compiled.finalBarriers, (ResourceHandle)i, states[i], final);
+         }
+      }
+
+      compiled.barrierCount += (uint32_t)compiled.finalBarriers.barriers.size();
+
+      // The previous frame ran this same graph on the same queue, so the
+      // first use of a transient resource also has to wait for its last
+      for (size_t i = 0; i < _resources.size(); i++)
+      {
+         if (!_resources[i].imported && compiled.lifetimes[i].IsUsed())
+         {
+            AddWrapDependency(compiled, (ResourceHandle)i, (ResourceHandle)i);
+         }
+      }
+
+      return compiled;
+   }
+
+   TransientPlacement RenderGraph::PlaceTransients(CompiledGraph& compiled, const vector<TransientRequest>& requests) const
+   {
+      TransientPlacement placement;
+      placement.offsets.assign(requests.size(), 0);
+
+      // Biggest first, each at the lowest offset clear of everything already
+      // placed whose lifetime overlaps its own
+      vector<size_t> order(requests.size());
+      for (size_t i = 0; i < order.size(); i++)
+      {
+         order[i] = i;
+      }
+
+      stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return requests[a].size > requests[b].size; });
+
+      vector<size_t> placed;
+
+      for (size_t index : order)
+      {
+         const TransientRequest& request = requests[index];
+         const ResourceLifetime& lifetime = compiled.lifetimes[request.resource];
+         VkDeviceSize alignment = max<VkDeviceSize>(request.alignment, 1);
+
+         placement.unaliasedSize += request.size;
+
+         vector<size_t> conflicts;
+         vector<VkDeviceSize> candidates = { 0 };
+
+         for (size_t other : placed)
+         {
+            if (lifetime.Overlaps(compiled.lifetimes[requests[other].resource]))
+            {
+               conflicts.push_back(other);
+
+               VkDeviceSize end = placement.offsets[other] + requests[other].size;
+               candidates.push_back((end + alignment - 1) / alignment * alignment);
+            }
+         }
+
+         sort(candidates.begin(), candidates.end());
+
+         for (VkDeviceSize candidate : candidates)
+         {
+            bool fits = all_of(conflicts.begin(), conflicts.end(), [&](size_t other)
+            {
+               VkDeviceSize otherStart = placement.offsets[other];
+               return candidate + request.size <= otherStart || otherStart + requests[other].size <= candidate;
+            });
+
+            if (fits)
+            {
+               placement.offsets[index] = candidate;
+               break;
+            }
+         }
+
+         placement.heapSize = max(placement.heapSize, placement.offsets[index] + request.size);
+         placed.push_back(index);
+      }
+
+      // Memory handed from one resource to another needs the old owner's
+      // last use finished before the new owner's first
+      for (size_t a = 0; a < requests.size(); a++)
+      {
+         for (size_t b = 0; b < requests.size(); b++)
+         {
+            const ResourceLifetime& before = compiled.lifetimes[requests[a].resource];
+            const ResourceLifetime& after = compiled.lifetimes[requests[b].resource];
+
+            bool memoryOverlaps = placement.offsets[a] < placement.offsets[b] + requests[b].size &&
+               placement.offsets[b] < placement.offsets[a] + requests[a].size;
+
+            if (a == b || !memoryOverlaps || before.lastPass >= after.firstPass)
+            {
+               continue;
+            }
+
+            const UsageState& lastUse = compiled.lastUse[requests[a].resource];
+            const UsageState& firstUse = compiled.firstUse[requests[b].resource];
+
+            BarrierBatch& batch = compiled.passes[after.firstPass].barriers;
+            batch.srcStages |= lastUse.stages;
+            batch.dstStages |= firstUse.stages;
+            batch.memorySrcAccess |= lastUse.write ? lastUse.access : 0;
+            batch.memoryDstAccess |= firstUse.access;
+
+            // And the next frame hands the memory back the other way
+            AddWrapDependency(compiled, requests[b].resource, requests[a].resource);
+         }
+      }
+
+      return placement;
+   }
+}
@@ -0,0 +1,211 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../Common/Common.h"
+
+namespace rendergraph {
+
+   typedef uint32_t ResourceHandle;
+   typedef uint32_t PassHandle;
+
+   // Every way a pass can touch a resource. Each maps to the pipeline
+   // stages, access mask and image layout barriers are built from.
+   enum class ResourceUsage
+   {
+      None,
+      ColourAttachment,
+      DepthStencilAttachment,
+      DepthStencilRead,
+      FragmentSampled,
+      ComputeSampled,
+      ComputeStorageRead,
+      ComputeStorageWrite,
+      VertexBuffer,
+      IndexBuffer,
+      IndirectBuffer,
+      TransferSrc,
+      TransferDst,
+      Present
+   };
+
+   struct UsageState
+   {
+      VkPipelineStageFlags stages = 0;
+      VkAccessFlags access = 0;
+      VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+      bool write = false;
+   };
+
+   UsageState GetUsageState(ResourceUsage usage);
+
+   enum class ResourceType
+   {
+      Image,
+      Buffer
+   };
+
+   struct ResourceDesc
+   {
+      std::string name;
+      ResourceType type = ResourceType::Image;
+
+      // Images
+      VkFormat format = VK_FORMAT_UNDEFINED;
+      VkExtent2D extent = {};
+      uint32_t mipLevels = 1;
+      VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+
+      // Buffers
+      VkDeviceSize size = 0;
+
+      // Imported resources are owned outside the graph and never aliased
+      bool imported = false;
+      ResourceUsage initialUsage = ResourceUsage::None;
+      ResourceUsage finalUsage = ResourceUsage::None;
+      bool preserveContents = false;
+   };
+
+   struct Barrier
+   {
+      ResourceHandle resource;
+      VkAccessFlags srcAccess;
+      VkAccessFlags dstAccess;
+      VkImageLayout oldLayout;
+      VkImageLayout newLayout;
+   };
+
+   // Everything one vkCmdPipelineBarrier call does
+   struct BarrierBatch
+   {
+      VkPipelineStageFlags srcStages = 0;
+      VkPipelineStageFlags dstStages = 0;
+      std::vector<Barrier> barriers;
+
+      // A global memory barrier, for resources sharing memory through aliasing
+      VkAccessFlags memorySrcAccess = 0;
+      VkAccessFlags memoryDstAccess = 0;
+
+      bool IsEmpty() const { return barriers.empty() && memorySrcAccess == 0 && memoryDstAccess == 0 && srcStages == 0; }
+   };
+
+   struct CompiledPass
+   {
+      PassHandle pass;
+      BarrierBatch barriers;   // Recorded before the pass
+   };
+
+   // First and last use, as indices into CompiledGraph::passes
+   struct ResourceLifetime
+   {
+      uint32_t firstPass = UINT32_MAX;
+      uint32_t lastPass = 0;
+
+      bool IsUsed() const { return firstPass != UINT32_MAX; }
+      bool Overlaps(const ResourceLifetime& other) const { return firstPass <= other.lastPass && other.firstPass <= lastPass; }
+   };
+
+   struct CompiledGraph
+   {
+      std::vector<CompiledPass> passes;
+      BarrierBatch finalBarriers;        // Imported resources to their final usage
+
+      // Per resource
+      std::vector<ResourceLifetime> lifetimes;
+      std::vector<VkImageUsageFlags> imageUsage;
+      std::vector<VkBufferUsageFlags> bufferUsage;
+      std::vector<UsageState> firstUse;
+      std::vector<UsageState> lastUse;
+
+      uint32_t culledPassCount = 0;
+      uint32_t barrierCount = 0;
+   };
+
+   struct TransientRequest
+   {
+      ResourceHandle resource;
+      VkDeviceSize size;
+      VkDeviceSize alignment;
+   };
+
+   struct TransientPlacement
+   {
+      std::vector<VkDeviceSize> offsets;   // Parallel to the requests
+      VkDeviceSize heapSize = 0;
+      VkDeviceSize unaliasedSize = 0;      // What separate allocations would have cost
+   };
+
+   // Passes declare the resources they read and write, and Compile works
+   // out which passes are needed, the barriers and layout transitions
+   // between them, and how long each resource lives. Neither building nor
+   // compiling touches the device, so the whole thing runs on the CPU.
+   class RenderGraph {
+   public:
+      typedef std::function<void(VkCommandBuffer commandBuffer)> ExecuteFunction;
+
+      ResourceHandle CreateImage(const std::string& name, VkFormat format, VkExtent2D extent,
+         VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT);
+      ResourceHandle CreateBuffer(const std::string& name, VkDeviceSize size);
+
+      // initialUsage is how the resource was last used outside the graph.
+      // Unless preserveContents is set it is treated as undefined, so its
+      // first transition discards whatever it held.
+      ResourceHandle ImportImage(const std::string& name, VkFormat format, VkExtent2D extent,
+         ResourceUsage initialUsage, ResourceUsage finalUsage, bool preserveContents = false);
+      ResourceHandle ImportBuffer(const std::string& name, VkDeviceSize size,
+         ResourceUsage initialUsage, ResourceUsage finalUsage);
+
+      // Changes the size of an image, for attachments that follow the
+      // swap chain. Transient images take the new size once the graph is
+      // compiled and realised, or rebuilt, again.
+      void ResizeImage(ResourceHandle resource, VkExtent2D extent);
+
+      PassHandle AddPass(const std::string& name, ExecuteFunction execute);
+      void Read(PassHandle pass, ResourceHandle resource, ResourceUsage usage);
+      void Write(PassHandle pass, ResourceHandle resource, ResourceUsage usage);
+
+      // Keeps a pass even though nothing in the graph reads what it writes
+      void SetSideEffects(PassHandle pass);
+      // Keeps whichever passes produce this resource
+      void MarkOutput(ResourceHandle resource);
+
+      CompiledGraph Compile() const;
+
+      // Packs transient resources into one heap, letting any two whose
+      // lifetimes do not overlap share memory, and adds the dependencies
+      // that sharing needs to the compiled barriers
+      TransientPlacement PlaceTransients(CompiledGraph& compiled, const std::vector<TransientRequest>& requests) const;
+
+      uint32_t ResourceCount() const { return (uint32_t)_resources.size(); }
+      const ResourceDesc& GetResource(ResourceHandle resource) const { return _resources[resource]; }
+      const std::string& GetPassName(PassHandle pass) const { return _passes[pass].name; }
+      void ExecutePass(PassHandle pass, VkCommandBuffer commandBuffer) const;
+
+   private:
+      struct ResourceAccess
+      {
+         ResourceHandle resource;
+         ResourceUsage usage;
+         bool write;
+      };
+
+      struct Pass
+      {
+         std::string name;
+         ExecuteFunction execute;
+         std::vector<ResourceAccess> accesses;
+         bool sideEffects = false;
+      };
+
+      std::vector<bool> CullPasses() const;
+
+      // Orders the first use of next after the last use of previous in
+      // the frame before
+      void AddWrapDependency(CompiledGraph& compiled, ResourceHandle previous, ResourceHandle next) const;
+
+      std::vector<ResourceDesc> _resources;
+      std::vector<Pass> _passes;
+      std::vector<bool> _outputs;
+   };
+}
@@ -0,0 +1,331 @@
+#include "RenderGraphExecutor.h"
+
+#include <stdexcept>
+
+#include "../Profiling/Trace.h"
+
+using namespace std;
+using namespace memory;
+
+namespace rendergraph {
+
+   void RenderGraphExecutor::Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, DeviceAllocator& allocator)
+   {
+      _device = device;
+      _pAllocationCallbacks = pAllocationCallbacks;
+      _pAllocator = &allocator;
+   }
+
+   void RenderGraphExecutor::Destroy()
+   {
+      Release();
+
+      _device = VK_NULL_HANDLE;
+      _pAllocator = nullptr;
+   }
+
+   void RenderGraphExecutor::Realise(const RenderGraph& graph, CompiledGraph& compiled)
+   {
+      TRACE_FUNCTION();
+
+      Release();
+
+      uint32_t resourceCount = graph.ResourceCount();
+      _images.assign(resourceCount, VK_NULL_HANDLE);
+      _imageViews.assign(resourceCount, VK_NULL_HANDLE);
+      _buffers.assign(resourceCount, VK_NULL_HANDLE);
+      _owned.assign(resourceCount, false);
+      _bufferAllocations.assign(resourceCount, Allocation());
+
+      for (ResourceHandle i = 0; i < resourceCount; i++)
+      {
+         const ResourceDesc& desc = graph.GetResource(i);
+
+         // Images are left to CreateImages, the rest are culled away or
+         // owned by someone else
+         if (desc.type != ResourceType::Buffer || desc.imported || !compiled.lifetimes[i].IsUsed())
+         {
+            continue;
+         }
+
+         _owned[i] = true;
+
+         // Buffers are small next to attachments, so they are not worth aliasing
+         VkBufferCreateInfo bufferInfo = {};
+         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+         bufferInfo.size = desc.size;
+         bufferInfo.usage = compiled.bufferUsage[i];
+         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+         _pAllocator->CreateBuffer(bufferInfo, MemoryUsage::GpuOnly, _buffers[i], _bufferAllocations[i]);
+      }
+
+      CreateImages(graph, compiled);
+   }
+
+   RetiredImages RenderGraphExecutor::RebuildImages(const RenderGraph& graph, CompiledGraph& compiled)
+   {
+      TRACE_FUNCTION();
+
+      RetiredImages retired;
+
+      for (size_t i = 0; i < _owned.size(); i++)
+      {
+         if (!_owned[i] || _images[i] == VK_NULL_HANDLE)
+         {
+            continue;
+         }
+
+         retired.images.push_back(_images[i]);
+         retired.imageViews.push_back(_imageViews[i]);
+         _images[i] = VK_NULL_HANDLE;
+         _imageViews[i] = VK_NULL_HANDLE;
+         _owned[i] = false;
+      }
+
+      retired.heapAllocation = _heapAllocation;
+      _heapAllocation = Allocation();
+      _unaliasedSize = 0;
+
+      CreateImages(graph, compiled);
+      return retired;
+   }
+
+   void RenderGraphExecutor::DestroyRetired(RetiredImages& retired)
+   {
+      for (size_t i = 0; i < retired.images.size(); i++)
+      {
+         vkDestroyImageView(_device, retired.imageViews[i], _pAllocationCallbacks);
+         vkDestroyImage(_device, retired.images[i], _pAllocationCallbacks);
+      }
+
+      if (retired.heapAllocation.type != AllocationType::None)
+      {
+         _pAllocator->Free(retired.heapAllocation);
+      }
+
+      retired = RetiredImages();
+   }
+
+   void RenderGraphExecutor::CreateImages(const RenderGraph& graph, CompiledGraph& compiled)
+   {
+      vector<TransientRequest> requests;
+      uint32_t memoryTypeBits = UINT32_MAX;
+
+      for (ResourceHandle i = 0; i < graph.ResourceCount(); i++)
+      {
+         const ResourceDesc& desc = graph.GetResource(i);
+
+         if (desc.type != ResourceType::Image || desc.imported || !compiled.lifetimes[i].IsUsed())
+         {
+            continue;
+         }
+
+         _owned[i] = true;
+
+         VkImageCreateInfo imageInfo = {};
+         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+         imageInfo.imageType = VK_IMAGE_TYPE_2D;
+         imageInfo.format = desc.format;
+         imageInfo.extent = { desc.extent.width, desc.extent.height, 1 };
+         imageInfo.mipLevels = desc.mipLevels;
+         imageInfo.arrayLayers = 1;
+         imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+         imageInfo.usage = compiled.imageUsage[i];
+         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+         if (vkCreateImage(_device, &imageInfo, _pAllocationCallbacks, &_images[i]) != VK_SUCCESS)
+         {
+            throw runtime_error("Failed to create render graph image " + desc.name);
+         }
+
+         VkMemoryRequirements requirements;
+         vkGetImageMemoryRequirements(_device, _images[i], &requirements);
+
+         requests.push_back({ i, requirements.size, requirements.alignment });
+         memoryTypeBits &= requirements.memoryTypeBits;
+      }
+
+      if (!requests.empty())
+      {
+         if (memoryTypeBits == 0)
+         {
+            throw runtime_error("Failed to find a memory type all render graph images can share");
+         }
+
+         TransientPlacement placement = graph.PlaceTransients(compiled, requests);
+
+         VkDeviceSize alignment = 1;
+         for (const auto& request : requests)
+         {
+            alignment = max(alignment, request.alignment);
+         }
+
+         VkMemoryRequirements heapRequirements = { placement.heapSize, alignment, memoryTypeBits };
+         _heapAllocation = _pAllocator->Allocate(heapRequirements, MemoryUsage::GpuOnly, ResourceTiling::Optimal);
+         _unaliasedSize = placement.unaliasedSize;
+
+         for (size_t i = 0; i < requests.size(); i++)
+         {
+            ResourceHandle resource = requests[i].resource;
+
+            if (vkBindImageMemory(_device, _images[resource], _heapAllocation.memory, _heapAllocation.offset + placement.offsets[i]) != VK_SUCCESS)
+            {
+               throw runtime_error("Failed to bind render graph image memory");
+            }
+
+            const ResourceDesc& desc = graph.GetResource(resource);
+
+            VkImageViewCreateInfo viewInfo = {};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = _images[resource];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = desc.format;
+            viewInfo.subresourceRange.aspectMask = desc.aspectMask;
+            viewInfo.subresourceRange.levelCount = desc.mipLevels;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            if (vkCreateImageView(_device, &viewInfo, _pAllocationCallbacks, &_imageViews[resource]) != VK_SUCCESS)
+            {
+               throw runtime_error("Failed to create render graph image view");
+            }
+         }
+      }
+   }
+
+   void RenderGraphExecutor::Release()
+   {
+      for (size_t i = 0; i < _owned.size(); i++)
+      {
+         if (!_owned[i])
+         {
+            continue;
+         }
+
+         if (_imageViews[i] != VK_NULL_HANDLE)
+         {
+            vkDestroyImageView(_device, _imageViews[i], _pAllocationCallbacks);
+         }
+
+         if (_images[i] != VK_NULL_HANDLE)
+         {
+            vkDestroyImage(_device, _images[i], _pAllocationCallbacks);
+         }
+
+         if (_buffers[i] != VK_NULL_HANDLE)
+         {
+            _pAllocator->DestroyBuffer(_buffers[i], _bufferAllocations[i]);
+         }
+      }
+
+      if (_heapAllocation.type != AllocationType::None)
+      {
+         _pAllocator->Free(_heapAllocation);
+         _heapAllocation = Allocation();
+      }
+
+      _images.clear();
+      _imageViews.clear();
+      _buffers.clear();
+      _owned.clear();
+      _bufferAllocations.clear();
+      _unaliasedSize = 0;
+   }
+
+   void RenderGraphExecutor::BindImage(ResourceHandle resource, VkImage image, VkImageView view)
+   {
+      if (_owned[resource])
+      {
+         throw runtime_error("Failed to bind image, resource is not imported");
+      }
+
+      _images[resource] = image;
+      _imageViews[resource] = view;
+   }
+
+   void RenderGraphExecutor::BindBuffer(ResourceHandle resource, VkBuffer buffer)
+   {
+      if (_owned[resource])
+      {
+         throw runtime_error("Failed to bind buffer, resource is not imported");
+      }
+
+      _buffers[resource] = buffer;
+   }
+
+   void RenderGraphExecutor::Execute(VkCommandBuffer commandBuffer, const RenderGraph& graph, const CompiledGraph& compiled) const
+   {
+      TRACE_FUNCTION();
+
+      for (const auto& pass : compiled.passes)
+      {
+         RecordBarriers(commandBuffer, graph, pass.barriers);
+         graph.ExecutePass(pass.pass, commandBuffer);
+      }
+
+      RecordBarriers(commandBuffer, graph, compiled.finalBarriers);
+   }
+
+   void RenderGraphExecutor::RecordBarriers(VkCommandBuffer commandBuffer, const RenderGraph& graph, const BarrierBatch& batch) const
+   {
+      if (batch.IsEmpty())
+      {
+         return;
+      }
+
+      vector<VkImageMemoryBarrier> imageBarriers;
+      vector<VkBufferMemoryBarrier> bufferBarriers;
+
+      for (const auto& barrier : batch.barriers)
+      {
+         const ResourceDesc& desc = graph.GetResource(barrier.resource);
+
+         if (desc.type == ResourceType::Buffer)
+         {
+            VkBufferMemoryBarrier bufferBarrier = {};
+            bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            bufferBarrier.srcAccessMask = barrier.srcAccess;
+            bufferBarrier.dstAccessMask = barrier.dstAccess;
+            bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.buffer = _buffers[barrier.resource];
+            bufferBarrier.offset = 0;
+            bufferBarrier.size = VK_WHOLE_SIZE;
+
+            bufferBarriers.push_back(bufferBarrier);
+            continue;
+         }
+
+         VkImageMemoryBarrier imageBarrier = {};
+         imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+         imageBarrier.srcAccessMask = barrier.srcAccess;
+         imageBarrier.dstAccessMask = barrier.dstAccess;
+         imageBarrier.oldLayout = barrier.oldLayout;
+         imageBarrier.newLayout = barrier.newLayout;
+         imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+         imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+         imageBarrier.image = _images[barrier.resource];
+         imageBarrier.subresourceRange.aspectMask = desc.aspectMask;
+         imageBarrier.subresourceRange.levelCount = desc.mipLevels;
+         imageBarrier.subresourceRange.layerCount = 1;
+
+         imageBarriers.push_back(imageBarrier);
+      }
+
+      VkMemoryBarrier memoryBarrier = {};
+      memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      memoryBarrier.srcAccessMask = batch.memorySrcAccess;
+      memoryBarrier.dstAccessMask = batch.memoryDstAccess;
+      uint32_t memoryBarrierCount = (batch.memorySrcAccess | batch.memoryDstAccess) != 0 ? 1 : 0;
+
+      VkPipelineStageFlags srcStages = batch.srcStages ? batch.srcStages : (VkPipelineStageFlags)VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+      VkPipelineStageFlags dstStages = batch.dstStages ? batch.dstStages : (VkPipelineStageFlags)VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+      vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0,
+         memoryBarrierCount, &memoryBarrier,
+         (uint32_t)bufferBarriers.size(), bufferBarriers.data(),
+         (uint32_t)imageBarriers.size(), imageBarriers.data());
+   }
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+
+#include "../Common/Common.h"
+#include "../Memory/DeviceAllocator.h"
+#include "RenderGraph.h"
+
+namespace rendergraph {
+
+   // Transient images replaced by a rebuild, kept alive until no frame in
+   // flight can still be using them
+   struct RetiredImages
+   {
+      std::vector<VkImage> images;
+      std::vector<VkImageView> imageViews;
+      memory::Allocation heapAllocation;
+   };
+
+   // Turns a compiled graph into device objects and commands. Transient
+   // images are created here and bound into a single heap laid out by
+   // RenderGraph::PlaceTransients, so attachments that are never alive at
+   // the same time share memory. Imported resources are bound by the
+   // caller, and may be rebound every frame (the swapchain image, say).
+   class RenderGraphExecutor {
+   public:
+      void Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, memory::DeviceAllocator& allocator);
+      void Destroy();
+
+      // Creates the transient resources for this graph, releasing any made
+      // for a previous one. May add aliasing barriers to compiled.
+      void Realise(const RenderGraph& graph, CompiledGraph& compiled);
+      void Release();
+
+      // Recreates the transient images alone, for a graph whose images have
+      // been resized. Buffers are left as they are. The old images are
+      // handed back rather than destroyed, as frames in flight may still
+      // be rendering to them.
+      RetiredImages RebuildImages(const RenderGraph& graph, CompiledGraph& compiled);
+      void DestroyRetired(RetiredImages& retired);
+
+      void BindImage(ResourceHandle resource, VkImage image, VkImageView view = VK_NULL_HANDLE);
+      void BindBuffer(ResourceHandle resource, VkBuffer buffer);
+
+      VkImage GetImage(ResourceHandle resource) const { return _images[resource]; }
+      VkImageView GetImageView(ResourceHandle resource) const { return _imageViews[resource]; }
+      VkBuffer GetBuffer(ResourceHandle resource) const { return _buffers[resource]; }
+
+      // Records every surviving pass, each behind its batched barrier
+      void Execute(VkCommandBuffer commandBuffer, const RenderGraph& graph, const CompiledGraph& compiled) const;
+
+      VkDeviceSize HeapSize() const { return _heapAllocation.size; }
+      VkDeviceSize UnaliasedSize() const { return _unaliasedSize; }
+
+   private:
+      void CreateImages(const RenderGraph& graph, CompiledGraph& compiled);
+      void RecordBarriers(VkCommandBuffer commandBuffer, const RenderGraph& graph, const BarrierBatch& batch) const;
+
+      VkDevice _device = VK_NULL_HANDLE;
+      const VkAllocationCallbacks* _pAllocationCallbacks = nullptr;
+      memory::DeviceAllocator* _pAllocator = nullptr;
+
+      // Per resource, bound or owned
+      std::vector<VkImage> _images;
+      std::vector<VkImageView> _imageViews;
+      std::vector<VkBuffer> _buffers;
+      std::vector<bool> _owned;
+
+      memory::Allocation _heapAllocation;
+      std::vector<memory::Allocation> _bufferAllocations;
+      VkDeviceSize _unaliasedSize = 0;
+   };
+}
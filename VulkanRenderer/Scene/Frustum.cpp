@@ -0,0 +1,37 @@
+#include "Frustum.h"
+#include <cmath>
+
+using namespace std;
+
+namespace scene {
+
+   Frustum Frustum::FromViewProjection(const glm::mat4& viewProjection)
+   {
+      // Planes from the rows of the view projection matrix. glm is column
+      // major, so row i is m[*][i].
+      const glm::mat4& m = viewProjection;
+      Frustum frustum;
+
+      for (int i = 0; i < 4; i++)
+      {
+         frustum.planes[Left][i] = m[i][3] + m[i][0];
+         frustum.planes[Right][i] = m[i][3] - m[i][0];
+         frustum.planes[Bottom][i] = m[i][3] + m[i][1];
+         frustum.planes[Top][i] = m[i][3] - m[i][1];
+         frustum.planes[Near][i] = m[i][2];
+         frustum.planes[Far][i] = m[i][3] - m[i][2];
+      }
+
+      for (auto& plane : frustum.planes)
+      {
+         float length = sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+
+         for (float& component : plane)
+         {
+            component /= length;
+         }
+      }
+
+      return frustum;
+   }
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <glm/mat4x4.hpp>
+
+namespace scene {
+
+   // Six planes pointing into the view volume, normalised so a point's
+   // signed distance is dot(plane.xyz, point) + plane.w. Each plane is
+   // four packed floats, so the array can be copied into the vec4
+   // frustumPlanes[6] of the cull shader's std140 FrameConstants block.
+   struct Frustum
+   {
+      enum Plane { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+
+      float planes[PlaneCount][4];
+
+      // For a 0 to 1 depth range, as GLM_FORCE_DEPTH_ZERO_TO_ONE gives
+      static Frustum FromViewProjection(const glm::mat4& viewProjection);
+   };
+}
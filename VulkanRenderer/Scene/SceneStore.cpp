@@ -0,0 +1,388 @@
+#include "SceneStore.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "../Profiling/Trace.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define SCENE_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define SCENE_SIMD_X86 0
+#endif
+
+// MSVC emits AVX2 intrinsics wherever they appear, GCC and Clang need the
+// function marked, and the CPU is checked before either calls it
+#if SCENE_SIMD_X86 && !defined(_MSC_VER)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+using namespace std;
+using namespace threading;
+
+namespace scene {
+
+   namespace {
+      // Padding spheres fail every plane test, whatever the frustum
+      const float PaddingRadius = -FLT_MAX;
+
+      bool CpuHasAvx2()
+      {
+#if !SCENE_SIMD_X86
+         return false;
+#elif defined(_MSC_VER)
+         int info[4];
+         __cpuid(info, 0);
+
+         if (info[0] < 7)
+         {
+            return false;
+         }
+
+         // The OS has to save the YMM registers too, not just the CPU have them
+         __cpuid(info, 1);
+         bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+
+         __cpuidex(info, 7, 0);
+         return osSavesAvx && (info[1] & (1 << 5)) != 0;
+#else
+         return __builtin_cpu_supports("avx2");
+#endif
+      }
+
+      inline uint32_t CountTrailingZeros(uint32_t mask)
+      {
+#ifdef _MSC_VER
+         unsigned long index;
+         _BitScanForward(&index, mask);
+         return (uint32_t)index;
+#else
+         return (uint32_t)__builtin_ctz(mask);
+#endif
+      }
+
+      // One index per set bit, so a block costs a write per visible object
+      // and nothing for the culled ones
+      inline uint32_t AppendVisible(uint32_t mask, uint32_t firstIndex, uint32_t* pVisible)
+      {
+         uint32_t count = 0;
+
+         while (mask != 0)
+         {
+            pVisible[count++] = firstIndex + CountTrailingZeros(mask);
+            mask &= mask - 1;
+         }
+
+         return count;
+      }
+   }
+
+   bool SceneStore::IsSupported(CullKernel kernel)
+   {
+      static const bool hasAvx2 = CpuHasAvx2();
+
+      switch (kernel)
+      {
+      case CullKernel::Sse:
+         return SCENE_SIMD_X86 != 0;
+      case CullKernel::Avx2:
+         return hasAvx2;
+      default:
+         return true;
+      }
+   }
+
+   CullKernel SceneStore::BestKernel()
+   {
+      static const CullKernel best = IsSupported(CullKernel::Avx2) ? CullKernel::Avx2 :
+         IsSupported(CullKernel::Sse) ? CullKernel::Sse : CullKernel::Scalar;
+
+      return best;
+   }
+
+   const char* SceneStore::KernelName(CullKernel kernel)
+   {
+      switch (kernel)
+      {
+      case CullKernel::Sse:
+         return "SSE";
+      case CullKernel::Avx2:
+         return "AVX2";
+      default:
+         return "scalar";
+      }
+   }
+
+   void SceneStore::Reserve(size_t count)
+   {
+      size_t padded = (count + BlockSize - 1) / BlockSize * BlockSize;
+
+      _transforms.reserve(count);
+      _localSpheres.reserve(count);
+      _centreX.reserve(padded);
+      _centreY.reserve(padded);
+      _centreZ.reserve(padded);
+      _radius.reserve(padded);
+   }
+
+   void SceneStore::Clear()
+   {
+      _transforms.clear();
+      _localSpheres.clear();
+      _centreX.clear();
+      _centreY.clear();
+      _centreZ.clear();
+      _radius.clear();
+   }
+
+   uint32_t SceneStore::Add(const glm::mat4& transform, const glm::vec3& centre, float radius)
+   {
+      uint32_t index = Size();
+
+      _transforms.push_back(transform);
+      _localSpheres.push_back(glm::vec4(centre, radius));
+
+      // Grows a block at a time, so the arrays always end on a block boundary
+      if (index == _radius.size())
+      {
+         _centreX.resize(index + BlockSize, 0.0f);
+         _centreY.resize(index + BlockSize, 0.0f);
+         _centreZ.resize(index + BlockSize, 0.0f);
+         _radius.resize(index + BlockSize, PaddingRadius);
+      }
+
+      UpdateWorldSphere(index);
+
+      return index;
+   }
+
+   void SceneStore::SetTransform(uint32_t index, const glm::mat4& transform)
+   {
+      _transforms[index] = transform;
+      UpdateWorldSphere(index);
+   }
+
+   void SceneStore::UpdateWorldSphere(uint32_t index)
+   {
+      const glm::mat4& m = _transforms[index];
+      const glm::vec4& sphere = _localSpheres[index];
+
+      _centreX[index] = m[0][0] * sphere.x + m[1][0] * sphere.y + m[2][0] * sphere.z + m[3][0];
+      _centreY[index] = m[0][1] * sphere.x + m[1][1] * sphere.y + m[2][1] * sphere.z + m[3][1];
+      _centreZ[index] = m[0][2] * sphere.x + m[1][2] * sphere.y + m[2][2] * sphere.z + m[3][2];
+
+      // Scaled by the longest axis, so a non-uniform scale still fits inside
+      float scale = 0.0f;
+
+      for (int axis = 0; axis < 3; axis++)
+      {
+         scale = max(scale, sqrt(m[axis][0] * m[axis][0] + m[axis][1] * m[axis][1] + m[axis][2] * m[axis][2]));
+      }
+
+      _radius[index] = sphere.w * scale;
+   }
+
+   uint32_t SceneStore::Cull(const Frustum& frustum, vector<uint32_t>& visible, CullKernel kernel) const
+   {
+      // Room for everything being visible, so the kernels write through a
+      // pointer with no capacity checks. Shrinking it to the count would
+      // have the next cull zero the whole list again as it grew back.
+      if (visible.size() < _radius.size())
+      {
+         visible.resize(_radius.size());
+      }
+
+      return CullRange(frustum, kernel, 0, (uint32_t)_radius.size(), visible.data());
+   }
+
+   uint32_t SceneStore::Cull(const Frustum& frustum, vector<uint32_t>& visible, JobSystem& jobs) const
+   {
+      TRACE_FUNCTION();
+
+      uint32_t size = (uint32_t)_radius.size();
+      uint32_t jobCount = (size + ObjectsPerJob - 1) / ObjectsPerJob;
+
+      if (jobCount <= 1 || jobs.ThreadCount() == 1)
+      {
+         return Cull(frustum, visible);
+      }
+
+      if (visible.size() < size)
+      {
+         visible.resize(size);
+      }
+
+      vector<uint32_t> jobVisibleCounts(jobCount);
+
+      CullKernel kernel = BestKernel();
+      uint32_t* pVisible = visible.data();
+      JobCounter counter;
+
+      // ObjectsPerJob is a whole number of blocks, so every range but the
+      // last is too
+      jobs.ParallelFor(size, ObjectsPerJob, [&](uint32_t first, uint32_t count)
+      {
+         jobVisibleCounts[first / ObjectsPerJob] = CullRange(frustum, kernel, first, first + count, pVisible + first);
+      }, counter);
+
+      jobs.Wait(counter);
+
+      // Each range's results are at or after where they belong, so moving
+      // them down in order never overwrites one not yet moved
+      uint32_t count = jobVisibleCounts[0];
+
+      for (uint32_t job = 1; job < jobCount; job++)
+      {
+         memmove(pVisible + count, pVisible + job * ObjectsPerJob, jobVisibleCounts[job] * sizeof(uint32_t));
+         count += jobVisibleCounts[job];
+      }
+
+      return count;
+   }
+
+   uint32_t SceneStore::CullRange(const Frustum& frustum, CullKernel kernel, uint32_t first, uint32_t end, uint32_t* pVisible) const
+   {
+      if (kernel == CullKernel::Avx2 && IsSupported(CullKernel::Avx2))
+      {
+         return CullAvx2(frustum, first, end, pVisible);
+      }
+
+      if (kernel != CullKernel::Scalar && IsSupported(CullKernel::Sse))
+      {
+         return CullSse(frustum, first, end, pVisible);
+      }
+
+      return CullScalar(frustum, first, end, pVisible);
+   }
+
+   uint32_t SceneStore::CullScalar(const Frustum& frustum, uint32_t first, uint32_t end, uint32_t* pVisible) const
+   {
+      uint32_t count = 0;
+
+      // Padding is skipped rather than tested
+      end = min(end, Size());
+
+      // No early out and no branch on the result. With objects scattered
+      // through the view either one mispredicts often enough to cost more
+      // than the planes it skips.
+      for (uint32_t i = first; i < end; i++)
+      {
+         bool inside = true;
+
+         // Summed in the same order as the SIMD kernels, so every kernel
+         // agrees on spheres that only just touch a plane
+         for (const auto& plane : frustum.planes)
+         {
+            float distance = _centreX[i] * plane[0] + _centreY[i] * plane[1] + _centreZ[i] * plane[2] + plane[3] + _radius[i];
+            inside &= distance >= 0.0f;
+         }
+
+         pVisible[count] = i;
+         count += inside ? 1 : 0;
+      }
+
+      return count;
+   }
+
+#if SCENE_SIMD_X86
+   // All six planes are tested for every block, ANDing the results, since
+   // a branch per plane costs more than it saves when objects are spread
+   // through the frustum
+   uint32_t SceneStore::CullSse(const Frustum& frustum, uint32_t first, uint32_t end, uint32_t* pVisible) const
+   {
+      __m128 planes[Frustum::PlaneCount][4];
+
+      for (int p = 0; p < Frustum::PlaneCount; p++)
+      {
+         for (int i = 0; i < 4; i++)
+         {
+            planes[p][i] = _mm_set1_ps(frustum.planes[p][i]);
+         }
+      }
+
+      const __m128 zero = _mm_setzero_ps();
+      uint32_t count = 0;
+
+      for (uint32_t i = first; i < end; i += 4)
+      {
+         __m128 x = _mm_loadu_ps(&_centreX[i]);
+         __m128 y = _mm_loadu_ps(&_centreY[i]);
+         __m128 z = _mm_loadu_ps(&_centreZ[i]);
+         __m128 radius = _mm_loadu_ps(&_radius[i]);
+         __m128 inside = _mm_cmpeq_ps(zero, zero);
+
+         for (int p = 0; p < Frustum::PlaneCount; p++)
+         {
+            __m128 distance = _mm_mul_ps(x, planes[p][0]);
+            distance = _mm_add_ps(distance, _mm_mul_ps(y, planes[p][1]));
+            distance = _mm_add_ps(distance, _mm_mul_ps(z, planes[p][2]));
+            distance = _mm_add_ps(distance, planes[p][3]);
+            distance = _mm_add_ps(distance, radius);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+         }
+
+         count += AppendVisible((uint32_t)_mm_movemask_ps(inside), i, pVisible + count);
+      }
+
+      return count;
+   }
+
+   TARGET_AVX2 uint32_t SceneStore::CullAvx2(const Frustum& frustum, uint32_t first, uint32_t end, uint32_t* pVisible) const
+   {
+      __m256 planes[Frustum::PlaneCount][4];
+
+      for (int p = 0; p < Frustum::PlaneCount; p++)
+      {
+         for (int i = 0; i < 4; i++)
+         {
+            planes[p][i] = _mm256_set1_ps(frustum.planes[p][i]);
+         }
+      }
+
+      const __m256 zero = _mm256_setzero_ps();
+      uint32_t count = 0;
+
+      for (uint32_t i = first; i < end; i += 8)
+      {
+         __m256 x = _mm256_loadu_ps(&_centreX[i]);
+         __m256 y = _mm256_loadu_ps(&_centreY[i]);
+         __m256 z = _mm256_loadu_ps(&_centreZ[i]);
+         __m256 radius = _mm256_loadu_ps(&_radius[i]);
+         __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+         // Separate multiplies and adds rather than FMA, which rounds
+         // differently and would let the kernels disagree at the edges
+         for (int p = 0; p < Frustum::PlaneCount; p++)
+         {
+            __m256 distance = _mm256_mul_ps(x, planes[p][0]);
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(y, planes[p][1]));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(z, planes[p][2]));
+            distance = _mm256_add_ps(distance, planes[p][3]);
+            distance = _mm256_add_ps(distance, radius);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+         }
+
+         count += AppendVisible((uint32_t)_mm256_movemask_ps(inside), i, pVisible + count);
+      }
+
+      return count;
+   }
+#else
+   uint32_t SceneStore::CullSse(const Frustum& frustum, uint32_t first, uint32_t end, uint32_t* pVisible) const
+   {
+      return CullScalar(frustum, first, end, pVisible);
+   }
+
+   uint32_t SceneStore::CullAvx2(const Frustum& frustum, uint32_t first, uint32_t end, uint32_t* pVisible) const
+   {
+      return CullScalar(frustum, first, end, pVisible);
+   }
+#endif
+}
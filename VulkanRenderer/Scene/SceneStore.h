@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "../Threading/JobSystem.h"
+#include "Frustum.h"
+
+namespace scene {
+
+   enum class CullKernel { Scalar, Sse, Avx2 };
+
+   // The CPU side of the scene: a world transform and bounding sphere per
+   // object. The world spheres the cull reads every frame are kept as
+   // structure of arrays, one array per component, so SIMD kernels can
+   // test 4 or 8 objects per instruction with plain loads.
+   //
+   // The arrays are padded to a whole number of 8 wide blocks with spheres
+   // no frustum can contain, so the kernels have no tail to handle.
+   class SceneStore {
+   public:
+      // SSE needs an x86 build, and AVX2 is checked for on the CPU once
+      static bool IsSupported(CullKernel kernel);
+      static CullKernel BestKernel();
+      static const char* KernelName(CullKernel kernel);
+
+      void Reserve(size_t count);
+      void Clear();
+
+      // The sphere is the object's bounds in its own space. Returns the
+      // object's index, which Cull writes to the visible list.
+      uint32_t Add(const glm::mat4& transform, const glm::vec3& centre, float radius);
+      void SetTransform(uint32_t index, const glm::mat4& transform);
+
+      const glm::mat4& Transform(uint32_t index) const { return _transforms[index]; };
+      uint32_t Size() const { return (uint32_t)_transforms.size(); };
+
+      // Writes the indices of the objects touching the frustum to the start
+      // of visible, in ascending order, and returns how many there are.
+      // visible only ever grows, so reusing it from frame to frame costs
+      // no allocation or clearing.
+      uint32_t Cull(const Frustum& frustum, std::vector<uint32_t>& visible) const { return Cull(frustum, visible, BestKernel()); };
+      uint32_t Cull(const Frustum& frustum, std::vector<uint32_t>& visible, CullKernel kernel) const;
+
+      // The same, split into jobs across the job system. Each job writes
+      // its visible objects at the start of its own range, and the ranges
+      // are packed together once they have all finished.
+      uint32_t Cull(const Frustum& frustum, std::vector<uint32_t>& visible, threading::JobSystem& jobs) const;
+
+   private:
+      static const uint32_t BlockSize = 8;
+
+      // Objects per cull job. Fewer and the jobs cost more to schedule
+      // than they save.
+      static const uint32_t ObjectsPerJob = 16 * 1024;
+
+      void UpdateWorldSphere(uint32_t index);
+
+      // Each kernel culls objects [first, end), where first is a multiple
+      // of the block size, and writes them to pVisible
+      uint32_t CullRange(const Frustum& frustum, CullKernel kernel, uint32_t first, uint32_t end, uint32_t* pVisible) const;
+      uint32_t CullScalar(const Frustum& frustum, uint32_t first, uint32_t end, uint32_t* pVisible) const;
+      uint32_t CullSse(const Frustum& frustum, uint32_t first, uint32_t end, uint32_t* pVisible) const;
+      uint32_t CullAvx2(const Frustum& frustum, uint32_t first, uint32_t end, uint32_t* pVisible) const;
+
+      // Cold, only read when a transform changes
+      std::vector<glm::mat4> _transforms;
+      std::vector<glm::vec4> _localSpheres;
+
+      // Hot, read by every cull
+      std::vector<float> _centreX;
+      std::vector<float> _centreY;
+      std::vector<float> _centreZ;
+      std::vector<float> _radius;
+   };
+}
@@ -1,42 +1,148 @@
 #include "Shader.h"
 #include <stdexcept>
 
+#include "../Common/MappedFile.h"
+#include "../Profiling/Trace.h"
+
 using namespace std;
+using namespace common;
 
 namespace shader {
-   vector<char> Shader::ReadFile(const string& filename)
+
+   void Shader::Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks)
+   {
+      _device = device;
+      _pAllocationCallbacks = pAllocationCallbacks;
+   }
+
+   void Shader::Destroy()
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      for (auto& module : _modules)
+      {
+         vkDestroyShaderModule(_device, module.second, _pAllocationCallbacks);
+      }
+
+      _modules.clear();
+      _modulesByPath.clear();
+   }
+
+   VkShaderModule Shader::LoadModule(const string& filename)
+   {
+      TRACE_FUNCTION();
+
+      {
+         lock_guard<mutex> lock(_mutex);
+         auto cached = _modulesByPath.find(filename);
+
+         if (cached != _modulesByPath.end())
+         {
+            return cached->second;
+         }
+      }
+
+      MappedFile file;
+
+      if (!file.Open(filename))
+      {
+         throw runtime_error("Failed to open shader file " + filename);
+      }
+
+      // The mapping is page aligned, so the code can be handed to Vulkan in place
+      VkShaderModule module = CreateCachedModule(reinterpret_cast<const uint32_t*>(file.Data()), file.Size(), filename);
+
+      lock_guard<mutex> lock(_mutex);
+      _modulesByPath[filename] = module;
+
+      return module;
+   }
+
+   VkShaderModule Shader::CreateShaderModule(const uint32_t* pCode, size_t codeSize)
+   {
+      return CreateCachedModule(pCode, codeSize, "shader code");
+   }
+
+   VkShaderModule Shader::ReplaceModule(const string& filename, const uint32_t* pCode, size_t codeSize)
+   {
+      VkShaderModule module = CreateCachedModule(pCode, codeSize, filename);
+
+      lock_guard<mutex> lock(_mutex);
+      _modulesByPath[filename] = module;
+
+      return module;
+   }
+
+   size_t Shader::ModuleCount()
    {
-      ifstream file(filename, ios::ate | ios::binary);
+      lock_guard<mutex> lock(_mutex);
+      return _modules.size();
+   }
+
+   // 64 bit FNV-1a over whole words. Collisions are too unlikely across a
+   // few thousand shaders to be worth keeping the code around to compare.
+   uint64_t Shader::HashCode(const uint32_t* pCode, size_t wordCount)
+   {
+      uint64_t hash = 0xcbf29ce484222325ull;
 
-      if (!file.is_open())
+      for (size_t i = 0; i < wordCount; i++)
       {
-         throw runtime_error("Failed to open shader file");
+         hash ^= pCode[i];
+         hash *= 0x100000001b3ull;
       }
 
-      size_t fileSize = (size_t)file.tellg();
-      vector<char> buffer(fileSize);
+      return hash;
+   }
 
-      file.seekg(0);
-      file.read(buffer.data(), fileSize);
-      file.close();
+   void Shader::CheckSpirv(const void* pCode, size_t codeSize, const string& name)
+   {
+      if (codeSize < 5 * sizeof(uint32_t) || codeSize % sizeof(uint32_t) != 0)
+      {
+         throw runtime_error("Failed to load " + name + ", it is not a whole number of SPIR-V words");
+      }
 
-      return buffer;
+      if (reinterpret_cast<uintptr_t>(pCode) % alignof(uint32_t) != 0)
+      {
+         throw runtime_error("Failed to load " + name + ", SPIR-V must be 4 byte aligned");
+      }
+
+      uint32_t magic = *static_cast<const uint32_t*>(pCode);
+
+      if (magic != SpirvMagic)
+      {
+         throw runtime_error("Failed to load " + name + (magic == 0x03022307 ?
+            ", it is SPIR-V of the wrong endianness" : ", it is not SPIR-V"));
+      }
    }
 
-   VkShaderModule Shader::CreateShaderModule(const VkDevice& device, const vector<char>& code)
+   VkShaderModule Shader::CreateCachedModule(const uint32_t* pCode, size_t codeSize, const string& name)
    {
+      CheckSpirv(pCode, codeSize, name);
+
+      uint64_t hash = HashCode(pCode, codeSize / sizeof(uint32_t));
+
+      lock_guard<mutex> lock(_mutex);
+      auto cached = _modules.find(hash);
+
+      if (cached != _modules.end())
+      {
+         return cached->second;
+      }
+
       VkShaderModuleCreateInfo createInfo = {};
       createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-      createInfo.codeSize = code.size();
-      createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+      createInfo.codeSize = codeSize;
+      createInfo.pCode = pCode;
 
       VkShaderModule shaderModule;
 
-      if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+      if (vkCreateShaderModule(_device, &createInfo, _pAllocationCallbacks, &shaderModule) != VK_SUCCESS)
       {
          throw runtime_error("Failed to create shader module");
       }
 
+      _modules[hash] = shaderModule;
+
       return shaderModule;
    }
 }
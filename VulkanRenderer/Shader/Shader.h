@@ -1,14 +1,50 @@
 #pragma once
-#include <fstream>
-#include <vector>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 #include "../Common/Common.h"
 
 namespace shader {
+
+   static const uint32_t SpirvMagic = 0x07230203;
+
+   // Loads SPIR-V and owns the shader modules made from it. Files are
+   // mapped rather than read, and modules are cached by a hash of their
+   // code, so however many pipelines share a shader it is read and
+   // compiled into a module once. Every module lives until Destroy.
+   //
+   // Safe to call from several threads at once.
    class Shader {
    public:
-      std::vector<char> ReadFile(const std::string& filename);
-      VkShaderModule CreateShaderModule(const VkDevice& device, const std::vector<char>& code);
+      void Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks);
+      void Destroy();
+
+      // A file is only mapped the first time its path is loaded
+      VkShaderModule LoadModule(const std::string& filename);
+
+      // code must be 4 byte aligned SPIR-V, codeSize in bytes
+      VkShaderModule CreateShaderModule(const uint32_t* pCode, size_t codeSize);
+
+      // Points filename at new code, as after a hot reload. The old module
+      // stays cached, since frames in flight may still be using it.
+      VkShaderModule ReplaceModule(const std::string& filename, const uint32_t* pCode, size_t codeSize);
+
+      size_t ModuleCount();
+
+   private:
+      static uint64_t HashCode(const uint32_t* pCode, size_t wordCount);
+      static void CheckSpirv(const void* pCode, size_t codeSize, const std::string& name);
+
+      VkShaderModule CreateCachedModule(const uint32_t* pCode, size_t codeSize, const std::string& name);
+
+      VkDevice _device = VK_NULL_HANDLE;
+      const VkAllocationCallbacks* _pAllocationCallbacks = nullptr;
+
+      // Keyed by content, with the path cache in front of it
+      std::unordered_map<uint64_t, VkShaderModule> _modules;
+      std::unordered_map<std::string, VkShaderModule> _modulesByPath;
+
+      std::mutex _mutex;
    };
 }
-
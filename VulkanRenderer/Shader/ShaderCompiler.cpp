@@ -0,0 +1,264 @@
+#include "ShaderCompiler.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "../Profiling/Trace.h"
+#include "Shader.h"
+
+#if ENABLE_SHADER_COMPILER
+#include <shaderc/shaderc.h>
+#endif
+
+using namespace std;
+
+namespace shader {
+
+   namespace {
+      // Part of every cache key, so changing how shaders are compiled
+      // leaves the old results behind rather than reusing them
+      const char* CompilerOptionsKey = "vulkan1.1 performance 1";
+
+      struct ShaderStage
+      {
+         const char* extension;
+#if ENABLE_SHADER_COMPILER
+         shaderc_shader_kind kind;
+#endif
+      };
+
+#if ENABLE_SHADER_COMPILER
+      const ShaderStage ShaderStages[] = {
+         { ".vert", shaderc_vertex_shader },
+         { ".frag", shaderc_fragment_shader },
+         { ".comp", shaderc_compute_shader }
+      };
+#else
+      const ShaderStage ShaderStages[] = { { ".vert" }, { ".frag" }, { ".comp" } };
+#endif
+
+      const ShaderStage* FindStage(const string& path)
+      {
+         string extension = filesystem::path(path).extension().string();
+
+         for (const auto& stage : ShaderStages)
+         {
+            if (extension == stage.extension)
+            {
+               return &stage;
+            }
+         }
+
+         return nullptr;
+      }
+
+      bool ReadBytes(const string& path, string& bytes)
+      {
+         ifstream file(path, ios::binary);
+
+         if (!file.is_open())
+         {
+            return false;
+         }
+
+         bytes.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+         return !file.bad();
+      }
+
+      bool ReadSpirv(const string& path, vector<uint32_t>& spirv)
+      {
+         string bytes;
+
+         if (!ReadBytes(path, bytes) || bytes.size() < sizeof(uint32_t) || bytes.size() % sizeof(uint32_t) != 0)
+         {
+            return false;
+         }
+
+         spirv.resize(bytes.size() / sizeof(uint32_t));
+         memcpy(spirv.data(), bytes.data(), bytes.size());
+
+         return spirv[0] == SpirvMagic;
+      }
+
+      // Through a temporary file, so nothing ever maps a half written one
+      bool WriteSpirv(const string& path, const vector<uint32_t>& spirv)
+      {
+         string temporaryPath = path + ".tmp";
+
+         {
+            ofstream file(temporaryPath, ios::binary | ios::trunc);
+            file.write(reinterpret_cast<const char*>(spirv.data()), (streamsize)(spirv.size() * sizeof(uint32_t)));
+
+            if (!file)
+            {
+               return false;
+            }
+         }
+
+         error_code error;
+         filesystem::rename(temporaryPath, path, error);
+
+         return !error;
+      }
+
+      uint64_t HashBytes(uint64_t hash, const char* pData, size_t size)
+      {
+         for (size_t i = 0; i < size; i++)
+         {
+            hash ^= (uint8_t)pData[i];
+            hash *= 0x100000001b3ull;
+         }
+
+         return hash;
+      }
+   }
+
+   bool ShaderCompiler::IsShaderSource(const string& path)
+   {
+      return FindStage(path) != nullptr;
+   }
+
+   string ShaderCompiler::SpirvPath(const string& sourcePath)
+   {
+      filesystem::path path(sourcePath);
+      string name = path.filename().string();
+      transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+
+      return path.replace_filename(name + ".spv").generic_string();
+   }
+
+   void ShaderCompiler::Initialise(const string& cacheDirectory)
+   {
+      _cacheDirectory = cacheDirectory;
+
+      error_code error;
+      filesystem::create_directories(_cacheDirectory, error);
+
+#if ENABLE_SHADER_COMPILER
+      _pCompiler = shaderc_compiler_initialize();
+#endif
+   }
+
+   void ShaderCompiler::Destroy()
+   {
+#if ENABLE_SHADER_COMPILER
+      if (_pCompiler)
+      {
+         shaderc_compiler_release(static_cast<shaderc_compiler_t>(_pCompiler));
+      }
+#endif
+
+      _pCompiler = nullptr;
+   }
+
+   bool ShaderCompiler::Compile(const string& sourcePath, vector<uint32_t>& spirv, string& errors)
+   {
+      TRACE_FUNCTION();
+
+      const ShaderStage* pStage = FindStage(sourcePath);
+
+      if (pStage == nullptr)
+      {
+         errors = sourcePath + " is not a shader stage the compiler knows";
+         return false;
+      }
+
+      string source;
+
+      if (!ReadBytes(sourcePath, source))
+      {
+         errors = "Failed to read " + sourcePath;
+         return false;
+      }
+
+      uint64_t hash = 0xcbf29ce484222325ull;
+      hash = HashBytes(hash, CompilerOptionsKey, strlen(CompilerOptionsKey));
+      hash = HashBytes(hash, pStage->extension, strlen(pStage->extension));
+      hash = HashBytes(hash, source.data(), source.size());
+
+      string cachePath = CachePath(hash);
+
+      if (ReadSpirv(cachePath, spirv))
+      {
+         _cacheHitCount++;
+         return true;
+      }
+
+#if ENABLE_SHADER_COMPILER
+      shaderc_compile_options_t options = shaderc_compile_options_initialize();
+      shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
+      shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+
+      shaderc_compilation_result_t result = shaderc_compile_into_spv(static_cast<shaderc_compiler_t>(_pCompiler),
+         source.data(), source.size(), pStage->kind, sourcePath.c_str(), "main", options);
+
+      bool compiled = shaderc_result_get_compilation_status(result) == shaderc_compilation_status_success;
+
+      if (compiled)
+      {
+         spirv.resize(shaderc_result_get_length(result) / sizeof(uint32_t));
+         memcpy(spirv.data(), shaderc_result_get_bytes(result), spirv.size() * sizeof(uint32_t));
+      }
+      else
+      {
+         errors = shaderc_result_get_error_message(result);
+      }
+
+      shaderc_result_release(result);
+      shaderc_compile_options_release(options);
+
+      if (!compiled)
+      {
+         return false;
+      }
+
+      _compileCount++;
+
+      // Losing the cache only costs a compile next time, so a failed write is not an error
+      WriteSpirv(cachePath, spirv);
+
+      return true;
+#else
+      errors = "Failed to compile " + sourcePath + ", the shader compiler is compiled out of this build";
+      return false;
+#endif
+   }
+
+   bool ShaderCompiler::CompileToFile(const string& sourcePath, vector<uint32_t>& spirv, string& errors)
+   {
+      if (!Compile(sourcePath, spirv, errors))
+      {
+         return false;
+      }
+
+      // Leaves an up to date file alone, so its timestamp only moves when it changes
+      string spirvPath = SpirvPath(sourcePath);
+      vector<uint32_t> existing;
+
+      if (ReadSpirv(spirvPath, existing) && existing == spirv)
+      {
+         return true;
+      }
+
+      if (!WriteSpirv(spirvPath, spirv))
+      {
+         errors = "Failed to write " + spirvPath;
+         return false;
+      }
+
+      return true;
+   }
+
+   string ShaderCompiler::CachePath(uint64_t sourceHash) const
+   {
+      char name[32];
+      snprintf(name, sizeof(name), "%016llx.spv", (unsigned long long)sourceHash);
+
+      return (filesystem::path(_cacheDirectory) / name).generic_string();
+   }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// In process GLSL compilation needs shaderc, which comes with the Vulkan
+// SDK. Build with ENABLE_SHADER_COMPILER=1 and link shaderc_shared to use
+// it; otherwise Compile always fails and the .spv files are used as they are.
+#ifndef ENABLE_SHADER_COMPILER
+#define ENABLE_SHADER_COMPILER 0
+#endif
+
+namespace shader {
+
+   // Compiles GLSL to SPIR-V in process, so shaders build wherever the
+   // renderer does. Results are cached on disk by a hash of the source, so
+   // a shader is only compiled again once its source changes.
+   //
+   // Compile may be called from several threads at once.
+   class ShaderCompiler {
+   public:
+      static constexpr bool IsAvailable() { return ENABLE_SHADER_COMPILER != 0; };
+
+      // Whether the extension names a stage this can compile
+      static bool IsShaderSource(const std::string& path);
+
+      // The source's name lowercased plus .spv, beside the source, which is
+      // where HelloTriangleShaderCompile.bat writes it too
+      static std::string SpirvPath(const std::string& sourcePath);
+
+      void Initialise(const std::string& cacheDirectory);
+      void Destroy();
+
+      // Returns false with the compiler's messages in errors if the source
+      // cannot be read or does not compile
+      bool Compile(const std::string& sourcePath, std::vector<uint32_t>& spirv, std::string& errors);
+
+      // Compiles and writes the result to SpirvPath, so the next run starts
+      // from up to date SPIR-V even without a compiler
+      bool CompileToFile(const std::string& sourcePath, std::vector<uint32_t>& spirv, std::string& errors);
+
+      uint32_t CompileCount() const { return _compileCount; };
+      uint32_t CacheHitCount() const { return _cacheHitCount; };
+
+   private:
+      std::string CachePath(uint64_t sourceHash) const;
+
+      std::string _cacheDirectory;
+      void* _pCompiler = nullptr;      // shaderc_compiler_t, kept out of this header
+
+      std::atomic<uint32_t> _compileCount{ 0 };
+      std::atomic<uint32_t> _cacheHitCount{ 0 };
+   };
+}
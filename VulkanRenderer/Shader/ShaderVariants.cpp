@@ -0,0 +1,92 @@
+#include "ShaderVariants.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace shader {
+
+   void ShaderVariants::Initialise(const string& name, const vector<string>& features)
+   {
+      // One bit short of the key, so the permutation count still fits in it
+      if (features.size() >= MaxVariantFeatures)
+      {
+         throw runtime_error("Failed to create variants of " + name + ", it has too many features");
+      }
+
+      _name = name;
+      _features = features;
+   }
+
+   VariantKey ShaderVariants::Key(const vector<string>& enabledFeatures) const
+   {
+      VariantKey key = 0;
+
+      for (const auto& feature : enabledFeatures)
+      {
+         auto found = find(_features.begin(), _features.end(), feature);
+
+         if (found == _features.end())
+         {
+            throw runtime_error("Failed to find shader feature " + feature + " in " + _name);
+         }
+
+         key |= 1u << (found - _features.begin());
+      }
+
+      return key;
+   }
+
+   vector<VariantKey> ShaderVariants::AllKeys() const
+   {
+      vector<VariantKey> keys(PermutationCount());
+
+      for (VariantKey key = 0; key < keys.size(); key++)
+      {
+         keys[key] = key;
+      }
+
+      return keys;
+   }
+
+   string ShaderVariants::Describe(VariantKey key) const
+   {
+      string description;
+
+      for (uint32_t i = 0; i < _features.size(); i++)
+      {
+         if (key & (1u << i))
+         {
+            description += (description.empty() ? "" : "|") + _features[i];
+         }
+      }
+
+      return description.empty() ? "none" : description;
+   }
+
+   void ShaderVariants::MarkGenerated(VariantKey key)
+   {
+      lock_guard<mutex> lock(_mutex);
+      _generated.insert(key);
+   }
+
+   void ShaderVariants::MarkUsed(VariantKey key)
+   {
+      lock_guard<mutex> lock(_mutex);
+      _used.insert(key);
+   }
+
+   void ShaderVariants::PrintReport(ostream& stream)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      stream << "Shader variants of " << _name << ": " << PermutationCount() << " possible, "
+         << _generated.size() << " generated, " << _used.size() << " used" << endl;
+
+      for (VariantKey key : _generated)
+      {
+         stream << "   0x" << hex << key << dec << " " << Describe(key)
+            << (_used.count(key) != 0 ? "" : " (never used)") << endl;
+      }
+   }
+}
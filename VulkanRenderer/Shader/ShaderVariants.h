@@ -0,0 +1,57 @@
+#pragma once
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../Common/Common.h"
+
+namespace shader {
+
+   // One bit per feature. Bit i sets the bool specialisation constant
+   // declared with constant_id = i, so a shader reads its features as
+   // layout(constant_id = i) const bool Feature = false;
+   typedef uint32_t VariantKey;
+   static const uint32_t MaxVariantFeatures = 32;
+
+   // The permutations of one shader. Every variant is the same SPIR-V,
+   // specialised when its pipeline is compiled, so the driver folds the
+   // feature branches away instead of the GPU taking them at run time.
+   //
+   // Keys are what pipelines and the pipeline cache are matched on, so
+   // features may be added to the end of the list but never reordered.
+   //
+   // Also counts which variants had pipelines generated and which were
+   // drawn with, to show what a prewarm compiled for nothing. Counting is
+   // thread safe.
+   class ShaderVariants {
+   public:
+      void Initialise(const std::string& name, const std::vector<std::string>& features);
+
+      // Throws on a feature the shader does not have
+      VariantKey Key(const std::vector<std::string>& enabledFeatures) const;
+
+      // Every key, from no features to all of them
+      std::vector<VariantKey> AllKeys() const;
+
+      // Feature names joined with '|', or "none"
+      std::string Describe(VariantKey key) const;
+
+      uint32_t FeatureCount() const { return (uint32_t)_features.size(); };
+      uint32_t PermutationCount() const { return 1u << _features.size(); };
+
+      void MarkGenerated(VariantKey key);
+      void MarkUsed(VariantKey key);
+
+      void PrintReport(std::ostream& stream);
+
+   private:
+      std::string _name;
+      std::vector<std::string> _features;
+
+      std::set<VariantKey> _generated;
+      std::set<VariantKey> _used;
+      std::mutex _mutex;
+   };
+}
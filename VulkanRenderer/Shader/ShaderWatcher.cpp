@@ -0,0 +1,137 @@
+#include "ShaderWatcher.h"
+
+#include <iostream>
+
+#include "../Profiling/Trace.h"
+
+using namespace std;
+
+namespace shader {
+
+   ShaderWatcher::~ShaderWatcher()
+   {
+      Stop();
+   }
+
+   void ShaderWatcher::Start(ShaderCompiler& compiler, const string& directory, chrono::milliseconds pollInterval)
+   {
+      Stop();
+
+      _pCompiler = &compiler;
+      _directory = directory;
+      _pollInterval = pollInterval;
+      _stopping = false;
+      _timestamps.clear();
+
+      vector<string> existing;
+      Poll(existing);
+
+      _thread = thread(&ShaderWatcher::Run, this);
+   }
+
+   void ShaderWatcher::Stop()
+   {
+      if (!_thread.joinable())
+      {
+         return;
+      }
+
+      {
+         lock_guard<mutex> lock(_mutex);
+         _stopping = true;
+      }
+
+      _wake.notify_all();
+      _thread.join();
+   }
+
+   vector<CompiledShader> ShaderWatcher::TakeCompiled()
+   {
+      lock_guard<mutex> lock(_mutex);
+      return move(_compiled);
+   }
+
+   void ShaderWatcher::Run()
+   {
+      TRACE_THREAD_NAME("ShaderWatcher");
+
+      while (true)
+      {
+         {
+            unique_lock<mutex> lock(_mutex);
+            _wake.wait_for(lock, _pollInterval, [this] { return _stopping; });
+
+            if (_stopping)
+            {
+               return;
+            }
+         }
+
+         vector<string> changed;
+
+         if (!Poll(changed))
+         {
+            continue;
+         }
+
+         for (const auto& sourcePath : changed)
+         {
+            CompiledShader compiled;
+            compiled.sourcePath = sourcePath;
+            compiled.spirvPath = ShaderCompiler::SpirvPath(sourcePath);
+            string errors;
+
+            if (!_pCompiler->CompileToFile(sourcePath, compiled.code, errors))
+            {
+               cerr << errors << endl;
+               continue;
+            }
+
+            cout << "Recompiled " << sourcePath << endl;
+
+            lock_guard<mutex> lock(_mutex);
+            _compiled.push_back(move(compiled));
+         }
+      }
+   }
+
+   bool ShaderWatcher::Poll(vector<string>& changed)
+   {
+      TRACE_FUNCTION();
+
+      error_code error;
+      filesystem::directory_iterator entries(_directory, error);
+
+      if (error)
+      {
+         return false;
+      }
+
+      for (const auto& entry : entries)
+      {
+         string path = entry.path().generic_string();
+
+         if (!entry.is_regular_file(error) || !ShaderCompiler::IsShaderSource(path))
+         {
+            continue;
+         }
+
+         filesystem::file_time_type timestamp = entry.last_write_time(error);
+
+         if (error)
+         {
+            continue;
+         }
+
+         auto known = _timestamps.find(path);
+
+         if (known == _timestamps.end() || known->second != timestamp)
+         {
+            _timestamps[path] = timestamp;
+            changed.push_back(path);
+         }
+      }
+
+      return !changed.empty();
+   }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ShaderCompiler.h"
+
+namespace shader {
+
+   struct CompiledShader
+   {
+      std::string sourcePath;
+      std::string spirvPath;
+      std::vector<uint32_t> code;
+   };
+
+   // Watches a directory of shader sources from a background thread and
+   // recompiles any whose timestamp changes. The render loop collects the
+   // results between frames, so compiling never holds up a frame. A shader
+   // that fails to compile reports its errors and is left as it was.
+   class ShaderWatcher {
+   public:
+      ~ShaderWatcher();
+
+      // Sources already in the directory are taken as up to date
+      void Start(ShaderCompiler& compiler, const std::string& directory,
+         std::chrono::milliseconds pollInterval = std::chrono::milliseconds(250));
+      void Stop();
+
+      // Everything recompiled since the last call
+      std::vector<CompiledShader> TakeCompiled();
+
+   private:
+      void Run();
+      bool Poll(std::vector<std::string>& changed);
+
+      ShaderCompiler* _pCompiler = nullptr;
+      std::string _directory;
+      std::chrono::milliseconds _pollInterval{ 0 };
+      std::unordered_map<std::string, std::filesystem::file_time_type> _timestamps;
+
+      std::thread _thread;
+      std::mutex _mutex;
+      std::condition_variable _wake;
+      bool _stopping = false;
+      std::vector<CompiledShader> _compiled;
+   };
+}
@@ -1,11 +1,23 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Feature bits of the variant key, specialised when the pipeline is
+// compiled. The ids are the bit numbers and must not be reordered.
+layout(constant_id = 0) const bool Greyscale = false;
+layout(constant_id = 1) const bool VisualiseDepth = false;
+
 layout(location = 0) out vec4 outColour;
 
 layout(location = 0) in vec3 fragColour;
 
 void main()
 {
-	outColour = vec4(fragColour, 1.0);
+	vec3 colour = VisualiseDepth ? vec3(gl_FragCoord.z) : fragColour;
+
+	if (Greyscale)
+	{
+		colour = vec3(dot(colour, vec3(0.2126, 0.7152, 0.0722)));
+	}
+
+	outColour = vec4(colour, 1.0);
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
-glslangValidator.exe -V HelloTriangle.vert
-glslangValidator.exe -V HelloTriangle.frag
+glslangValidator.exe -V HelloTriangle.vert -o hellotriangle.vert.spv
+glslangValidator.exe -V HelloTriangle.frag -o hellotriangle.frag.spv
+glslangValidator.exe -V Mesh.vert -o mesh.vert.spv
+glslangValidator.exe -V Cull.comp -o cull.comp.spv
 pause
\ No newline at end of file
@@ -0,0 +1,61 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+struct Instance
+{
+	vec4 positionScale;
+	uint meshIndex;
+	uint colour;
+	uint padding[2];
+};
+
+struct Mesh
+{
+	uint indexCount;
+	uint firstIndex;
+	int vertexOffset;
+	float radius;
+	vec4 dequantiseOffset;
+	vec4 dequantiseScale;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Instances
+{
+	Instance instances[];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Meshes
+{
+	Mesh meshes[];
+};
+
+layout(std140, set = 0, binding = 4) uniform FrameConstants
+{
+	mat4 viewProjection;
+	vec4 frustumPlanes[6];
+	uint instanceCount;
+	uint compact;
+} constants;
+
+// Quantised, snorm positions within the mesh's bounding box
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inColour;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+layout(location = 0) out vec3 fragColour;
+
+// The cull pass writes each visible instance's index as firstInstance
+void main()
+{
+	Instance instance = instances[gl_InstanceIndex];
+	Mesh mesh = meshes[instance.meshIndex];
+
+	vec3 position = mesh.dequantiseOffset.xyz + inPosition.xyz * mesh.dequantiseScale.xyz;
+	vec3 worldPosition = position * instance.positionScale.w + instance.positionScale.xyz;
+	gl_Position = constants.viewProjection * vec4(worldPosition, 1.0);
+	fragColour = inColour.rgb * unpackUnorm4x8(instance.colour).rgb;
+}
\ No newline at end of file
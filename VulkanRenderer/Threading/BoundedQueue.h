@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace threading {
+
+   // Fixed capacity multi-producer, multi-consumer queue. Each slot carries
+   // a sequence number saying whose turn it is, so producers and consumers
+   // only contend on claiming a position and never take a lock. Pushing
+   // to a full queue fails rather than waiting. Capacity must be a power
+   // of two.
+   //
+   // After Vyukov, "Bounded MPMC queue", 1024cores.net, 2010.
+   template <typename T>
+   class BoundedQueue {
+   public:
+      explicit BoundedQueue(uint32_t capacity)
+         : _cells(new Cell[capacity]), _mask(capacity - 1)
+      {
+         for (uint32_t i = 0; i < capacity; i++)
+         {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+         }
+      }
+
+      BoundedQueue(const BoundedQueue&) = delete;
+      BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+      // Any thread. False when full, leaving the item with the caller.
+      bool TryPush(const T& item)
+      {
+         uint64_t position = _enqueuePosition.load(std::memory_order_relaxed);
+         Cell* pCell;
+
+         while (true)
+         {
+            pCell = &_cells[position & _mask];
+            uint64_t sequence = pCell->sequence.load(std::memory_order_acquire);
+            int64_t difference = (int64_t)sequence - (int64_t)position;
+
+            if (difference == 0)
+            {
+               if (_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+               {
+                  break;
+               }
+            }
+            else if (difference < 0)
+            {
+               // Still holds the item pushed a lap ago
+               return false;
+            }
+            else
+            {
+               // Another producer claimed it first
+               position = _enqueuePosition.load(std::memory_order_relaxed);
+            }
+         }
+
+         pCell->item = item;
+         pCell->sequence.store(position + 1, std::memory_order_release);
+
+         return true;
+      }
+
+      // Any thread, oldest first. False when empty.
+      bool TryPop(T& item)
+      {
+         uint64_t position = _dequeuePosition.load(std::memory_order_relaxed);
+         Cell* pCell;
+
+         while (true)
+         {
+            pCell = &_cells[position & _mask];
+            uint64_t sequence = pCell->sequence.load(std::memory_order_acquire);
+            int64_t difference = (int64_t)sequence - (int64_t)(position + 1);
+
+            if (difference == 0)
+            {
+               if (_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+               {
+                  break;
+               }
+            }
+            else if (difference < 0)
+            {
+               return false;
+            }
+            else
+            {
+               position = _dequeuePosition.load(std::memory_order_relaxed);
+            }
+         }
+
+         item = pCell->item;
+         pCell->sequence.store(position + _mask + 1, std::memory_order_release);
+
+         return true;
+      }
+
+      // Only a hint while other threads are pushing or popping
+      uint32_t ApproximateSize() const
+      {
+         uint64_t enqueued = _enqueuePosition.load(std::memory_order_relaxed);
+         uint64_t dequeued = _dequeuePosition.load(std::memory_order_relaxed);
+         return enqueued > dequeued ? (uint32_t)(enqueued - dequeued) : 0;
+      }
+
+      uint32_t Capacity() const { return (uint32_t)(_mask + 1); }
+
+   private:
+      struct Cell
+      {
+         std::atomic<uint64_t> sequence;
+         T item;
+      };
+
+      std::unique_ptr<Cell[]> _cells;
+      uint64_t _mask;
+
+      // On their own cache lines, since producers hammer one and consumers the other
+      alignas(64) std::atomic<uint64_t> _enqueuePosition{ 0 };
+      alignas(64) std::atomic<uint64_t> _dequeuePosition{ 0 };
+   };
+}
@@ -0,0 +1,386 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <string>
+
+#include "../Profiling/Trace.h"
+
+using namespace std;
+
+namespace threading {
+
+   struct Job
+   {
+      JobSystem::JobFunction function;
+      JobCounter* pCounter;
+   };
+
+   namespace {
+      // Which job system, if any, the current thread runs jobs for
+      thread_local const JobSystem* t_pJobSystem = nullptr;
+      thread_local uint32_t t_threadIndex = 0;
+
+      // Tries before a worker with nothing to do goes to sleep. Frame work
+      // comes in bursts, and yielding a little catches the next burst
+      // without the cost of a wake up.
+      const uint32_t SpinCount = 64;
+   }
+
+   void JobSystem::Initialise(uint32_t threadCount)
+   {
+      if (threadCount == 0)
+      {
+         threadCount = max(thread::hardware_concurrency(), 1u);
+      }
+
+      _stopping = false;
+
+      for (uint32_t i = 0; i < threadCount; i++)
+      {
+         _threadStates.push_back(make_unique<ThreadState>());
+      }
+
+      t_pJobSystem = this;
+      t_threadIndex = 0;
+
+      for (uint32_t i = 1; i < threadCount; i++)
+      {
+         _threads.emplace_back(&JobSystem::WorkerMain, this, i);
+      }
+   }
+
+   void JobSystem::Destroy()
+   {
+      if (_threadStates.empty())
+      {
+         return;
+      }
+
+      {
+         lock_guard<mutex> lock(_sleepMutex);
+         _stopping = true;
+         _wakeGeneration++;
+      }
+
+      _wake.notify_all();
+
+      for (auto& thread : _threads)
+      {
+         thread.join();
+      }
+
+      _threads.clear();
+
+      // Whatever is left was never waited on. It may capture state that is
+      // gone by now, so it is dropped rather than run.
+      for (uint32_t i = 0; i < _threadStates.size(); i++)
+      {
+         while (Job* pJob = _threadStates[i]->deque.Steal())
+         {
+            delete pJob;
+         }
+      }
+
+      for (Job* pJob : _injected)
+      {
+         delete pJob;
+      }
+
+      _injected.clear();
+      _injectedCount = 0;
+      _threadStates.clear();
+
+      if (t_pJobSystem == this)
+      {
+         t_pJobSystem = nullptr;
+      }
+   }
+
+   uint32_t JobSystem::ThreadIndex() const
+   {
+      return t_pJobSystem == this ? t_threadIndex : InvalidThread;
+   }
+
+   void JobSystem::Run(JobFunction job, JobCounter* pCounter)
+   {
+      if (pCounter)
+      {
+         pCounter->_pending.fetch_add(1, memory_order_relaxed);
+      }
+
+      Schedule(new Job{ move(job), pCounter });
+   }
+
+   void JobSystem::Run(JobFunction job, JobCounter& dependency, JobCounter* pCounter)
+   {
+      if (pCounter)
+      {
+         pCounter->_pending.fetch_add(1, memory_order_relaxed);
+      }
+
+      Job* pJob = new Job{ move(job), pCounter };
+
+      {
+         // The count only reaches zero under this lock, so the job is
+         // either held here before then or scheduled now
+         lock_guard<mutex> lock(dependency._mutex);
+
+         if (!dependency.IsDone())
+         {
+            dependency._heldJobs.push_back(pJob);
+            return;
+         }
+      }
+
+      Schedule(pJob);
+   }
+
+   void JobSystem::ParallelFor(uint32_t count, uint32_t grainSize, RangeFunction body, JobCounter& counter)
+   {
+      grainSize = max(grainSize, 1u);
+
+      // Shared, so the jobs copy a pointer rather than the function
+      auto pBody = make_shared<RangeFunction>(move(body));
+
+      for (uint32_t first = 0; first < count; first += grainSize)
+      {
+         uint32_t rangeCount = min(grainSize, count - first);
+         Run([pBody, first, rangeCount] { (*pBody)(first, rangeCount); }, &counter);
+      }
+   }
+
+   void JobSystem::Wait(JobCounter& counter)
+   {
+      TRACE_FUNCTION();
+
+      uint32_t threadIndex = ThreadIndex();
+
+      while (!counter.IsDone())
+      {
+         // Only job threads may run jobs, since a job can rely on its
+         // thread index being unique
+         Job* pJob = threadIndex != InvalidThread ? FindJob(threadIndex) : nullptr;
+
+         if (pJob)
+         {
+            Execute(pJob, threadIndex);
+         }
+         else
+         {
+            this_thread::yield();
+         }
+      }
+
+      lock_guard<mutex> lock(counter._mutex);
+
+      if (counter._exception)
+      {
+         exception_ptr exception = counter._exception;
+         counter._exception = nullptr;
+         rethrow_exception(exception);
+      }
+   }
+
+   JobSystem::Statistics JobSystem::GetStatistics() const
+   {
+      Statistics statistics;
+
+      for (const auto& state : _threadStates)
+      {
+         statistics.jobsRun += state->jobsRun.load(memory_order_relaxed);
+         statistics.jobsStolen += state->jobsStolen.load(memory_order_relaxed);
+      }
+
+      return statistics;
+   }
+
+   void JobSystem::WorkerMain(uint32_t threadIndex)
+   {
+      TRACE_THREAD_NAME("Job " + to_string(threadIndex));
+
+      t_pJobSystem = this;
+      t_threadIndex = threadIndex;
+
+      while (!_stopping.load(memory_order_relaxed))
+      {
+         Job* pJob = FindJob(threadIndex);
+
+         for (uint32_t spin = 0; pJob == nullptr && spin < SpinCount; spin++)
+         {
+            this_thread::yield();
+            pJob = FindJob(threadIndex);
+         }
+
+         if (pJob == nullptr)
+         {
+            unique_lock<mutex> lock(_sleepMutex);
+            _sleepingCount.fetch_add(1);
+
+            // Checked again after saying it is asleep, so a job scheduled
+            // in between either is found here or sees it sleeping and wakes it
+            pJob = FindJob(threadIndex);
+
+            // Stopping is checked under the lock too, or a worker that read
+            // it just before Destroy set it would sleep through the only wake
+            if (pJob == nullptr && !_stopping.load(memory_order_relaxed))
+            {
+               uint64_t generation = _wakeGeneration;
+               _wake.wait(lock, [&] { return _wakeGeneration != generation; });
+            }
+
+            _sleepingCount.fetch_sub(1);
+         }
+
+         if (pJob)
+         {
+            Execute(pJob, threadIndex);
+         }
+      }
+
+      t_pJobSystem = nullptr;
+   }
+
+   void JobSystem::Schedule(Job* pJob)
+   {
+      uint32_t threadIndex = ThreadIndex();
+
+      if (threadIndex == InvalidThread)
+      {
+         lock_guard<mutex> lock(_injectedMutex);
+         _injected.push_back(pJob);
+         _injectedCount.fetch_add(1);
+      }
+      else if (!_threadStates[threadIndex]->deque.Push(pJob))
+      {
+         // A full deque means there is a backlog anyway, so running the job
+         // now costs nothing in parallelism
+         Execute(pJob, threadIndex);
+         return;
+      }
+
+      WakeWorker();
+   }
+
+   Job* JobSystem::FindJob(uint32_t threadIndex)
+   {
+      ThreadState& state = *_threadStates[threadIndex];
+
+      if (Job* pJob = state.deque.Pop())
+      {
+         return pJob;
+      }
+
+      if (_injectedCount.load() > 0)
+      {
+         lock_guard<mutex> lock(_injectedMutex);
+
+         if (!_injected.empty())
+         {
+            Job* pJob = _injected.front();
+            _injected.pop_front();
+            _injectedCount.fetch_sub(1);
+            return pJob;
+         }
+      }
+
+      // Starting after our own index spreads thieves across the victims
+      uint32_t threadCount = ThreadCount();
+
+      for (uint32_t i = 1; i < threadCount; i++)
+      {
+         if (Job* pJob = _threadStates[(threadIndex + i) % threadCount]->deque.Steal())
+         {
+            state.jobsStolen.fetch_add(1, memory_order_relaxed);
+            return pJob;
+         }
+      }
+
+      return nullptr;
+   }
+
+   void JobSystem::Execute(Job* pJob, uint32_t threadIndex)
+   {
+      try
+      {
+         pJob->function();
+      }
+      catch (...)
+      {
+         if (pJob->pCounter)
+         {
+            lock_guard<mutex> lock(pJob->pCounter->_mutex);
+
+            if (!pJob->pCounter->_exception)
+            {
+               pJob->pCounter->_exception = current_exception();
+            }
+         }
+      }
+
+      JobCounter* pCounter = pJob->pCounter;
+      delete pJob;
+
+      _threadStates[threadIndex]->jobsRun.fetch_add(1, memory_order_relaxed);
+      Finish(pCounter);
+   }
+
+   void JobSystem::Finish(JobCounter* pCounter)
+   {
+      if (pCounter == nullptr)
+      {
+         return;
+      }
+
+      // Counting down is lock-free until the last job, so jobs sharing a
+      // counter do not contend on it
+      uint32_t pending = pCounter->_pending.load(memory_order_relaxed);
+
+      while (pending > 1)
+      {
+         if (pCounter->_pending.compare_exchange_weak(pending, pending - 1, memory_order_acq_rel, memory_order_relaxed))
+         {
+            return;
+         }
+      }
+
+      // Reaching zero happens under the lock. Wait takes the same lock
+      // before returning, so the counter cannot be destroyed under us,
+      // and a job held on the counter is either released here or never held.
+      vector<Job*> released;
+
+      {
+         lock_guard<mutex> lock(pCounter->_mutex);
+
+         if (pCounter->_pending.fetch_sub(1, memory_order_acq_rel) != 1)
+         {
+            return;
+         }
+
+         released.swap(pCounter->_heldJobs);
+      }
+
+      for (Job* pJob : released)
+      {
+         Schedule(pJob);
+      }
+   }
+
+   void JobSystem::WakeWorker()
+   {
+      // Pairs with the sleeping worker's count then check, so one side
+      // always sees the other
+      atomic_thread_fence(memory_order_seq_cst);
+
+      if (_sleepingCount.load() == 0)
+      {
+         return;
+      }
+
+      {
+         lock_guard<mutex> lock(_sleepMutex);
+         _wakeGeneration++;
+      }
+
+      _wake.notify_one();
+   }
+}
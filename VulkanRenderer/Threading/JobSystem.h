@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "WorkStealingDeque.h"
+
+namespace threading {
+
+   struct Job;
+
+   // Jobs run with a counter add one to it and take it off again when they
+   // finish, so waiting on the counter waits on all of them. A job may
+   // instead be held back until a counter reaches zero, which is how
+   // dependencies are expressed.
+   //
+   // A counter can be reused once it has been waited on.
+   class JobCounter {
+   public:
+      JobCounter() = default;
+      JobCounter(const JobCounter&) = delete;
+      JobCounter& operator=(const JobCounter&) = delete;
+
+      bool IsDone() const { return _pending.load(std::memory_order_acquire) == 0; };
+
+   private:
+      friend class JobSystem;
+
+      std::atomic<uint32_t> _pending{ 0 };
+
+      // Guards handing over held jobs as the count reaches zero
+      std::mutex _mutex;
+      std::vector<Job*> _heldJobs;
+      std::exception_ptr _exception;
+   };
+
+   // Work-stealing scheduler with one thread per core. The thread that
+   // calls Initialise is thread 0 and runs jobs whenever it waits, so with
+   // one thread everything runs inline.
+   //
+   // Every job thread has its own lock-free deque. Jobs a thread starts go
+   // on its own deque, and a thread with nothing left steals the oldest
+   // job from another's, so work spreads without any shared queue. Jobs
+   // started from other threads, such as a background loader, go through
+   // a locked queue instead.
+   //
+   // Long jobs are fine as long as nothing needs their result this frame:
+   // check IsDone on their counter rather than waiting on it.
+   class JobSystem {
+   public:
+      typedef std::function<void()> JobFunction;
+
+      // For ParallelFor, a contiguous range of indices
+      typedef std::function<void(uint32_t first, uint32_t count)> RangeFunction;
+
+      struct Statistics
+      {
+         uint64_t jobsRun = 0;
+         uint64_t jobsStolen = 0;
+      };
+
+      ~JobSystem() { Destroy(); };
+
+      // 0 uses one thread per hardware thread, including the caller
+      void Initialise(uint32_t threadCount = 0);
+      void Destroy();
+
+      uint32_t ThreadCount() const { return (uint32_t)_threadStates.size(); };
+
+      // Index of the calling job thread, from 0 to ThreadCount() - 1. Each
+      // index is only ever in use on one thread, so it can select per
+      // thread state such as command pools.
+      uint32_t ThreadIndex() const;
+
+      void Run(JobFunction job, JobCounter* pCounter = nullptr);
+
+      // Held until dependency reaches zero
+      void Run(JobFunction job, JobCounter& dependency, JobCounter* pCounter);
+
+      // Splits count indices into jobs of up to grainSize each
+      void ParallelFor(uint32_t count, uint32_t grainSize, RangeFunction body, JobCounter& counter);
+
+      // Runs other jobs until the counter reaches zero. The first exception
+      // a counted job threw is rethrown here.
+      void Wait(JobCounter& counter);
+
+      Statistics GetStatistics() const;
+
+   private:
+      static const uint32_t DequeCapacity = 4096;
+      static const uint32_t InvalidThread = UINT32_MAX;
+
+      // Only ever written by its own thread
+      struct ThreadState
+      {
+         ThreadState() : deque(DequeCapacity) {}
+
+         WorkStealingDeque<Job> deque;
+         std::atomic<uint64_t> jobsRun{ 0 };
+         std::atomic<uint64_t> jobsStolen{ 0 };
+      };
+
+      void WorkerMain(uint32_t threadIndex);
+      void Schedule(Job* pJob);
+      Job* FindJob(uint32_t threadIndex);
+      void Execute(Job* pJob, uint32_t threadIndex);
+      void Finish(JobCounter* pCounter);
+      void WakeWorker();
+
+      std::vector<std::unique_ptr<ThreadState>> _threadStates;
+      std::vector<std::thread> _threads;
+
+      std::mutex _injectedMutex;
+      std::deque<Job*> _injected;
+      std::atomic<uint32_t> _injectedCount{ 0 };
+
+      // Idle workers sleep here rather than spin
+      std::mutex _sleepMutex;
+      std::condition_variable _wake;
+      std::atomic<uint32_t> _sleepingCount{ 0 };
+      uint64_t _wakeGeneration = 0;
+      std::atomic<bool> _stopping{ false };
+   };
+}
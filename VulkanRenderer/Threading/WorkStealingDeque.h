@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace threading {
+
+   // Fixed capacity Chase-Lev deque. The owning thread pushes and pops at
+   // the bottom, so its newest work is still warm in its cache, and any
+   // other thread may steal the oldest from the top. Neither end takes a
+   // lock. Capacity must be a power of two.
+   //
+   // After Le, Pop, Cohen and Zappa Nardelli, "Correct and Efficient
+   // Work-Stealing for Weak Memory Models", 2013.
+   template <typename T>
+   class WorkStealingDeque {
+   public:
+      explicit WorkStealingDeque(uint32_t capacity)
+         : _items(new std::atomic<T*>[capacity]), _mask(capacity - 1)
+      {
+      }
+
+      WorkStealingDeque(const WorkStealingDeque&) = delete;
+      WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+      // Owner only. False when full, leaving the item with the caller.
+      bool Push(T* pItem)
+      {
+         int64_t bottom = _bottom.load(std::memory_order_relaxed);
+         int64_t top = _top.load(std::memory_order_acquire);
+
+         if (bottom - top > (int64_t)_mask)
+         {
+            return false;
+         }
+
+         _items[bottom & _mask].store(pItem, std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_release);
+         _bottom.store(bottom + 1, std::memory_order_relaxed);
+
+         return true;
+      }
+
+      // Owner only, newest first
+      T* Pop()
+      {
+         int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+         _bottom.store(bottom, std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         int64_t top = _top.load(std::memory_order_relaxed);
+
+         if (top > bottom)
+         {
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+         }
+
+         T* pItem = _items[bottom & _mask].load(std::memory_order_relaxed);
+
+         // The last item may be being stolen at the same time, and only
+         // one side can win it
+         if (top == bottom)
+         {
+            if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+               pItem = nullptr;
+            }
+
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+         }
+
+         return pItem;
+      }
+
+      // Any thread, oldest first. Null when empty or another thief won.
+      T* Steal()
+      {
+         int64_t top = _top.load(std::memory_order_acquire);
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         int64_t bottom = _bottom.load(std::memory_order_acquire);
+
+         if (top >= bottom)
+         {
+            return nullptr;
+         }
+
+         T* pItem = _items[top & _mask].load(std::memory_order_relaxed);
+
+         if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+         {
+            return nullptr;
+         }
+
+         return pItem;
+      }
+
+      bool IsEmpty() const
+      {
+         return _top.load(std::memory_order_acquire) >= _bottom.load(std::memory_order_acquire);
+      }
+
+   private:
+      std::unique_ptr<std::atomic<T*>[]> _items;
+      int64_t _mask;
+
+      // On their own cache lines, since thieves hammer one and the owner the other
+      alignas(64) std::atomic<int64_t> _top{ 0 };
+      alignas(64) std::atomic<int64_t> _bottom{ 0 };
+   };
+}
@@ -0,0 +1,470 @@
+#include "UploadEngine.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "../Profiling/Trace.h"
+
+using namespace std;
+using namespace memory;
+
+namespace transfer {
+
+   namespace {
+      // Satisfies the copy offset rules for every texel format we upload
+      const VkDeviceSize StagingAlignment = 16;
+
+      VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+      {
+         return (value + alignment - 1) & ~(alignment - 1);
+      }
+   }
+
+   void UploadEngine::Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, DeviceAllocator& allocator, VkQueue transferQueue,
+      uint32_t transferFamily, uint32_t graphicsFamily, VkDeviceSize ringSize)
+   {
+      _device = device;
+      _pAllocationCallbacks = pAllocationCallbacks;
+      _pAllocator = &allocator;
+      _transferQueue = transferQueue;
+      _transferFamily = transferFamily;
+      _graphicsFamily = graphicsFamily;
+      _ringSize = ringSize;
+      _ringHead = 0;
+      _ringTail = 0;
+
+      VkCommandPoolCreateInfo poolInfo = {};
+      poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+      poolInfo.queueFamilyIndex = transferFamily;
+
+      if (vkCreateCommandPool(_device, &poolInfo, _pAllocationCallbacks, &_commandPool) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to create upload command pool");
+      }
+
+      VkBufferCreateInfo bufferInfo = {};
+      bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      bufferInfo.size = ringSize;
+      bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+      bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+      _pAllocator->CreateBuffer(bufferInfo, MemoryUsage::CpuToGpu, _ringBuffer, _ringAllocation);
+
+      if (_ringAllocation.pMapped == nullptr)
+      {
+         throw runtime_error("Upload staging ring is not host visible");
+      }
+   }
+
+   void UploadEngine::Destroy()
+   {
+      // The caller has already waited for the device to go idle
+      for (auto& batch : _batches)
+      {
+         vkDestroySemaphore(_device, batch->semaphore, _pAllocationCallbacks);
+         vkDestroyFence(_device, batch->fence, _pAllocationCallbacks);
+      }
+
+      _batches.clear();
+      _freeBatches.clear();
+      _submitted.clear();
+      _completed.clear();
+      _acquired.clear();
+      _pRecording = nullptr;
+
+      vkDestroyCommandPool(_device, _commandPool, _pAllocationCallbacks);
+      _pAllocator->DestroyBuffer(_ringBuffer, _ringAllocation);
+   }
+
+   UploadTicket UploadEngine::UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* pData, VkDeviceSize size,
+      VkAccessFlags dstAccess, VkPipelineStageFlags dstStage)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      // Large buffers go through in chunks, so they can stream through a
+      // ring much smaller than themselves
+      const VkDeviceSize chunkSize = _ringSize / 4;
+      const char* pSource = static_cast<const char*>(pData);
+      UploadTicket ticket = 0;
+
+      for (VkDeviceSize copied = 0; copied < size; copied += chunkSize)
+      {
+         VkDeviceSize copySize = min(chunkSize, size - copied);
+         VkDeviceSize stagingOffset = AllocateStaging(copySize);
+         memcpy(static_cast<char*>(_ringAllocation.pMapped) + stagingOffset, pSource + copied, (size_t)copySize);
+
+         UploadBatch& batch = RecordingBatch();
+
+         VkBufferCopy region = {};
+         region.srcOffset = stagingOffset;
+         region.dstOffset = offset + copied;
+         region.size = copySize;
+         vkCmdCopyBuffer(batch.commandBuffer, _ringBuffer, buffer, 1, &region);
+
+         VkBufferMemoryBarrier release = {};
+         release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+         release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+         release.dstAccessMask = dstAccess;
+         release.srcQueueFamilyIndex = HasOwnershipTransfer() ? _transferFamily : VK_QUEUE_FAMILY_IGNORED;
+         release.dstQueueFamilyIndex = HasOwnershipTransfer() ? _graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+         release.buffer = buffer;
+         release.offset = offset + copied;
+         release.size = copySize;
+
+         batch.bufferReleases.push_back(release);
+         batch.dstStages |= dstStage;
+         ticket = batch.ticket;
+      }
+
+      return ticket;
+   }
+
+   UploadTicket UploadEngine::UploadImage(VkImage image, VkExtent3D extent, const void* pData, VkDeviceSize size,
+      VkImageLayout finalLayout, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      VkDeviceSize stagingOffset = AllocateStaging(size);
+      memcpy(static_cast<char*>(_ringAllocation.pMapped) + stagingOffset, pData, (size_t)size);
+
+      UploadBatch& batch = RecordingBatch();
+
+      VkImageSubresourceRange range = {};
+      range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      range.levelCount = 1;
+      range.layerCount = 1;
+
+      // Previous contents are discarded, so no ownership is needed for this
+      VkImageMemoryBarrier toTransfer = {};
+      toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      toTransfer.srcAccessMask = 0;
+      toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      toTransfer.image = image;
+      toTransfer.subresourceRange = range;
+
+      vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+         0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+      VkBufferImageCopy region = {};
+      region.bufferOffset = stagingOffset;
+      region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region.imageSubresource.layerCount = 1;
+      region.imageExtent = extent;
+      vkCmdCopyBufferToImage(batch.commandBuffer, _ringBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+      // The release and acquire must describe the same layout transition
+      VkImageMemoryBarrier release = {};
+      release.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      release.dstAccessMask = dstAccess;
+      release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      release.newLayout = finalLayout;
+      release.srcQueueFamilyIndex = HasOwnershipTransfer() ? _transferFamily : VK_QUEUE_FAMILY_IGNORED;
+      release.dstQueueFamilyIndex = HasOwnershipTransfer() ? _graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+      release.image = image;
+      release.subresourceRange = range;
+
+      batch.imageReleases.push_back(release);
+      batch.dstStages |= dstStage;
+
+      return batch.ticket;
+   }
+
+   void UploadEngine::Flush()
+   {
+      TRACE_FUNCTION();
+
+      lock_guard<mutex> lock(_mutex);
+      SubmitBatch();
+   }
+
+   bool UploadEngine::IsComplete(UploadTicket ticket)
+   {
+      lock_guard<mutex> lock(_mutex);
+      RetireTransfers(false);
+      return ticket <= _completedTicket;
+   }
+
+   void UploadEngine::AcquireCompleted(VkCommandBuffer commandBuffer, uint32_t frameSlot,
+      vector<VkSemaphore>& waitSemaphores, vector<VkPipelineStageFlags>& waitStages)
+   {
+      lock_guard<mutex> lock(_mutex);
+      RetireTransfers(false);
+
+      if (_completed.empty())
+      {
+         return;
+      }
+
+      vector<VkBufferMemoryBarrier> bufferAcquires;
+      vector<VkImageMemoryBarrier> imageAcquires;
+      VkPipelineStageFlags dstStages = 0;
+
+      for (UploadBatch* pBatch : _completed)
+      {
+         // Matching halves of the releases recorded on the transfer queue.
+         // Without a family change the release already made the data visible.
+         if (HasOwnershipTransfer())
+         {
+            for (VkBufferMemoryBarrier barrier : pBatch->bufferReleases)
+            {
+               barrier.srcAccessMask = 0;
+               bufferAcquires.push_back(barrier);
+            }
+
+            for (VkImageMemoryBarrier barrier : pBatch->imageReleases)
+            {
+               barrier.srcAccessMask = 0;
+               imageAcquires.push_back(barrier);
+            }
+         }
+
+         // Already signalled, so waiting on it costs the graphics queue nothing
+         waitSemaphores.push_back(pBatch->semaphore);
+         waitStages.push_back(pBatch->dstStages);
+         dstStages |= pBatch->dstStages;
+
+         pBatch->frameSlot = frameSlot;
+         _acquired.push_back(pBatch);
+      }
+
+      _completed.clear();
+
+      if (!bufferAcquires.empty() || !imageAcquires.empty())
+      {
+         vkCmdPipelineBarrier(commandBuffer, dstStages, dstStages, 0, 0, nullptr,
+            (uint32_t)bufferAcquires.size(), bufferAcquires.data(),
+            (uint32_t)imageAcquires.size(), imageAcquires.data());
+      }
+   }
+
+   void UploadEngine::RetireFrame(uint32_t frameSlot)
+   {
+      lock_guard<mutex> lock(_mutex);
+
+      for (size_t i = 0; i < _acquired.size();)
+      {
+         if (_acquired[i]->frameSlot == frameSlot)
+         {
+            _freeBatches.push_back(_acquired[i]);
+            _acquired[i] = _acquired.back();
+            _acquired.pop_back();
+         }
+         else
+         {
+            i++;
+         }
+      }
+   }
+
+   UploadEngine::UploadBatch& UploadEngine::RecordingBatch()
+   {
+      if (_pRecording)
+      {
+         return *_pRecording;
+      }
+
+      UploadBatch* pBatch;
+
+      if (!_freeBatches.empty())
+      {
+         pBatch = _freeBatches.back();
+         _freeBatches.pop_back();
+
+         vkResetCommandBuffer(pBatch->commandBuffer, 0);
+         vkResetFences(_device, 1, &pBatch->fence);
+         pBatch->bufferReleases.clear();
+         pBatch->imageReleases.clear();
+         pBatch->dstStages = 0;
+         pBatch->frameSlot = UINT32_MAX;
+      }
+      else
+      {
+         _batches.push_back(make_unique<UploadBatch>());
+         pBatch = _batches.back().get();
+
+         VkCommandBufferAllocateInfo allocateInfo = {};
+         allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+         allocateInfo.commandPool = _commandPool;
+         allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+         allocateInfo.commandBufferCount = 1;
+
+         VkFenceCreateInfo fenceInfo = {};
+         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+         VkSemaphoreCreateInfo semaphoreInfo = {};
+         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+         if (vkAllocateCommandBuffers(_device, &allocateInfo, &pBatch->commandBuffer) != VK_SUCCESS ||
+            vkCreateFence(_device, &fenceInfo, _pAllocationCallbacks, &pBatch->fence) != VK_SUCCESS ||
+            vkCreateSemaphore(_device, &semaphoreInfo, _pAllocationCallbacks, &pBatch->semaphore) != VK_SUCCESS)
+         {
+            throw runtime_error("Failed to create upload batch");
+         }
+      }
+
+      VkCommandBufferBeginInfo beginInfo = {};
+      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+      if (vkBeginCommandBuffer(pBatch->commandBuffer, &beginInfo) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to begin recording upload command buffer");
+      }
+
+      pBatch->ticket = _nextTicket++;
+      _pRecording = pBatch;
+
+      return *pBatch;
+   }
+
+   VkDeviceSize UploadEngine::AllocateStaging(VkDeviceSize size)
+   {
+      VkDeviceSize offset;
+
+      // Out of room: submit what is pending so it can retire, then wait on
+      // the oldest transfer to free its part of the ring
+      while (!TryAllocateRing(size, offset))
+      {
+         if (_pRecording)
+         {
+            SubmitBatch();
+         }
+         else if (!_submitted.empty())
+         {
+            RetireTransfers(true);
+         }
+         else
+         {
+            throw runtime_error("Upload does not fit in the staging ring");
+         }
+      }
+
+      return offset;
+   }
+
+   bool UploadEngine::TryAllocateRing(VkDeviceSize size, VkDeviceSize& offset)
+   {
+      bool empty = _pRecording == nullptr && _submitted.empty();
+
+      if (empty)
+      {
+         _ringHead = 0;
+         _ringTail = 0;
+      }
+
+      VkDeviceSize head = AlignUp(_ringHead, StagingAlignment);
+
+      if (empty || _ringHead > _ringTail)
+      {
+         // Free space runs from the head to the end, then from the start
+         // up to the tail
+         if (head + size <= _ringSize)
+         {
+            offset = head;
+         }
+         else if (!empty && size <= _ringTail)
+         {
+            offset = 0;
+         }
+         else
+         {
+            return false;
+         }
+      }
+      else if (_ringHead < _ringTail && head + size <= _ringTail)
+      {
+         offset = head;
+      }
+      else
+      {
+         // Not enough room before the tail, or the head has caught up with it
+         return false;
+      }
+
+      _ringHead = offset + size;
+      return true;
+   }
+
+   void UploadEngine::SubmitBatch()
+   {
+      if (!_pRecording)
+      {
+         return;
+      }
+
+      UploadBatch& batch = *_pRecording;
+
+      // With an ownership transfer only the source half of the release
+      // executes here; the graphics queue's acquire covers the rest
+      VkPipelineStageFlags dstStage = HasOwnershipTransfer() ? (VkPipelineStageFlags)VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : batch.dstStages;
+
+      // The stored barriers keep their access masks for the acquire
+      vector<VkBufferMemoryBarrier> bufferReleases = batch.bufferReleases;
+      vector<VkImageMemoryBarrier> imageReleases = batch.imageReleases;
+
+      if (HasOwnershipTransfer())
+      {
+         for (auto& barrier : bufferReleases)
+         {
+            barrier.dstAccessMask = 0;
+         }
+
+         for (auto& barrier : imageReleases)
+         {
+            barrier.dstAccessMask = 0;
+         }
+      }
+
+      vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr,
+         (uint32_t)bufferReleases.size(), bufferReleases.data(),
+         (uint32_t)imageReleases.size(), imageReleases.data());
+
+      if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to record upload command buffer");
+      }
+
+      VkSubmitInfo submitInfo = {};
+      submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      submitInfo.commandBufferCount = 1;
+      submitInfo.pCommandBuffers = &batch.commandBuffer;
+      submitInfo.signalSemaphoreCount = 1;
+      submitInfo.pSignalSemaphores = &batch.semaphore;
+
+      if (vkQueueSubmit(_transferQueue, 1, &submitInfo, batch.fence) != VK_SUCCESS)
+      {
+         throw runtime_error("Failed to submit upload command buffer");
+      }
+
+      batch.ringEnd = _ringHead;
+      _submitted.push_back(_pRecording);
+      _pRecording = nullptr;
+   }
+
+   void UploadEngine::RetireTransfers(bool wait)
+   {
+      // A queue completes its submissions in order, so only the oldest
+      // batch ever needs checking
+      if (wait && !_submitted.empty())
+      {
+         vkWaitForFences(_device, 1, &_submitted.front()->fence, VK_TRUE, UINT64_MAX);
+      }
+
+      while (!_submitted.empty() && vkGetFenceStatus(_device, _submitted.front()->fence) == VK_SUCCESS)
+      {
+         UploadBatch* pBatch = _submitted.front();
+         _submitted.pop_front();
+
+         _ringTail = pBatch->ringEnd;
+         _completedTicket = pBatch->ticket;
+         _completed.push_back(pBatch);
+      }
+   }
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../Common/Common.h"
+#include "../Memory/DeviceAllocator.h"
+
+namespace transfer {
+
+   typedef uint64_t UploadTicket;
+
+   // Streams data to device local resources through a persistently mapped
+   // staging ring, recording the copies on the transfer queue so large
+   // uploads run alongside rendering rather than in front of it.
+   //
+   // When the transfer queue belongs to a different family than graphics,
+   // every upload is released by the transfer queue and acquired by the
+   // graphics queue. A frame only acquires batches whose copies have already
+   // finished, so the graphics queue never sits waiting on the transfer
+   // queue.
+   //
+   // Uploads may be issued from any thread. Without a dedicated transfer
+   // family the engine submits to the graphics queue, so uploads must then
+   // come from the thread that submits frames.
+   class UploadEngine {
+   public:
+      static constexpr VkDeviceSize DefaultRingSize = 32ull * 1024 * 1024;
+
+      void Initialise(const VkDevice& device, const VkAllocationCallbacks* pAllocationCallbacks, memory::DeviceAllocator& allocator, VkQueue transferQueue,
+         uint32_t transferFamily, uint32_t graphicsFamily, VkDeviceSize ringSize = DefaultRingSize);
+      void Destroy();
+
+      // dstAccess and dstStage describe the first use on the graphics queue
+      UploadTicket UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* pData, VkDeviceSize size,
+         VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+      UploadTicket UploadImage(VkImage image, VkExtent3D extent, const void* pData, VkDeviceSize size,
+         VkImageLayout finalLayout, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+
+      // Submits everything recorded so far to the transfer queue
+      void Flush();
+
+      // True once the copies have finished on the transfer queue. The data
+      // is visible to graphics from the next frame that acquires it.
+      bool IsComplete(UploadTicket ticket);
+
+      // Records acquire barriers for every finished batch into a graphics
+      // command buffer and adds the batch semaphores the submit has to wait on
+      void AcquireCompleted(VkCommandBuffer commandBuffer, uint32_t frameSlot,
+         std::vector<VkSemaphore>& waitSemaphores, std::vector<VkPipelineStageFlags>& waitStages);
+
+      // Called once the frame in frameSlot has finished on the GPU, so the
+      // batches it acquired can be reused
+      void RetireFrame(uint32_t frameSlot);
+
+      bool HasOwnershipTransfer() { return _transferFamily != _graphicsFamily; };
+
+   private:
+      struct UploadBatch
+      {
+         UploadTicket ticket = 0;
+         VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+         VkFence fence = VK_NULL_HANDLE;
+         VkSemaphore semaphore = VK_NULL_HANDLE;
+
+         std::vector<VkBufferMemoryBarrier> bufferReleases;
+         std::vector<VkImageMemoryBarrier> imageReleases;
+         VkPipelineStageFlags dstStages = 0;
+
+         VkDeviceSize ringEnd = 0;
+         uint32_t frameSlot = UINT32_MAX;
+      };
+
+      UploadBatch& RecordingBatch();
+      VkDeviceSize AllocateStaging(VkDeviceSize size);
+      bool TryAllocateRing(VkDeviceSize size, VkDeviceSize& offset);
+      void SubmitBatch();
+      void RetireTransfers(bool wait);
+
+      VkDevice _device = VK_NULL_HANDLE;
+      const VkAllocationCallbacks* _pAllocationCallbacks = nullptr;
+      memory::DeviceAllocator* _pAllocator = nullptr;
+      VkQueue _transferQueue = VK_NULL_HANDLE;
+      uint32_t _transferFamily = 0;
+      uint32_t _graphicsFamily = 0;
+
+      VkCommandPool _commandPool = VK_NULL_HANDLE;
+
+      // Staging ring, in use from _ringTail up to _ringHead, wrapping at _ringSize
+      VkBuffer _ringBuffer = VK_NULL_HANDLE;
+      memory::Allocation _ringAllocation;
+      VkDeviceSize _ringSize = 0;
+      VkDeviceSize _ringHead = 0;
+      VkDeviceSize _ringTail = 0;
+
+      // Batches move from recording, to submitted, to completed once the
+      // transfer queue is done with them, to acquired once a frame has
+      // taken ownership, and back to free when that frame retires
+      std::vector<std::unique_ptr<UploadBatch>> _batches;
+      std::vector<UploadBatch*> _freeBatches;
+      UploadBatch* _pRecording = nullptr;
+      std::deque<UploadBatch*> _submitted;
+      std::vector<UploadBatch*> _completed;
+      std::vector<UploadBatch*> _acquired;
+
+      UploadTicket _nextTicket = 1;
+      UploadTicket _completedTicket = 0;
+
+      std::mutex _mutex;
+   };
+}
@@ -0,0 +1,343 @@
+#include "ValidationSink.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "../Profiling/Trace.h"
+
+using namespace std;
+
+namespace validation {
+
+   namespace {
+      // How long the background thread sleeps when the queue is quiet.
+      // Pushes wake it early once the queue is a quarter full.
+      const chrono::milliseconds PollInterval(20);
+
+      // Each message ID is printed this many times, and only counted after
+      const uint32_t MaxRepeats = 3;
+
+      // Across every message ID
+      const uint32_t MaxMessagesPerSecond = 50;
+
+      // IDs listed in the summary, most repeated first
+      const uint32_t SummaryIdCount = 10;
+
+      // Truncates rather than overrunning, and always terminates
+      void CopyString(char* pDestination, size_t size, const char* pSource)
+      {
+         if (!pSource)
+         {
+            pDestination[0] = '\0';
+            return;
+         }
+
+         size_t length = strnlen(pSource, size - 1);
+         memcpy(pDestination, pSource, length);
+         pDestination[length] = '\0';
+      }
+
+      const char* SeverityName(VkDebugUtilsMessageSeverityFlagBitsEXT severity)
+      {
+         switch (severity)
+         {
+         case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT: return "error";
+         case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT: return "warning";
+         case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT: return "info";
+         default: return "verbose";
+         }
+      }
+
+      const char* TypeName(VkDebugUtilsMessageTypeFlagsEXT types)
+      {
+         if (types & VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT)
+         {
+            return "validation";
+         }
+
+         if (types & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT)
+         {
+            return "performance";
+         }
+
+         return "general";
+      }
+
+      const char* ObjectTypeName(VkObjectType type)
+      {
+         switch (type)
+         {
+         case VK_OBJECT_TYPE_INSTANCE: return "VkInstance";
+         case VK_OBJECT_TYPE_PHYSICAL_DEVICE: return "VkPhysicalDevice";
+         case VK_OBJECT_TYPE_DEVICE: return "VkDevice";
+         case VK_OBJECT_TYPE_QUEUE: return "VkQueue";
+         case VK_OBJECT_TYPE_SEMAPHORE: return "VkSemaphore";
+         case VK_OBJECT_TYPE_COMMAND_BUFFER: return "VkCommandBuffer";
+         case VK_OBJECT_TYPE_FENCE: return "VkFence";
+         case VK_OBJECT_TYPE_DEVICE_MEMORY: return "VkDeviceMemory";
+         case VK_OBJECT_TYPE_BUFFER: return "VkBuffer";
+         case VK_OBJECT_TYPE_IMAGE: return "VkImage";
+         case VK_OBJECT_TYPE_QUERY_POOL: return "VkQueryPool";
+         case VK_OBJECT_TYPE_IMAGE_VIEW: return "VkImageView";
+         case VK_OBJECT_TYPE_SHADER_MODULE: return "VkShaderModule";
+         case VK_OBJECT_TYPE_PIPELINE_LAYOUT: return "VkPipelineLayout";
+         case VK_OBJECT_TYPE_RENDER_PASS: return "VkRenderPass";
+         case VK_OBJECT_TYPE_PIPELINE: return "VkPipeline";
+         case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT: return "VkDescriptorSetLayout";
+         case VK_OBJECT_TYPE_DESCRIPTOR_POOL: return "VkDescriptorPool";
+         case VK_OBJECT_TYPE_DESCRIPTOR_SET: return "VkDescriptorSet";
+         case VK_OBJECT_TYPE_FRAMEBUFFER: return "VkFramebuffer";
+         case VK_OBJECT_TYPE_COMMAND_POOL: return "VkCommandPool";
+         case VK_OBJECT_TYPE_SWAPCHAIN_KHR: return "VkSwapchainKHR";
+         default: return "object";
+         }
+      }
+   }
+
+   ValidationSink::ValidationSink() :
+      _queue(QueueCapacity)
+   {
+   }
+
+   ValidationSink::~ValidationSink()
+   {
+      Stop();
+   }
+
+   void ValidationSink::Start(ostream& stream)
+   {
+      Stop();
+
+      _pStream = &stream;
+      _stopping = false;
+      _dropped = 0;
+      _ids.clear();
+      _windowStart = chrono::steady_clock::now();
+      _windowPrinted = 0;
+      _windowSuppressed = 0;
+      _errorCount = 0;
+      _warningCount = 0;
+      _otherCount = 0;
+      _repeatsSuppressed = 0;
+      _rateSuppressed = 0;
+
+      _thread = thread(&ValidationSink::Run, this);
+   }
+
+   void ValidationSink::Stop()
+   {
+      if (!_thread.joinable())
+      {
+         return;
+      }
+
+      {
+         lock_guard<mutex> lock(_mutex);
+         _stopping = true;
+      }
+
+      _wake.notify_all();
+      _thread.join();
+
+      PrintSummary();
+   }
+
+   void ValidationSink::Push(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT types,
+      const VkDebugUtilsMessengerCallbackDataEXT& data)
+   {
+      Message message;
+      message.severity = severity;
+      message.types = types;
+      message.idNumber = data.messageIdNumber;
+      CopyString(message.idName, MaxIdNameLength, data.pMessageIdName);
+      CopyString(message.text, MaxTextLength, data.pMessage);
+
+      message.objectCount = min(data.objectCount, MaxObjects);
+
+      for (uint32_t i = 0; i < message.objectCount; i++)
+      {
+         message.objects[i].type = data.pObjects[i].objectType;
+         message.objects[i].handle = data.pObjects[i].objectHandle;
+         CopyString(message.objects[i].name, MaxObjectNameLength, data.pObjects[i].pObjectName);
+      }
+
+      if (!_queue.TryPush(message))
+      {
+         _dropped.fetch_add(1, memory_order_relaxed);
+         return;
+      }
+
+      // Notifying without the lock never blocks, and a wake that arrives
+      // just before the thread sleeps is only late by the poll interval
+      if (_queue.ApproximateSize() >= QueueCapacity / 4)
+      {
+         _wake.notify_one();
+      }
+   }
+
+   void ValidationSink::Run()
+   {
+      TRACE_THREAD_NAME("Validation");
+
+      string output;
+
+      while (true)
+      {
+         bool stopping;
+
+         {
+            unique_lock<mutex> lock(_mutex);
+            _wake.wait_for(lock, PollInterval, [this] { return _stopping || _queue.ApproximateSize() >= QueueCapacity / 4; });
+            stopping = _stopping;
+         }
+
+         // Everything pushed before Stop is printed
+         Drain(output);
+
+         if (!output.empty())
+         {
+            // One write per batch rather than one flush per message
+            *_pStream << output << flush;
+            output.clear();
+         }
+
+         if (stopping)
+         {
+            return;
+         }
+      }
+   }
+
+   void ValidationSink::Drain(string& output)
+   {
+      Message message;
+
+      while (_queue.TryPop(message))
+      {
+         Format(message, output);
+      }
+
+      auto now = chrono::steady_clock::now();
+
+      if (now - _windowStart >= chrono::seconds(1))
+      {
+         if (_windowSuppressed > 0)
+         {
+            output += to_string(_windowSuppressed) + " validation messages over the rate limit were not printed\n";
+         }
+
+         _windowStart = now;
+         _windowPrinted = 0;
+         _windowSuppressed = 0;
+      }
+   }
+
+   void ValidationSink::Format(const Message& message, string& output)
+   {
+      switch (message.severity)
+      {
+      case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT: _errorCount++; break;
+      case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT: _warningCount++; break;
+      default: _otherCount++; break;
+      }
+
+      // Messages from outside the validation layers may have no ID, so
+      // their text stands in for one
+      uint64_t key = message.idNumber != 0 ? (uint32_t)message.idNumber :
+         hash<string_view>()(message.idName[0] != '\0' ? message.idName : message.text);
+
+      IdStatistics& id = _ids[key];
+
+      if (id.count++ == 0)
+      {
+         id.name = message.idName[0] != '\0' ? message.idName : "(no message ID)";
+      }
+
+      if (id.count > MaxRepeats)
+      {
+         _repeatsSuppressed++;
+         return;
+      }
+
+      if (_windowPrinted >= MaxMessagesPerSecond)
+      {
+         _windowSuppressed++;
+         _rateSuppressed++;
+         return;
+      }
+
+      _windowPrinted++;
+
+      output += "Validation ";
+      output += SeverityName(message.severity);
+      output += " [";
+      output += id.name;
+      output += "] (";
+      output += TypeName(message.types);
+      output += "): ";
+      output += message.text;
+      output += "\n";
+
+      for (uint32_t i = 0; i < message.objectCount; i++)
+      {
+         const ObjectInfo& object = message.objects[i];
+
+         char line[160];
+         snprintf(line, sizeof(line), "\t%s 0x%llx%s%s%s\n", ObjectTypeName(object.type), (unsigned long long)object.handle,
+            object.name[0] != '\0' ? " \"" : "", object.name, object.name[0] != '\0' ? "\"" : "");
+         output += line;
+      }
+
+      if (id.count == MaxRepeats)
+      {
+         output += "\tFurther messages with this ID are only counted\n";
+      }
+   }
+
+   void ValidationSink::PrintSummary()
+   {
+      uint32_t total = _errorCount + _warningCount + _otherCount;
+      uint32_t dropped = _dropped.load();
+
+      if (total == 0 && dropped == 0)
+      {
+         return;
+      }
+
+      ostream& stream = *_pStream;
+
+      char line[256];
+      snprintf(line, sizeof(line), "Validation: %u errors, %u warnings, %u other messages across %u message IDs",
+         _errorCount, _warningCount, _otherCount, (uint32_t)_ids.size());
+      stream << line << endl;
+
+      snprintf(line, sizeof(line), "\t%u repeats and %u over the rate limit not printed, %u dropped with the queue full",
+         _repeatsSuppressed, _rateSuppressed, dropped);
+      stream << line << endl;
+
+      vector<const IdStatistics*> repeated;
+
+      for (const auto& id : _ids)
+      {
+         if (id.second.count > MaxRepeats)
+         {
+            repeated.push_back(&id.second);
+         }
+      }
+
+      sort(repeated.begin(), repeated.end(), [](const IdStatistics* pA, const IdStatistics* pB)
+      {
+         return pA->count > pB->count;
+      });
+
+      for (size_t i = 0; i < repeated.size() && i < SummaryIdCount; i++)
+      {
+         snprintf(line, sizeof(line), "\t%8u x %s", repeated[i]->count, repeated[i]->name.c_str());
+         stream << line << endl;
+      }
+   }
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "../Common/Common.h"
+#include "../Threading/BoundedQueue.h"
+
+namespace validation {
+
+   // Takes messages from the debug utils callback and prints them from a
+   // background thread. The callback runs inside whichever Vulkan call the
+   // message is about, so it only copies the message into a lock-free
+   // queue, and never allocates, takes a lock or writes to the console. A
+   // message that finds the queue full is dropped and counted.
+   //
+   // Messages are deduplicated by message ID: each ID is printed the first
+   // few times it is seen and only counted after that, so one mistake made
+   // every frame does not bury everything else. On top of that, no more
+   // than a set number are printed per second.
+   class ValidationSink {
+   public:
+      ValidationSink();
+      ~ValidationSink();
+
+      void Start(std::ostream& stream);
+
+      // Prints whatever is still queued, then the summary
+      void Stop();
+
+      // Any thread, from the debug utils callback
+      void Push(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT types,
+         const VkDebugUtilsMessengerCallbackDataEXT& data);
+
+      // Once stopped
+      uint32_t ErrorCount() const { return _errorCount; };
+
+   private:
+      static constexpr uint32_t QueueCapacity = 512;
+      static constexpr uint32_t MaxIdNameLength = 96;
+      static constexpr uint32_t MaxTextLength = 2048;
+      static constexpr uint32_t MaxObjects = 4;
+      static constexpr uint32_t MaxObjectNameLength = 64;
+
+      // Copied out of the callback data, which only lives for the call
+      struct ObjectInfo
+      {
+         VkObjectType type;
+         uint64_t handle;
+         char name[MaxObjectNameLength];
+      };
+
+      struct Message
+      {
+         VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+         VkDebugUtilsMessageTypeFlagsEXT types;
+         int32_t idNumber;
+         char idName[MaxIdNameLength];
+         char text[MaxTextLength];
+         uint32_t objectCount;
+         ObjectInfo objects[MaxObjects];
+      };
+
+      struct IdStatistics
+      {
+         std::string name;
+         uint32_t count = 0;
+      };
+
+      void Run();
+      void Drain(std::string& output);
+      void Format(const Message& message, std::string& output);
+      void PrintSummary();
+
+      threading::BoundedQueue<Message> _queue;
+      std::atomic<uint32_t> _dropped{ 0 };
+
+      std::ostream* _pStream = nullptr;
+      std::thread _thread;
+      std::mutex _mutex;
+      std::condition_variable _wake;
+      bool _stopping = false;
+
+      // Background thread only, until stopped
+      std::unordered_map<uint64_t, IdStatistics> _ids;
+      std::chrono::steady_clock::time_point _windowStart;
+      uint32_t _windowPrinted = 0;
+      uint32_t _windowSuppressed = 0;
+
+      uint32_t _errorCount = 0;
+      uint32_t _warningCount = 0;
+      uint32_t _otherCount = 0;
+      uint32_t _repeatsSuppressed = 0;
+      uint32_t _rateSuppressed = 0;
+   };
+}
@@ -1,5 +1,9 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "HelloTriangle.h"
 
+#include <glm/gtc/matrix_transform.hpp>
+
 #include <iostream>
 #include <stdexcept>
 #include <functional>
@@ -7,73 +11,497 @@
 #include <algorithm>
 #include <map>
 #include <set>
-#include <thread>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
 
 #include "ValidationCallbacks.h"
+#include "../Profiling/Trace.h"
 
 using namespace std;
 
 namespace renderer {
-	void HelloTriangle::Run()
+
+	namespace {
+		// Adds the time until it goes out of scope to a running total
+		class ScopedAccumulator
+		{
+		public:
+			explicit ScopedAccumulator(double& totalMs) : _totalMs(totalMs), _startTime(chrono::high_resolution_clock::now()) {};
+
+			~ScopedAccumulator()
+			{
+				chrono::duration<double, milli> elapsed = chrono::high_resolution_clock::now() - _startTime;
+				_totalMs += elapsed.count();
+			}
+
+		private:
+			double& _totalMs;
+			chrono::high_resolution_clock::time_point _startTime;
+		};
+	}
+	const char* HelloTriangle::ShaderDirectory = "ShaderData";
+	const char* HelloTriangle::ShaderCacheDirectory = "Data/ShaderCache";
+
+	HelloTriangle::HelloTriangle(const RendererSettings& settings) :
+		_settings(settings)
+	{
+		if (_settings.framesInFlight == 0)
+		{
+			_settings.framesInFlight = 1;
+		}
+
+		window.Configure(_settings.windowWidth, _settings.windowHeight, _settings.windowResizable);
+	}
+
+	void HelloTriangle::Initialise()
 	{
 		InitialiseWindow();
 		InitialiseVulkan();
-		MainLoop();
-		CleanUp();
 	}
 
 	void HelloTriangle::InitialiseWindow()
 	{
+		if (_settings.headless)
+		{
+			pWindow = nullptr;
+			return;
+		}
+
 		pWindow = window.Get();
 	}
 
 	void HelloTriangle::InitialiseVulkan()
 	{
+		TRACE_FUNCTION();
+
+		auto startTime = chrono::high_resolution_clock::now();
+
+		// Every create and destroy call takes these, and objects must be
+		// destroyed with the callbacks they were created with
+		_pAllocationCallbacks = _settings.hostAllocator ? _hostAllocator.Callbacks() : nullptr;
+
 		CreateInstance();
 		SetupDebugCallback();
 		CreateSurface();
+		// Started first, so everything from here on can hand work to it
+		_jobs.Initialise(_settings.workerCount);
+
 		PickPhysicalDevice();
 		CreateLogicalDevice();
-		CreateSwapChain();
+		_allocator.Initialise(_device, _pAllocationCallbacks, _physicalDevice);
+		_uploadEngine.Initialise(_device, _pAllocationCallbacks, _allocator, _transferQueue, _queueFamilies.transferFamily, _queueFamilies.graphicsFamily);
+		_uniformRing.Initialise(_physicalDevice, _allocator, _settings.framesInFlight);
+		// Ahead of the swap chain, which it chooses the present mode for
+		_framePacer.Initialise(_device, _settings.latencyMode, _settings.framesInFlight, _settings.targetFrameMs, _displayTimingSupported);
+		CreatePipelineCache();
+		_pipelineManager.Initialise(_device, _pAllocationCallbacks, _pipelineCache.Get());
+		_shader.Initialise(_device, _pAllocationCallbacks);
+		CompileShaders();
+
+		// Bit order matches the constant ids in the shader
+		_fragmentVariants.Initialise("hellotriangle.frag", { "GREYSCALE", "VISUALISE_DEPTH" });
+		_fragmentVariant = _fragmentVariants.Key(_settings.shaderFeatures);
+
+		if (_settings.headless)
+		{
+			CreateOffscreenTargets();
+		}
+		else
+		{
+			CreateSwapChain();
+		}
+
 		CreateImageViews();
+		CreateRenderPass();
+		CreateDescriptors();
 		CreateGraphicsPipeline();
+		CreateScene();
+		CreateRenderGraph();
+		CreateFramebuffers();
+		CreateFrameData();
+
+		// The pipelines compiled alongside everything since CreateGraphicsPipeline.
+		// Waiting here keeps the first frame from being drawn without them.
+		if (_pipelineManager.Wait(_graphicsPipeline) == VK_NULL_HANDLE)
+		{
+			throw runtime_error("Failed to create graphics pipeline");
+		}
+
+		_startupTimings.graphicsPipelineMs = _pipelineManager.CompileMs(_graphicsPipeline);
+
+		chrono::duration<double, milli> elapsed = chrono::high_resolution_clock::now() - startTime;
+		_startupTimings.initialiseVulkanMs = elapsed.count();
+
+		// Startup allocates plenty, the report is about what every frame costs
+		_hostAllocationsAtFirstFrame = _hostAllocator.GetStatistics();
 	}
 
 	void HelloTriangle::CleanUp()
 	{
+		TRACE_FUNCTION();
+
+		// Nothing can be destroyed while the GPU may still be using it
+		vkDeviceWaitIdle(_device);
+
+		_shaderWatcher.Stop();
+		_shaderCompiler.Destroy();
+
+		_gpuProfiler.Destroy();
+
+		for (auto& frame : _frames)
+		{
+			vkDestroySemaphore(_device, frame.imageAvailableSemaphore, _pAllocationCallbacks);
+			vkDestroySemaphore(_device, frame.renderFinishedSemaphore, _pAllocationCallbacks);
+			vkDestroyFence(_device, frame.inFlightFence, _pAllocationCallbacks);
+			vkDestroyCommandPool(_device, frame.commandPool, _pAllocationCallbacks);
+		}
+
+		_frames.clear();
+
+		_recorder.Destroy();
+		_jobs.Destroy();
+
+		for (auto framebuffer : _swapChainFramebuffers)
+		{
+			vkDestroyFramebuffer(_device, framebuffer, _pAllocationCallbacks);
+		}
+
+		for (auto& retired : _retiredSwapChains)
+		{
+			DestroyRetiredSwapChain(retired);
+		}
+
+		_retiredSwapChains.clear();
+
+		_graphExecutor.Destroy();
+		_indirectRenderer.Destroy();
+
+		// Every pipeline, including those replaced by reloads, belongs to the manager
+		_pipelineManager.Destroy();
+		vkDestroyPipelineLayout(_device, _pipelineLayout, _pAllocationCallbacks);
+		_shader.Destroy();
+		vkDestroyRenderPass(_device, _renderPass, _pAllocationCallbacks);
+
+		_bindless.Destroy();
+		_descriptorAllocator.Destroy();
+
+		// Write back whatever the driver compiled this run so the next
+		// launch starts warm
+		_pipelineCache.Save();
+		_pipelineCache.Destroy();
+
 		for (auto imageView : _swapChainImageViews)
 		{
-			vkDestroyImageView(_device, imageView, nullptr);
+			vkDestroyImageView(_device, imageView, _pAllocationCallbacks);
+		}
+
+		if (_settings.headless)
+		{
+			for (size_t i = 0; i < _swapChainImages.size(); i++)
+			{
+				_allocator.DestroyImage(_swapChainImages[i], _offscreenImageAllocations[i]);
+			}
+		}
+		else
+		{
+			vkDestroySwapchainKHR(_device, _swapChain, _pAllocationCallbacks);
+		}
+
+		if (_settings.validation)
+		{
+			_allocator.PrintStatistics(cout);
+		}
+
+		_uploadEngine.Destroy();
+		_uniformRing.Destroy();
+		_allocator.Destroy();
+		vkDestroyDevice(_device, _pAllocationCallbacks);
+
+		if (_settings.validation)
+		{
+			ValidationCallbacks::DestroyDebugUtilsMessengerEXT(_instance, _debugMessenger, _pAllocationCallbacks);
+		}
+
+		if (!_settings.headless)
+		{
+			vkDestroySurfaceKHR(_instance, _surface, _pAllocationCallbacks);
+		}
+
+		vkDestroyInstance(_instance, _pAllocationCallbacks);
+
+		// After the instance, so messages about destroying it are printed
+		_validationSink.Stop();
+
+		if (!_settings.headless)
+		{
+			window.Destroy();
+			glfwTerminate();
+		}
+	}
+
+	bool HelloTriangle::ShouldClose()
+	{
+		if (_settings.headless)
+		{
+			return _frameCount >= _settings.headlessFrameCount;
+		}
+
+		return glfwWindowShouldClose(pWindow);
+	}
+
+	bool HelloTriangle::IsMinimised()
+	{
+		if (_settings.headless)
+		{
+			return false;
+		}
+
+		VkExtent2D size = window.FramebufferSize();
+		return size.width == 0 || size.height == 0;
+	}
+
+	void HelloTriangle::DrawFrame()
+	{
+		TRACE_FUNCTION();
+		ScopedAccumulator frameTime(_frameTimings.frameMs);
+
+		FrameData& frame = _frames[_currentFrame];
+
+		// Only blocks if the CPU has got framesInFlight frames ahead of the GPU
+		{
+			TRACE_SCOPE("WaitForFrameFence");
+			ScopedAccumulator waitTime(_frameTimings.waitMs);
+			vkWaitForFences(_device, 1, &frame.inFlightFence, VK_TRUE, UINT64_MAX);
+
+			// Lower latency modes queue fewer frames than there are slots, so
+			// also wait on the frame FramesAhead before this one. Its slot's
+			// fence is the last one submitted there.
+			uint32_t framesAhead = _framePacer.FramesAhead();
+
+			if (framesAhead < _settings.framesInFlight)
+			{
+				FrameData& ahead = _frames[(_currentFrame + _settings.framesInFlight - framesAhead) % _settings.framesInFlight];
+				vkWaitForFences(_device, 1, &ahead.inFlightFence, VK_TRUE, UINT64_MAX);
+			}
+
+			// Sleeps out the rest of the target interval, and marks where the
+			// frame's latency is measured from
+			_framePacer.BeginFrame(_frameCount);
+		}
+
+		_framePacer.Collect(_settings.headless ? VK_NULL_HANDLE : _swapChain);
+
+		// Uploads this frame acquired last time round are done with, and
+		// anything queued since goes to the transfer queue now so it can
+		// copy while this frame renders
+		_uploadEngine.RetireFrame(_currentFrame);
+		_uploadEngine.Flush();
+		_recorder.BeginFrame(_currentFrame);
+		_descriptorAllocator.BeginFrame(_currentFrame);
+		_uniformRing.BeginFrame(_currentFrame);
+
+		if (_bindlessSupported)
+		{
+			_bindless.BeginFrame(_currentFrame);
+		}
+
+		DestroyFinishedSwapChains();
+		ApplyShaderReloads();
+
+		frame.waitSemaphores.clear();
+		frame.waitStages.clear();
+
+		if (_settings.headless)
+		{
+			// Each frame in flight has its own target, so there is nothing to
+			// acquire and nothing to present; the GPU runs unthrottled
+			vkResetCommandPool(_device, frame.commandPool, 0);
+			RecordCommandBuffer(frame, _currentFrame);
+
+			VkSubmitInfo submitInfo = {};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.waitSemaphoreCount = static_cast<uint32_t>(frame.waitSemaphores.size());
+			submitInfo.pWaitSemaphores = frame.waitSemaphores.data();
+			submitInfo.pWaitDstStageMask = frame.waitStages.data();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &frame.commandBuffer;
+
+			vkResetFences(_device, 1, &frame.inFlightFence);
+
+			if (vkQueueSubmit(_graphicsQueue, 1, &submitInfo, frame.inFlightFence) != VK_SUCCESS)
+			{
+				throw runtime_error("Failed to submit draw command buffer");
+			}
+
+			_gpuProfiler.EndFrame(_currentFrame);
+			_framePacer.EndFrame(_frameCount, frame.inFlightFence);
+
+			_currentFrame = (_currentFrame + 1) % _settings.framesInFlight;
+			_frameCount++;
+			_frameTimings.frameCount++;
+			return;
+		}
+
+		_swapChainStale = window.ConsumeResize() || _swapChainStale;
+
+		if (_swapChainStale && !RecreateSwapChain())
+		{
+			return;
+		}
+
+		uint32_t imageIndex;
+		VkResult result;
+		{
+			TRACE_SCOPE("AcquireNextImage");
+			ScopedAccumulator waitTime(_frameTimings.waitMs);
+			result = vkAcquireNextImageKHR(_device, _swapChain, UINT64_MAX, frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+		}
+
+		// Nothing was acquired, so the frame is tried again next time round
+		// against a new swap chain. A suboptimal image is still drawn and
+		// presented, and the swap chain replaced after.
+		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			_swapChainStale = true;
+			return;
+		}
+		else if (result == VK_SUBOPTIMAL_KHR)
+		{
+			_swapChainStale = true;
+		}
+		else if (result != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to acquire swap chain image");
+		}
+
+		// The swap chain can hand back an image an older frame is still rendering to
+		if (_imagesInFlight[imageIndex] != VK_NULL_HANDLE)
+		{
+			ScopedAccumulator waitTime(_frameTimings.waitMs);
+			vkWaitForFences(_device, 1, &_imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+		}
+
+		_imagesInFlight[imageIndex] = frame.inFlightFence;
+
+		// The fence guarantees the GPU is done with this frame's command buffer
+		frame.waitSemaphores.push_back(frame.imageAvailableSemaphore);
+		frame.waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+		vkResetCommandPool(_device, frame.commandPool, 0);
+		RecordCommandBuffer(frame, imageIndex);
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(frame.waitSemaphores.size());
+		submitInfo.pWaitSemaphores = frame.waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = frame.waitStages.data();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &frame.commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &frame.renderFinishedSemaphore;
+
+		vkResetFences(_device, 1, &frame.inFlightFence);
+
+		if (vkQueueSubmit(_graphicsQueue, 1, &submitInfo, frame.inFlightFence) != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to submit draw command buffer");
 		}
 
-		vkDestroySwapchainKHR(_device, _swapChain, nullptr);
-		vkDestroyDevice(_device, nullptr);
+		_gpuProfiler.EndFrame(_currentFrame);
+		_framePacer.EndFrame(_frameCount, frame.inFlightFence);
+
+		VkPresentInfoKHR presentInfo = {};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = &frame.renderFinishedSemaphore;
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = &_swapChain;
+		presentInfo.pImageIndices = &imageIndex;
+		_framePacer.ChainPresentTime(_frameCount, presentInfo);
+
+		{
+			TRACE_SCOPE("QueuePresent");
+			result = vkQueuePresentKHR(_presentationQueue, &presentInfo);
+		}
 
-		if (_enableValidationLayers)
+		if (result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR)
 		{
-			ValidationCallbacks::DestroyDebugReportCallbackEXT(_instance, _debugCallback, nullptr);
+			_swapChainStale = true;
+		}
+		else if (result != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to present swap chain image");
 		}
 
-		vkDestroySurfaceKHR(_instance, _surface, nullptr);
-		vkDestroyInstance(_instance, nullptr);
-		window.Destroy();
-		glfwTerminate();
+		_currentFrame = (_currentFrame + 1) % _settings.framesInFlight;
+		_frameCount++;
+		_frameTimings.frameCount++;
 	}
 
-	void HelloTriangle::MainLoop()
+	void HelloTriangle::PrintFrameReport(ostream& stream)
 	{
-		while (!glfwWindowShouldClose(pWindow))
+		char line[256];
+		snprintf(line, sizeof(line), "CPU frame %.3f ms (busy %.3f ms, recording %.3f ms, waiting %.3f ms) over %u frames",
+			_frameTimings.MeanFrameMs(), _frameTimings.MeanBusyMs(), _frameTimings.MeanRecordMs(),
+			_frameTimings.MeanWaitMs(), _frameTimings.frameCount);
+		stream << line << endl;
+
+		_gpuProfiler.PrintReport(stream);
+		_framePacer.PrintReport(stream, _settings.latencyReport);
+
+		if (_settings.dynamicResolution)
+		{
+			_dynamicResolution.PrintReport(stream);
+		}
+
+		if (_swapChainRecreations > 0)
+		{
+			stream << "Swap chain recreated " << _swapChainRecreations << " times" << endl;
+		}
+
+		if (_uniformRing.HighWaterMark() > 0)
+		{
+			stream << "Uniform ring: at most " << _uniformRing.HighWaterMark() << " bytes in a frame" << endl;
+		}
+
+		// Without it, culled instances are still drawn as empty commands
+		if (_settings.instanceCount > 0 && _indirectSupport.supported)
+		{
+			stream << "Indirect draw count: " << (_indirectRenderer.Support().drawIndirectCount ? "supported" : "not supported") << endl;
+		}
+
+		if (_settings.shaderVariantReport)
 		{
-			glfwPollEvents();
+			_fragmentVariants.PrintReport(stream);
 
-			this_thread::sleep_for(chrono::milliseconds(250));
+			// Includes anything hot reload rebuilt
+			if (ShaderCompiler::IsAvailable())
+			{
+				stream << "Shaders: " << _shaderCompiler.CompileCount() << " compiled, "
+					<< _shaderCompiler.CacheHitCount() << " from the cache" << endl;
+			}
+		}
+
+		if (_settings.hostAllocationReport && _settings.hostAllocator)
+		{
+			_hostAllocator.PrintReport(stream, _hostAllocationsAtFirstFrame, _frameTimings.frameCount);
+		}
+
+		// Whichever side has the longer frame sets the pace, and the other
+		// ends up waiting on it
+		if (_gpuProfiler.IsSupported() && _frameTimings.frameCount > 0)
+		{
+			stream << (_gpuProfiler.MeanFrameMs() > _frameTimings.MeanBusyMs() ? "GPU bound" : "CPU bound") << endl;
 		}
 	}
 
 	void HelloTriangle::CreateInstance()
 	{
-		if (_enableValidationLayers && !CheckValidationLayerSupport())
+		TRACE_FUNCTION();
+
+		if (_settings.validation && !CheckValidationLayerSupport())
 		{
 			throw runtime_error("Validation layers requested, but not available");
 		}
@@ -86,7 +514,8 @@ namespace renderer {
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "No Engine";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		// 1.1 for vkGetPhysicalDeviceFeatures2, which descriptor indexing is queried through
+		appInfo.apiVersion = VK_API_VERSION_1_1;
 
 		// Get all available extensions
 		uint32_t extensionCount = 0;
@@ -94,13 +523,6 @@ namespace renderer {
 		vector<VkExtensionProperties> extensions(extensionCount);
 		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
 
-		// Output available extensions
-		cout << "Available extensions:" << endl;
-		for (const auto& extension : extensions)
-		{
-			cout << "\t" << extension.extensionName << endl;
-		}
-
 		// Get required extensions to interface with our window system
 		vector<const char*> requiredExtensions = GetRequiredExtensions();
 
@@ -133,17 +555,24 @@ namespace renderer {
 		createInfo.enabledExtensionCount = (uint32_t)requiredExtensions.size();
 		createInfo.ppEnabledExtensionNames = requiredExtensions.data();
 
-		if (_enableValidationLayers)
+		// Chained in as well, so creating and destroying the instance
+		// itself is reported, before and after the messenger exists
+		VkDebugUtilsMessengerCreateInfoEXT messengerInfo = DebugMessengerCreateInfo();
+
+		if (_settings.validation)
 		{
 			createInfo.enabledLayerCount = static_cast<uint32_t>(_validationLayers.size());
 			createInfo.ppEnabledLayerNames = _validationLayers.data();
+			createInfo.pNext = &messengerInfo;
+
+			_validationSink.Start(cerr);
 		}
 		else
 		{
 			createInfo.enabledLayerCount = 0;
 		}
 
-		if (vkCreateInstance(&createInfo, nullptr, &_instance) != VK_SUCCESS)
+		if (vkCreateInstance(&createInfo, _pAllocationCallbacks, &_instance) != VK_SUCCESS)
 		{
 			throw runtime_error("Failed to create Vulkan instance");
 		}
@@ -183,15 +612,20 @@ namespace renderer {
 	std::vector<const char*> HelloTriangle::GetRequiredExtensions()
 	{
 		// Setup the Vulkan extensions required by this application
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		vector<const char*> extensions;
+
+		if (!_settings.headless)
+		{
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions;
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-		vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
-		if (_enableValidationLayers)
+		if (_settings.validation)
 		{
-			extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 		}
 
 		return extensions;
@@ -199,21 +633,69 @@ namespace renderer {
 
 	void HelloTriangle::SetupDebugCallback()
 	{
-		if (!_enableValidationLayers) return;
+		TRACE_FUNCTION();
+
+		if (!_settings.validation) return;
 
-		VkDebugReportCallbackCreateInfoEXT createInfo = {};
-		createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT;
-		createInfo.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT;
-		createInfo.pfnCallback = ValidationCallbacks::DebugCallback;
+		VkDebugUtilsMessengerCreateInfoEXT createInfo = DebugMessengerCreateInfo();
 
-		if (ValidationCallbacks::CreateDebugReportCallbackEXT(_instance, &createInfo, nullptr, &_debugCallback) != VK_SUCCESS)
+		if (ValidationCallbacks::CreateDebugUtilsMessengerEXT(_instance, &createInfo, _pAllocationCallbacks, &_debugMessenger) != VK_SUCCESS)
 		{
 			throw runtime_error("Failed to setup debug callback");
 		}
 	}
 
+	VkDebugUtilsMessengerCreateInfoEXT HelloTriangle::DebugMessengerCreateInfo()
+	{
+		VkDebugUtilsMessengerCreateInfoEXT createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+		createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+		createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+			VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+		createInfo.pfnUserCallback = ValidationCallbacks::DebugCallback;
+		createInfo.pUserData = &_validationSink;
+		return createInfo;
+	}
+
+	void HelloTriangle::NameObject(VkObjectType objectType, uint64_t objectHandle, const string& name)
+	{
+		// Only the validation layers read the names
+		if (!_settings.validation || objectHandle == 0)
+		{
+			return;
+		}
+
+		ValidationCallbacks::SetObjectName(_device, objectType, objectHandle, name.c_str());
+	}
+
+	void HelloTriangle::NameGraphResources()
+	{
+		// Imported resources are named by whoever owns them
+		for (ResourceHandle resource = 0; resource < _renderGraph.ResourceCount(); resource++)
+		{
+			const ResourceDesc& desc = _renderGraph.GetResource(resource);
+
+			if (desc.imported)
+			{
+				continue;
+			}
+
+			if (desc.type == ResourceType::Image)
+			{
+				NameObject(VK_OBJECT_TYPE_IMAGE, (uint64_t)_graphExecutor.GetImage(resource), desc.name);
+				NameObject(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)_graphExecutor.GetImageView(resource), desc.name);
+			}
+			else
+			{
+				NameObject(VK_OBJECT_TYPE_BUFFER, (uint64_t)_graphExecutor.GetBuffer(resource), desc.name);
+			}
+		}
+	}
+
 	void HelloTriangle::PickPhysicalDevice()
 	{
+		TRACE_FUNCTION();
+
 		uint32_t deviceCount = 0;
 		vkEnumeratePhysicalDevices(_instance, &deviceCount, nullptr);
 
@@ -275,7 +757,11 @@ namespace renderer {
 		// Check swap chain
 		bool swapChainAdequate = false;
 
-		if (extensionsSupported)
+		if (_settings.headless)
+		{
+			swapChainAdequate = true;
+		}
+		else if (extensionsSupported)
 		{
 			SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(device);
 			swapChainAdequate = !swapChainSupport.formats.empty() &&
@@ -305,7 +791,8 @@ namespace renderer {
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
 		// "Cross-out" the names of extensions which we require
-		set<string> requiredExtensions(_deviceExtensions.begin(), _deviceExtensions.end());
+		vector<const char*> deviceExtensions = GetRequiredDeviceExtensions();
+		set<string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 		for (const auto& extension : availableExtensions)
 		{
 			requiredExtensions.erase(extension.extensionName);
@@ -314,6 +801,17 @@ namespace renderer {
 		return requiredExtensions.empty();
 	}
 
+	vector<const char*> HelloTriangle::GetRequiredDeviceExtensions()
+	{
+		// Nothing is presented in headless mode, so there is no need for a swap chain
+		if (_settings.headless)
+		{
+			return {};
+		}
+
+		return _deviceExtensions;
+	}
+
 	//int HelloTriangle::RateDeviceSuitability(VkPhysicalDevice device)
 	//{
 	//	// Get device information
@@ -345,6 +843,7 @@ namespace renderer {
 	QueueFamilyIndices HelloTriangle::FindQueueFamilies(VkPhysicalDevice device)
 	{
 		QueueFamilyIndices indices;
+		indices.presentRequired = !_settings.headless;
 
 		uint32_t queueFamilyCount = 0;
 		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
@@ -354,38 +853,77 @@ namespace renderer {
 		int i = 0;
 		for (const auto& queueFamily : queueFamilies)
 		{
+			if (queueFamily.queueCount == 0)
+			{
+				i++;
+				continue;
+			}
+
 			// Check queue
-			if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+			bool graphics = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+			bool compute = (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+			bool transfer = (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) != 0;
+
+			if (graphics && indices.graphicsFamily < 0)
 			{
 				indices.graphicsFamily = i;
 			}
 
-			// Check presentation
-			VkBool32 presentationSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _surface, &presentationSupport);
-			if (queueFamily.queueCount > 0 && presentationSupport)
+			if (compute && !graphics && indices.computeFamily < 0)
 			{
-				indices.presentFamily = i;
+				indices.computeFamily = i;
 			}
 
-			if (indices.IsComplete())
+			// Transfer only families are usually backed by the DMA engines
+			if (transfer && !graphics && !compute && indices.transferFamily < 0)
 			{
-				break;
+				indices.transferFamily = i;
+			}
+
+			// Check presentation, preferring the graphics family so the frame
+			// does not need to change queue to be presented
+			if (indices.presentRequired && (indices.presentFamily < 0 || i == indices.graphicsFamily))
+			{
+				VkBool32 presentationSupport = false;
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _surface, &presentationSupport);
+				if (presentationSupport)
+				{
+					indices.presentFamily = i;
+				}
 			}
 
 			i++;
 		}
 
+		// Compute families can always transfer as well, so they are the next
+		// best thing when there is no transfer only family
+		if (indices.transferFamily < 0)
+		{
+			indices.transferFamily = indices.computeFamily >= 0 ? indices.computeFamily : indices.graphicsFamily;
+		}
+
+		if (indices.computeFamily < 0)
+		{
+			indices.computeFamily = indices.graphicsFamily;
+		}
+
 		return indices;
 	}
 
 	void HelloTriangle::CreateLogicalDevice()
 	{
+		TRACE_FUNCTION();
+
 		QueueFamilyIndices indices = FindQueueFamilies(_physicalDevice);
 
 		// Specify queue infos
 		vector<VkDeviceQueueCreateInfo> queueCreateInfos = {};
-		set<int> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+		set<int> uniqueQueueFamilies = { indices.graphicsFamily, indices.transferFamily, indices.computeFamily };
+
+		if (indices.presentRequired)
+		{
+			uniqueQueueFamilies.insert(indices.presentFamily);
+		}
 
 		float queuePriority = 1.0f;
 		for (int queueFamily : uniqueQueueFamilies)
@@ -400,17 +938,40 @@ namespace renderer {
 
 		// Specify device features
 		VkPhysicalDeviceFeatures deviceFeatures = {};
+		vector<const char*> deviceExtensions = GetRequiredDeviceExtensions();
+
+		// Bindless descriptors are used wherever the device has them
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+		_bindlessSupported = BindlessDescriptors::QuerySupport(_physicalDevice, indexingFeatures);
+
+		if (_bindlessSupported)
+		{
+			deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		}
+
+		// Present times are measured wherever the device can report them
+		if (!_settings.headless)
+		{
+			_displayTimingSupported = FramePacer::QueryDisplayTimingSupport(_physicalDevice, deviceExtensions);
+		}
+
+		// Only asked for when there are instances to draw
+		if (_settings.instanceCount > 0)
+		{
+			_indirectSupport = IndirectRenderer::QuerySupport(_physicalDevice, deviceFeatures, deviceExtensions);
+		}
 
 		// Logical device creation
 		VkDeviceCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		createInfo.pNext = _bindlessSupported ? &indexingFeatures : nullptr;
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(_deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = _deviceExtensions.data();
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
-		if (_enableValidationLayers)
+		if (_settings.validation)
 		{
 			createInfo.enabledLayerCount = static_cast<uint32_t>(_validationLayers.size());
 			createInfo.ppEnabledLayerNames = _validationLayers.data();
@@ -420,19 +981,41 @@ namespace renderer {
 			createInfo.enabledLayerCount = 0;
 		}
 
-		if (vkCreateDevice(_physicalDevice, &createInfo, nullptr, &_device) != VK_SUCCESS)
+		if (vkCreateDevice(_physicalDevice, &createInfo, _pAllocationCallbacks, &_device) != VK_SUCCESS)
 		{
 			throw runtime_error("Failed to create logical device");
 		}
 
 		// Get handles for queue
 		vkGetDeviceQueue(_device, indices.graphicsFamily, 0, &_graphicsQueue);
-		vkGetDeviceQueue(_device, indices.presentFamily, 0, &_presentationQueue);
+		vkGetDeviceQueue(_device, indices.transferFamily, 0, &_transferQueue);
+		vkGetDeviceQueue(_device, indices.computeFamily, 0, &_computeQueue);
+
+		if (indices.presentRequired)
+		{
+			vkGetDeviceQueue(_device, indices.presentFamily, 0, &_presentationQueue);
+		}
+
+		// Families can share a queue, in which case the last name given sticks
+		NameObject(VK_OBJECT_TYPE_DEVICE, (uint64_t)_device, "Device");
+		NameObject(VK_OBJECT_TYPE_QUEUE, (uint64_t)_presentationQueue, "Present queue");
+		NameObject(VK_OBJECT_TYPE_QUEUE, (uint64_t)_transferQueue, "Transfer queue");
+		NameObject(VK_OBJECT_TYPE_QUEUE, (uint64_t)_computeQueue, "Compute queue");
+		NameObject(VK_OBJECT_TYPE_QUEUE, (uint64_t)_graphicsQueue, "Graphics queue");
+
+		_queueFamilies = indices;
 	}
 
 	void HelloTriangle::CreateSurface()
 	{
-		if (glfwCreateWindowSurface(_instance, pWindow, nullptr, &_surface) != VK_SUCCESS)
+		TRACE_FUNCTION();
+
+		if (_settings.headless)
+		{
+			return;
+		}
+
+		if (glfwCreateWindowSurface(_instance, pWindow, _pAllocationCallbacks, &_surface) != VK_SUCCESS)
 		{
 			throw runtime_error("Failed to create window surface");
 		}
@@ -440,20 +1023,16 @@ namespace renderer {
 
 	void HelloTriangle::CreateSwapChain()
 	{
+		TRACE_FUNCTION();
+
 		SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(_physicalDevice);
 
 		VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.formats);
 		VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapChainSupport.presentModes);
 		VkExtent2D extent = ChooseSwapExtent(swapChainSupport.capabilities);
 
-		uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-
-		// A value of 0 for maxImageCount means that there is no limit besides memory requirements
-		if (swapChainSupport.capabilities.maxImageCount > 0 &&
-			imageCount > swapChainSupport.capabilities.maxImageCount)
-		{
-			imageCount = swapChainSupport.capabilities.maxImageCount;
-		}
+		// Depends on the present mode, so chosen after it
+		uint32_t imageCount = _framePacer.ChooseImageCount(swapChainSupport.capabilities);
 
 		VkSwapchainCreateInfoKHR createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -466,10 +1045,21 @@ namespace renderer {
 		createInfo.imageArrayLayers = 1;
 		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-		QueueFamilyIndices indices = FindQueueFamilies(_physicalDevice);
-		uint32_t queueFamilyIndices[] = { (uint32_t)indices.graphicsFamily, (uint32_t)indices.presentFamily };
-
-		if (indices.graphicsFamily != indices.presentFamily)
+		// The upscaled scene is blitted in rather than rendered
+		if (_settings.dynamicResolution)
+		{
+			if ((swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0)
+			{
+				throw runtime_error("Failed to create swap chain, dynamic resolution needs to blit to its images");
+			}
+
+			createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		}
+
+		QueueFamilyIndices indices = FindQueueFamilies(_physicalDevice);
+		uint32_t queueFamilyIndices[] = { (uint32_t)indices.graphicsFamily, (uint32_t)indices.presentFamily };
+
+		if (indices.graphicsFamily != indices.presentFamily)
 		{
 			createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
 			createInfo.queueFamilyIndexCount = 2;
@@ -486,9 +1076,11 @@ namespace renderer {
 		createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 		createInfo.presentMode = presentMode;
 		createInfo.clipped = VK_TRUE;
-		createInfo.oldSwapchain = VK_NULL_HANDLE;
+		// Lets the driver hand resources straight over from the swap chain
+		// being replaced, which stays valid until it is destroyed
+		createInfo.oldSwapchain = _swapChain;
 
-		if (vkCreateSwapchainKHR(_device, &createInfo, nullptr, &_swapChain) != VK_SUCCESS)
+		if (vkCreateSwapchainKHR(_device, &createInfo, _pAllocationCallbacks, &_swapChain) != VK_SUCCESS)
 		{
 			throw runtime_error("Failed to create swap chain");
 		}
@@ -497,12 +1089,155 @@ namespace renderer {
 		vkGetSwapchainImagesKHR(_device, _swapChain, &imageCount, nullptr);
 		_swapChainImages.resize(imageCount);
 		vkGetSwapchainImagesKHR(_device, _swapChain, &imageCount, _swapChainImages.data());
+		NameObject(VK_OBJECT_TYPE_SWAPCHAIN_KHR, (uint64_t)_swapChain, "Swap chain " + to_string(_swapChainRecreations));
 
 		// Cache swap chain member variables
 		_swapChainImageFormat = surfaceFormat.format;
 		_swapChainExtent = extent;
 	}
 
+	bool HelloTriangle::RecreateSwapChain()
+	{
+		TRACE_FUNCTION();
+
+		// Left stale until the window is restored
+		VkExtent2D size = window.FramebufferSize();
+
+		if (size.width == 0 || size.height == 0)
+		{
+			return false;
+		}
+
+		// Frames still in flight keep drawing to the old images, so they
+		// are retired on the frame fences rather than destroyed here
+		RetiredSwapChain retired;
+		retired.swapChain = _swapChain;
+		retired.imageViews = move(_swapChainImageViews);
+		retired.framebuffers = move(_swapChainFramebuffers);
+		retired.retiredAtFrame = _frameCount;
+
+		VkFormat previousFormat = _swapChainImageFormat;
+		CreateSwapChain();
+		_framePacer.SwapChainReplaced();
+
+		// The render pass and every pipeline were built for the old format
+		if (_swapChainImageFormat != previousFormat)
+		{
+			throw runtime_error("Failed to recreate swap chain, the surface format changed");
+		}
+
+		CreateImageViews();
+		ResizeAttachments(retired.attachments);
+		CreateFramebuffers();
+
+		// None of the new images have been drawn to yet
+		_imagesInFlight.assign(_swapChainImages.size(), VK_NULL_HANDLE);
+
+		_retiredSwapChains.push_back(move(retired));
+		_swapChainStale = false;
+		_swapChainRecreations++;
+		return true;
+	}
+
+	void HelloTriangle::ResizeAttachments(RetiredImages& retired)
+	{
+		// A swap chain can go stale without changing size, and then the
+		// attachments are kept as they are
+		VkExtent2D depthExtent = _renderGraph.GetResource(_depth).extent;
+
+		if (depthExtent.width == _swapChainExtent.width && depthExtent.height == _swapChainExtent.height)
+		{
+			return;
+		}
+
+		_renderGraph.ResizeImage(_backbuffer, _swapChainExtent);
+		_renderGraph.ResizeImage(_depth, _swapChainExtent);
+
+		if (_settings.dynamicResolution)
+		{
+			_renderGraph.ResizeImage(_sceneColour, _swapChainExtent);
+		}
+
+		// Recompiled for a fresh set of aliasing barriers, as placing the
+		// resized images adds them again. Only the images are recreated,
+		// the graph's buffers are left alone.
+		_compiledGraph = _renderGraph.Compile();
+		retired = _graphExecutor.RebuildImages(_renderGraph, _compiledGraph);
+		NameGraphResources();
+	}
+
+	void HelloTriangle::DestroyFinishedSwapChains()
+	{
+		// Called once the current slot's fence has signalled, which finishes
+		// the frame framesInFlight before this one. A fence covers all work
+		// submitted before it, so every frame up to that one has finished.
+		size_t kept = 0;
+
+		for (size_t i = 0; i < _retiredSwapChains.size(); i++)
+		{
+			RetiredSwapChain& retired = _retiredSwapChains[i];
+
+			if (retired.retiredAtFrame + _settings.framesInFlight <= _frameCount + 1)
+			{
+				DestroyRetiredSwapChain(retired);
+			}
+			else if (kept++ != i)
+			{
+				_retiredSwapChains[kept - 1] = move(retired);
+			}
+		}
+
+		_retiredSwapChains.resize(kept);
+	}
+
+	void HelloTriangle::DestroyRetiredSwapChain(RetiredSwapChain& retired)
+	{
+		for (auto framebuffer : retired.framebuffers)
+		{
+			vkDestroyFramebuffer(_device, framebuffer, _pAllocationCallbacks);
+		}
+
+		for (auto imageView : retired.imageViews)
+		{
+			vkDestroyImageView(_device, imageView, _pAllocationCallbacks);
+		}
+
+		_graphExecutor.DestroyRetired(retired.attachments);
+		vkDestroySwapchainKHR(_device, retired.swapChain, _pAllocationCallbacks);
+	}
+
+	void HelloTriangle::CreateOffscreenTargets()
+	{
+		TRACE_FUNCTION();
+
+		// One target per frame in flight, so a frame never has to wait on
+		// another frame's image before it can start rendering
+		_swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+		_swapChainExtent = { (uint32_t)window.Width(), (uint32_t)window.Height() };
+		_swapChainImages.resize(_settings.framesInFlight);
+		_offscreenImageAllocations.resize(_settings.framesInFlight);
+
+		for (size_t i = 0; i < _swapChainImages.size(); i++)
+		{
+			VkImageCreateInfo imageInfo = {};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = _swapChainImageFormat;
+			imageInfo.extent = { _swapChainExtent.width, _swapChainExtent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			// Transfer source so finished frames can be copied out
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+				(_settings.dynamicResolution ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0);
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			_allocator.CreateImage(imageInfo, MemoryUsage::GpuOnly, _swapChainImages[i], _offscreenImageAllocations[i]);
+		}
+	}
+
 	SwapChainSupportDetails HelloTriangle::QuerySwapChainSupport(VkPhysicalDevice device)
 	{
 		SwapChainSupportDetails details;
@@ -555,21 +1290,8 @@ namespace renderer {
 
 	VkPresentModeKHR HelloTriangle::ChooseSwapPresentMode(const vector<VkPresentModeKHR> availablePresentModes)
 	{
-		VkPresentModeKHR bestMode = VK_PRESENT_MODE_FIFO_KHR;
-
-		for (const auto& availablePresentMode : availablePresentModes)
-		{
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
-			{
-				return availablePresentMode;
-			}
-			else if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR)
-			{
-				bestMode = availablePresentMode;
-			}
-		}
-
-		return bestMode;
+		// Depends on the latency mode, unless the settings ask for one
+		return _framePacer.ChoosePresentMode(availablePresentModes, _settings.presentMode);
 	}
 
 	VkExtent2D HelloTriangle::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
@@ -581,7 +1303,7 @@ namespace renderer {
 			return capabilities.currentExtent;
 		}
 
-		VkExtent2D actualExtent = { (uint32_t)window.Width(), (uint32_t)window.Height() };
+		VkExtent2D actualExtent = window.FramebufferSize();
 		actualExtent.width = max(capabilities.minImageExtent.width,
 			min(capabilities.maxImageExtent.width, actualExtent.width));
 		actualExtent.height = max(capabilities.minImageExtent.height,
@@ -591,6 +1313,8 @@ namespace renderer {
 
 	void HelloTriangle::CreateImageViews()
 	{
+		TRACE_FUNCTION();
+
 		_swapChainImageViews.resize(_swapChainImages.size());
 
 		for (size_t i = 0; i < _swapChainImages.size(); i++)
@@ -610,36 +1334,645 @@ namespace renderer {
 			createInfo.subresourceRange.baseArrayLayer = 0;
 			createInfo.subresourceRange.layerCount = 1;
 
-			if (vkCreateImageView(_device, &createInfo, nullptr, &_swapChainImageViews[i]) != VK_SUCCESS)
+			if (vkCreateImageView(_device, &createInfo, _pAllocationCallbacks, &_swapChainImageViews[i]) != VK_SUCCESS)
 			{
 				throw runtime_error("Failed to create image view");
 			}
+
+			string name = (_settings.headless ? "Offscreen target " : "Swap chain image ") + to_string(i);
+			NameObject(VK_OBJECT_TYPE_IMAGE, (uint64_t)_swapChainImages[i], name);
+			NameObject(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)_swapChainImageViews[i], name);
+		}
+	}
+
+	void HelloTriangle::CreatePipelineCache()
+	{
+		TRACE_FUNCTION();
+
+		_pipelineCache.Load(_device, _pAllocationCallbacks, _physicalDevice, _settings.pipelineCachePath);
+		_startupTimings.pipelineCacheWarm = _pipelineCache.IsWarm();
+	}
+
+	void HelloTriangle::CreateRenderPass()
+	{
+		TRACE_FUNCTION();
+
+		VkAttachmentDescription colourAttachment = {};
+		colourAttachment.format = _swapChainImageFormat;
+		colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		// The render graph moves the image in and out of this layout, along
+		// with whatever waiting that needs
+		colourAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colourAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colourAttachmentRef = {};
+		colourAttachmentRef.attachment = 0;
+		colourAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		// Depth is only needed while the pass runs, so it is never stored
+		_depthFormat = ChooseDepthFormat();
+
+		VkAttachmentDescription depthAttachment = {};
+		depthAttachment.format = _depthFormat;
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference depthAttachmentRef = {};
+		depthAttachmentRef.attachment = 1;
+		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colourAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		VkAttachmentDescription attachments[] = { colourAttachment, depthAttachment };
+
+		VkRenderPassCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		createInfo.attachmentCount = 2;
+		createInfo.pAttachments = attachments;
+		createInfo.subpassCount = 1;
+		createInfo.pSubpasses = &subpass;
+
+		if (vkCreateRenderPass(_device, &createInfo, _pAllocationCallbacks, &_renderPass) != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to create render pass");
+		}
+
+		NameObject(VK_OBJECT_TYPE_RENDER_PASS, (uint64_t)_renderPass, "MainPass");
+	}
+
+	void HelloTriangle::CreateDescriptors()
+	{
+		TRACE_FUNCTION();
+
+		// Short lived sets, such as the indirect renderer's, come from per
+		// frame pools whether or not the device can do bindless
+		_descriptorAllocator.Initialise(_device, _pAllocationCallbacks, _settings.framesInFlight);
+
+		if (_bindlessSupported)
+		{
+			_bindless.Initialise(_device, _pAllocationCallbacks, _physicalDevice, _settings.framesInFlight);
 		}
 	}
 
 	void HelloTriangle::CreateGraphicsPipeline()
 	{
-		auto vertexShaderCode = _shader.ReadFile("ShaderData/vert.spv");
-		auto fragmentShaderCode = _shader.ReadFile("ShaderData/frag.spv");
+		TRACE_FUNCTION();
+
+		// Draws are told what to use through push constants. With bindless,
+		// the one set they index into is bound once per command buffer.
+		VkDescriptorSetLayout bindlessSetLayout = _bindless.SetLayout();
+		VkPushConstantRange pushConstantRange = BindlessDescriptors::PushConstantRange();
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = _bindlessSupported ? 1 : 0;
+		pipelineLayoutInfo.pSetLayouts = _bindlessSupported ? &bindlessSetLayout : nullptr;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		// A shader reload rebuilds the pipeline but keeps the layout
+		if (_pipelineLayout == VK_NULL_HANDLE && vkCreatePipelineLayout(_device, &pipelineLayoutInfo, _pAllocationCallbacks, &_pipelineLayout) != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to create pipeline layout");
+		}
+
+		NameObject(VK_OBJECT_TYPE_PIPELINE_LAYOUT, (uint64_t)_pipelineLayout, "MainPass");
+
+		// Owned by the shader cache, which outlives every pipeline made from them.
+		// Vertices are hardcoded in the vertex shader for now, and the
+		// triangles are flat and drawn in order, so depth is left alone.
+		GraphicsPipelineDesc desc;
+		desc.vertexShader = _shader.LoadModule("ShaderData/hellotriangle.vert.spv");
+		desc.fragmentShader = _shader.LoadModule("ShaderData/hellotriangle.frag.spv");
+		desc.variantFeatureCount = _fragmentVariants.FeatureCount();
+		desc.cullMode = VK_CULL_MODE_BACK_BIT;
+		desc.frontFace = VK_FRONT_FACE_CLOCKWISE;
+		desc.depthTest = false;
+		desc.depthWrite = false;
+		desc.layout = _pipelineLayout;
+		desc.renderPass = _renderPass;
+
+		// Nothing waits on these, so they compile in the background for
+		// whenever the features are switched
+		if (_settings.prewarmShaderVariants)
+		{
+			for (VariantKey key : _fragmentVariants.AllKeys())
+			{
+				desc.variantKey = key;
+				_pipelineManager.Request(desc);
+				_fragmentVariants.MarkGenerated(key);
+			}
+		}
+
+		// Compiles in the background. On a reload the current pipeline keeps
+		// drawing until its replacement is ready.
+		desc.variantKey = _fragmentVariant;
+		_graphicsPipeline = _pipelineManager.Request(desc, _graphicsPipeline);
+		_fragmentVariants.MarkGenerated(_fragmentVariant);
+	}
+
+	void HelloTriangle::CreateFramebuffers()
+	{
+		TRACE_FUNCTION();
+
+		_swapChainFramebuffers.resize(_swapChainImageViews.size());
+
+		for (size_t i = 0; i < _swapChainImageViews.size(); i++)
+		{
+			// Every frame shares the one depth buffer, which the render
+			// graph orders between frames. With dynamic resolution they share
+			// the scene colour target too, and the framebuffers are all alike.
+			VkImageView colourView = _settings.dynamicResolution ? _graphExecutor.GetImageView(_sceneColour) : _swapChainImageViews[i];
+			VkImageView attachments[] = { colourView, _graphExecutor.GetImageView(_depth) };
+
+			VkFramebufferCreateInfo createInfo = {};
+			createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			createInfo.renderPass = _renderPass;
+			createInfo.attachmentCount = 2;
+			createInfo.pAttachments = attachments;
+			createInfo.width = _swapChainExtent.width;
+			createInfo.height = _swapChainExtent.height;
+			createInfo.layers = 1;
+
+			if (vkCreateFramebuffer(_device, &createInfo, _pAllocationCallbacks, &_swapChainFramebuffers[i]) != VK_SUCCESS)
+			{
+				throw runtime_error("Failed to create framebuffer");
+			}
+
+			NameObject(VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t)_swapChainFramebuffers[i], "Framebuffer " + to_string(i));
+		}
+	}
+
+	void HelloTriangle::CreateFrameData()
+	{
+		TRACE_FUNCTION();
+
+		QueueFamilyIndices indices = FindQueueFamilies(_physicalDevice);
+
+		_frames.resize(_settings.framesInFlight);
+		_imagesInFlight.assign(_swapChainImages.size(), VK_NULL_HANDLE);
+		_currentFrame = 0;
+
+		for (auto& frame : _frames)
+		{
+			// One pool per frame, reset wholesale once the frame's fence
+			// has signalled rather than freeing buffers individually
+			VkCommandPoolCreateInfo poolInfo = {};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			poolInfo.queueFamilyIndex = indices.graphicsFamily;
+
+			if (vkCreateCommandPool(_device, &poolInfo, _pAllocationCallbacks, &frame.commandPool) != VK_SUCCESS)
+			{
+				throw runtime_error("Failed to create command pool");
+			}
+
+			VkCommandBufferAllocateInfo allocateInfo = {};
+			allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocateInfo.commandPool = frame.commandPool;
+			allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocateInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(_device, &allocateInfo, &frame.commandBuffer) != VK_SUCCESS)
+			{
+				throw runtime_error("Failed to allocate command buffer");
+			}
+
+			VkSemaphoreCreateInfo semaphoreInfo = {};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+			// Created signalled so the first wait on each frame returns immediately
+			VkFenceCreateInfo fenceInfo = {};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+			if (vkCreateSemaphore(_device, &semaphoreInfo, _pAllocationCallbacks, &frame.imageAvailableSemaphore) != VK_SUCCESS ||
+				vkCreateSemaphore(_device, &semaphoreInfo, _pAllocationCallbacks, &frame.renderFinishedSemaphore) != VK_SUCCESS ||
+				vkCreateFence(_device, &fenceInfo, _pAllocationCallbacks, &frame.inFlightFence) != VK_SUCCESS)
+			{
+				throw runtime_error("Failed to create frame synchronisation objects");
+			}
+		}
+
+		for (size_t i = 0; i < _frames.size(); i++)
+		{
+			string prefix = "Frame " + to_string(i) + " ";
+			NameObject(VK_OBJECT_TYPE_COMMAND_POOL, (uint64_t)_frames[i].commandPool, prefix + "command pool");
+			NameObject(VK_OBJECT_TYPE_COMMAND_BUFFER, (uint64_t)_frames[i].commandBuffer, prefix + "command buffer");
+			NameObject(VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)_frames[i].imageAvailableSemaphore, prefix + "image available");
+			NameObject(VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)_frames[i].renderFinishedSemaphore, prefix + "render finished");
+			NameObject(VK_OBJECT_TYPE_FENCE, (uint64_t)_frames[i].inFlightFence, prefix + "in flight");
+		}
+
+		// Draw recording is split into jobs, each thread with its own pool per frame
+		_recorder.Initialise(_device, _pAllocationCallbacks, indices.graphicsFamily, _settings.framesInFlight, _jobs);
+
+		_gpuProfiler.Initialise(_device, _pAllocationCallbacks, _physicalDevice, indices.graphicsFamily, _settings.framesInFlight);
+	}
+
+	void HelloTriangle::CreateRenderGraph()
+	{
+		TRACE_FUNCTION();
+
+		// Headless targets are left ready to be copied out rather than presented
+		_backbuffer = _renderGraph.ImportImage("Backbuffer", _swapChainImageFormat, _swapChainExtent,
+			ResourceUsage::ColourAttachment, _settings.headless ? ResourceUsage::TransferSrc : ResourceUsage::Present);
+
+		// Without separateDepthStencilLayouts a combined format's layout
+		// transitions have to cover the stencil aspect as well
+		VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+		if (_depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || _depthFormat == VK_FORMAT_D24_UNORM_S8_UINT)
+		{
+			depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+
+		_depth = _renderGraph.CreateImage("Depth", _depthFormat, _swapChainExtent, depthAspect);
+
+		// Sized for the full extent once, so changing the scale never
+		// allocates, only the viewport moves
+		if (_settings.dynamicResolution)
+		{
+			if (!DynamicResolution::QuerySupport(_physicalDevice, _swapChainImageFormat))
+			{
+				throw runtime_error("Failed to set up dynamic resolution, the swap chain format cannot be blitted with a linear filter");
+			}
+
+			_sceneColour = _renderGraph.CreateImage("SceneColour", _swapChainImageFormat, _swapChainExtent);
+			_dynamicResolution.Initialise(_settings.gpuBudgetMs, _settings.minResolutionScale, _settings.framesInFlight);
+		}
+
+		_renderExtent = _swapChainExtent;
+
+		ResourceHandle drawCommands = 0;
+		ResourceHandle drawCount = 0;
+
+		if (_settings.instanceCount > 0)
+		{
+			_indirectRenderer.AddPasses(_renderGraph, drawCommands, drawCount);
+		}
+
+		PassHandle mainPass = _renderGraph.AddPass("MainPass", [this](VkCommandBuffer commandBuffer) { RecordMainPass(commandBuffer); });
+		_renderGraph.Write(mainPass, _settings.dynamicResolution ? _sceneColour : _backbuffer, ResourceUsage::ColourAttachment);
+		_renderGraph.Write(mainPass, _depth, ResourceUsage::DepthStencilAttachment);
+
+		if (_settings.instanceCount > 0)
+		{
+			_renderGraph.Read(mainPass, drawCommands, ResourceUsage::IndirectBuffer);
+			_renderGraph.Read(mainPass, drawCount, ResourceUsage::IndirectBuffer);
+		}
+
+		if (_settings.dynamicResolution)
+		{
+			PassHandle upscalePass = _renderGraph.AddPass("Upscale", [this](VkCommandBuffer commandBuffer) { RecordUpscalePass(commandBuffer); });
+			_renderGraph.Read(upscalePass, _sceneColour, ResourceUsage::TransferSrc);
+			_renderGraph.Write(upscalePass, _backbuffer, ResourceUsage::TransferDst);
+		}
+
+		_compiledGraph = _renderGraph.Compile();
+
+		_graphExecutor.Initialise(_device, _pAllocationCallbacks, _allocator);
+		_graphExecutor.Realise(_renderGraph, _compiledGraph);
+		NameGraphResources();
+
+		if (_settings.instanceCount > 0)
+		{
+			_indirectRenderer.BindResources(_graphExecutor);
+		}
+	}
+
+	void HelloTriangle::CreateScene()
+	{
+		TRACE_FUNCTION();
+
+		if (_settings.instanceCount == 0)
+		{
+			return;
+		}
+
+		if (!_indirectSupport.supported)
+		{
+			throw runtime_error("Failed to create scene, indirect drawing needs multiDrawIndirect and drawIndirectFirstInstance");
+		}
+
+		_indirectRenderer.Initialise(_device, _pAllocationCallbacks, _physicalDevice, _allocator, _uniformRing, _descriptorAllocator, _uploadEngine,
+			_shader, _pipelineManager, _fragmentVariants, _fragmentVariant, _settings.prewarmShaderVariants, _renderPass, _indirectSupport);
+
+		// Mesh files stay mapped only until SetScene has copied them into
+		// staging memory
+		vector<PackedMesh> builtInMeshes;
+		vector<MeshFile> meshFiles(_settings.meshPaths.size());
+		vector<InstanceData> instances;
+		uint32_t meshCount = _settings.meshPaths.empty() ? 3 : (uint32_t)meshFiles.size();
+
+		// Every mesh and the instance list are decoded as jobs of their own,
+		// and the main thread takes a share of them while it waits
+		JobCounter decoded;
+
+		if (_settings.meshPaths.empty())
+		{
+			builtInMeshes.resize(meshCount);
+			_jobs.Run([&] { builtInMeshes[0] = Quantise(CreateCube()); }, &decoded);
+			_jobs.Run([&] { builtInMeshes[1] = Quantise(CreateOctahedron()); }, &decoded);
+			_jobs.Run([&] { builtInMeshes[2] = Quantise(CreateTetrahedron()); }, &decoded);
+		}
+
+		for (size_t i = 0; i < meshFiles.size(); i++)
+		{
+			_jobs.Run([&, i] { meshFiles[i].Open(_settings.meshPaths[i]); }, &decoded);
+		}
+
+		_jobs.Run([&] { instances = GenerateInstances(_settings.instanceCount, meshCount, InstanceSpacing); }, &decoded);
+		_jobs.Wait(decoded);
+
+		vector<MeshView> meshes;
+
+		for (const auto& mesh : builtInMeshes)
+		{
+			meshes.push_back(mesh.View());
+		}
+
+		for (const auto& meshFile : meshFiles)
+		{
+			meshes.push_back(meshFile.View());
+		}
+
+		_indirectRenderer.SetScene(meshes, instances);
+	}
+
+	void HelloTriangle::CompileShaders()
+	{
+		TRACE_FUNCTION();
+
+		if (!ShaderCompiler::IsAvailable())
+		{
+			if (_settings.shaderHotReload)
+			{
+				cerr << "Shader hot reload needs the shader compiler, rebuild with ENABLE_SHADER_COMPILER=1" << endl;
+			}
+
+			return;
+		}
+
+		_shaderCompiler.Initialise(ShaderCacheDirectory);
+
+		// Brings every .spv up to date before any pipeline loads it. An
+		// unchanged source is a cache hit, so this costs little after the
+		// first run.
+		error_code error;
+
+		for (const auto& entry : filesystem::directory_iterator(ShaderDirectory, error))
+		{
+			string sourcePath = entry.path().generic_string();
+
+			if (!ShaderCompiler::IsShaderSource(sourcePath))
+			{
+				continue;
+			}
+
+			vector<uint32_t> spirv;
+			string errors;
+
+			// Falls back to whatever .spv is already there
+			if (!_shaderCompiler.CompileToFile(sourcePath, spirv, errors))
+			{
+				cerr << errors << endl;
+			}
+		}
+
+		if (_settings.shaderHotReload)
+		{
+			_shaderWatcher.Start(_shaderCompiler, ShaderDirectory);
+		}
+	}
+
+	void HelloTriangle::ApplyShaderReloads()
+	{
+		vector<CompiledShader> compiled = _shaderWatcher.TakeCompiled();
 
-		VkShaderModule vertexShaderModule = _shader.CreateShaderModule(_device, vertexShaderCode);
-		VkShaderModule fragmentShaderModule = _shader.CreateShaderModule(_device, fragmentShaderCode);
+		if (compiled.empty())
+		{
+			return;
+		}
+
+		TRACE_SCOPE("ReloadPipelines");
 
-		VkPipelineShaderStageCreateInfo vertexShaderStageInfo = {};
-		vertexShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertexShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertexShaderStageInfo.module = vertexShaderModule;
-		vertexShaderStageInfo.pName = "main";
+		for (const auto& shader : compiled)
+		{
+			_shader.ReplaceModule(shader.spirvPath, shader.code.data(), shader.code.size() * sizeof(uint32_t));
+		}
+
+		// With this few pipelines, requesting them all is simpler than
+		// working out which use the changed shaders. Any whose shaders did
+		// not change match their old description and are not compiled again.
+		CreateGraphicsPipeline();
+		_indirectRenderer.ReloadPipelines(_shader, _renderPass);
+	}
+
+	glm::mat4 HelloTriangle::CameraViewProjection()
+	{
+		// Circles the instance field from just inside its edge, so some of
+		// it is always behind the camera and culled
+		float halfExtent = 0.5f * InstanceSpacing * cbrt((float)_settings.instanceCount);
+		float angle = _frameCount / 600.0f * 2.0f * 3.14159265f;
+		glm::vec3 eye(cos(angle) * halfExtent, 0.25f * halfExtent, sin(angle) * halfExtent);
+
+		float aspect = (float)_swapChainExtent.width / (float)_swapChainExtent.height;
+		glm::mat4 projection = glm::perspective(glm::radians(60.0f), aspect, 0.1f, 4.0f * halfExtent);
+		glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+		// Vulkan's clip space y points down
+		projection[1][1] *= -1.0f;
+
+		return projection * view;
+	}
 
-		VkPipelineShaderStageCreateInfo fragmentShaderStageInfo = {};
-		fragmentShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragmentShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragmentShaderStageInfo.module = fragmentShaderModule;
-		fragmentShaderStageInfo.pName = "main";
+	VkFormat HelloTriangle::ChooseDepthFormat()
+	{
+		for (VkFormat format : { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT })
+		{
+			VkFormatProperties properties;
+			vkGetPhysicalDeviceFormatProperties(_physicalDevice, format, &properties);
+
+			if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+			{
+				return format;
+			}
+		}
+
+		throw runtime_error("Failed to find a supported depth format");
+	}
+
+	void HelloTriangle::RecordCommandBuffer(FrameData& frame, uint32_t imageIndex)
+	{
+		TRACE_FUNCTION();
+		ScopedAccumulator recordTime(_frameTimings.recordMs);
+
+		VkCommandBuffer commandBuffer = frame.commandBuffer;
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to begin recording command buffer");
+		}
+
+		// Before acquiring uploads, so the scene only draws once it has them
+		if (_settings.instanceCount > 0)
+		{
+			_indirectRenderer.Update(CameraViewProjection(), _currentFrame);
+		}
 
-		VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderStageInfo, fragmentShaderStageInfo };
+		// Take ownership of whatever the transfer queue has finished uploading
+		_uploadEngine.AcquireCompleted(commandBuffer, _currentFrame, frame.waitSemaphores, frame.waitStages);
 
-		vkDestroyShaderModule(_device, vertexShaderModule, nullptr);
-		vkDestroyShaderModule(_device, fragmentShaderModule, nullptr);
+		// Picks up this frame slot's timestamps from framesInFlight frames ago
+		_gpuProfiler.BeginFrame(commandBuffer, _currentFrame);
+
+		// Straight after the read back, so the scale reacts as soon as it can
+		if (_settings.dynamicResolution)
+		{
+			_dynamicResolution.Update(_gpuProfiler);
+			_renderExtent = _dynamicResolution.RenderExtent(_swapChainExtent);
+		}
+		else
+		{
+			_renderExtent = _swapChainExtent;
+		}
+
+		// The graph's barriers take the image from the presentation engine
+		// and hand it back, the passes only record what goes between
+		_currentImageIndex = imageIndex;
+		_graphExecutor.BindImage(_backbuffer, _swapChainImages[imageIndex], _swapChainImageViews[imageIndex]);
+		_graphExecutor.Execute(commandBuffer, _renderGraph, _compiledGraph);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			throw runtime_error("Failed to record command buffer");
+		}
+	}
+
+	void HelloTriangle::RecordMainPass(VkCommandBuffer commandBuffer)
+	{
+		uint32_t passScope = _gpuProfiler.BeginScope(commandBuffer, _currentFrame, "MainPass");
+
+		VkClearValue clearValues[2] = {};
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = _renderPass;
+		renderPassInfo.framebuffer = _swapChainFramebuffers[_currentImageIndex];
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = _renderExtent;
+		renderPassInfo.clearValueCount = 2;
+		renderPassInfo.pClearValues = clearValues;
+
+		VkViewport viewport = {};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float)_renderExtent.width;
+		viewport.height = (float)_renderExtent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+
+		VkRect2D scissor = {};
+		scissor.offset = { 0, 0 };
+		scissor.extent = _renderExtent;
+
+		// The GPU driven path is one indirect call, with nothing to split
+		// across threads
+		if (_settings.instanceCount > 0)
+		{
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+			_indirectRenderer.RecordDraw(commandBuffer, viewport, scissor);
+			vkCmdEndRenderPass(commandBuffer);
+
+			_gpuProfiler.EndScope(commandBuffer, _currentFrame, passScope);
+			return;
+		}
+
+		// Looked up once so every slice draws with the same pipeline. It is
+		// only null if the first compile has not finished, and then the
+		// pass just clears.
+		VkPipeline graphicsPipeline = _pipelineManager.Get(_graphicsPipeline);
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+		// Secondary buffers inherit nothing but the render pass, so each
+		// slice binds its own pipeline and dynamic state
+		const vector<VkCommandBuffer>& secondaries = _recorder.Record(_currentFrame, _renderPass, 0,
+			_swapChainFramebuffers[_currentImageIndex], _settings.drawCount,
+			[&](VkCommandBuffer secondary, uint32_t firstDraw, uint32_t drawCount)
+			{
+				if (graphicsPipeline == VK_NULL_HANDLE)
+				{
+					return;
+				}
+
+				vkCmdBindPipeline(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+				_fragmentVariants.MarkUsed(_fragmentVariant);
+				vkCmdSetViewport(secondary, 0, 1, &viewport);
+				vkCmdSetScissor(secondary, 0, 1, &scissor);
+
+				if (_bindlessSupported)
+				{
+					_bindless.Bind(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout);
+				}
+
+				// Nothing is rebound between draws, only the indices change.
+				// The triangle shaders sample nothing yet, so nothing is
+				// registered and every resource index is left invalid.
+				BindlessPushConstants constants = { 0, InvalidBindlessIndex, InvalidBindlessIndex, InvalidBindlessIndex };
+
+				for (uint32_t i = firstDraw; i < firstDraw + drawCount; i++)
+				{
+					constants.drawIndex = i;
+					vkCmdPushConstants(secondary, _pipelineLayout, BindlessDescriptors::Stages, 0, sizeof(constants), &constants);
+					vkCmdDraw(secondary, 3, 1, 0, i);
+				}
+			});
+
+		vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		_gpuProfiler.EndScope(commandBuffer, _currentFrame, passScope);
+	}
+
+	void HelloTriangle::RecordUpscalePass(VkCommandBuffer commandBuffer)
+	{
+		GpuScope scope(_gpuProfiler, commandBuffer, _currentFrame, "Upscale");
+
+		// Filtered up from the part of the scene target that was rendered
+		// to, over the whole backbuffer
+		VkImageBlit region = {};
+		region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.srcSubresource.layerCount = 1;
+		region.srcOffsets[1] = { (int32_t)_renderExtent.width, (int32_t)_renderExtent.height, 1 };
+		region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.dstSubresource.layerCount = 1;
+		region.dstOffsets[1] = { (int32_t)_swapChainExtent.width, (int32_t)_swapChainExtent.height, 1 };
+
+		vkCmdBlitImage(commandBuffer,
+			_graphExecutor.GetImage(_sceneColour), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			_graphExecutor.GetImage(_backbuffer), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &region, VK_FILTER_LINEAR);
 	}
 }
\ No newline at end of file
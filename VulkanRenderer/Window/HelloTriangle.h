@@ -1,12 +1,48 @@
 #pragma once
+#include <memory>
+#include <ostream>
+#include <string>
 #include <vector>
 
 #include "../Common/Common.h"
+#include "../Descriptor/BindlessDescriptors.h"
+#include "../Descriptor/DescriptorAllocator.h"
+#include "../Indirect/IndirectRenderer.h"
+#include "../Memory/DeviceAllocator.h"
+#include "../Memory/HostAllocator.h"
+#include "../Memory/UniformRing.h"
+#include "../Mesh/MeshFile.h"
+#include "../Pipeline/PipelineCache.h"
+#include "../Pipeline/PipelineManager.h"
+#include "../Presentation/DynamicResolution.h"
+#include "../Presentation/FramePacer.h"
+#include "../Profiling/GpuProfiler.h"
+#include "../Recording/ParallelRecorder.h"
+#include "../RenderGraph/RenderGraph.h"
+#include "../RenderGraph/RenderGraphExecutor.h"
 #include "../Shader/Shader.h"
+#include "../Shader/ShaderCompiler.h"
+#include "../Shader/ShaderVariants.h"
+#include "../Shader/ShaderWatcher.h"
+#include "../Threading/JobSystem.h"
+#include "../Transfer/UploadEngine.h"
+#include "../Validation/ValidationSink.h"
 
 #include "RenderWindow.h"
 
 using namespace shader;
+using namespace pipeline;
+using namespace memory;
+using namespace transfer;
+using namespace profiling;
+using namespace recording;
+using namespace threading;
+using namespace rendergraph;
+using namespace descriptor;
+using namespace indirect;
+using namespace mesh;
+using namespace presentation;
+using namespace validation;
 
 namespace renderer {
 
@@ -15,10 +51,19 @@ namespace renderer {
 		int graphicsFamily = -1;
 		int presentFamily = -1;
 
+		// Families with no graphics support, when the device has them, so
+		// uploads and compute work can run alongside rendering. Both fall
+		// back to the graphics family otherwise.
+		int transferFamily = -1;
+		int computeFamily = -1;
+
+		// Headless rendering never presents, so it has no use for a present family
+		bool presentRequired = true;
+
 		bool IsComplete()
 		{
 			return graphicsFamily >= 0 &&
-				presentFamily >= 0;
+				(presentFamily >= 0 || !presentRequired);
 		}
 	};
 
@@ -29,57 +74,241 @@ namespace renderer {
 		std::vector<VkPresentModeKHR> presentModes;
 	};
 
+	// Filled in from Data/window.settings.json by SettingsLoader, then
+	// overridden from the command line
+	struct RendererSettings
+	{
+		// Window size in screen coordinates, also the size of the headless targets
+		int windowWidth = 800;
+		int windowHeight = 600;
+		bool windowResizable = true;
+
+		// How many frames the CPU may record ahead of the GPU
+		uint32_t framesInFlight = 2;
+
+		// Present mode the swap chain is created with, in place of the one
+		// latencyMode picks. VK_PRESENT_MODE_MAX_ENUM_KHR leaves it to the
+		// latency mode, as does a mode the surface does not support.
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+
+		// Enable the validation layers and report their messages
+#ifdef NDEBUG
+		bool validation = false;
+#else
+		bool validation = true;
+#endif
+
+		// Where the pipeline cache is loaded from and saved back to
+		std::string pipelineCachePath = "Data/pipeline.cache";
+
+		// Render into device owned images with no window, surface or swap chain
+		bool headless = false;
+
+		// With no window to close, a headless run stops after this many frames
+		uint32_t headlessFrameCount = 1000;
+
+		// Present mode, swap chain length and how far the CPU may run ahead
+		// of the GPU, traded between throughput and latency
+		LatencyMode latencyMode = LatencyMode::Throughput;
+
+		// Frames start no closer together than this, 0 to start each as soon as possible
+		double targetFrameMs = 0.0;
+
+		// Print frame interval and latency histograms at the end of the run
+		bool latencyReport = false;
+
+		// Render the scene at a fraction of the swap chain extent and upscale
+		// it, picking the fraction to keep GPU frame time under gpuBudgetMs
+		bool dynamicResolution = false;
+		double gpuBudgetMs = 14.0;
+		float minResolutionScale = 0.5f;
+
+		// Job threads, including the main thread, 0 for one per hardware thread
+		uint32_t workerCount = 0;
+
+		// Triangles drawn per frame, each its own draw call
+		uint32_t drawCount = 1;
+
+		// Instances drawn by the GPU driven path in place of the triangles,
+		// culled on the GPU and drawn with one indirect call. 0 keeps the
+		// triangles.
+		uint32_t instanceCount = 0;
+
+		// .vmesh files the instances are drawn with, in place of the built in shapes
+		std::vector<std::string> meshPaths;
+
+		// Recompile shaders as their sources change and swap the rebuilt
+		// pipelines in between frames. Needs the shader compiler.
+		bool shaderHotReload = false;
+
+		// Features hellotriangle.frag is specialised with, by name
+		std::vector<std::string> shaderFeatures;
+
+		// Compile a pipeline for every permutation of the features, not just
+		// the ones drawn with
+		bool prewarmShaderVariants = false;
+
+		// Report which shader variants were generated and used, and how many
+		// shaders were compiled or taken from the cache, at the end of the run
+		bool shaderVariantReport = false;
+
+		// Hand the driver's host allocations to HostAllocator rather than
+		// its own malloc, counting them per allocation scope
+		bool hostAllocator = true;
+
+		// Report the driver's host allocations per frame at the end of the run
+		bool hostAllocationReport = false;
+	};
+
+	// Everything one in-flight frame owns, so the CPU can record frame N+1
+	// while the GPU is still working on frame N
+	struct FrameData
+	{
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+		VkSemaphore renderFinishedSemaphore = VK_NULL_HANDLE;
+		VkFence inFlightFence = VK_NULL_HANDLE;
+
+		// Everything the frame's submit waits on, rebuilt every frame
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<VkPipelineStageFlags> waitStages;
+	};
+
+	// A swap chain replaced by a resize, and everything built on its images.
+	// Frames recorded before the replacement may still be rendering to or
+	// presenting from it, so it is destroyed once their fences have
+	// signalled rather than after waiting for the device to go idle.
+	struct RetiredSwapChain
+	{
+		VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+		std::vector<VkImageView> imageViews;
+		std::vector<VkFramebuffer> framebuffers;
+
+		// Only set if the resize changed the attachments' size
+		RetiredImages attachments;
+
+		// Frames numbered below this were recorded against it
+		uint32_t retiredAtFrame = 0;
+	};
+
+	struct StartupTimings
+	{
+		double initialiseVulkanMs = 0.0;
+		double graphicsPipelineMs = 0.0;
+		bool pipelineCacheWarm = false;
+	};
+
+	// CPU time spent in DrawFrame, split into time blocked on the GPU or
+	// swap chain and time spent recording command buffers
+	struct FrameTimings
+	{
+		double frameMs = 0.0;
+		double waitMs = 0.0;
+		double recordMs = 0.0;
+		uint32_t frameCount = 0;
+
+		double MeanFrameMs() const { return frameCount > 0 ? frameMs / frameCount : 0.0; }
+		double MeanWaitMs() const { return frameCount > 0 ? waitMs / frameCount : 0.0; }
+		double MeanRecordMs() const { return frameCount > 0 ? recordMs / frameCount : 0.0; }
+		double MeanBusyMs() const { return MeanFrameMs() - MeanWaitMs(); }
+	};
+
 	class HelloTriangle
 	{
 
 	public:
 
-		void Run();
+		HelloTriangle(const RendererSettings& settings = RendererSettings());
+
+		// The caller drives the loop, calling DrawFrame until ShouldClose
+		void Initialise();
+		bool ShouldClose();
+		bool IsMinimised();
+		void DrawFrame();
+		void CleanUp();
+
+		const StartupTimings& GetStartupTimings() { return _startupTimings; };
+		const FrameTimings& GetFrameTimings() { return _frameTimings; };
+
+		// CPU and GPU frame costs side by side, and which of the two bounds the frame rate
+		void PrintFrameReport(std::ostream& stream);
+
+		static const char* ShaderDirectory;
+		static const char* ShaderCacheDirectory;
 
 	private:
 
 		void InitialiseWindow();
 		void InitialiseVulkan();
-		void CleanUp();
-		void MainLoop();
 
 		void CreateInstance();
 		bool CheckValidationLayerSupport();
 		std::vector<const char*> GetRequiredExtensions();
 		void SetupDebugCallback();
+		VkDebugUtilsMessengerCreateInfoEXT DebugMessengerCreateInfo();
+		void NameObject(VkObjectType objectType, uint64_t objectHandle, const std::string& name);
+		void NameGraphResources();
 		void PickPhysicalDevice();
 		bool IsPhysicalDeviceSuitable(VkPhysicalDevice device);
 		bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
+		std::vector<const char*> GetRequiredDeviceExtensions();
 		//int RateDeviceSuitability(VkPhysicalDevice device);
 		QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device);
 		void CreateLogicalDevice();
 		void CreateSurface();
 		void CreateSwapChain();
+		bool RecreateSwapChain();
+		void ResizeAttachments(RetiredImages& retired);
+		void DestroyFinishedSwapChains();
+		void DestroyRetiredSwapChain(RetiredSwapChain& retired);
+		void CreateOffscreenTargets();
 		void CreateImageViews();
+		void CreatePipelineCache();
+		void CreateRenderPass();
+		void CreateDescriptors();
 		void CreateGraphicsPipeline();
+		void CreateFramebuffers();
+		void CreateFrameData();
+		void CreateScene();
+		void CreateRenderGraph();
+		void CompileShaders();
+		void ApplyShaderReloads();
+		void RecordCommandBuffer(FrameData& frame, uint32_t imageIndex);
+		void RecordMainPass(VkCommandBuffer commandBuffer);
+		void RecordUpscalePass(VkCommandBuffer commandBuffer);
+		glm::mat4 CameraViewProjection();
+		VkFormat ChooseDepthFormat();
 
 		SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device);
 		VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 		VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR> availablePresentModes);
 		VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 
+		RendererSettings _settings;
+
 		// Window variables
 		RenderWindow window;
 		GLFWwindow* pWindow;
 
+		// Host memory for the driver. Declared ahead of every Vulkan member,
+		// so it outlives everything created with its callbacks.
+		HostAllocator _hostAllocator;
+		const VkAllocationCallbacks* _pAllocationCallbacks = nullptr;
+		HostAllocator::Statistics _hostAllocationsAtFirstFrame;
+
 		// Vulkan variables
 		VkInstance _instance;
 
 		// Validation
 		const std::vector<const char*> _validationLayers = {
-			"VK_LAYER_LUNARG_standard_validation"
+			"VK_LAYER_KHRONOS_validation"
 		};
 
-#ifdef NDEBUG
-		const bool _enableValidationLayers = false;
-#else
-		const bool _enableValidationLayers = true;
-#endif
+		// Validation messages are printed from its thread, never from
+		// inside the Vulkan call that raised them
+		ValidationSink _validationSink;
+		VkDebugUtilsMessengerEXT _debugMessenger = VK_NULL_HANDLE;
 
 		// Extensions
 		const std::vector<const char*> _deviceExtensions =
@@ -87,25 +316,93 @@ namespace renderer {
 			VK_KHR_SWAPCHAIN_EXTENSION_NAME
 		};
 
-		VkDebugReportCallbackEXT _debugCallback;
-
 		// Devices
 		VkPhysicalDevice _physicalDevice = VK_NULL_HANDLE;
 		VkDevice _device;
 
+		DeviceAllocator _allocator;
+		UploadEngine _uploadEngine;
+		UniformRing _uniformRing;
+
+		QueueFamilyIndices _queueFamilies;
 		VkQueue _graphicsQueue;
 		VkQueue _presentationQueue;
+		VkQueue _transferQueue;
+		VkQueue _computeQueue;
 
 		VkSurfaceKHR _surface;
 
-		VkSwapchainKHR _swapChain;
+		VkSwapchainKHR _swapChain = VK_NULL_HANDLE;
 		std::vector<VkImage> _swapChainImages;
 		VkFormat _swapChainImageFormat;
 		VkExtent2D _swapChainExtent;
 		std::vector<VkImageView> _swapChainImageViews;
 
+		// Set when the window is resized or presenting reports the swap
+		// chain no longer matches the surface, and cleared by recreating it
+		bool _swapChainStale = false;
+		std::vector<RetiredSwapChain> _retiredSwapChains;
+		uint32_t _swapChainRecreations = 0;
+
+		// Headless mode renders into these in place of swap chain images
+		std::vector<Allocation> _offscreenImageAllocations;
+
+		// Pipeline
+		PipelineCache _pipelineCache;
+		VkRenderPass _renderPass;
+		PipelineManager _pipelineManager;
+		VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+		PipelineHandle _graphicsPipeline = InvalidPipeline;
+
+		// Descriptors
+		DescriptorAllocator _descriptorAllocator;
+		BindlessDescriptors _bindless;
+		bool _bindlessSupported = false;
+
+		// Built and compiled once, replayed every frame against the acquired image
+		RenderGraph _renderGraph;
+		CompiledGraph _compiledGraph;
+		RenderGraphExecutor _graphExecutor;
+		ResourceHandle _backbuffer = 0;
+		ResourceHandle _depth = 0;
+		VkFormat _depthFormat = VK_FORMAT_UNDEFINED;
+
+		// With dynamic resolution the scene renders into the top left
+		// _renderExtent of this, and the upscale pass blits it to the
+		// backbuffer. Otherwise _renderExtent is the swap chain extent.
+		ResourceHandle _sceneColour = 0;
+		VkExtent2D _renderExtent = {};
+		DynamicResolution _dynamicResolution;
+
+		// Culling, recording and loading run as jobs on every core
+		JobSystem _jobs;
+
+		// GPU driven scene
+		static constexpr float InstanceSpacing = 3.0f;
+		IndirectSupport _indirectSupport;
+		IndirectRenderer _indirectRenderer;
+
+		// Frame loop
+		std::vector<VkFramebuffer> _swapChainFramebuffers;
+		std::vector<FrameData> _frames;
+		std::vector<VkFence> _imagesInFlight;
+		ParallelRecorder _recorder;
+		GpuProfiler _gpuProfiler;
+		FramePacer _framePacer;
+		bool _displayTimingSupported = false;
+		uint32_t _currentFrame = 0;
+		uint32_t _currentImageIndex = 0;
+		uint32_t _frameCount = 0;
+
 		// Shaders
 		Shader _shader;
+		ShaderCompiler _shaderCompiler;
+		ShaderWatcher _shaderWatcher;
+		ShaderVariants _fragmentVariants;
+		VariantKey _fragmentVariant = 0;
+
+		StartupTimings _startupTimings;
+		FrameTimings _frameTimings;
 	};
 }
 
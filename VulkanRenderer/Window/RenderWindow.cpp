@@ -11,6 +11,13 @@ namespace renderer {
       return pWindow;
    }
 
+   void RenderWindow::Configure(int width, int height, bool resizable)
+   {
+      windowWidth = width;
+      windowHeight = height;
+      windowResizable = resizable;
+   }
+
    void RenderWindow::Destroy()
    {
       glfwDestroyWindow(pWindow);
@@ -21,8 +28,35 @@ namespace renderer {
    {
       glfwInit();
       glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);  // Do not create an OpenGL context
-      glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // Disable window resizing
+      glfwWindowHint(GLFW_RESIZABLE, windowResizable ? GLFW_TRUE : GLFW_FALSE);
 
       pWindow = glfwCreateWindow(windowWidth, windowHeight, pWindowTitle, nullptr, nullptr);
+
+      glfwSetWindowUserPointer(pWindow, this);
+      glfwSetFramebufferSizeCallback(pWindow, FramebufferSizeCallback);
+   }
+
+   VkExtent2D RenderWindow::FramebufferSize()
+   {
+      int width = 0;
+      int height = 0;
+      glfwGetFramebufferSize(Get(), &width, &height);
+
+      return { (uint32_t)width, (uint32_t)height };
+   }
+
+   bool RenderWindow::ConsumeResize()
+   {
+      bool wasResized = resized;
+      resized = false;
+      return wasResized;
+   }
+
+   void RenderWindow::FramebufferSizeCallback(GLFWwindow* pWindow, int width, int height)
+   {
+      // Dragging the border fires this many times a frame, so it only
+      // marks the swap chain stale and the next frame rebuilds it once
+      RenderWindow* pRenderWindow = static_cast<RenderWindow*>(glfwGetWindowUserPointer(pWindow));
+      pRenderWindow->resized = true;
    }
 }
\ No newline at end of file
@@ -6,16 +6,29 @@ namespace renderer {
    public:
       void Destroy();
       GLFWwindow* Get();
+
+      // Before the window is first created
+      void Configure(int width, int height, bool resizable);
       
       int Width() { return windowWidth; };
       int Height() { return windowHeight; };
 
+      // The drawable size in pixels, 0 by 0 while minimised
+      VkExtent2D FramebufferSize();
+
+      // True once after every change to the framebuffer size
+      bool ConsumeResize();
+
    private:
       void Initialise();
 
-      const int windowWidth = 800;
-      const int windowHeight = 600;
+      static void FramebufferSizeCallback(GLFWwindow* pWindow, int width, int height);
+
+      int windowWidth = 800;
+      int windowHeight = 600;
+      bool windowResizable = true;
       const char* pWindowTitle = "Vulkan Triangle";
-      GLFWwindow* pWindow;
+      GLFWwindow* pWindow = nullptr;
+      bool resized = false;
    };
 }
\ No newline at end of file
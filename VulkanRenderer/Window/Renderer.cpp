@@ -91,7 +91,7 @@ namespace renderer {
 
       if (_enableValidationLayers)
       {
-         extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
       }
 
       return extensions;
@@ -20,7 +20,7 @@ namespace renderer {
 
 		// Validation
 		const std::vector<const char*> _validationLayers = {
-			"VK_LAYER_LUNARG_standard_validation"
+			"VK_LAYER_KHRONOS_validation"
 		};
 
 #ifdef NDEBUG
@@ -35,7 +35,7 @@ namespace renderer {
 			VK_KHR_SWAPCHAIN_EXTENSION_NAME
 		};
 
-		VkDebugReportCallbackEXT _debugCallback;
+		VkDebugUtilsMessengerEXT _debugMessenger;
    };
 
 }
\ No newline at end of file
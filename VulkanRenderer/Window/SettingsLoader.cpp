@@ -0,0 +1,223 @@
+#include "SettingsLoader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace renderer {
+
+   namespace {
+      const string SectionNames[] = { "window", "renderer", "latency", "dynamicResolution", "scene", "shaders", "memory" };
+
+      // Reads the keys of one section it is asked for, and can then warn
+      // about any it was not, as a misspelt key would otherwise be silently
+      // ignored and a sweep would measure the same thing every run
+      class SectionReader {
+      public:
+         SectionReader(const json& root, const char* name) :
+            _name(name)
+         {
+            auto section = root.find(name);
+
+            if (section != root.end())
+            {
+               if (!section->is_object())
+               {
+                  throw runtime_error(string("section ") + name + " is not an object");
+               }
+
+               _pSection = &*section;
+            }
+         }
+
+         void WarnUnknownKeys() const
+         {
+            if (!_pSection)
+            {
+               return;
+            }
+
+            for (auto item = _pSection->begin(); item != _pSection->end(); ++item)
+            {
+               if (find(_readKeys.begin(), _readKeys.end(), item.key()) == _readKeys.end())
+               {
+                  cerr << "Ignoring unknown setting " << _name << "." << item.key() << endl;
+               }
+            }
+         }
+
+         template<typename T>
+         bool Read(const char* key, T& value)
+         {
+            _readKeys.push_back(key);
+
+            if (!_pSection)
+            {
+               return false;
+            }
+
+            auto item = _pSection->find(key);
+
+            if (item == _pSection->end())
+            {
+               return false;
+            }
+
+            value = item->get<T>();
+            return true;
+         }
+
+      private:
+         const char* _name;
+         const json* _pSection = nullptr;
+         vector<string> _readKeys;
+      };
+   }
+
+   const char* SettingsLoader::DefaultPath = "Data/window.settings.json";
+
+   bool SettingsLoader::Load(const string& path, RendererSettings& settings)
+   {
+      ifstream file(path);
+
+      if (!file.is_open())
+      {
+         return false;
+      }
+
+      try
+      {
+         json root = json::parse(file);
+
+         if (!root.is_object())
+         {
+            throw runtime_error("the top level is not an object");
+         }
+
+         for (auto section = root.begin(); section != root.end(); ++section)
+         {
+            if (find(begin(SectionNames), end(SectionNames), section.key()) == end(SectionNames))
+            {
+               cerr << "Ignoring unknown settings section " << section.key() << endl;
+            }
+         }
+
+         {
+            SectionReader window(root, "window");
+            window.Read("width", settings.windowWidth);
+            window.Read("height", settings.windowHeight);
+            window.Read("resize", settings.windowResizable);
+            window.WarnUnknownKeys();
+         }
+
+         {
+            SectionReader renderer(root, "renderer");
+            renderer.Read("framesInFlight", settings.framesInFlight);
+            renderer.Read("workerCount", settings.workerCount);
+            renderer.Read("validation", settings.validation);
+            renderer.Read("pipelineCachePath", settings.pipelineCachePath);
+            renderer.Read("headless", settings.headless);
+            renderer.Read("headlessFrameCount", settings.headlessFrameCount);
+
+            // "latency" leaves it to the latency mode
+            string presentMode;
+
+            if (renderer.Read("presentMode", presentMode))
+            {
+               if (presentMode == "latency")
+               {
+                  settings.presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+               }
+               else if (!ParsePresentMode(presentMode, settings.presentMode))
+               {
+                  throw runtime_error("unknown present mode " + presentMode +
+                     ", expected latency, immediate, mailbox, fifo or fifo-relaxed");
+               }
+            }
+
+            renderer.WarnUnknownKeys();
+         }
+
+         {
+            SectionReader latency(root, "latency");
+            latency.Read("targetFrameMs", settings.targetFrameMs);
+            latency.Read("report", settings.latencyReport);
+
+            string mode;
+
+            if (latency.Read("mode", mode) && !ParseLatencyMode(mode, settings.latencyMode))
+            {
+               throw runtime_error("unknown latency mode " + mode + ", expected throughput, vsync or low-latency");
+            }
+
+            latency.WarnUnknownKeys();
+         }
+
+         {
+            SectionReader dynamicResolution(root, "dynamicResolution");
+            dynamicResolution.Read("enabled", settings.dynamicResolution);
+            dynamicResolution.Read("gpuBudgetMs", settings.gpuBudgetMs);
+            dynamicResolution.Read("minScale", settings.minResolutionScale);
+            dynamicResolution.WarnUnknownKeys();
+         }
+
+         {
+            SectionReader scene(root, "scene");
+            scene.Read("drawCount", settings.drawCount);
+            scene.Read("instanceCount", settings.instanceCount);
+            scene.Read("meshes", settings.meshPaths);
+            scene.WarnUnknownKeys();
+         }
+
+         {
+            SectionReader shaders(root, "shaders");
+            shaders.Read("hotReload", settings.shaderHotReload);
+            shaders.Read("features", settings.shaderFeatures);
+            shaders.Read("prewarmVariants", settings.prewarmShaderVariants);
+            shaders.Read("variantReport", settings.shaderVariantReport);
+            shaders.WarnUnknownKeys();
+         }
+
+         {
+            SectionReader memory(root, "memory");
+            memory.Read("hostAllocator", settings.hostAllocator);
+            memory.Read("hostAllocationReport", settings.hostAllocationReport);
+            memory.WarnUnknownKeys();
+         }
+      }
+      catch (const json::exception& e)
+      {
+         throw runtime_error("Failed to load settings from " + path + ": " + e.what());
+      }
+      catch (const runtime_error& e)
+      {
+         throw runtime_error("Failed to load settings from " + path + ": " + e.what());
+      }
+
+      return true;
+   }
+
+   void SettingsLoader::Validate(const RendererSettings& settings)
+   {
+      if (settings.windowWidth <= 0 || settings.windowHeight <= 0)
+      {
+         throw runtime_error("Window size must be at least 1 by 1");
+      }
+
+      if (settings.framesInFlight == 0)
+      {
+         throw runtime_error("Frames in flight must be at least 1");
+      }
+
+      if (settings.pipelineCachePath.empty())
+      {
+         throw runtime_error("Pipeline cache path must not be empty");
+      }
+   }
+}
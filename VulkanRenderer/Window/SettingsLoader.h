@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+
+#include "HelloTriangle.h"
+
+namespace renderer {
+
+   // Fills RendererSettings from a JSON file, so the knobs benchmarks
+   // sweep can change between runs without a rebuild. Every key is
+   // optional and anything missing keeps its current value, so the
+   // command line can still override whatever the file sets.
+   //
+   //    {
+   //       "window": { "width": 800, "height": 600, "resize": true },
+   //       "renderer": { "framesInFlight": 2, "presentMode": "mailbox", "workerCount": 0,
+   //          "validation": false, "pipelineCachePath": "Data/pipeline.cache" },
+   //       "latency": { "mode": "throughput", "targetFrameMs": 0.0 },
+   //       ...
+   //    }
+   class SettingsLoader {
+   public:
+      static const char* DefaultPath;
+
+      // Returns false if there is no file at path, leaving settings as they
+      // were. Throws if it cannot be parsed or a value has the wrong type.
+      static bool Load(const std::string& path, RendererSettings& settings);
+
+      // Throws if the settings, wherever they came from, cannot be run with
+      static void Validate(const RendererSettings& settings);
+   };
+}
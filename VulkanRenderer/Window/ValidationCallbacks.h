@@ -1,37 +1,36 @@
 #pragma once
 #include <vulkan/vulkan.h>
-#include <iostream>
+
+#include "../Validation/ValidationSink.h"
 
 namespace renderer {
 
 	class ValidationCallbacks
 	{
 	public:
+		// pUserData is the ValidationSink. Runs inside the Vulkan call the
+		// message is about, so it only hands the message over.
 		static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(
-			VkDebugReportFlagsEXT flags,			// Message type
-			VkDebugReportObjectTypeEXT objType,	// Typoe of object that is the subject of the message
-			uint64_t obj,
-			size_t location,
-			int32_t code,
-			const char* layerPrefix,
-			const char* msg,
-			void* userData)							// Use to pass my own data to the callback
+			VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+			VkDebugUtilsMessageTypeFlagsEXT types,
+			const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
+			void* pUserData)
 		{
-			std::cerr << "validation layer: " << msg << std::endl;
+			static_cast<validation::ValidationSink*>(pUserData)->Push(severity, types, *pCallbackData);
 			return VK_FALSE;							// Returning true will abort the call with VK_ERROR_VALIDATION_FAILED_EXT error
 		}
 
-		static VkResult CreateDebugReportCallbackEXT(
+		static VkResult CreateDebugUtilsMessengerEXT(
 			VkInstance instance,
-			const VkDebugReportCallbackCreateInfoEXT* pCreateInfo,
+			const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
 			const VkAllocationCallbacks* pAllocator,
-			VkDebugReportCallbackEXT* pCallback)
+			VkDebugUtilsMessengerEXT* pMessenger)
 		{
-			auto func = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugReportCallbackEXT");
+			auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
 
 			if (func)
 			{
-				return func(instance, pCreateInfo, pAllocator, pCallback);
+				return func(instance, pCreateInfo, pAllocator, pMessenger);
 			}
 			else
 			{
@@ -39,16 +38,36 @@ namespace renderer {
 			}
 		}
 
-		static void DestroyDebugReportCallbackEXT(
+		static void DestroyDebugUtilsMessengerEXT(
 			VkInstance instance,
-			VkDebugReportCallbackEXT callback,
+			VkDebugUtilsMessengerEXT messenger,
 			const VkAllocationCallbacks* pAllocator)
 		{
-			auto func = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT");
+			auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+
+			if (func)
+			{
+				func(instance, messenger, pAllocator);
+			}
+		}
+
+		// Names show up in validation messages in place of bare handles
+		static void SetObjectName(
+			VkDevice device,
+			VkObjectType objectType,
+			uint64_t objectHandle,
+			const char* pName)
+		{
+			auto func = (PFN_vkSetDebugUtilsObjectNameEXT)vkGetDeviceProcAddr(device, "vkSetDebugUtilsObjectNameEXT");
 
 			if (func)
 			{
-				func(instance, callback, pAllocator);
+				VkDebugUtilsObjectNameInfoEXT nameInfo = {};
+				nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+				nameInfo.objectType = objectType;
+				nameInfo.objectHandle = objectHandle;
+				nameInfo.pObjectName = pName;
+				func(device, &nameInfo);
 			}
 		}
 	};
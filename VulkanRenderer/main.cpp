@@ -3,18 +3,387 @@
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
 
+#include <cctype>
+#include <cstring>
 #include <iostream>
+#include <string>
 
 #include "Application.h"
+#include "Benchmark/CullingBenchmark.h"
+#include "Benchmark/JobSystemBenchmark.h"
+#include "Benchmark/MeshLoadBenchmark.h"
+#include "Benchmark/RecordingBenchmark.h"
+#include "Benchmark/StartupBenchmark.h"
+#include "Mesh/MeshConverter.h"
+#include "Profiling/Trace.h"
+#include "Window/SettingsLoader.h"
 
 using namespace application;
+using namespace benchmark;
+using namespace mesh;
+using namespace presentation;
+using namespace profiling;
 
-int main() 
+// Only once every worker has been joined, so the trace buffers are quiet
+static void WriteTrace(const std::string& path)
 {
+	if (!path.empty() && !Trace::WriteChromeJson(path))
+	{
+		std::cerr << "Failed to write trace to " << path << std::endl;
+	}
+}
+
+int main(int argc, char* argv[]) 
+{
+	RendererSettings settings;
+	bool benchmarkStartup = false;
+	int benchmarkIterations = 5;
+	bool benchmarkRecording = false;
+	uint32_t benchmarkDrawCount = 10000;
+	bool benchmarkMeshLoad = false;
+	std::string benchmarkMeshPath;
+	bool benchmarkCulling = false;
+	int benchmarkCullingIterations = 100;
+	bool benchmarkJobs = false;
+	int benchmarkJobsIterations = 20;
+	std::string convertInputPath;
+	std::string convertOutputPath;
+	std::string tracePath;
+	std::string settingsPath = SettingsLoader::DefaultPath;
+
+	// The file is read first, so every flag below overrides it
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--settings") == 0)
+		{
+			settingsPath = argv[++i];
+		}
+	}
+
+	try
+	{
+		if (!SettingsLoader::Load(settingsPath, settings) && settingsPath != SettingsLoader::DefaultPath)
+		{
+			std::cerr << "Failed to open settings file " << settingsPath << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--settings") == 0 && i + 1 < argc)
+		{
+			i++;
+		}
+		else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+		{
+			settings.windowWidth = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc)
+		{
+			settings.windowHeight = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--no-resize") == 0)
+		{
+			settings.windowResizable = false;
+		}
+		else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+		{
+			settings.framesInFlight = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc)
+		{
+			if (!ParsePresentMode(argv[++i], settings.presentMode))
+			{
+				std::cerr << "Unknown present mode " << argv[i] << ", expected immediate, mailbox, fifo or fifo-relaxed" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (strcmp(argv[i], "--validation") == 0)
+		{
+			settings.validation = true;
+		}
+		else if (strcmp(argv[i], "--no-validation") == 0)
+		{
+			settings.validation = false;
+		}
+		else if (strcmp(argv[i], "--pipeline-cache") == 0 && i + 1 < argc)
+		{
+			settings.pipelineCachePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--headless") == 0)
+		{
+			settings.headless = true;
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			settings.headlessFrameCount = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+		{
+			settings.workerCount = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--draws") == 0 && i + 1 < argc)
+		{
+			settings.drawCount = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+		{
+			settings.instanceCount = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--hot-reload") == 0)
+		{
+			settings.shaderHotReload = true;
+		}
+		else if (strcmp(argv[i], "--shader-feature") == 0 && i + 1 < argc)
+		{
+			settings.shaderFeatures.push_back(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--prewarm-variants") == 0)
+		{
+			settings.prewarmShaderVariants = true;
+		}
+		else if (strcmp(argv[i], "--variant-report") == 0)
+		{
+			settings.shaderVariantReport = true;
+		}
+		else if (strcmp(argv[i], "--system-host-allocator") == 0)
+		{
+			settings.hostAllocator = false;
+		}
+		else if (strcmp(argv[i], "--host-allocation-report") == 0)
+		{
+			settings.hostAllocationReport = true;
+		}
+		else if (strcmp(argv[i], "--latency-mode") == 0 && i + 1 < argc)
+		{
+			if (!ParseLatencyMode(argv[++i], settings.latencyMode))
+			{
+				std::cerr << "Unknown latency mode " << argv[i] << ", expected throughput, vsync or low-latency" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (strcmp(argv[i], "--target-frame-ms") == 0 && i + 1 < argc)
+		{
+			settings.targetFrameMs = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--latency-report") == 0)
+		{
+			settings.latencyReport = true;
+		}
+		else if (strcmp(argv[i], "--dynamic-resolution") == 0)
+		{
+			settings.dynamicResolution = true;
+
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+			{
+				settings.gpuBudgetMs = atof(argv[++i]);
+			}
+		}
+		else if (strcmp(argv[i], "--min-resolution-scale") == 0 && i + 1 < argc)
+		{
+			settings.minResolutionScale = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc)
+		{
+			settings.meshPaths.push_back(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--convert-mesh") == 0 && i + 2 < argc)
+		{
+			convertInputPath = argv[++i];
+			convertOutputPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--trace") == 0)
+		{
+			tracePath = "Data/trace.json";
+
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				tracePath = argv[++i];
+			}
+		}
+		else if (strcmp(argv[i], "--benchmark-startup") == 0)
+		{
+			benchmarkStartup = true;
+
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+			{
+				benchmarkIterations = atoi(argv[++i]);
+			}
+		}
+		else if (strcmp(argv[i], "--benchmark-recording") == 0)
+		{
+			benchmarkRecording = true;
+
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+			{
+				benchmarkDrawCount = (uint32_t)atoi(argv[++i]);
+			}
+		}
+		else if (strcmp(argv[i], "--benchmark-mesh-load") == 0)
+		{
+			benchmarkMeshLoad = true;
+
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				benchmarkMeshPath = argv[++i];
+			}
+		}
+		else if (strcmp(argv[i], "--benchmark-culling") == 0)
+		{
+			benchmarkCulling = true;
+
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+			{
+				benchmarkCullingIterations = atoi(argv[++i]);
+			}
+		}
+		else if (strcmp(argv[i], "--benchmark-jobs") == 0)
+		{
+			benchmarkJobs = true;
+
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+			{
+				benchmarkJobsIterations = atoi(argv[++i]);
+			}
+		}
+	}
+
+	try
+	{
+		SettingsLoader::Validate(settings);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (!tracePath.empty() && !Trace::IsEnabled())
+	{
+		std::cerr << "Tracing is compiled out of this build, rebuild with ENABLE_TRACING=1" << std::endl;
+		tracePath.clear();
+	}
+
+	TRACE_THREAD_NAME("Main");
+
+	// Offline conversion, no renderer needed
+	if (!convertInputPath.empty())
+	{
+		int exitCode = EXIT_FAILURE;
+
+		try
+		{
+			MeshConverter converter;
+			exitCode = converter.Run(convertInputPath, convertOutputPath);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+		}
+
+		return exitCode;
+	}
+
+	if (benchmarkStartup)
+	{
+		int exitCode = EXIT_FAILURE;
+
+		try
+		{
+			StartupBenchmark startupBenchmark;
+			exitCode = startupBenchmark.Run(settings, benchmarkIterations);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+		}
+
+		WriteTrace(tracePath);
+		return exitCode;
+	}
+
+	if (benchmarkRecording)
+	{
+		int exitCode = EXIT_FAILURE;
+
+		try
+		{
+			RecordingBenchmark recordingBenchmark;
+			exitCode = recordingBenchmark.Run(settings, benchmarkDrawCount, 200);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+		}
+
+		WriteTrace(tracePath);
+		return exitCode;
+	}
+
+	if (benchmarkMeshLoad)
+	{
+		int exitCode = EXIT_FAILURE;
+
+		try
+		{
+			MeshLoadBenchmark meshLoadBenchmark;
+			exitCode = meshLoadBenchmark.Run(benchmarkMeshPath, 5);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+		}
+
+		WriteTrace(tracePath);
+		return exitCode;
+	}
+
+	if (benchmarkCulling)
+	{
+		int exitCode = EXIT_FAILURE;
+
+		try
+		{
+			CullingBenchmark cullingBenchmark;
+			exitCode = cullingBenchmark.Run(benchmarkCullingIterations);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+		}
+
+		WriteTrace(tracePath);
+		return exitCode;
+	}
+
+	if (benchmarkJobs)
+	{
+		int exitCode = EXIT_FAILURE;
+
+		try
+		{
+			JobSystemBenchmark jobSystemBenchmark;
+			exitCode = jobSystemBenchmark.Run(benchmarkJobsIterations);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+		}
+
+		WriteTrace(tracePath);
+		return exitCode;
+	}
+
 	Application app;
 	int exitCode = EXIT_SUCCESS;
 
-	app.Initialise();
+	app.Initialise(settings);
 
 	int n;
 
@@ -25,15 +394,23 @@ int main()
 	catch (const std::exception& e) 
 	{
 		std::cerr << e.what() << std::endl;
-		std::cin >> n;
 
-		
+		if (!settings.headless)
+		{
+			std::cin >> n;
+		}
+
 		exitCode = EXIT_FAILURE;
 	}
 
-	std::cin >> n;
+	// Keep the console open, unless nobody is there to close it
+	if (!settings.headless)
+	{
+		std::cin >> n;
+	}
 
 	app.Destroy();
+	WriteTrace(tracePath);
 
 	return exitCode;
 }
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "Test.h"
+
+#include <algorithm>
+
+#include "../VulkanRenderer/RenderGraph/RenderGraph.h"
+
+using namespace rendergraph;
+using namespace std;
+
+namespace {
+
+   const VkExtent2D Extent = { 64, 64 };
+
+   const Barrier* FindBarrier(const BarrierBatch& batch, ResourceHandle resource)
+   {
+      auto barrier = find_if(batch.barriers.begin(), batch.barriers.end(), [&](const Barrier& b) { return b.resource == resource; });
+      return barrier != batch.barriers.end() ? &*barrier : nullptr;
+   }
+}
+
+TEST(RenderGraphPlacesBarrierBeforeReader)
+{
+   RenderGraph graph;
+   ResourceHandle colour = graph.CreateImage("Colour", VK_FORMAT_R8G8B8A8_UNORM, Extent);
+   ResourceHandle output = graph.CreateImage("Output", VK_FORMAT_R8G8B8A8_UNORM, Extent);
+
+   PassHandle draw = graph.AddPass("Draw", nullptr);
+   graph.Write(draw, colour, ResourceUsage::ColourAttachment);
+
+   PassHandle resolve = graph.AddPass("Resolve", nullptr);
+   graph.Read(resolve, colour, ResourceUsage::FragmentSampled);
+   graph.Write(resolve, output, ResourceUsage::ColourAttachment);
+   graph.MarkOutput(output);
+
+   CompiledGraph compiled = graph.Compile();
+   CHECK(compiled.passes.size() == 2);
+   CHECK(compiled.culledPassCount == 0);
+
+   // The first write only moves out of undefined
+   const Barrier* pFirst = FindBarrier(compiled.passes[0].barriers, colour);
+   CHECK(pFirst != nullptr);
+   CHECK(pFirst && pFirst->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+   CHECK(pFirst && pFirst->newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+   // The read waits for the write and changes the layout
+   const BarrierBatch& batch = compiled.passes[1].barriers;
+   const Barrier* pRead = FindBarrier(batch, colour);
+   CHECK(pRead != nullptr);
+   CHECK(pRead && pRead->oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+   CHECK(pRead && pRead->newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+   CHECK(pRead && (pRead->srcAccess & VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT));
+   CHECK(pRead && pRead->dstAccess == VK_ACCESS_SHADER_READ_BIT);
+   CHECK(batch.srcStages & VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+   CHECK(batch.dstStages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+TEST(RenderGraphCullsUnusedPasses)
+{
+   RenderGraph graph;
+   ResourceHandle unused = graph.CreateImage("Unused", VK_FORMAT_R8G8B8A8_UNORM, Extent);
+   ResourceHandle output = graph.CreateImage("Output", VK_FORMAT_R8G8B8A8_UNORM, Extent);
+
+   PassHandle dead = graph.AddPass("Dead", nullptr);
+   graph.Write(dead, unused, ResourceUsage::ColourAttachment);
+
+   PassHandle draw = graph.AddPass("Draw", nullptr);
+   graph.Write(draw, output, ResourceUsage::ColourAttachment);
+   graph.MarkOutput(output);
+
+   CompiledGraph compiled = graph.Compile();
+   CHECK(compiled.culledPassCount == 1);
+   CHECK(compiled.passes.size() == 1);
+   CHECK(compiled.passes.size() == 1 && compiled.passes[0].pass == draw);
+   CHECK(!compiled.lifetimes[unused].IsUsed());
+}
+
+TEST(RenderGraphBatchesBarriersPerPass)
+{
+   RenderGraph graph;
+   ResourceHandle colour = graph.CreateImage("Colour", VK_FORMAT_R8G8B8A8_UNORM, Extent);
+   ResourceHandle depth = graph.CreateImage("Depth", VK_FORMAT_D32_SFLOAT, Extent, VK_IMAGE_ASPECT_DEPTH_BIT);
+   ResourceHandle output = graph.CreateImage("Output", VK_FORMAT_R8G8B8A8_UNORM, Extent);
+
+   PassHandle draw = graph.AddPass("Draw", nullptr);
+   graph.Write(draw, colour, ResourceUsage::ColourAttachment);
+   graph.Write(draw, depth, ResourceUsage::DepthStencilAttachment);
+
+   PassHandle composite = graph.AddPass("Composite", nullptr);
+   graph.Read(composite, colour, ResourceUsage::FragmentSampled);
+   graph.Read(composite, depth, ResourceUsage::FragmentSampled);
+   graph.Write(composite, output, ResourceUsage::ColourAttachment);
+   graph.MarkOutput(output);
+
+   CompiledGraph compiled = graph.Compile();
+   CHECK(compiled.passes.size() == 2);
+
+   // Both transitions land in the one batch, with the stages of both writers
+   const BarrierBatch& batch = compiled.passes[1].barriers;
+   CHECK(FindBarrier(batch, colour) != nullptr);
+   CHECK(FindBarrier(batch, depth) != nullptr);
+   CHECK(FindBarrier(batch, output) != nullptr);
+   CHECK(batch.barriers.size() == 3);
+   CHECK(batch.srcStages & VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+   CHECK(batch.srcStages & VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+   CHECK(batch.dstStages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+TEST(RenderGraphSkipsReadAfterReadInSameStage)
+{
+   RenderGraph graph;
+   ResourceHandle colour = graph.CreateImage("Colour", VK_FORMAT_R8G8B8A8_UNORM, Extent);
+
+   PassHandle draw = graph.AddPass("Draw", nullptr);
+   graph.Write(draw, colour, ResourceUsage::ColourAttachment);
+
+   PassHandle first = graph.AddPass("First", nullptr);
+   graph.Read(first, colour, ResourceUsage::FragmentSampled);
+   graph.SetSideEffects(first);
+
+   PassHandle second = graph.AddPass("Second", nullptr);
+   graph.Read(second, colour, ResourceUsage::FragmentSampled);
+   graph.SetSideEffects(second);
+
+   CompiledGraph compiled = graph.Compile();
+   CHECK(compiled.passes.size() == 3);
+   CHECK(FindBarrier(compiled.passes[1].barriers, colour) != nullptr);
+   CHECK(FindBarrier(compiled.passes[2].barriers, colour) == nullptr);
+   CHECK(compiled.passes[2].barriers.IsEmpty());
+}
+
+TEST(RenderGraphOrdersSecondReaderAfterLayoutChange)
+{
+   RenderGraph graph;
+   ResourceHandle colour = graph.CreateImage("Colour", VK_FORMAT_R8G8B8A8_UNORM, Extent);
+
+   PassHandle draw = graph.AddPass("Draw", nullptr);
+   graph.Write(draw, colour, ResourceUsage::ColourAttachment);
+
+   // Changes the layout, and only the fragment stage waits for the write
+   PassHandle fragment = graph.AddPass("Fragment", nullptr);
+   graph.Read(fragment, colour, ResourceUsage::FragmentSampled);
+   graph.SetSideEffects(fragment);
+
+   // Same layout, but a stage that has not waited for anything yet
+   PassHandle compute = graph.AddPass("Compute", nullptr);
+   graph.Read(compute, colour, ResourceUsage::ComputeSampled);
+   graph.SetSideEffects(compute);
+
+   PassHandle fragmentAgain = graph.AddPass("FragmentAgain", nullptr);
+   graph.Read(fragmentAgain, colour, ResourceUsage::FragmentSampled);
+   graph.SetSideEffects(fragmentAgain);
+
+   PassHandle redraw = graph.AddPass("Redraw", nullptr);
+   graph.Write(redraw, colour, ResourceUsage::ColourAttachment);
+   graph.SetSideEffects(redraw);
+
+   CompiledGraph compiled = graph.Compile();
+   CHECK(compiled.passes.size() == 5);
+
+   // The compute read still needs the colour write made visible to it,
+   // and has to follow the layout transition made for the fragment read
+   const BarrierBatch& computeBatch = compiled.passes[2].barriers;
+   const Barrier* pCompute = FindBarrier(computeBatch, colour);
+   CHECK(pCompute != nullptr);
+   CHECK(pCompute && (pCompute->srcAccess & VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT));
+   CHECK(pCompute && pCompute->dstAccess == VK_ACCESS_SHADER_READ_BIT);
+   CHECK(pCompute && pCompute->oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+   CHECK(pCompute && pCompute->newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+   CHECK(computeBatch.srcStages & VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+   CHECK(computeBatch.srcStages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+   CHECK(computeBatch.dstStages & VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+   // Both stages have seen the write by now
+   CHECK(FindBarrier(compiled.passes[3].barriers, colour) == nullptr);
+
+   // The next write waits for every reader
+   const BarrierBatch& redrawBatch = compiled.passes[4].barriers;
+   CHECK(FindBarrier(redrawBatch, colour) != nullptr);
+   CHECK(redrawBatch.srcStages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+   CHECK(redrawBatch.srcStages & VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+}
+
+TEST(RenderGraphAliasesTransientsWithDisjointLifetimes)
+{
+   RenderGraph graph;
+   ResourceHandle a = graph.CreateImage("A", VK_FORMAT_R8G8B8A8_UNORM, Extent);
+   ResourceHandle b = graph.CreateImage("B", VK_FORMAT_R8G8B8A8_UNORM, Extent);
+   ResourceHandle c = graph.CreateImage("C", VK_FORMAT_R8G8B8A8_UNORM, Extent);
+
+   PassHandle first = graph.AddPass("First", nullptr);
+   graph.Write(first, a, ResourceUsage::ColourAttachment);
+
+   PassHandle second = graph.AddPass("Second", nullptr);
+   graph.Read(second, a, ResourceUsage::FragmentSampled);
+   graph.Write(second, b, ResourceUsage::ColourAttachment);
+
+   PassHandle third = graph.AddPass("Third", nullptr);
+   graph.Read(third, b, ResourceUsage::FragmentSampled);
+   graph.Write(third, c, ResourceUsage::ColourAttachment);
+
+   PassHandle fourth = graph.AddPass("Fourth", nullptr);
+   graph.Read(fourth, c, ResourceUsage::FragmentSampled);
+   graph.SetSideEffects(fourth);
+
+   CompiledGraph compiled = graph.Compile();
+   CHECK(compiled.lifetimes[a].firstPass == 0 && compiled.lifetimes[a].lastPass == 1);
+   CHECK(compiled.lifetimes[b].firstPass == 1 && compiled.lifetimes[b].lastPass == 2);
+   CHECK(compiled.lifetimes[c].firstPass == 2 && compiled.lifetimes[c].lastPass == 3);
+
+   vector<TransientRequest> requests = { { a, 1000, 256 }, { b, 1000, 256 }, { c, 1000, 256 } };
+   TransientPlacement placement = graph.PlaceTransients(compiled, requests);
+
+   // A and C never live at the same time, B overlaps both
+   CHECK(placement.offsets[0] == placement.offsets[2]);
+   CHECK(placement.offsets[1] == 1024);
+   CHECK(placement.offsets[1] % 256 == 0);
+   CHECK(placement.heapSize == 2024);
+   CHECK(placement.unaliasedSize == 3000);
+
+   // C's first write waits for A's last read of the same memory
+   const BarrierBatch& handover = compiled.passes[2].barriers;
+   CHECK(handover.srcStages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+   CHECK(handover.dstStages & VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+   CHECK(handover.memoryDstAccess & VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+   // And next frame, A's first write waits for C's last read
+   CHECK(compiled.passes[0].barriers.srcStages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
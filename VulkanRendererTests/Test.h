@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace test {
+
+   // Tests register themselves before main runs. CHECK records a failure
+   // and carries on, so one run reports everything that is wrong.
+   struct TestCase
+   {
+      const char* name;
+      void (*function)();
+   };
+
+   std::vector<TestCase>& Registry();
+   uint32_t& FailureCount();
+   void Fail(const char* file, int line, const char* expression);
+
+   struct Registrar
+   {
+      Registrar(const char* name, void (*function)()) { Registry().push_back({ name, function }); }
+   };
+}
+
+#define TEST(name) \
+   static void name(); \
+   static test::Registrar name##Registrar(#name, name); \
+   static void name()
+
+#define CHECK(expression) \
+   do { if (!(expression)) test::Fail(__FILE__, __LINE__, #expression); } while (false)
@@ -0,0 +1,49 @@
+#include "Test.h"
+
+#include <iostream>
+
+using namespace std;
+
+namespace test {
+
+   vector<TestCase>& Registry()
+   {
+      static vector<TestCase> tests;
+      return tests;
+   }
+
+   uint32_t& FailureCount()
+   {
+      static uint32_t count = 0;
+      return count;
+   }
+
+   void Fail(const char* file, int line, const char* expression)
+   {
+      cout << "\t" << file << "(" << line << "): CHECK(" << expression << ") failed" << endl;
+      FailureCount()++;
+   }
+}
+
+// Runs every test and returns the number that failed, so a build step or
+// script can tell from the exit code alone
+int main()
+{
+   uint32_t failedTests = 0;
+
+   for (const auto& test : test::Registry())
+   {
+      uint32_t failuresBefore = test::FailureCount();
+
+      cout << test.name << endl;
+      test.function();
+
+      if (test::FailureCount() != failuresBefore)
+      {
+         failedTests++;
+      }
+   }
+
+   cout << test::Registry().size() - failedTests << " of " << test::Registry().size() << " tests passed" << endl;
+   return (int)failedTests;
+}
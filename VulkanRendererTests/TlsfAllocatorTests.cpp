@@ -0,0 +1,193 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <random>
+
+#include "../VulkanRenderer/Memory/TlsfAllocator.h"
+
+using namespace memory;
+using namespace std;
+
+TEST(TlsfAllocatesAndFrees)
+{
+   TlsfAllocator allocator(1024);
+   TlsfAllocation a, b, c;
+
+   CHECK(allocator.Allocate(100, 1, a));
+   CHECK(allocator.Allocate(200, 1, b));
+   CHECK(allocator.Allocate(300, 1, c));
+   CHECK(a.offset == 0 && b.offset == 100 && c.offset == 300);
+   CHECK(allocator.UsedBytes() == 600);
+   CHECK(allocator.FreeBytes() == 424);
+   CHECK(allocator.AllocationCount() == 3);
+
+   allocator.Free(b);
+   CHECK(allocator.UsedBytes() == 400);
+   CHECK(allocator.AllocationCount() == 2);
+
+   // The freed block is reused
+   TlsfAllocation d;
+   CHECK(allocator.Allocate(200, 1, d));
+   CHECK(d.offset == 100);
+
+   allocator.Free(a);
+   allocator.Free(c);
+   allocator.Free(d);
+   CHECK(allocator.IsEmpty());
+   CHECK(allocator.UsedBytes() == 0);
+
+   // Zero sized requests are refused
+   TlsfAllocation empty;
+   CHECK(!allocator.Allocate(0, 1, empty));
+}
+
+TEST(TlsfCoalescesNeighbours)
+{
+   TlsfAllocator allocator(1024);
+   TlsfAllocation a, b, c;
+
+   CHECK(allocator.Allocate(256, 1, a));
+   CHECK(allocator.Allocate(256, 1, b));
+   CHECK(allocator.Allocate(512, 1, c));
+   CHECK(allocator.FreeBlockCount() == 0);
+
+   // Not neighbours, so they stay apart
+   allocator.Free(a);
+   allocator.Free(c);
+   CHECK(allocator.FreeBlockCount() == 2);
+   CHECK(allocator.LargestFreeBlock() == 512);
+
+   // Joins both sides into the whole range again
+   allocator.Free(b);
+   CHECK(allocator.FreeBlockCount() == 1);
+   CHECK(allocator.LargestFreeBlock() == 1024);
+
+   TlsfAllocation all;
+   CHECK(allocator.Allocate(1024, 1, all));
+   CHECK(all.offset == 0);
+}
+
+TEST(TlsfHonoursAlignment)
+{
+   TlsfAllocator allocator(1 << 20);
+   TlsfAllocation first, aligned, padding;
+
+   CHECK(allocator.Allocate(1, 1, first));
+   CHECK(allocator.Allocate(64, 256, aligned));
+   CHECK(aligned.offset == 256);
+
+   // The bytes skipped to align are still free
+   CHECK(allocator.Allocate(100, 1, padding));
+   CHECK(padding.offset >= 1 && padding.offset + 100 <= 256);
+
+   const uint64_t alignments[] = { 1, 4, 16, 256, 4096, 65536 };
+   vector<TlsfAllocation> allocations;
+
+   for (uint32_t i = 0; i < 60; i++)
+   {
+      uint64_t alignment = alignments[i % 6];
+      TlsfAllocation allocation;
+
+      CHECK(allocator.Allocate(100 + i * 37, alignment, allocation));
+      CHECK(allocation.offset % alignment == 0);
+      allocations.push_back(allocation);
+   }
+
+   for (const auto& allocation : allocations)
+   {
+      allocator.Free(allocation);
+   }
+
+   allocator.Free(first);
+   allocator.Free(aligned);
+   allocator.Free(padding);
+   CHECK(allocator.IsEmpty());
+   CHECK(allocator.FreeBlockCount() == 1);
+}
+
+TEST(TlsfFailsWhenExhausted)
+{
+   TlsfAllocator allocator(4096);
+   vector<TlsfAllocation> allocations;
+   TlsfAllocation allocation;
+
+   while (allocator.Allocate(64, 64, allocation))
+   {
+      allocations.push_back(allocation);
+   }
+
+   CHECK(allocations.size() == 64);
+   CHECK(allocator.FreeBytes() == 0);
+   CHECK(allocator.LargestFreeBlock() == 0);
+
+   // One freed block is exactly enough for one more
+   allocator.Free(allocations[10]);
+   CHECK(!allocator.Allocate(65, 1, allocation));
+   CHECK(allocator.Allocate(64, 64, allocation));
+   CHECK(allocation.offset == allocations[10].offset);
+
+   // A request that exactly fits what is left still fits, even though it
+   // does not fill its size class
+   TlsfAllocator exact(1000);
+   CHECK(exact.Allocate(1000, 1, allocation));
+   CHECK(!exact.Allocate(1, 1, allocation));
+
+   TlsfAllocator tooSmall(1000);
+   CHECK(!tooSmall.Allocate(1001, 1, allocation));
+   CHECK(tooSmall.IsEmpty());
+}
+
+TEST(TlsfRandomAllocationsNeverOverlap)
+{
+   TlsfAllocator allocator(1 << 24);
+   vector<TlsfAllocation> live;
+   mt19937 random(1234);
+
+   for (uint32_t i = 0; i < 5000; i++)
+   {
+      if (live.empty() || random() % 3 != 0)
+      {
+         TlsfAllocation allocation;
+         uint64_t alignment = 1ull << (random() % 12);
+
+         if (allocator.Allocate(1 + random() % 20000, alignment, allocation))
+         {
+            CHECK(allocation.offset % alignment == 0);
+            CHECK(allocation.offset + allocation.size <= allocator.Size());
+            live.push_back(allocation);
+         }
+      }
+      else
+      {
+         size_t index = random() % live.size();
+         allocator.Free(live[index]);
+         live.erase(live.begin() + index);
+      }
+   }
+
+   sort(live.begin(), live.end(), [](const TlsfAllocation& a, const TlsfAllocation& b) { return a.offset < b.offset; });
+
+   uint64_t usedBytes = 0;
+
+   for (size_t i = 0; i < live.size(); i++)
+   {
+      usedBytes += live[i].size;
+
+      if (i > 0)
+      {
+         CHECK(live[i - 1].offset + live[i - 1].size <= live[i].offset);
+      }
+   }
+
+   CHECK(allocator.UsedBytes() == usedBytes);
+   CHECK(allocator.AllocationCount() == live.size());
+
+   for (const auto& allocation : live)
+   {
+      allocator.Free(allocation);
+   }
+
+   CHECK(allocator.IsEmpty());
+   CHECK(allocator.FreeBlockCount() == 1);
+   CHECK(allocator.LargestFreeBlock() == allocator.Size());
+}